@@ -0,0 +1,194 @@
+import {randomUUID} from "crypto";
+import {mkdtempSync, rmSync, writeFileSync} from "fs";
+import {tmpdir} from "os";
+import {join} from "path";
+import {Hypervisor, Domain, DomainInfoSlot, libvirt} from "../lib/binding";
+
+/**
+ * Binding overhead benchmarks against the libvirt test driver, no hypervisor required.
+ *
+ *   npm run bench -- [--out results.json] [--filter substring] [--quick]
+ *
+ * Prints a summary to stderr and one JSON document to stdout (or --out) for comparing runs.
+ */
+
+type Result = {
+    name: string,
+    iterations: number,
+    concurrency: number,
+    totalMs: number,
+    opsPerSec: number,
+    /** per call latency in microseconds */
+    meanUs: number,
+    p50Us: number,
+    p95Us: number,
+    p99Us: number,
+    maxUs: number
+}
+
+const args = process.argv.slice(2);
+const option = (name: string) => {
+    const index = args.indexOf(name);
+    return index >= 0 ? args[index + 1] : undefined;
+}
+const quick = args.includes("--quick");
+const filter = option("--filter");
+const out = option("--out");
+const scale = quick ? 0.1 : 1;
+
+const results: Result[] = [];
+
+function percentile(sorted: number[], p: number) {
+    return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+function record(name: string, samples: number[], totalNs: number, concurrency: number) {
+    const sorted = samples.map((ns) => ns / 1000).sort((a, b) => a - b);
+    const totalMs = totalNs / 1e6;
+    const result: Result = {
+        name,
+        iterations: samples.length,
+        concurrency,
+        totalMs,
+        opsPerSec: samples.length / (totalMs / 1000),
+        meanUs: sorted.reduce((sum, us) => sum + us, 0) / sorted.length,
+        p50Us: percentile(sorted, 0.5),
+        p95Us: percentile(sorted, 0.95),
+        p99Us: percentile(sorted, 0.99),
+        maxUs: sorted[sorted.length - 1]
+    };
+    results.push(result);
+    console.error(`${name.padEnd(48)} ${result.opsPerSec.toFixed(0).padStart(10)} ops/s  ` +
+        `p50 ${result.p50Us.toFixed(1)}us  p99 ${result.p99Us.toFixed(1)}us`);
+}
+
+const enabled = (name: string) => !filter || name.includes(filter);
+
+function benchSync(name: string, iterations: number, fn: (i: number) => unknown) {
+    if (!enabled(name)) return;
+    iterations = Math.max(1, Math.round(iterations * scale));
+    for (let i = 0; i < Math.min(100, iterations); i++) fn(i);
+
+    const samples = new Array<number>(iterations);
+    const start = process.hrtime.bigint();
+    for (let i = 0; i < iterations; i++) {
+        const t0 = process.hrtime.bigint();
+        fn(i);
+        samples[i] = Number(process.hrtime.bigint() - t0);
+    }
+    record(name, samples, Number(process.hrtime.bigint() - start), 1);
+}
+
+async function benchAsync(name: string, iterations: number, concurrency: number, fn: (i: number) => Promise<unknown>) {
+    if (!enabled(name)) return;
+    iterations = Math.max(1, Math.round(iterations * scale));
+    const warmup = Math.min(10, iterations);
+    for (let i = 0; i < warmup; i++) await fn(i);
+
+    /* Measured calls continue the index after the warmup, so per index keys are not reused */
+    const samples = new Array<number>(iterations);
+    let next = 0;
+    const start = process.hrtime.bigint();
+    const lane = async () => {
+        while (next < iterations) {
+            const i = next++;
+            const t0 = process.hrtime.bigint();
+            await fn(warmup + i);
+            samples[i] = Number(process.hrtime.bigint() - t0);
+        }
+    };
+    await Promise.all(Array.from({length: concurrency}, lane));
+    record(name, samples, Number(process.hrtime.bigint() - start), concurrency);
+}
+
+/**
+ * Test driver node definition with count running guests, each connection to it gets its own copy.
+ */
+function testDriverURI(directory: string, count: number) {
+    const domains = Array.from({length: count}, (_, i) => `
+  <domain type='test'>
+    <name>bench-${i}</name>
+    <uuid>${randomUUID()}</uuid>
+    <memory>8192</memory>
+    <vcpu>1</vcpu>
+    <os><type>hvm</type></os>
+  </domain>`).join("");
+    const file = join(directory, `node-${count}.xml`);
+    writeFileSync(file, `<node>${domains}\n</node>\n`);
+    return `test://${file}`;
+}
+
+async function main() {
+    const directory = mkdtempSync(join(tmpdir(), "node-libvirt-bench-"));
+    try {
+//region accessors and worker round trips on the default test driver
+        const hypervisor = new Hypervisor({uri: "test:///default"});
+        await hypervisor.connect();
+        const domain = await hypervisor.lookupDomainByName("test");
+        const target = new Float64Array(DomainInfoSlot.STRIDE);
+
+        benchSync("domain.info", 100000, () => domain.info);
+        benchSync("domain.infoInto", 100000, () => domain.infoInto(target));
+        benchSync("domain.name", 100000, () => domain.name);
+        benchSync("domain.uuid", 100000, () => domain.uuid);
+
+        await benchAsync("lookupDomainByName cached", 20000, 1, () => hypervisor.lookupDomainByName("test"));
+        await benchAsync("domain.toXML", 20000, 1, () => domain.toXML(0));
+        await benchAsync("domain.toXML x64", 50000, 64, () => domain.toXML(0));
+
+        const xml = await domain.toXML(0);
+        await benchAsync("xml round trip (toXML + DefineXML)", 5000, 1, async () => {
+            await Domain.DefineXML(await domain.toXML(0), hypervisor);
+        });
+        await benchAsync("DefineXML", 5000, 1, () => Domain.DefineXML(xml, hypervisor));
+        await hypervisor.disconnect();
+//endregion
+
+//region listing and lookups by number of guests
+        for (const count of [10, 1000, 10000]) {
+            const scaled = Math.max(10, Math.round(count * scale));
+            const many = new Hypervisor({uri: testDriverURI(directory, scaled)});
+            await many.connect();
+
+            benchSync(`domains() ${count}`, Math.max(5, Math.round(200000 / count)), () => many.domains());
+
+            /* Each name once, so every lookup misses the registry and takes a worker hop */
+            if (scaled > 100) {
+                await benchAsync(`lookupDomainByName uncached ${count}`, Math.min(scaled - 10, 2000) / scale, 1,
+                    (i) => many.lookupDomainByName(`bench-${i}`));
+            }
+
+            const names = Array.from({length: scaled}, (_, i) => `bench-${i}`);
+            await benchAsync(`lookupDomains ${count}`, Math.max(5, Math.round(20000 / count)), 1,
+                () => many.lookupDomains({names}));
+
+            const domains = many.domains();
+            const samples = new BigUint64Array(domains.length * DomainInfoSlot.STRIDE);
+            await benchAsync(`domainsInfoInto ${count}`, Math.max(5, Math.round(20000 / count)), 1,
+                () => many.domainsInfoInto(domains, samples));
+            await many.disconnect();
+        }
+//endregion
+    } finally {
+        rmSync(directory, {recursive: true, force: true});
+    }
+
+    const report = JSON.stringify({
+        timestamp: new Date().toISOString(),
+        node: process.version,
+        libvirt: libvirt.GetVersion(),
+        quick,
+        executor: libvirt.GetExecutorStats(),
+        results
+    }, null, 2);
+    if (out) {
+        writeFileSync(out, report + "\n");
+    } else {
+        console.log(report);
+    }
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
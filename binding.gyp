@@ -6,8 +6,30 @@
         'src/node-libvirt.cpp',
         'src/hypervisor.cpp',
         'src/domain.cpp',
+        'src/domain_stats.cpp',
+        'src/domain_events.cpp',
+        'src/event_loop.cpp',
+        'src/connection_pool.cpp',
+        'src/executor.cpp',
+        'src/domain_registry.cpp',
+        'src/stream.cpp',
+        'src/xml_projection.cpp',
+        'src/host_data.cpp',
+        'src/batch_runner.cpp',
+        'src/bulk_operation.cpp',
+        'src/migration.cpp',
+        'src/io_sampler.cpp',
+        'src/cpu_stats.cpp',
+        'src/metrics.cpp',
+        'src/snapshots.cpp',
+        'src/storage_pool.cpp',
+        'src/storage_volume.cpp',
+        'src/volume_clone.cpp',
+        'src/address_inventory.cpp',
+        'src/connection_registry.cpp',
+        'src/balloon_controller.cpp',
        ],
-      'include_dirs': ["<!@(node -p \"require('node-addon-api').include\")","/usr/include/libvirt"],
+      'include_dirs': ["<!@(node -p \"require('node-addon-api').include\")","/usr/include/libvirt","<!@(pkg-config --cflags-only-I libxml-2.0 | sed s/-I//g)"],
       'dependencies': ["<!(node -p \"require('node-addon-api').gyp\")"],
       'libraries': ["/usr/lib/x86_64-linux-gnu/libvirt.so.0"],
       'cflags!': [ '-fno-exceptions' ],
@@ -22,7 +44,8 @@
       },
       "link_settings": {
                       "libraries": [
-                          "<!@(pkg-config --libs libvirt)"
+                          "<!@(pkg-config --libs libvirt)",
+                          "<!@(pkg-config --libs libxml-2.0)"
                       ]
              }
     }
@@ -5,9 +5,38 @@ const $ = require("./../build/Release/node-libvirt.node") as virt;
 
 export const Hypervisor = $.Hypervisor;
 export const Domain = $.Domain;
+export const Stream = $.Stream;
+export const IoSampler = $.IoSampler;
+export const StoragePool = $.StoragePool;
+export const StorageVolume = $.StorageVolume;
+export const BalloonController = $.BalloonController;
+
+export {
+    DomainInfoSlot,
+    MemoryStatSlot,
+    DomainMemoryModFlags,
+    DomainMigrateFlags,
+    DomainSnapshotCreateFlags,
+    DomainSnapshotListFlags,
+    DomainSnapshotRevertFlags,
+    DomainSnapshotDeleteFlags
+} from "./types/domain";
+export {NodeInfoSlot, HostCpuSlot, DomainCpuSlot, VcpuSlot} from "./types/nodeinfo";
+export {BlockRateSlot, InterfaceRateSlot, IO_RATE_STRIDE} from "./types/iosampler";
+export {StoragePoolState, StorageVolType, StorageVolCreateFlags} from "./types/storage";
+export {IPAddrType, AddressSource} from "./types/network";
+export {DomainStatsTypes, ConnectGetAllDomainStatsFlags} from "./types/domainstats";
+export {DomainLifecycleEvent} from "./types/events";
+export {DomainEventEmitter, domainEvents} from "./events";
+export {StreamDuplex, openConsole, volumeUpload, volumeDownload} from "./stream";
 
 export const libvirt = {
     GetVersion: $.GetVersion,
+    GetExecutorStats: $.GetExecutorStats,
+    ConfigureExecutor: $.ConfigureExecutor,
+    GetMetrics: $.GetMetrics,
+    ResetMetrics: $.ResetMetrics,
+    GetSharedConnections: $.GetSharedConnections,
     GetVersionObject: () => {
         const version = $.GetVersion();
         return {
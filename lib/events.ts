@@ -0,0 +1,55 @@
+import {EventEmitter, on} from "events";
+import {type DomainEvent, type DomainEventOptions} from "./types/events";
+
+type EventSource = {
+    registerDomainEvents(listener: (events: DomainEvent[], dropped: number) => void, options?: DomainEventOptions): Promise<void>
+    deregisterDomainEvents(): Promise<void>
+};
+
+/**
+ * EventEmitter facade over the native domain event subscription of a hypervisor.
+ *
+ * Emits every event as `event` and under its type (`lifecycle`, `reboot`, ...), `dropped` when the native queue
+ * overflowed. Iterating the emitter with `for await` yields the events one by one.
+ */
+export class DomainEventEmitter extends EventEmitter {
+    private started = false;
+
+    constructor(private readonly hypervisor: EventSource, private readonly options: DomainEventOptions = {}) {
+        super();
+    }
+
+    async start(): Promise<this> {
+        if (!this.started) {
+            await this.hypervisor.registerDomainEvents((events, dropped) => {
+                if (dropped > 0) this.emit("dropped", dropped);
+                for (const event of events) {
+                    this.emit(event.type, event);
+                    this.emit("event", event);
+                }
+            }, this.options);
+            this.started = true;
+        }
+        return this;
+    }
+
+    async stop(): Promise<void> {
+        if (this.started) {
+            this.started = false;
+            await this.hypervisor.deregisterDomainEvents();
+        }
+    }
+
+    async* [Symbol.asyncIterator](): AsyncIterableIterator<DomainEvent> {
+        for await (const [event] of on(this, "event")) {
+            yield event as DomainEvent;
+        }
+    }
+}
+
+/**
+ * Subscribe to the domain events of a connected hypervisor.
+ */
+export function domainEvents(hypervisor: EventSource, options?: DomainEventOptions): Promise<DomainEventEmitter> {
+    return new DomainEventEmitter(hypervisor, options).start();
+}
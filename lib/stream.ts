@@ -0,0 +1,74 @@
+import {Duplex, type DuplexOptions} from "stream";
+import {type Stream} from "./types/stream";
+
+/**
+ * Node.js Duplex over a native virStream.
+ *
+ * Reading starts on the first read, `push()` returning false pauses the native stream until the consumer asks for
+ * more. Writes are sent straight from the given buffers.
+ */
+export class StreamDuplex extends Duplex {
+    private reading = false;
+
+    constructor(private readonly native: Stream, options?: DuplexOptions) {
+        super(options);
+    }
+
+    _read(): void {
+        if (this.reading) {
+            this.native.resume();
+            return;
+        }
+        this.reading = true;
+        this.native.readStart((error, chunk) => {
+            if (error) {
+                this.destroy(error);
+            } else if (chunk === null) {
+                this.push(null);
+                this.native.finish().catch((e) => this.destroy(e));
+            } else if (chunk && !this.push(chunk)) {
+                this.native.pause();
+            }
+        });
+    }
+
+    _write(chunk: Buffer, _encoding: BufferEncoding, callback: (error?: Error | null) => void): void {
+        this.native.write(chunk, callback);
+    }
+
+    _final(callback: (error?: Error | null) => void): void {
+        this.native.finish().then(() => callback(), callback);
+    }
+
+    _destroy(error: Error | null, callback: (error?: Error | null) => void): void {
+        this.native.abort().then(() => callback(error), () => callback(error));
+    }
+}
+
+type ConsoleSource = { openConsole(devName?: string, flags?: number): Promise<Stream> };
+
+type VolumeSource = {
+    volumeUpload(path: string, offset?: number, length?: number, flags?: number): Promise<Stream>
+    volumeDownload(path: string, offset?: number, length?: number, flags?: number): Promise<Stream>
+};
+
+/**
+ * Guest console or serial device as a Duplex.
+ */
+export async function openConsole(domain: ConsoleSource, devName?: string, flags?: number): Promise<StreamDuplex> {
+    return new StreamDuplex(await domain.openConsole(devName, flags));
+}
+
+/**
+ * Writable into a storage volume, end() finishes the upload.
+ */
+export async function volumeUpload(hypervisor: VolumeSource, path: string, offset = 0, length = 0, flags = 0): Promise<StreamDuplex> {
+    return new StreamDuplex(await hypervisor.volumeUpload(path, offset, length, flags), {allowHalfOpen: true});
+}
+
+/**
+ * Readable content of a storage volume.
+ */
+export async function volumeDownload(hypervisor: VolumeSource, path: string, offset = 0, length = 0, flags = 0): Promise<StreamDuplex> {
+    return new StreamDuplex(await hypervisor.volumeDownload(path, offset, length, flags));
+}
@@ -0,0 +1,60 @@
+/**
+ * Watermarks of a BalloonController, sizes in KiB. Free memory is the guest's usable memory, or its unused memory
+ * when the balloon driver does not report usable.
+ */
+export type BalloonPolicy = {
+    /** Grow the balloon target of guests below (default 256 MiB) */
+    minFreeKiB?: number,
+    /** Shrink the balloon target of guests above, 0 never reclaims (default) */
+    maxFreeKiB?: number,
+    /** Largest change of one guest per adjustment (default 256 MiB) */
+    stepKiB?: number,
+    /** Never shrink a guest below (default 512 MiB) */
+    floorKiB?: number,
+    /** Guests adjusted per round, the most starved first (default 8) */
+    batchSize?: number,
+    /** Default 5000, at least 500 */
+    intervalMs?: number,
+    /** Time between two adjustments of the same guest (default 15000) */
+    cooldownMs?: number,
+    /** Balloon stats period in seconds set on the guests when started, 0 leaves it unchanged (default) */
+    statsPeriod?: number
+};
+
+export type BalloonAction = {
+    type: "grow" | "shrink",
+    /** Index into the domains the controller was created with */
+    domain: number,
+    fromKiB: number,
+    toKiB: number,
+    /** Free memory that triggered the adjustment */
+    freeKiB: number
+} | {
+    type: "error",
+    domain: number,
+    message: string
+};
+
+export type BalloonActionListener = (actions: BalloonAction[]) => void;
+
+export declare class BalloonController {
+    private constructor();
+
+    /** Number of domains */
+    get size(): number;
+
+    get running(): boolean;
+
+    get policy(): Required<BalloonPolicy>;
+
+    get stats(): { rounds: number, grown: number, shrunk: number, errors: number };
+
+    start(): void;
+
+    stop(): void;
+
+    /**
+     * Unset fields keep their value, applies from the next round.
+     */
+    setPolicy(policy: BalloonPolicy): void;
+}
@@ -1,8 +1,67 @@
 import {Hypervisor} from "./hypervisor";
-import {libvirt} from "./index";
+import {libvirt, type CancelOptions} from "./index";
+import {type Stream} from "./stream";
+import {type DomainInterface} from "./network";
 
 export type DomainInfo = { state: DomainState, maxMem: number, memory: number, nrVirtCpu: number, cpuTime: number };
 
+/**
+ * Element index of each DomainInfo field when written into a typed array, records are STRIDE elements apart.
+ * Fields that could not be read are NaN (Float64Array) or 2n ** 64n - 1n (BigUint64Array).
+ */
+export enum DomainInfoSlot {
+    STATE = 0,
+    MAX_MEM = 1,
+    MEMORY = 2,
+    NR_VIRT_CPU = 3,
+    /** CPU time used in nanoseconds, exact only in a BigUint64Array */
+    CPU_TIME = 4,
+    STRIDE = 5
+}
+
+export type StatsTarget = Float64Array | BigUint64Array;
+
+/**
+ * Element index of each virDomainMemoryStats value in the array returned by memoryStats. Sizes in KiB, stats the
+ * guest did not report are NaN.
+ */
+export enum MemoryStatSlot {
+    SWAP_IN = 0,
+    SWAP_OUT = 1,
+    MAJOR_FAULT = 2,
+    MINOR_FAULT = 3,
+    UNUSED = 4,
+    AVAILABLE = 5,
+    /** Current balloon target */
+    ACTUAL_BALLOON = 6,
+    RSS = 7,
+    USABLE = 8,
+    /** Seconds since the epoch */
+    LAST_UPDATE = 9,
+    DISK_CACHES = 10,
+    HUGETLB_PGALLOC = 11,
+    HUGETLB_PGFAIL = 12,
+    STRIDE = 13
+}
+
+export enum DomainMemoryModFlags {
+    CURRENT = 0,
+    LIVE = 1,
+    CONFIG = 2,
+    /** Change the maximum memory instead (setMemory only) */
+    MAXIMUM = 4
+}
+
+/**
+ * XPath selectors keyed by result name, or a list of expressions used as their own keys.
+ */
+export type XmlSelectors = Record<string, string> | string[];
+
+/**
+ * Node sets resolve to the string values of their nodes, `count()`, `string()` and `boolean()` expressions to scalars.
+ */
+export type XmlProjection = Record<string, string[] | string | number | boolean>;
+
 export enum DomainState {
     /**
      * no state
@@ -118,28 +177,284 @@ export enum DomainSaveRestoreFlags {
      * (0x8; 1 << 3)
      * Re-initialize NVRAM from template
      */
-    SAVE_RESET_NVRAM = 8
+    SAVE_RESET_NVRAM = 8,
+    /**
+     * (0x10; 1 << 4)
+     * Save and restore using parallel channels, see SaveParams.parallelChannels
+     */
+    SAVE_PARALLEL = 16
 }
 
+export enum DomainMigrateFlags {
+    /** Do not pause the domain during migration */
+    LIVE = 1,
+    /** Direct connection between source and destination hosts */
+    PEER2PEER = 2,
+    /** Tunnel migration data over the libvirt RPC channel */
+    TUNNELLED = 4,
+    /** Persist the domain on the destination host */
+    PERSIST_DEST = 8,
+    /** Undefine the domain on the source host */
+    UNDEFINE_SOURCE = 16,
+    /** Leave the domain suspended on the destination host */
+    PAUSED = 32,
+    /** Migration with non-shared storage with full disk copy */
+    NON_SHARED_DISK = 64,
+    /** Migration with non-shared storage with incremental copy */
+    NON_SHARED_INC = 128,
+    /** Protect for changing domain configuration through the whole migration process */
+    CHANGE_PROTECTION = 256,
+    /** Force migration even if it is considered unsafe */
+    UNSAFE = 512,
+    /** Migrate a domain definition without starting the domain on the destination */
+    OFFLINE = 1024,
+    /** Compress data during migration */
+    COMPRESSED = 2048,
+    /** Abort migration on I/O errors happened during migration */
+    ABORT_ON_ERROR = 4096,
+    /** Force convergence */
+    AUTO_CONVERGE = 8192,
+    /** RDMA Pin all pages during migration */
+    RDMA_PIN_ALL = 16384,
+    /** Enable algorithms that ensure a live migration will eventually converge */
+    POSTCOPY = 32768,
+    /** Encrypt the migration data with TLS */
+    TLS = 65536,
+    /** Send memory pages over multiple connections */
+    PARALLEL = 131072,
+    /** Resume a failed post-copy migration */
+    POSTCOPY_RESUME = 262144,
+    /** Use zero-copy mechanism for migrating memory pages */
+    ZEROCOPY = 1048576
+}
+
+/**
+ * virDomainMigrateToURI3 parameters, see VIR_MIGRATE_PARAM_*.
+ */
+export type MigrationParams = {
+    uri?: string,
+    destName?: string,
+    destXML?: string,
+    persistXML?: string,
+    /** MiB/s */
+    bandwidth?: number,
+    bandwidthPostcopy?: number,
+    graphicsURI?: string,
+    listenAddress?: string,
+    migrateDisks?: string[],
+    disksPort?: number,
+    disksURI?: string,
+    compression?: string[],
+    compressionMTLevel?: number,
+    compressionMTThreads?: number,
+    compressionMTDThreads?: number,
+    compressionXBZRLECache?: number,
+    autoConvergeInitial?: number,
+    autoConvergeIncrement?: number,
+    parallelConnections?: number,
+    tlsDestination?: string
+};
+
+/**
+ * virDomainGetJobStats, VIR_DOMAIN_JOB_* fields in camelCase (timeElapsed, dataRemaining, memoryDirtyRate, ...).
+ */
+export type JobStats = {
+    type: "none" | "bounded" | "unbounded" | "completed" | "failed" | "cancelled",
+    [field: string]: string | number | boolean
+};
+
+/**
+ * virDomainBlockStatsFlags, fields in camelCase; which ones are present depends on the driver.
+ */
+export type BlockStats = {
+    rdOperations?: number,
+    rdBytes?: number,
+    rdTotalTimes?: number,
+    wrOperations?: number,
+    wrBytes?: number,
+    wrTotalTimes?: number,
+    flushOperations?: number,
+    flushTotalTimes?: number,
+    errs?: number
+};
+
+export type InterfaceStats = {
+    rxBytes: number,
+    rxPackets: number,
+    rxErrs: number,
+    rxDrop: number,
+    txBytes: number,
+    txPackets: number,
+    txErrs: number,
+    txDrop: number
+};
+
+export type DomainCPUStats = {
+    cpuTime?: number,
+    userTime?: number,
+    systemTime?: number,
+    vcpuTime?: number
+};
+
+export enum VcpuState {
+    OFFLINE = 0,
+    RUNNING = 1,
+    BLOCKED = 2
+}
+
+export type VcpuInfo = {
+    number: number,
+    state: VcpuState,
+    /** Nanoseconds */
+    cpuTime: number,
+    /** Host CPU, -1 when offline */
+    cpu: number,
+    affinity: number[]
+};
+
+export type MigrationOptions = CancelOptions & {
+    /** Called with job statistics while the migration runs, samples are skipped while a call is pending */
+    onProgress?: (stats: JobStats) => void,
+    /** Default 1000, at least 50 */
+    progressIntervalMs?: number
+};
+
+/**
+ * virDomainSaveParams / virDomainRestoreParams parameters
+ */
+export type SaveParams = {
+    file?: string,
+    dxml?: string,
+    /** "raw", "gzip", "bzip2", "xz", "lzop", "zstd", ... as supported by the driver */
+    imageFormat?: string,
+    /** With DomainSaveRestoreFlags.SAVE_PARALLEL */
+    parallelChannels?: number
+};
+
+export type SaveOptions = CancelOptions & {
+    /** Called with job statistics while the image is written or read, samples are skipped while a call is pending */
+    onProgress?: (stats: JobStats) => void,
+    /** Default 1000, at least 50 */
+    progressIntervalMs?: number
+};
+
+export enum DomainSnapshotCreateFlags {
+    /** Replace the metadata of an existing snapshot */
+    REDEFINE = 1,
+    /** Make the snapshot current */
+    CURRENT = 2,
+    /** Do not keep libvirt metadata, only the disk state */
+    NO_METADATA = 4,
+    /** Stop the domain after taking the snapshot */
+    HALT = 8,
+    /** Disk state only */
+    DISK_ONLY = 16,
+    /** Reuse existing external files */
+    REUSE_EXT = 32,
+    /** Freeze guest file systems through the guest agent */
+    QUIESCE = 64,
+    /** All disks at once, or nothing */
+    ATOMIC = 128,
+    /** Memory state of a running domain while it keeps running */
+    LIVE = 256,
+    /** Validate the XML against the schema */
+    VALIDATE = 512
+}
+
+export enum DomainSnapshotListFlags {
+    /** Only snapshots without parent */
+    ROOTS = 1,
+    /** Parents before children, the bindings always return this order */
+    TOPOLOGICAL = 1024,
+    LEAVES = 4,
+    NO_LEAVES = 8,
+    METADATA = 2,
+    NO_METADATA = 16,
+    INACTIVE = 32,
+    ACTIVE = 64,
+    DISK_ONLY = 128,
+    INTERNAL = 256,
+    EXTERNAL = 512
+}
+
+export enum DomainSnapshotRevertFlags {
+    RUNNING = 1,
+    PAUSED = 2,
+    /** Revert even when it is risky */
+    FORCE = 4,
+    /** Reset NVRAM to the pristine template */
+    RESET_NVRAM = 8
+}
+
+export enum DomainSnapshotDeleteFlags {
+    /** Also delete the descendants */
+    CHILDREN = 1,
+    /** Only remove the libvirt metadata */
+    METADATA_ONLY = 2,
+    /** Delete only the descendants */
+    CHILDREN_ONLY = 4
+}
+
+/**
+ * A snapshot and its place in the tree. creationTime, state and description need details, xml needs xml.
+ */
+export type DomainSnapshot = {
+    name: string,
+    parent: string | null,
+    /** Direct children among the listed snapshots */
+    children: string[],
+    current: boolean,
+    /** Seconds since the epoch */
+    creationTime?: number,
+    state?: string,
+    description?: string,
+    xml?: string
+};
+
+export type DomainHandle = {
+    uri: string,
+    uuid: string
+};
+
+export type SnapshotListOptions = CancelOptions & {
+    /** Bitwise-OR of DomainSnapshotListFlags */
+    flags?: number,
+    /** Fetch the snapshot XML for creationTime, state and description, one round trip per snapshot */
+    details?: boolean,
+    /** Also return the snapshot XML, implies details */
+    xml?: boolean
+};
+
 export declare class Domain {
     /* Instance accessors */
     get id(): number;
 
     get info(): DomainInfo;
 
+    /**
+     * Write the info of this domain into target at offset using the DomainInfoSlot layout.
+     * @return offset of the next record
+     */
+    infoInto(target: StatsTarget, offset?: number): number;
+
     get name(): string
 
     get uuid(): string
 
+    /**
+     * Structured-clonable identity, resolve it with Hypervisor.domainFromHandle in another worker_thread.
+     */
+    get handle(): DomainHandle
+
     /* Instance Methods */
-    shutdown(flags?: DomainShutdownFlagValues): void
+    shutdown(flags?: DomainShutdownFlagValues, options?: CancelOptions): Promise<void>
 
     /**
      * Launch a defined domain.
      * If the call succeeds the domain moves from the defined to the running domains pools.
      * @param flags bitwise-OR of supported DomainCreateFlags
      */
-    create(flags?: DomainCreateFlags): void;
+    create(flags?: DomainCreateFlags, options?: CancelOptions): Promise<void>;
 
     /**
      * This method will suspend a domain and save its memory contents to a file on disk. After the call, if successful, the domain is not listed as running anymore (this ends the life of a transient domain). Use virDomainRestore() to restore a domain after saving.
@@ -149,12 +464,152 @@ export declare class Domain {
      * A save file can be inspected or modified slightly with virDomainSaveImageGetXMLDesc() and virDomainSaveImageDefineXML().
      * Some hypervisors may prevent this operation if there is a current block job running; in that case, use virDomainBlockJobAbort() to stop the block job first.
      *
+     * Runs on a worker thread, the returned promise settles once the image is written.
+     * Cancelling through options aborts the save job. With SAVE_PARALLEL it goes through virDomainSaveParams.
+     *
      * @param filename
      * @param dxml
      * @param flags
      */
-    save(filename: string, dxml?: string, flags?: DomainSaveRestoreFlags): void;
+    save(filename: string, dxml?: string, flags?: DomainSaveRestoreFlags, options?: SaveOptions): Promise<void>;
+
+    /**
+     * virDomainSaveParams, params.file is required. Use it for parallel channels (with SAVE_PARALLEL) or a
+     * compressed image format.
+     */
+    save(params: SaveParams, flags?: DomainSaveRestoreFlags, options?: SaveOptions): Promise<void>;
+
+    /**
+     * Provide an XML description of the domain.
+     * @param flags bitwise-OR of virDomainXMLFlags
+     */
+    toXML(flags: number, options?: CancelOptions): Promise<string>;
+
+    /**
+     * Evaluate XPath selectors against the domain XML natively, only the selected values are returned.
+     * @example domain.queryXML({disks: "/domain/devices/disk/source/@file", macs: "//interface/mac/@address"})
+     * @param flags bitwise-OR of virDomainXMLFlags
+     */
+    queryXML(selectors: XmlSelectors, flags?: number, options?: CancelOptions): Promise<XmlProjection>;
+
+    /**
+     * Open a non-blocking stream to the guest console, see openConsole() for a Duplex.
+     * @param devName console or serial device alias, defaults to the first console
+     * @param flags bitwise-OR of virDomainConsoleFlags
+     */
+    openConsole(devName?: string, flags?: number, options?: CancelOptions): Promise<Stream>;
+
+    /**
+     * Counters of one disk, see hypervisor.createIoSampler for rates of many disks.
+     * @param disk target name (vda) or source path
+     */
+    blockStats(disk: string, flags?: number, options?: CancelOptions): Promise<BlockStats>;
+
+    /**
+     * Counters of one interface, unsupported counters are -1.
+     * @param device interface device (vnet0) or MAC address
+     */
+    interfaceStats(device: string, options?: CancelOptions): Promise<InterfaceStats>;
+
+    /**
+     * Addresses of the guest interfaces, the agent and ARP sources need a running domain.
+     * @param source default "lease"
+     */
+    interfaceAddresses(source?: "lease" | "agent" | "arp", options?: CancelOptions): Promise<DomainInterface[]>;
+
+    /**
+     * CPU time of the domain in nanoseconds.
+     * @param startCpu -1 (default) for the totals, otherwise the first host CPU of a per CPU breakdown
+     * @param ncpus host CPUs in the breakdown, the remaining ones when omitted
+     */
+    cpuStats(startCpu?: -1, ncpus?: number, flags?: number, options?: CancelOptions): Promise<DomainCPUStats>;
+    cpuStats(startCpu: number, ncpus?: number, flags?: number, options?: CancelOptions): Promise<DomainCPUStats[]>;
+
+    /**
+     * Host CPU and affinity of every vCPU, the domain must be running.
+     */
+    vcpus(options?: CancelOptions): Promise<VcpuInfo[]>;
+
+    /**
+     * Host CPUs every vCPU may run on.
+     * @param flags virDomainModificationImpact, 2 (VIR_DOMAIN_AFFECT_CONFIG) also works for inactive domains
+     */
+    vcpuPinInfo(flags?: number, options?: CancelOptions): Promise<number[][]>;
+
+    /**
+     * Migrate the domain, the promise resolves with the statistics of the completed job.
+     * Downtime and bandwidth can be changed from onProgress through migrateSetMaxDowntime and migrateSetMaxSpeed.
+     * Cancelling through options aborts the migration job.
+     * @param dconnuri destination connection URI, null for a direct migration using params.uri
+     * @param flags bitwise-OR of DomainMigrateFlags
+     */
+    migrate(dconnuri: string | null, params?: MigrationParams, flags?: DomainMigrateFlags, options?: MigrationOptions): Promise<JobStats>;
+
+    /**
+     * Statistics of the current job.
+     * @param flags bitwise-OR of virDomainGetJobStatsFlags, 1 for the last completed job
+     */
+    jobStats(flags?: number, options?: CancelOptions): Promise<JobStats>;
+
+    /**
+     * @param downtime maximum tolerable downtime in milliseconds
+     */
+    migrateSetMaxDowntime(downtime: number, flags?: number, options?: CancelOptions): Promise<void>;
+
+    /**
+     * @param bandwidth MiB/s
+     * @param flags 1 to set the post-copy bandwidth
+     */
+    migrateSetMaxSpeed(bandwidth: number, flags?: number, options?: CancelOptions): Promise<void>;
+
+    /**
+     * Balloon statistics in the MemoryStatSlot layout. Most of them are only refreshed once a stats period is set.
+     */
+    memoryStats(options?: CancelOptions): Promise<Float64Array>;
+
+    /**
+     * Resize the balloon, or the maximum memory with DomainMemoryModFlags.MAXIMUM.
+     * @param memory KiB
+     * @param flags bitwise-OR of DomainMemoryModFlags
+     */
+    setMemory(memory: number, flags?: number, options?: CancelOptions): Promise<void>;
+
+    /**
+     * @param period seconds between balloon stats updates, 0 disables them
+     * @param flags bitwise-OR of DomainMemoryModFlags
+     */
+    setMemoryStatsPeriod(period: number, flags?: number, options?: CancelOptions): Promise<void>;
+
+    /**
+     * @param xml domainsnapshot document
+     * @param flags bitwise-OR of DomainSnapshotCreateFlags
+     */
+    createSnapshot(xml: string, flags?: number, options?: CancelOptions): Promise<DomainSnapshot>;
+
+    /**
+     * Snapshots with parents before children. Without details or xml no snapshot XML is fetched.
+     */
+    snapshots(options?: SnapshotListOptions): Promise<DomainSnapshot[]>;
+
+    /**
+     * @param flags bitwise-OR of DomainSnapshotRevertFlags
+     */
+    revertToSnapshot(name: string, flags?: number, options?: CancelOptions): Promise<void>;
+
+    /**
+     * @param flags bitwise-OR of DomainSnapshotDeleteFlags
+     */
+    deleteSnapshot(name: string, flags?: number, options?: CancelOptions): Promise<void>;
 
     /* Static Methods */
-    static FromXML(xml: string, context: Hypervisor, flags?: number): Domain
+
+    /**
+     * Define a domain, but does not start it.
+     */
+    static DefineXML(xml: string, context: Hypervisor, flags?: number, options?: CancelOptions): Promise<Domain>
+
+    /**
+     * Launch a new guest domain, based on an XML description.
+     */
+    static CreateXML(xml: string, context: Hypervisor, flags?: DomainCreateFlags, options?: CancelOptions): Promise<Domain>
 }
@@ -0,0 +1,101 @@
+import {type Domain} from "./domain";
+
+/**
+ * Statistics groups for virConnectGetAllDomainStats (virDomainStatsTypes)
+ */
+export enum DomainStatsTypes {
+    /** return domain state (Since: 1.2.8) */
+    STATE = (1 << 0),
+    /** return domain CPU info (Since: 1.2.9) */
+    CPU_TOTAL = (1 << 1),
+    /** return domain balloon info (Since: 1.2.9) */
+    BALLOON = (1 << 2),
+    /** return domain virtual CPU info (Since: 1.2.9) */
+    VCPU = (1 << 3),
+    /** return domain interfaces info (Since: 1.2.9) */
+    INTERFACE = (1 << 4),
+    /** return domain block info (Since: 1.2.9) */
+    BLOCK = (1 << 5),
+    /** return domain perf event info (Since: 1.3.3) */
+    PERF = (1 << 6),
+    /** return iothread poll info (Since: 4.10.0) */
+    IOTHREAD = (1 << 7),
+    /** return domain memory info (Since: 6.0.0) */
+    MEMORY = (1 << 8),
+    /** return domain dirty rate info (Since: 7.2.0) */
+    DIRTYRATE = (1 << 9),
+    /** return vm info (Since: 8.9.0) */
+    VM = (1 << 10),
+}
+
+/**
+ * Filters for virConnectGetAllDomainStats (virConnectGetAllDomainStatsFlags)
+ */
+export enum ConnectGetAllDomainStatsFlags {
+    ACTIVE = (1 << 0),
+    INACTIVE = (1 << 1),
+    PERSISTENT = (1 << 2),
+    TRANSIENT = (1 << 3),
+    RUNNING = (1 << 4),
+    PAUSED = (1 << 5),
+    SHUTOFF = (1 << 6),
+    OTHER = (1 << 7),
+    /** report statistics that can be obtained immediately without any blocking (Since: 4.5.0) */
+    NOWAIT = (1 << 29),
+    /** include backing chain for block stats (Since: 1.2.12) */
+    BACKING = (1 << 30),
+    /** enforce requested stats (Since: 1.2.8) */
+    ENFORCE_STATS = 0x80000000,
+}
+
+export type DomainStateStats = { state: number, reason: number };
+
+export type DomainCpuStats = {
+    time: number, user?: number, system?: number,
+    /** cpu.haltpoll.success.time / cpu.haltpoll.fail.time, flattened like every other nested field */
+    haltpollSuccessTime?: number, haltpollFailTime?: number
+};
+
+export type DomainBalloonStats = {
+    current: number, maximum: number,
+    swapIn?: number, swapOut?: number, majorFault?: number, minorFault?: number,
+    unused?: number, available?: number, rss?: number, usable?: number, lastUpdate?: number,
+    diskCaches?: number, hugetlbPgalloc?: number, hugetlbPgfail?: number
+};
+
+export type DomainVcpuEntry = { state: number, time: number, wait?: number, delay?: number, halted?: boolean };
+
+export type DomainVcpuStats = { current: number, maximum: number, vcpus?: DomainVcpuEntry[] };
+
+export type DomainInterfaceEntry = {
+    name: string,
+    rxBytes: number, rxPkts: number, rxErrs: number, rxDrop: number,
+    txBytes: number, txPkts: number, txErrs: number, txDrop: number
+};
+
+export type DomainInterfaceStats = { count: number, interfaces?: DomainInterfaceEntry[] };
+
+export type DomainBlockEntry = {
+    name: string, backingIndex?: number, path?: string,
+    rdReqs?: number, rdBytes?: number, rdTimes?: number,
+    wrReqs?: number, wrBytes?: number, wrTimes?: number,
+    flReqs?: number, flTimes?: number,
+    errors?: number, allocation?: number, capacity?: number, physical?: number
+};
+
+export type DomainBlockStats = { count: number, devices?: DomainBlockEntry[] };
+
+/**
+ * One record per domain, grouped by statistics type.
+ * Field names are the libvirt ones in camelCase, indexed entries (`block.<n>.*`) are collected into arrays.
+ */
+export type DomainStatsRecord = {
+    domain: Domain,
+    state?: DomainStateStats,
+    cpu?: DomainCpuStats,
+    balloon?: DomainBalloonStats,
+    vcpu?: DomainVcpuStats,
+    net?: DomainInterfaceStats,
+    block?: DomainBlockStats,
+    [group: string]: unknown
+};
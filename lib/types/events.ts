@@ -0,0 +1,50 @@
+import {type CancelOptions} from "./index";
+
+export type DomainEventName = "lifecycle" | "reboot" | "watchdog" | "ioError" | "deviceRemoved";
+
+/**
+ * Lifecycle event codes (virDomainEventType)
+ */
+export enum DomainLifecycleEvent {
+    DEFINED = 0,
+    UNDEFINED = 1,
+    STARTED = 2,
+    SUSPENDED = 3,
+    RESUMED = 4,
+    STOPPED = 5,
+    SHUTDOWN = 6,
+    PMSUSPENDED = 7,
+    CRASHED = 8,
+}
+
+type DomainEventBase = {
+    uuid: string,
+    name: string,
+    /** Domain id at the time of the event, -1 for inactive domains */
+    id: number,
+    /** Milliseconds since epoch of the latest occurrence */
+    timestamp: number,
+    /** Number of identical events coalesced into this one */
+    count: number
+};
+
+export type DomainEvent =
+    | DomainEventBase & { type: "lifecycle", event: DomainLifecycleEvent, detail: number }
+    | DomainEventBase & { type: "reboot" }
+    | DomainEventBase & { type: "watchdog", action: number }
+    | DomainEventBase & { type: "ioError", action: number, srcPath: string, devAlias: string, reason: string }
+    | DomainEventBase & { type: "deviceRemoved", devAlias: string };
+
+/**
+ * A cancelled registration rejects, a subscription registered after the cancel is deregistered again.
+ */
+export type DomainEventOptions = CancelOptions & {
+    /** Event types to subscribe to, defaults to all */
+    events?: DomainEventName[],
+    /** Maximum number of undelivered events, the oldest are dropped beyond it (default 1024) */
+    maxQueue?: number,
+    /** Fold identical undelivered events into one with a count (default true) */
+    coalesce?: boolean
+};
+
+export type DomainEventListener = (events: DomainEvent[], dropped: number) => void;
@@ -0,0 +1,59 @@
+export type ExecutorLane = "fast" | "bulk";
+
+export type ExecutorLaneStats = {
+    /** Threads currently started for the lane */
+    threads: number,
+    /** Tasks waiting for a thread (queue depth) */
+    queued: number,
+    running: number,
+    /** Threads still blocked in a cancelled call, replaced by extra threads meanwhile */
+    detached: number,
+    submitted: number,
+    completed: number,
+    /** Time spent in the queue */
+    totalWaitMs: number,
+    maxWaitMs: number,
+    /** Time spent in libvirt */
+    totalRunMs: number,
+    maxRunMs: number
+};
+
+export type ExecutorStats = Record<ExecutorLane, ExecutorLaneStats>;
+
+/**
+ * Thread count per lane, both default to 4.
+ * Lookups, info and stats run on the fast lane; connect, create, save and restore on the bulk lane.
+ */
+export type ExecutorConfig = Partial<Record<ExecutorLane, number>>;
+
+/**
+ * Latency distribution of one phase in milliseconds, percentiles are accurate to about 12%.
+ */
+export type LatencyHistogram = {
+    count: number,
+    totalMs: number,
+    maxMs: number,
+    p50: number,
+    p90: number,
+    p99: number,
+    p999: number
+};
+
+/**
+ * Where the time of an asynchronous binding goes: waiting for an executor thread (queue), inside libvirt (call),
+ * until the JavaScript thread picked up the result (deliver) and building the result (convert).
+ */
+export type OperationMetrics = {
+    queue: LatencyHistogram,
+    call: LatencyHistogram,
+    deliver: LatencyHistogram,
+    convert: LatencyHistogram,
+    errors: number,
+    cancelled: number
+};
+
+export type Metrics = {
+    /** Keyed by binding, e.g. "Domain.save" or "Hypervisor.lookupDomainByName" */
+    operations: Record<string, OperationMetrics>,
+    executor: ExecutorStats
+};
@@ -1,5 +1,156 @@
-import {type Domain, DomainSaveRestoreFlags} from "./domain";
-import {NodeInfo} from "./nodeinfo";
+import {
+    type Domain,
+    type DomainHandle,
+    type DomainSnapshot,
+    DomainSaveRestoreFlags,
+    type SaveOptions,
+    type SaveParams,
+    type SnapshotListOptions,
+    type StatsTarget,
+    type XmlProjection,
+    type XmlSelectors
+} from "./domain";
+import {type HostTopologySnapshot, NodeInfo, type NodeCPUStats} from "./nodeinfo";
+import {type Stream} from "./stream";
+import {type BalloonActionListener, type BalloonController, type BalloonPolicy} from "./balloon";
+import {type DomainEventListener, type DomainEventOptions} from "./events";
+import {type CancelOptions} from "./index";
+import {type IoSampler, type IoSamplerOptions, type IoSamplerTarget} from "./iosampler";
+import {type StoragePool} from "./storage";
+import {type AddressInventory, type AddressInventoryOptions, type DhcpLease} from "./network";
+import {type ConnectGetAllDomainStatsFlags, type DomainStatsRecord, type DomainStatsTypes} from "./domainstats";
+
+export type DomainLookupQuery = { uuids?: string[], names?: string[], ids?: number[] };
+
+export type DomainSnapshotsEntry = { domain: Domain | null, snapshots?: DomainSnapshot[], error?: Error };
+
+export type BulkOperation = "start" | "shutdown" | "destroy" | "reboot" | "suspend" | "resume" | "managedSave" | "save";
+
+export type BulkOptions = {
+    /** Operations running at the same time (default 8, at most 256), also capped by the bulk lane size */
+    concurrency?: number,
+    /**
+     * Per domain, a domain taking longer is reported as "timeout" and no longer holds up the batch. Once concurrency
+     * operations timed out, domains not started yet are reported as "error".
+     */
+    timeoutMs?: number,
+    /** Flags of the libvirt call behind op */
+    flags?: number,
+    /** Directory for "save", files are named <uuid>.save */
+    saveDir?: string,
+    /** "save" goes through virDomainSaveParams with these (file and dxml are ignored) */
+    saveParams?: SaveParams,
+    /** Stops starting further domains, those not started are reported as "cancelled" */
+    signal?: AbortSignal
+};
+
+export type BulkResult = {
+    status: "ok" | "error" | "timeout" | "cancelled",
+    error?: string,
+    /** Relative to the start of the batch, missing if the domain was never started */
+    startedMs?: number,
+    durationMs: number
+};
+
+export type ConnectionState = "closed" | "connected" | "disconnected" | "reconnecting";
+
+export type ConnectionStateEvent = {
+    state: ConnectionState,
+    /** Why the connection dropped ("eof", "keepalive", "error" or a libvirt message) */
+    reason?: string,
+    /** Set while reconnecting */
+    attempt?: number,
+    delayMs?: number
+};
+
+export type ReconnectOptions = {
+    enabled?: boolean,
+    /** Seconds between keepalive probes, 0 disables keepalive (default 5) */
+    keepAliveInterval?: number,
+    /** Unanswered probes before the connection is considered dead (default 3) */
+    keepAliveCount?: number,
+    /** Backoff between reconnect attempts, doubled up to maxDelayMs (default 50 / 5000) */
+    initialDelayMs?: number,
+    maxDelayMs?: number,
+    /** How long queued operations wait for the reconnect before they fail (default 30000) */
+    replayTimeoutMs?: number,
+    /** Times an idempotent operation is repeated after its connection dropped (default 2) */
+    maxRetries?: number
+};
+
+export type SharedConnectionStats = {
+    uri: string,
+    readOnly: boolean,
+    /** Connected Hypervisors across all worker_threads */
+    users: number,
+    /** Hypervisors and running operations holding the connections */
+    holders: number,
+    state: ConnectionState
+};
+
+export type ConnectionPoolStats = {
+    /** Number of connections */
+    size: number,
+    /** Per-connection cap on concurrent operations, 0 when unlimited */
+    maxInFlight: number,
+    /** Operations currently holding a connection */
+    inFlight: number,
+    /** Operations waiting for a connection (queue depth) */
+    waiting: number,
+    /** Total leases handed out */
+    leases: number,
+    totalWaitMs: number,
+    maxWaitMs: number,
+    state: ConnectionState,
+    /** Successful reconnects since connect() */
+    reconnects: number,
+    connections: { inFlight: number, leases: number }[]
+};
+
+export type NumaCell = {
+    id: number,
+    /** KiB */
+    memory: number,
+    cpus: { id: number, socketId: number, dieId: number, coreId: number, siblings: string }[],
+    /** distance to other cells keyed by cell id */
+    distances: Record<string, number>
+};
+
+export type ParsedCapabilities = {
+    host: {
+        uuid: string,
+        arch: string,
+        cpuModel: string,
+        cpuVendor: string,
+        topology: { sockets: number, dies: number, cores: number, threads: number },
+        cpuFeatures: string[],
+        migrationTransports: string[]
+    },
+    numa: NumaCell[],
+    guests: {
+        osType: string,
+        arch: string,
+        wordSize: number,
+        emulator: string,
+        machines: string[],
+        domainTypes: string[]
+    }[]
+};
+
+/**
+ * Cached host data, the same object is returned until the data is reloaded so treat it as read-only.
+ */
+export type HostData = {
+    hostname: string,
+    sysInfo: string,
+    maxVCPUs: number,
+    capabilities: string,
+    parsedCapabilities: ParsedCapabilities,
+    /** CPU models known for the host architecture */
+    cpuModels: string[],
+    /** epoch milliseconds */
+    loadedAt: number
+};
 
 export type Hypervisor = {
 
@@ -7,21 +158,178 @@ export type Hypervisor = {
         username?: string,
         password?: string,
         uri: string
-        readOnly?: true
+        readOnly?: true,
+        /** Number of connections opened for asynchronous operations (default 1) */
+        poolSize?: number,
+        /** Maximum concurrent operations per connection, waiters are served in order (default unlimited) */
+        maxInFlight?: number,
+        /** Age after which cached host data is reloaded, 0 to keep it until reconnect (default 5 minutes) */
+        hostDataTtlMs?: number,
+        /** Reopen dropped connections in the background (default enabled) */
+        reconnect?: boolean | ReconnectOptions,
+        /**
+         * Use the connections opened for this URI by any worker_thread of the process, refcounted and closed with
+         * the last user. poolSize, maxInFlight and reconnect of the first Hypervisor apply.
+         */
+        shared?: boolean
     });
 
-    get capabilities(): string
-    get hostname(): string
-    get sysInfo(): string
-    get maxVCPUs(): number
+    /**
+     * capabilities, hostname, sysInfo and maxVCPUs are served from the host data cache and never block.
+     * Once the TTL passed the cached value is returned while a refresh runs in the background. They are undefined
+     * until the first load finished (connect preloads it), await hostData() to wait for it.
+     */
+    get capabilities(): string | undefined
+    get hostname(): string | undefined
+    get sysInfo(): string | undefined
+    get maxVCPUs(): number | undefined
     get info(): NodeInfo
+    get poolStats(): ConnectionPoolStats
+    get connectionState(): ConnectionState
+
+    /**
+     * connect and disconnect reject while another one of this Hypervisor still runs, including a cancelled connect.
+     * A cancelled disconnect still closes the connection.
+     */
+    connect(options?: CancelOptions): Promise<void>;
+    disconnect(options?: CancelOptions): Promise<void>;
+    /**
+     * Follow connection drops and reconnect attempts. Lookups, statistics and host data are repeated on the new
+     * connection, other operations in flight when the connection dropped reject.
+     */
+    setConnectionListener(listener: ((event: ConnectionStateEvent) => void) | null): void
+    /**
+     * Reopen the connections as if they dropped, with reason "requested". Returns right away, operations queued
+     * meanwhile continue on the new connections.
+     */
+    reconnect(): void
 
-    connect(): Promise<void>;
-    disconnect(): Promise<void>;
+    /**
+     * Host data from the cache, loaded on a worker when missing or older than hostDataTtlMs.
+     */
+    hostData(): Promise<HostData>
+    refreshHostData(options?: CancelOptions): Promise<HostData>
 
     domains(): Domain[]
-    lookupDomainById(id: number): Promise<Domain>
-    lookupDomainByName(name: string): Promise<Domain>
-    lookupDomainByUUIDString(uuid: string): Promise<Domain>
-    restoreDomain(xml: string, dxml?: string, flags?: DomainSaveRestoreFlags): Promise<Domain>
+
+    /**
+     * Write the node info into target at offset using the NodeInfoSlot layout.
+     * @return offset of the next record
+     */
+    nodeInfoInto(target: StatsTarget, offset?: number): number
+
+    /**
+     * @param cpuNum host CPU, all CPUs when omitted
+     * @param flags 1 (VIR_NODE_CPU_STATS_UTILIZATION) for percentages
+     */
+    nodeCPUStats(cpuNum?: number, flags?: number, options?: CancelOptions): Promise<NodeCPUStats>
+
+    /**
+     * Free memory in bytes per NUMA cell.
+     * @param maxCells every cell from startCell when omitted
+     */
+    nodeCellsFreeMemory(startCell?: number, maxCells?: number, options?: CancelOptions): Promise<number[]>
+
+    /**
+     * Host CPU times, free memory per NUMA cell and the CPU / vCPU counters of every running domain, gathered on a
+     * worker in a handful of round trips.
+     */
+    hostTopologySnapshot(options?: CancelOptions): Promise<HostTopologySnapshot>
+    /**
+     * Sample the info of all given domains on a worker and write them back to back using the DomainInfoSlot layout.
+     * The same target can be reused every tick, no objects are created per sample.
+     * @return offset after the last record
+     */
+    domainsInfoInto(domains: Domain[], target: StatsTarget, offset?: number, options?: CancelOptions): Promise<number>
+    /**
+     * Evaluate XPath selectors against the XML of many domains in one worker task, results are in input order.
+     * An invalid selector rejects the promise, a domain that fails has an Error at its position.
+     */
+    queryDomainsXML(domains: Domain[], selectors: XmlSelectors, flags?: number, options?: CancelOptions): Promise<(XmlProjection | Error)[]>
+    /**
+     * Snapshot trees of many domains in one worker task, every domain of the connection when domains is omitted.
+     * A domain that fails has an error instead of snapshots.
+     */
+    domainsSnapshots(domains?: Domain[] | null, options?: SnapshotListOptions): Promise<DomainSnapshotsEntry[]>
+    /**
+     * @param mac only leases of this MAC address
+     */
+    networkDHCPLeases(network: string, mac?: string | null, options?: CancelOptions): Promise<DhcpLease[]>
+    /**
+     * Addresses of every active guest from the requested sources in one worker task, as columns.
+     * Domains or networks that fail are listed in errors and do not fail the call.
+     */
+    addressInventory(options?: AddressInventoryOptions): Promise<AddressInventory>
+    /**
+     * Statistics of all domains in a single round trip, collected on a worker thread.
+     * @param stats bitwise-OR of DomainStatsTypes, defaults to STATE | CPU_TOTAL | BALLOON | VCPU | INTERFACE | BLOCK
+     * @param flags bitwise-OR of ConnectGetAllDomainStatsFlags
+     */
+    allDomainStats(stats?: DomainStatsTypes | number, flags?: ConnectGetAllDomainStatsFlags | number, options?: CancelOptions): Promise<DomainStatsRecord[]>
+    /**
+     * Domain lookups return the same Domain object for the same guest as long as it is referenced.
+     * While the hypervisor follows lifecycle events, known domains resolve without a libvirt call.
+     */
+    lookupDomainById(id: number, options?: CancelOptions): Promise<Domain>
+    lookupDomainByName(name: string, options?: CancelOptions): Promise<Domain>
+    lookupDomainByUUIDString(uuid: string, options?: CancelOptions): Promise<Domain>
+    /**
+     * Resolve a Domain.handle posted from another worker_thread, rejects if it belongs to another URI.
+     */
+    domainFromHandle(handle: DomainHandle, options?: CancelOptions): Promise<Domain>
+    /**
+     * Resolve many domains in one worker task, keyed by the requested uuid, name or id.
+     * Domains that cannot be found map to an Error instead of rejecting the whole batch.
+     */
+    lookupDomains(query: DomainLookupQuery, options?: CancelOptions): Promise<Map<string | number, Domain | Error>>
+    /**
+     * Apply op to many domains on native threads, results are in input order.
+     * A failing or slow domain does not hold up the others.
+     */
+    bulk(op: BulkOperation, domains: Domain[], options?: BulkOptions): Promise<BulkResult[]>
+
+    /**
+     * Sample the block and interface counters of the given domains on a native thread, rates are computed there and
+     * buffered until read. The sampler is already running when the promise resolves.
+     */
+    createIoSampler(targets: IoSamplerTarget[], options?: IoSamplerOptions): Promise<IoSampler>
+    /**
+     * Keep the free memory of the given guests between the policy watermarks by resizing their balloons on a
+     * native thread. The controller starts stopped; the listener receives the actions of each round.
+     */
+    createBalloonController(domains: Domain[], policy?: BalloonPolicy,
+                            listener?: BalloonActionListener): BalloonController
+    /**
+     * Restore a domain saved with Domain.save, resolves with the restored domain, or null when the UUID of the image
+     * could not be read. Progress is reported where the driver tracks a job on the restored domain.
+     */
+    restoreDomain(file: string, dxml?: string, flags?: DomainSaveRestoreFlags,
+                  options?: SaveOptions): Promise<Domain | null>
+    /**
+     * virDomainRestoreParams, params.file is required.
+     */
+    restoreDomain(params: SaveParams, flags?: DomainSaveRestoreFlags, options?: SaveOptions): Promise<Domain | null>
+    /**
+     * @param flags bitwise-OR of virConnectListAllStoragePoolsFlags
+     */
+    storagePools(flags?: number, options?: CancelOptions): Promise<StoragePool[]>
+    lookupStoragePoolByName(name: string, options?: CancelOptions): Promise<StoragePool>
+
+    /**
+     * Subscribe to domain events, dispatched by the native event loop thread and delivered in batches.
+     * Only one subscription per hypervisor, use DomainEventEmitter to fan out.
+     */
+    registerDomainEvents(listener: DomainEventListener, options?: DomainEventOptions): Promise<void>
+
+    /**
+     * The subscription is detached at once, cancelling only stops waiting for its deregistration.
+     */
+    deregisterDomainEvents(options?: CancelOptions): Promise<void>
+
+    /**
+     * Streams into / out of the storage volume at path, see volumeUpload()/volumeDownload() for Node.js streams.
+     * @param length number of bytes, 0 for the rest of the volume
+     */
+    volumeUpload(path: string, offset?: number, length?: number, flags?: number, options?: CancelOptions): Promise<Stream>
+    volumeDownload(path: string, offset?: number, length?: number, flags?: number, options?: CancelOptions): Promise<Stream>
 }
\ No newline at end of file
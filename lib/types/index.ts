@@ -1,12 +1,37 @@
-import {type Hypervisor} from "./hypervisor";
+import {type Hypervisor, type SharedConnectionStats} from "./hypervisor";
 import {type Domain} from "./domain";
+import {type Stream} from "./stream";
+import {type IoSampler} from "./iosampler";
+import {type BalloonController} from "./balloon";
+import {type StoragePool, type StorageVolume} from "./storage";
+import {type ExecutorConfig, type ExecutorStats, type Metrics} from "./executor";
 
 export declare class External<T = unknown>{
     private constructor();
 }
 
+/**
+ * Accepted as the last argument of asynchronous methods. Aborting or passing the deadline rejects the promise right
+ * away; the native call is abandoned (long jobs such as save are aborted) and its thread is replaced.
+ */
+export type CancelOptions = {
+    signal?: AbortSignal,
+    timeoutMs?: number
+};
+
 export type libvirt = {
     Hypervisor: Hypervisor
     Domain: typeof Domain
+    Stream: typeof Stream
+    IoSampler: typeof IoSampler
+    StoragePool: typeof StoragePool
+    StorageVolume: typeof StorageVolume
+    BalloonController: typeof BalloonController
     GetVersion(): number;
+    GetExecutorStats(): ExecutorStats;
+    ConfigureExecutor(config: ExecutorConfig): ExecutorStats;
+    GetMetrics(options?: { format?: "object" }): Metrics;
+    GetMetrics(options: { format: "prometheus" }): string;
+    ResetMetrics(): void;
+    GetSharedConnections(): SharedConnectionStats[];
 }
\ No newline at end of file
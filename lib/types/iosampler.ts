@@ -0,0 +1,81 @@
+import {type Domain} from "./domain";
+import {type CancelOptions} from "./index";
+
+/**
+ * Per second rates of a block device inside an IoSampler record, relative to the device offset.
+ */
+export enum BlockRateSlot {
+    RD_REQS = 0,
+    RD_BYTES = 1,
+    WR_REQS = 2,
+    WR_BYTES = 3,
+    FLUSH_REQS = 4,
+    /** Nanoseconds spent reading per second */
+    RD_TIME = 5,
+    WR_TIME = 6,
+    ERRS = 7
+}
+
+/**
+ * Per second rates of an interface inside an IoSampler record, relative to the device offset.
+ */
+export enum InterfaceRateSlot {
+    RX_BYTES = 0,
+    RX_PACKETS = 1,
+    RX_ERRS = 2,
+    RX_DROP = 3,
+    TX_BYTES = 4,
+    TX_PACKETS = 5,
+    TX_ERRS = 6,
+    TX_DROP = 7
+}
+
+/**
+ * A record is the timestamp (ms since the epoch) followed by IO_RATE_STRIDE slots per device in `devices` order,
+ * device i starts at 1 + i * IO_RATE_STRIDE.
+ */
+export const IO_RATE_STRIDE = 8;
+
+export type IoSamplerTarget = Domain | {
+    domain: Domain,
+    /** Disk targets, read from the domain XML when omitted */
+    disks?: string[],
+    /** Interface devices, read from the domain XML when omitted (running domains only) */
+    interfaces?: string[]
+};
+
+export type IoSamplerOptions = CancelOptions & {
+    /** Default 1000, at least 100 */
+    intervalMs?: number,
+    /** Records kept until read, the oldest are dropped beyond. Default 60 */
+    capacity?: number
+};
+
+export type IoDevice = { domain: number, type: "block" | "interface", name: string };
+
+export declare class IoSampler {
+    private constructor();
+
+    get devices(): IoDevice[];
+
+    /** Slots per record */
+    get stride(): number;
+
+    /** Records waiting to be read */
+    get pending(): number;
+
+    /** Records overwritten before they were read */
+    get dropped(): number;
+
+    get running(): boolean;
+
+    start(): void;
+
+    stop(): void;
+
+    /**
+     * Move buffered records into target, oldest first. Missing rates are NaN.
+     * @return number of records written
+     */
+    read(target: Float64Array, offset?: number): number;
+}
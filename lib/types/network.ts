@@ -0,0 +1,69 @@
+import {type CancelOptions} from "./index";
+
+export enum IPAddrType {
+    IPV4 = 0,
+    IPV6 = 1
+}
+
+/**
+ * Values of the AddressInventory source column.
+ */
+export enum AddressSource {
+    /** Domain interfaces matched against the DHCP leases of libvirt networks */
+    LEASE = 0,
+    /** Reported by the guest agent */
+    AGENT = 1,
+    /** Host ARP table */
+    ARP = 2,
+    /** Network DHCP leases read directly, attributed to a domain by the interface MACs of its XML */
+    DHCP = 3
+}
+
+export type AddressSourceName = "lease" | "agent" | "arp" | "dhcp";
+
+export type DomainInterface = {
+    name: string,
+    hwaddr: string | null,
+    addrs: { type: IPAddrType, addr: string, prefix: number }[]
+};
+
+export type DhcpLease = {
+    iface: string,
+    /** Seconds since the epoch */
+    expiryTime: number,
+    type: IPAddrType,
+    mac: string | null,
+    iaid: string | null,
+    ipaddr: string,
+    prefix: number,
+    hostname: string | null,
+    clientid: string | null
+};
+
+export type AddressInventoryOptions = CancelOptions & {
+    /** Default ["lease"] */
+    sources?: AddressSourceName[],
+    /** Domains queried at the same time (default 8, at most 64) */
+    concurrency?: number
+};
+
+/**
+ * One row per address, row i is made of element i of every column. An address of a guest found by several sources
+ * is listed once, under the first of lease, agent, arp and dhcp.
+ */
+export type AddressInventory = {
+    count: number,
+    /** Domain UUID, empty for a DHCP lease without matching domain interface */
+    uuid: string[],
+    mac: string[],
+    ip: string[],
+    prefix: Uint8Array,
+    /** IPAddrType */
+    family: Uint8Array,
+    /** AddressSource */
+    source: Uint8Array,
+    /** Guest interface name, or the network name for DHCP rows */
+    interface: string[],
+    /** Domains or networks that could not be read; target is the domain UUID or the network name */
+    errors: { target: string, source: AddressSourceName, message: string }[]
+};
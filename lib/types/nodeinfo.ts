@@ -1,3 +1,5 @@
+import {type Domain} from "./domain";
+
 export type NodeInfo = {
     model: string,
     memory: number,
@@ -7,4 +9,87 @@ export type NodeInfo = {
     sockets: number,
     cores: number,
     threads: number
-}
\ No newline at end of file
+}
+/**
+ * Element index of each numeric NodeInfo field when written into a typed array, the model is not included.
+ */
+export enum NodeInfoSlot {
+    MEMORY = 0,
+    CPUS = 1,
+    MHZ = 2,
+    NODES = 3,
+    SOCKETS = 4,
+    CORES = 5,
+    THREADS = 6,
+    STRIDE = 7
+}
+
+/**
+ * virNodeGetCPUStats in nanoseconds, which fields exist depends on the driver.
+ */
+export type NodeCPUStats = {
+    kernel?: number,
+    user?: number,
+    idle?: number,
+    iowait?: number,
+    [field: string]: number | undefined
+};
+
+/**
+ * Host CPU times of HostTopologySnapshot.hostCpu in nanoseconds.
+ */
+export enum HostCpuSlot {
+    KERNEL = 0,
+    USER = 1,
+    IDLE = 2,
+    IOWAIT = 3,
+    STRIDE = 4
+}
+
+/**
+ * Record of one domain in HostTopologySnapshot.domainCpu, times in nanoseconds.
+ */
+export enum DomainCpuSlot {
+    TIME = 0,
+    USER = 1,
+    SYSTEM = 2,
+    VCPUS = 3,
+    STRIDE = 4
+}
+
+/**
+ * Record of one vCPU in HostTopologySnapshot.vcpus. DELAY is the time the vCPU was runnable but waiting for a host
+ * CPU (steal), in nanoseconds.
+ */
+export enum VcpuSlot {
+    DOMAIN = 0,
+    NUMBER = 1,
+    STATE = 2,
+    TIME = 3,
+    WAIT = 4,
+    DELAY = 5,
+    STRIDE = 6
+}
+
+export type NumaCellSnapshot = {
+    id: number,
+    /** KiB, from the capabilities */
+    memory?: number,
+    /** Bytes, null if the driver does not report it */
+    freeMemory: number | null,
+    cpus?: number[]
+};
+
+/**
+ * Result of hypervisor.hostTopologySnapshot(), unavailable values are NaN.
+ */
+export type HostTopologySnapshot = {
+    takenAt: number,
+    node: NodeInfo,
+    hostCpu: Float64Array,
+    cells: NumaCellSnapshot[],
+    /** Running domains, VcpuSlot.DOMAIN and the domainCpu records index into it */
+    domains: Domain[],
+    domainCpu: Float64Array,
+    vcpus: Float64Array
+};
@@ -0,0 +1,107 @@
+import {type CancelOptions} from "./index";
+
+export enum StoragePoolState {
+    INACTIVE = 0,
+    BUILDING = 1,
+    RUNNING = 2,
+    DEGRADED = 3,
+    INACCESSIBLE = 4
+}
+
+export enum StorageVolType {
+    FILE = 0,
+    BLOCK = 1,
+    DIR = 2,
+    NETWORK = 3,
+    NETDIR = 4,
+    PLOOP = 5
+}
+
+export enum StorageVolCreateFlags {
+    /** Only allocate the metadata of qcow2 volumes */
+    PREALLOC_METADATA = 1,
+    /** Clone with a copy-on-write reflink where the file system supports it */
+    REFLINK = 2,
+    /** Validate the XML against the schema */
+    VALIDATE = 4
+}
+
+/** Sizes in bytes */
+export type StoragePoolInfo = { state: StoragePoolState, capacity: number, allocation: number, available: number };
+
+/** Sizes in bytes */
+export type StorageVolumeInfo = { type: StorageVolType, capacity: number, allocation: number };
+
+export type VolumeCloneOptions = {
+    /** Clones running at the same time (default 4, at most 64) */
+    concurrency?: number,
+    /** Bitwise-OR of StorageVolCreateFlags */
+    flags?: number,
+    /** Stops starting new clones, running ones finish and are reported */
+    signal?: AbortSignal
+};
+
+export type VolumeCloneResult = {
+    name: string,
+    status: "ok" | "error" | "cancelled",
+    volume?: StorageVolume,
+    error?: string,
+    /** Relative to the start of the batch, missing if the clone was never started */
+    startedMs?: number,
+    durationMs: number
+};
+
+export declare class StorageVolume {
+    private constructor();
+
+    get name(): string;
+
+    /** Usually the path for file based pools */
+    get key(): string;
+
+    info(options?: CancelOptions): Promise<StorageVolumeInfo>;
+
+    path(options?: CancelOptions): Promise<string>;
+
+    toXML(flags?: number, options?: CancelOptions): Promise<string>;
+
+    /**
+     * @param flags bitwise-OR of virStorageVolDeleteFlags
+     */
+    delete(flags?: number, options?: CancelOptions): Promise<void>;
+}
+
+export declare class StoragePool {
+    private constructor();
+
+    get name(): string;
+
+    get uuid(): string;
+
+    info(options?: CancelOptions): Promise<StoragePoolInfo>;
+
+    refresh(flags?: number, options?: CancelOptions): Promise<void>;
+
+    toXML(flags?: number, options?: CancelOptions): Promise<string>;
+
+    volumes(options?: CancelOptions): Promise<StorageVolume[]>;
+
+    lookupVolume(name: string, options?: CancelOptions): Promise<StorageVolume>;
+
+    /**
+     * @param flags bitwise-OR of StorageVolCreateFlags
+     */
+    createVolume(xml: string, flags?: number, options?: CancelOptions): Promise<StorageVolume>;
+
+    /**
+     * Create a volume in this pool with the contents of source, which may live in another pool.
+     * @param flags bitwise-OR of StorageVolCreateFlags
+     */
+    cloneVolume(xml: string, source: StorageVolume, flags?: number, options?: CancelOptions): Promise<StorageVolume>;
+
+    /**
+     * Clone source (a golden image) into one new volume per name, like virsh vol-clone but with several clones
+     * running at once. A failed clone does not stop the others; results are in input order.
+     */
+    cloneVolumes(source: StorageVolume, names: string[], options?: VolumeCloneOptions): Promise<VolumeCloneResult[]>;
+}
@@ -0,0 +1,24 @@
+/**
+ * Native virStream handle, see StreamDuplex for the Node.js stream on top of it.
+ */
+export declare class Stream {
+    private constructor();
+
+    /**
+     * Start delivering received data, chunk is null at the end of the stream.
+     * Chunks are pooled external buffers owned by the callee.
+     */
+    readStart(onData: (error: Error | null, chunk?: Buffer | null) => void): void;
+
+    /** Stop requesting data from libvirt (backpressure) */
+    pause(): void;
+
+    resume(): void;
+
+    /** Send the buffer without copying it, it must not be modified until the callback ran */
+    write(chunk: Buffer, callback?: (error?: Error) => void): void;
+
+    finish(): Promise<void>;
+
+    abort(): Promise<void>;
+}
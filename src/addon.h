@@ -0,0 +1,42 @@
+//
+// Created by root on 3/23/24.
+//
+
+#ifndef NODE_LIBVIRT_ADDON_H
+#define NODE_LIBVIRT_ADDON_H
+
+#include <napi.h>
+
+/**
+ * Per environment state of the addon, stored with Env::SetInstanceData.
+ */
+struct AddonData {
+    Napi::FunctionReference hypervisorConstructor;
+    Napi::FunctionReference domainConstructor;
+    Napi::FunctionReference streamConstructor;
+    Napi::FunctionReference ioSamplerConstructor;
+    Napi::FunctionReference storagePoolConstructor;
+    Napi::FunctionReference storageVolumeConstructor;
+    Napi::FunctionReference balloonControllerConstructor;
+
+    /**
+     * Carries finished PromiseWorkers from executor threads back to the JavaScript thread.
+     * Only referenced while work is pending so it doesn't keep the event loop alive.
+     */
+    Napi::ThreadSafeFunction completions;
+    size_t pending = 0;
+
+    static AddonData *Get(Napi::Env env) {
+        return env.GetInstanceData<AddonData>();
+    }
+
+    void BeginWork(Napi::Env env) {
+        if (pending++ == 0) completions.Ref(env);
+    }
+
+    void EndWork(Napi::Env env) {
+        if (--pending == 0) completions.Unref(env);
+    }
+};
+
+#endif //NODE_LIBVIRT_ADDON_H
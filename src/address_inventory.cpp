@@ -0,0 +1,328 @@
+//
+// Created by root on 4/23/24.
+//
+
+#include "address_inventory.h"
+#include "xml_projection.h"
+#include "helper/libvirt_error.h"
+
+#include <libvirt/virterror.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+//region HELPERS
+
+static std::string String(const char *value) {
+    return value ? value : "";
+}
+
+/**
+ * MAC addresses compare case insensitively, libvirt reports them lower case but leases may not be.
+ */
+static std::string NormalizeMac(const std::string &mac) {
+    std::string result(mac);
+    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) -> char {
+        return static_cast<char>(std::tolower(c));
+    });
+    return result;
+}
+
+/**
+ * Empty or all zero, like the loopback interface reported by the guest agent. Such a MAC identifies no guest.
+ */
+static bool IsUnassignedMac(const std::string &mac) {
+    return std::all_of(mac.begin(), mac.end(), [](char c) -> bool {
+        return c == '0' || c == ':' || c == '-';
+    });
+}
+
+//endregion
+
+std::vector<InterfaceAddresses> GetInterfaceAddresses(virDomainPtr domain, unsigned int source) {
+    virDomainInterfacePtr *ifaces = nullptr;
+    auto count = virDomainInterfaceAddresses(domain, &ifaces, source, 0);
+    if (count < 0) throw LibvirtError("Failed to get interface addresses");
+
+    std::vector<InterfaceAddresses> interfaces(static_cast<size_t>(count));
+    for (int i = 0; i < count; i++) {
+        auto &target = interfaces[i];
+        target.name = String(ifaces[i]->name);
+        target.hwaddr = String(ifaces[i]->hwaddr);
+        for (unsigned int j = 0; j < ifaces[i]->naddrs; j++) {
+            InterfaceAddress address;
+            address.type = ifaces[i]->addrs[j].type;
+            address.addr = String(ifaces[i]->addrs[j].addr);
+            address.prefix = ifaces[i]->addrs[j].prefix;
+            target.addrs.push_back(std::move(address));
+        }
+        virDomainInterfaceFree(ifaces[i]);
+    }
+    free(ifaces);
+    return interfaces;
+}
+
+std::vector<DhcpLease> GetDhcpLeases(virNetworkPtr network, const std::string &mac) {
+    virNetworkDHCPLeasePtr *leases = nullptr;
+    auto count = virNetworkGetDHCPLeases(network, mac.empty() ? nullptr : mac.c_str(), &leases, 0);
+    if (count < 0) throw LibvirtError("Failed to get DHCP leases");
+
+    std::vector<DhcpLease> result(static_cast<size_t>(count));
+    for (int i = 0; i < count; i++) {
+        auto &target = result[i];
+        target.iface = String(leases[i]->iface);
+        target.expiryTime = leases[i]->expirytime;
+        target.type = leases[i]->type;
+        target.mac = String(leases[i]->mac);
+        target.iaid = String(leases[i]->iaid);
+        target.ipaddr = String(leases[i]->ipaddr);
+        target.prefix = leases[i]->prefix;
+        target.hostname = String(leases[i]->hostname);
+        target.clientid = String(leases[i]->clientid);
+        virNetworkDHCPLeaseFree(leases[i]);
+    }
+    free(leases);
+    return result;
+}
+
+Napi::Array InterfaceAddressesToArray(Napi::Env env, const std::vector<InterfaceAddresses> &interfaces) {
+    auto array = Napi::Array::New(env, interfaces.size());
+    for (size_t i = 0; i < interfaces.size(); i++) {
+        const auto &iface = interfaces[i];
+        auto obj = Napi::Object::New(env);
+        obj.Set("name", Napi::String::New(env, iface.name));
+        obj.Set("hwaddr", iface.hwaddr.empty() ? env.Null() : Napi::String::New(env, iface.hwaddr));
+        auto addrs = Napi::Array::New(env, iface.addrs.size());
+        for (size_t j = 0; j < iface.addrs.size(); j++) {
+            auto addr = Napi::Object::New(env);
+            addr.Set("type", Napi::Number::New(env, iface.addrs[j].type));
+            addr.Set("addr", Napi::String::New(env, iface.addrs[j].addr));
+            addr.Set("prefix", Napi::Number::New(env, iface.addrs[j].prefix));
+            addrs.Set(static_cast<uint32_t>(j), addr);
+        }
+        obj.Set("addrs", addrs);
+        array.Set(static_cast<uint32_t>(i), obj);
+    }
+    return array;
+}
+
+Napi::Array DhcpLeasesToArray(Napi::Env env, const std::vector<DhcpLease> &leases) {
+    auto optional = [env](const std::string &value) -> Napi::Value {
+        return value.empty() ? env.Null() : Napi::String::New(env, value);
+    };
+    auto array = Napi::Array::New(env, leases.size());
+    for (size_t i = 0; i < leases.size(); i++) {
+        const auto &lease = leases[i];
+        auto obj = Napi::Object::New(env);
+        obj.Set("iface", Napi::String::New(env, lease.iface));
+        obj.Set("expiryTime", Napi::Number::New(env, static_cast<double>(lease.expiryTime)));
+        obj.Set("type", Napi::Number::New(env, lease.type));
+        obj.Set("mac", optional(lease.mac));
+        obj.Set("iaid", optional(lease.iaid));
+        obj.Set("ipaddr", Napi::String::New(env, lease.ipaddr));
+        obj.Set("prefix", Napi::Number::New(env, lease.prefix));
+        obj.Set("hostname", optional(lease.hostname));
+        obj.Set("clientid", optional(lease.clientid));
+        array.Set(static_cast<uint32_t>(i), obj);
+    }
+    return array;
+}
+
+//region INVENTORY
+
+namespace {
+    struct DomainAddresses {
+        std::string uuid;
+        std::vector<InterfaceAddresses> interfaces[ADDRESS_SOURCE_DHCP];
+        /** Interface MACs of the domain XML, read for matching DHCP leases */
+        std::vector<std::string> macs;
+        /** Indexed by AddressSource, DHCP for reading the domain XML */
+        std::string errors[ADDRESS_SOURCE_COUNT];
+    };
+
+    /**
+     * MAC addresses of the interfaces in the domain definition, unlike the interface address sources they are known
+     * without a lease, agent or ARP entry.
+     */
+    std::vector<std::string> InterfaceMacs(virDomainPtr domain) {
+        auto xmlDesc = virDomainGetXMLDesc(domain, 0);
+        if (!xmlDesc) throw LibvirtError("Failed to get domain XML");
+        std::string xml(xmlDesc);
+        free(xmlDesc);
+        return ProjectXml(xml, {{"macs", "/domain/devices/interface/mac/@address"}})[0].second.nodes;
+    }
+}
+
+static void AddRow(AddressInventory &inventory, const std::string &uuid, const std::string &mac, const std::string &ip,
+                   unsigned int prefix, int family, AddressSource source, const std::string &interface) {
+    inventory.uuid.push_back(uuid);
+    inventory.mac.push_back(mac);
+    inventory.ip.push_back(ip);
+    inventory.prefix.push_back(static_cast<uint8_t>(prefix));
+    inventory.family.push_back(static_cast<uint8_t>(family));
+    inventory.source.push_back(static_cast<uint8_t>(source));
+    inventory.interface.push_back(interface);
+}
+
+AddressInventory CollectAddressInventory(virConnectPtr conn, const AddressInventoryOptions &options) {
+    virDomainPtr *list = nullptr;
+    auto count = virConnectListAllDomains(conn, &list, VIR_CONNECT_LIST_DOMAINS_ACTIVE);
+    if (count < 0) throw LibvirtError("Failed to list domains");
+    std::vector<virDomainPtr> domains(list, list + count);
+    free(list);
+
+    std::vector<DomainAddresses> results(domains.size());
+    std::atomic<size_t> next{0};
+    auto runner = [&domains, &results, &next, &options]() {
+        for (auto i = next++; i < domains.size(); i = next++) {
+            auto &result = results[i];
+            char uuid[VIR_UUID_STRING_BUFLEN];
+            if (virDomainGetUUIDString(domains[i], uuid) == 0) result.uuid = uuid;
+            for (unsigned int source = 0; source < ADDRESS_SOURCE_DHCP; source++) {
+                if (!(options.sources & (1u << source))) continue;
+                try {
+                    result.interfaces[source] = GetInterfaceAddresses(domains[i], source);
+                } catch (const std::exception &e) {
+                    result.errors[source] = e.what();
+                }
+            }
+            if (options.sources & (1u << ADDRESS_SOURCE_DHCP)) {
+                try {
+                    result.macs = InterfaceMacs(domains[i]);
+                } catch (const std::exception &e) {
+                    result.errors[ADDRESS_SOURCE_DHCP] = e.what();
+                }
+            }
+        }
+    };
+    auto threads = std::min(std::max<size_t>(options.concurrency, 1), domains.size());
+    std::vector<std::thread> runners;
+    /* The calling thread is one of the runners */
+    for (size_t i = 1; i < threads; i++) {
+        try {
+            runners.emplace_back(runner);
+        } catch (const std::system_error &) {
+            break;
+        }
+    }
+    runner();
+    for (auto &thread: runners) thread.join();
+    for (auto domainPtr: domains) virDomainFree(domainPtr);
+
+    AddressInventory inventory;
+    /*
+     * The lease source and the network leases report the same addresses, keep the first row of each. Keyed per guest
+     * since every guest agent reports lo and cloned guests may share a MAC and address on isolated networks.
+     */
+    std::set<std::string> seen;
+    auto addUnique = [&inventory, &seen](const std::string &uuid, const std::string &mac, const std::string &ip,
+                                         unsigned int prefix, int family, AddressSource source,
+                                         const std::string &interface) {
+        if (!seen.insert(uuid + "|" + NormalizeMac(mac) + "|" + ip).second) return;
+        AddRow(inventory, uuid, mac, ip, prefix, family, source, interface);
+    };
+    std::map<std::string, std::string> macToUuid;
+    auto addOwner = [&macToUuid](const std::string &mac, const std::string &uuid) {
+        if (IsUnassignedMac(mac)) return;
+        macToUuid[NormalizeMac(mac)] = uuid;
+    };
+    for (const auto &result: results) {
+        for (unsigned int source = 0; source < ADDRESS_SOURCE_COUNT; source++) {
+            if (!result.errors[source].empty()) {
+                inventory.errors.push_back({result.uuid, static_cast<AddressSource>(source), result.errors[source]});
+            }
+        }
+        for (const auto &mac: result.macs) addOwner(mac, result.uuid);
+        for (unsigned int source = 0; source < ADDRESS_SOURCE_DHCP; source++) {
+            for (const auto &iface: result.interfaces[source]) {
+                addOwner(iface.hwaddr, result.uuid);
+                for (const auto &addr: iface.addrs) {
+                    addUnique(result.uuid, iface.hwaddr, addr.addr, addr.prefix, addr.type,
+                              static_cast<AddressSource>(source), iface.name);
+                }
+            }
+        }
+    }
+
+    if (options.sources & (1u << ADDRESS_SOURCE_DHCP)) {
+        virNetworkPtr *networks = nullptr;
+        auto networkCount = virConnectListAllNetworks(conn, &networks, VIR_CONNECT_LIST_NETWORKS_ACTIVE);
+        if (networkCount < 0) {
+            auto error = LibvirtError("Failed to list networks");
+            inventory.errors.push_back({"", ADDRESS_SOURCE_DHCP, error.what()});
+        }
+        for (int i = 0; i < networkCount; i++) {
+            auto name = String(virNetworkGetName(networks[i]));
+            try {
+                for (const auto &lease: GetDhcpLeases(networks[i], "")) {
+                    auto owner = macToUuid.find(NormalizeMac(lease.mac));
+                    addUnique(owner == macToUuid.end() ? "" : owner->second, lease.mac, lease.ipaddr, lease.prefix,
+                              lease.type, ADDRESS_SOURCE_DHCP, name);
+                }
+            } catch (const std::exception &e) {
+                inventory.errors.push_back({name, ADDRESS_SOURCE_DHCP, e.what()});
+            }
+            virNetworkFree(networks[i]);
+        }
+        free(networks);
+    }
+    return inventory;
+}
+
+static Napi::Array StringColumn(Napi::Env env, const std::vector<std::string> &values) {
+    auto array = Napi::Array::New(env, values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        array.Set(static_cast<uint32_t>(i), Napi::String::New(env, values[i]));
+    }
+    return array;
+}
+
+static Napi::Uint8Array ByteColumn(Napi::Env env, const std::vector<uint8_t> &values) {
+    auto array = Napi::Uint8Array::New(env, values.size());
+    std::copy(values.begin(), values.end(), array.Data());
+    return array;
+}
+
+static const char *const SourceNames[ADDRESS_SOURCE_COUNT] = {"lease", "agent", "arp", "dhcp"};
+
+bool ParseAddressSource(const std::string &name, AddressSource &source) {
+    for (unsigned int i = 0; i < ADDRESS_SOURCE_COUNT; i++) {
+        if (name == SourceNames[i]) {
+            source = static_cast<AddressSource>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+Napi::Object AddressInventoryToObject(Napi::Env env, const AddressInventory &inventory) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("count", Napi::Number::New(env, static_cast<double>(inventory.uuid.size())));
+    obj.Set("uuid", StringColumn(env, inventory.uuid));
+    obj.Set("mac", StringColumn(env, inventory.mac));
+    obj.Set("ip", StringColumn(env, inventory.ip));
+    obj.Set("prefix", ByteColumn(env, inventory.prefix));
+    obj.Set("family", ByteColumn(env, inventory.family));
+    obj.Set("source", ByteColumn(env, inventory.source));
+    obj.Set("interface", StringColumn(env, inventory.interface));
+
+    auto errors = Napi::Array::New(env, inventory.errors.size());
+    for (size_t i = 0; i < inventory.errors.size(); i++) {
+        auto error = Napi::Object::New(env);
+        error.Set("target", Napi::String::New(env, inventory.errors[i].target));
+        error.Set("source", Napi::String::New(env, SourceNames[inventory.errors[i].source]));
+        error.Set("message", Napi::String::New(env, inventory.errors[i].message));
+        errors.Set(static_cast<uint32_t>(i), error);
+    }
+    obj.Set("errors", errors);
+    return obj;
+}
+
+//endregion
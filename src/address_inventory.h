@@ -0,0 +1,116 @@
+//
+// Created by root on 4/23/24.
+//
+
+#ifndef NODE_LIBVIRT_ADDRESS_INVENTORY_H
+#define NODE_LIBVIRT_ADDRESS_INVENTORY_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct InterfaceAddress {
+    /** virIPAddrType */
+    int type = 0;
+    std::string addr;
+    unsigned int prefix = 0;
+};
+
+struct InterfaceAddresses {
+    std::string name;
+    std::string hwaddr;
+    std::vector<InterfaceAddress> addrs;
+};
+
+struct DhcpLease {
+    std::string iface;
+    /** Seconds since the epoch */
+    long long expiryTime = 0;
+    /** virIPAddrType */
+    int type = 0;
+    std::string mac;
+    std::string iaid;
+    std::string ipaddr;
+    unsigned int prefix = 0;
+    std::string hostname;
+    std::string clientid;
+};
+
+/**
+ * The calls below block and throw std::runtime_error with the libvirt error, use them on a worker thread.
+ * @param source virDomainInterfaceAddressesSource
+ */
+std::vector<InterfaceAddresses> GetInterfaceAddresses(virDomainPtr domain, unsigned int source);
+
+/**
+ * @param mac only leases of this MAC address, all when empty
+ */
+std::vector<DhcpLease> GetDhcpLeases(virNetworkPtr network, const std::string &mac);
+
+Napi::Array InterfaceAddressesToArray(Napi::Env env, const std::vector<InterfaceAddresses> &interfaces);
+
+Napi::Array DhcpLeasesToArray(Napi::Env env, const std::vector<DhcpLease> &leases);
+
+/**
+ * Where an inventory row comes from: the virDomainInterfaceAddressesSource values, then the DHCP leases of the
+ * networks read directly.
+ */
+enum AddressSource {
+    ADDRESS_SOURCE_LEASE = 0,
+    ADDRESS_SOURCE_AGENT = 1,
+    ADDRESS_SOURCE_ARP = 2,
+    ADDRESS_SOURCE_DHCP = 3,
+    ADDRESS_SOURCE_COUNT
+};
+
+/**
+ * Guest addresses of every active domain as columns, one row per address.
+ *
+ * Interface addresses are read per domain and source with a few runner threads, since an unresponsive guest agent
+ * blocks its call for seconds. DHCP leases are read once per active network and matched to domains by the interface
+ * MACs of their XML, a lease without matching interface keeps an empty uuid. An address of a guest reported by
+ * several sources is listed once, under the first of lease, agent, arp and dhcp.
+ */
+struct AddressInventory {
+    std::vector<std::string> uuid;
+    std::vector<std::string> mac;
+    std::vector<std::string> ip;
+    std::vector<uint8_t> prefix;
+    /** virIPAddrType */
+    std::vector<uint8_t> family;
+    /** AddressSource */
+    std::vector<uint8_t> source;
+    /** Guest interface name, or the network name for DHCP rows */
+    std::vector<std::string> interface;
+
+    struct Error {
+        /** Domain UUID, or the network name for DHCP */
+        std::string target;
+        AddressSource source;
+        std::string message;
+    };
+    std::vector<Error> errors;
+};
+
+struct AddressInventoryOptions {
+    /** Bit (1 << AddressSource) per source to read */
+    unsigned int sources = 1u << ADDRESS_SOURCE_LEASE;
+    size_t concurrency = 8;
+};
+
+/**
+ * Failing domains and networks end up in errors, only listing the domains fails the whole call.
+ */
+AddressInventory CollectAddressInventory(virConnectPtr conn, const AddressInventoryOptions &options);
+
+Napi::Object AddressInventoryToObject(Napi::Env env, const AddressInventory &inventory);
+
+/**
+ * Parse a source name ("lease", "agent", "arp" or "dhcp").
+ */
+bool ParseAddressSource(const std::string &name, AddressSource &source);
+
+#endif //NODE_LIBVIRT_ADDRESS_INVENTORY_H
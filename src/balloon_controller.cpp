@@ -0,0 +1,436 @@
+//
+// Created by root on 4/25/24.
+//
+
+#include "balloon_controller.h"
+#include "addon.h"
+#include "helper/assert.h"
+#include "helper/stats_layout.h"
+#include "helper/libvirt_error.h"
+
+#include <libvirt/virterror.h>
+
+#include <algorithm>
+#include <thread>
+
+//region TUNER
+
+static BalloonAction ErrorAction(size_t domain, const char *fallback) {
+    BalloonAction action;
+    action.kind = BalloonAction::Error;
+    action.domain = domain;
+    action.error = LastErrorMessage(fallback);
+    return action;
+}
+
+BalloonTuner::BalloonTuner(std::vector<virDomainPtr> &&domains, const BalloonPolicy &policy)
+        : _domains(std::move(domains)), _adjustedAt(_domains.size()), _policy(policy) {
+}
+
+BalloonTuner::~BalloonTuner() {
+    for (auto domainPtr: _domains) {
+        if (domainPtr) virDomainFree(domainPtr);
+    }
+}
+
+void BalloonTuner::Start() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_running) return;
+    _running = true;
+    auto generation = ++_generation;
+    auto self = shared_from_this();
+    std::thread([self, generation]() {
+        self->Run(generation);
+    }).detach();
+}
+
+void BalloonTuner::Stop() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_running) return;
+    _running = false;
+    /* A thread still inside a round drops its report */
+    _generation++;
+    _wake.notify_all();
+}
+
+bool BalloonTuner::Running() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _running;
+}
+
+BalloonPolicy BalloonTuner::Policy() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _policy;
+}
+
+void BalloonTuner::SetPolicy(const BalloonPolicy &policy) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy = policy;
+}
+
+void BalloonTuner::SetReporter(Reporter reporter) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _reporter = std::move(reporter);
+}
+
+BalloonTuner::Stats BalloonTuner::GetStats() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void BalloonTuner::Run(unsigned long generation) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto policy = _policy;
+    lock.unlock();
+
+    std::vector<BalloonAction> actions;
+    if (policy.statsPeriod > 0) {
+        std::lock_guard<std::mutex> roundLock(_roundMutex);
+        for (size_t i = 0; i < _domains.size() && Current(generation); i++) {
+            if (virDomainIsActive(_domains[i]) == 1 &&
+                virDomainSetMemoryStatsPeriod(_domains[i], policy.statsPeriod, VIR_DOMAIN_AFFECT_LIVE) < 0) {
+                actions.push_back(ErrorAction(i, "Failed to set the memory stats period"));
+            }
+        }
+    }
+
+    lock.lock();
+    while (_generation == generation) {
+        policy = _policy;
+        lock.unlock();
+        auto startedAt = Clock::now();
+        {
+            std::lock_guard<std::mutex> roundLock(_roundMutex);
+            auto round = Round(policy, generation);
+            actions.insert(actions.end(), round.begin(), round.end());
+        }
+        lock.lock();
+        if (_generation != generation) break;
+
+        _stats.rounds++;
+        for (const auto &action: actions) {
+            if (action.kind == BalloonAction::Grow) _stats.grown++;
+            else if (action.kind == BalloonAction::Shrink) _stats.shrunk++;
+            else _stats.errors++;
+        }
+        auto reporter = _reporter;
+        if (reporter && !actions.empty()) {
+            lock.unlock();
+            reporter(std::move(actions));
+            lock.lock();
+        }
+        actions.clear();
+
+        _wake.wait_until(lock, startedAt + policy.interval, [this, generation]() {
+            return _generation != generation;
+        });
+    }
+}
+
+bool BalloonTuner::Current(unsigned long generation) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _generation == generation;
+}
+
+std::vector<BalloonAction> BalloonTuner::Round(const BalloonPolicy &policy, unsigned long generation) {
+    struct Candidate {
+        BalloonAction action;
+        /** KiB below minFree or above maxFree */
+        uint64_t distance;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<BalloonAction> actions;
+    auto now = Clock::now();
+    /* Aim for the middle of the watermarks so a guest doesn't bounce between them */
+    auto desired = policy.maxFreeKiB > policy.minFreeKiB
+                   ? policy.minFreeKiB + (policy.maxFreeKiB - policy.minFreeKiB) / 2 : policy.minFreeKiB;
+
+    for (size_t i = 0; i < _domains.size(); i++) {
+        if (_adjustedAt[i] != Clock::time_point() && now - _adjustedAt[i] < policy.cooldown) continue;
+        auto domainPtr = _domains[i];
+        if (virDomainIsActive(domainPtr) != 1) continue;
+
+        virDomainMemoryStatStruct stats[VIR_DOMAIN_MEMORY_STAT_NR];
+        auto count = virDomainMemoryStats(domainPtr, stats, VIR_DOMAIN_MEMORY_STAT_NR, 0);
+        if (count < 0) {
+            actions.push_back(ErrorAction(i, "Failed to read memory stats"));
+            continue;
+        }
+        uint64_t slots[MEMORY_STAT_STRIDE];
+        MemoryStatsSlots(stats, count, slots);
+        auto actual = slots[MEMORY_STAT_ACTUAL_BALLOON];
+        auto free = slots[MEMORY_STAT_USABLE] != STATS_MISSING ? slots[MEMORY_STAT_USABLE]
+                                                               : slots[MEMORY_STAT_UNUSED];
+        /* No balloon driver, or no stats period set */
+        if (actual == STATS_MISSING || free == STATS_MISSING) continue;
+
+        Candidate candidate;
+        candidate.action.domain = i;
+        candidate.action.fromKiB = actual;
+        candidate.action.freeKiB = free;
+        if (free < policy.minFreeKiB) {
+            auto maxMemory = virDomainGetMaxMemory(domainPtr);
+            if (maxMemory == 0) {
+                actions.push_back(ErrorAction(i, "Failed to read the maximum memory"));
+                continue;
+            }
+            auto target = std::min<uint64_t>(actual + std::min(policy.stepKiB, desired - free), maxMemory);
+            if (target <= actual) continue;
+            candidate.action.kind = BalloonAction::Grow;
+            candidate.action.toKiB = target;
+            candidate.distance = policy.minFreeKiB - free;
+        } else if (policy.maxFreeKiB > 0 && free > policy.maxFreeKiB) {
+            auto delta = std::min(policy.stepKiB, free - desired);
+            auto target = actual > policy.floorKiB + delta ? actual - delta : policy.floorKiB;
+            if (target >= actual) continue;
+            candidate.action.kind = BalloonAction::Shrink;
+            candidate.action.toKiB = target;
+            candidate.distance = free - policy.maxFreeKiB;
+        } else {
+            continue;
+        }
+        candidates.push_back(candidate);
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) -> bool {
+        if (a.action.kind != b.action.kind) return a.action.kind == BalloonAction::Grow;
+        return a.distance > b.distance;
+    });
+    if (candidates.size() > policy.batchSize) {
+        candidates.erase(candidates.begin() + static_cast<std::ptrdiff_t>(policy.batchSize), candidates.end());
+    }
+    for (const auto &candidate: candidates) {
+        /* Stopped while sampling, the changes are no longer wanted */
+        if (!Current(generation)) break;
+        auto i = candidate.action.domain;
+        if (virDomainSetMemoryFlags(_domains[i], candidate.action.toKiB, VIR_DOMAIN_AFFECT_LIVE) < 0) {
+            actions.push_back(ErrorAction(i, "Failed to set the balloon target"));
+            continue;
+        }
+        _adjustedAt[i] = now;
+        actions.push_back(candidate.action);
+    }
+    return actions;
+}
+
+bool ReadBalloonPolicy(Napi::Env env, const Napi::Value &value, BalloonPolicy &policy) {
+    if (value.IsUndefined()) return true;
+    if (!value.IsObject()) {
+        Napi::TypeError::New(env, "Expected a policy object").ThrowAsJavaScriptException();
+        return false;
+    }
+    auto object = value.ToObject();
+    auto result = policy;
+    auto readUnsigned = [&object](const char *key, uint64_t &target) -> bool {
+        auto item = object.Get(key);
+        if (item.IsUndefined()) return true;
+        if (!item.IsNumber() || item.ToNumber().DoubleValue() < 0) return false;
+        target = static_cast<uint64_t>(item.ToNumber().Int64Value());
+        return true;
+    };
+    uint64_t batchSize = result.batchSize;
+    uint64_t intervalMs = static_cast<uint64_t>(result.interval.count());
+    uint64_t cooldownMs = static_cast<uint64_t>(result.cooldown.count());
+    uint64_t statsPeriod = static_cast<uint64_t>(result.statsPeriod);
+    if (!readUnsigned("minFreeKiB", result.minFreeKiB) || !readUnsigned("maxFreeKiB", result.maxFreeKiB) ||
+        !readUnsigned("stepKiB", result.stepKiB) || !readUnsigned("floorKiB", result.floorKiB) ||
+        !readUnsigned("batchSize", batchSize) || !readUnsigned("intervalMs", intervalMs) ||
+        !readUnsigned("cooldownMs", cooldownMs) || !readUnsigned("statsPeriod", statsPeriod)) {
+        Napi::TypeError::New(env, "Policy values must be non-negative numbers").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (result.maxFreeKiB > 0 && result.maxFreeKiB <= result.minFreeKiB) {
+        Napi::RangeError::New(env, "'maxFreeKiB' must be above 'minFreeKiB'").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (result.stepKiB == 0 || batchSize == 0 || intervalMs < 500) {
+        Napi::RangeError::New(env, "'stepKiB' and 'batchSize' must be positive, 'intervalMs' at least 500")
+                .ThrowAsJavaScriptException();
+        return false;
+    }
+    result.batchSize = static_cast<size_t>(batchSize);
+    result.interval = std::chrono::milliseconds(intervalMs);
+    result.cooldown = std::chrono::milliseconds(cooldownMs);
+    result.statsPeriod = static_cast<int>(std::min<uint64_t>(statsPeriod, 86400));
+    policy = result;
+    return true;
+}
+
+//endregion
+
+/**
+ * Listener of the tuner's actions, shared with the reporter so rounds after the wrapper is gone are dropped.
+ */
+struct BalloonActionChannel {
+    std::mutex mutex;
+    Napi::ThreadSafeFunction tsfn;
+    bool active = false;
+};
+
+static Napi::Array ActionsToArray(Napi::Env env, const std::vector<BalloonAction> &actions) {
+    static const char *const kinds[] = {"grow", "shrink", "error"};
+    auto array = Napi::Array::New(env, actions.size());
+    for (size_t i = 0; i < actions.size(); i++) {
+        const auto &action = actions[i];
+        auto obj = Napi::Object::New(env);
+        obj.Set("type", Napi::String::New(env, kinds[action.kind]));
+        obj.Set("domain", Napi::Number::New(env, static_cast<double>(action.domain)));
+        if (action.kind == BalloonAction::Error) {
+            obj.Set("message", Napi::String::New(env, action.error));
+        } else {
+            obj.Set("fromKiB", Napi::Number::New(env, static_cast<double>(action.fromKiB)));
+            obj.Set("toKiB", Napi::Number::New(env, static_cast<double>(action.toKiB)));
+            obj.Set("freeKiB", Napi::Number::New(env, static_cast<double>(action.freeKiB)));
+        }
+        array.Set(static_cast<uint32_t>(i), obj);
+    }
+    return array;
+}
+
+//region STATIC
+
+Napi::Object BalloonController::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func =
+            DefineClass(env, "BalloonController", {
+                    /* Instance accessors */
+                    InstanceAccessor("size", &BalloonController::Size, nullptr),
+                    InstanceAccessor("running", &BalloonController::Running, nullptr),
+                    InstanceAccessor("policy", &BalloonController::Policy, nullptr),
+                    InstanceAccessor("stats", &BalloonController::Stats, nullptr),
+
+                    /* Instance Methods */
+                    InstanceMethod("start", &BalloonController::Start),
+                    InstanceMethod("stop", &BalloonController::Stop),
+                    InstanceMethod("setPolicy", &BalloonController::SetPolicy)
+            });
+
+    AddonData::Get(env)->balloonControllerConstructor = Napi::Persistent(func);
+    exports.Set("BalloonController", func);
+    return exports;
+}
+
+Napi::Object BalloonController::New(Napi::Env env, const std::initializer_list<napi_value> &args) {
+    Napi::EscapableHandleScope scope(env);
+    Napi::Object obj = AddonData::Get(env)->balloonControllerConstructor.New(args);
+    return scope.Escape(napi_value(obj)).ToObject();
+}
+
+//endregion
+
+//region INSTANCE
+
+BalloonController::BalloonController(const Napi::CallbackInfo &info) : Napi::ObjectWrap<BalloonController>(info) {
+    Napi::Env env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsExternal()) {
+        Napi::TypeError::New(env, "Expected an external.")
+                .ThrowAsJavaScriptException();
+        return;
+    }
+    auto tuner = info[0].As<Napi::External<std::shared_ptr<BalloonTuner>>>().Data();
+    this->_tuner = std::move(*tuner);
+    delete tuner;
+
+    auto channel = std::make_shared<BalloonActionChannel>();
+    this->_channel = channel;
+    if (info.Length() > 1 && info[1].IsFunction()) {
+        channel->tsfn = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "libvirt.balloon", 0, 1);
+        /* A listener alone must not keep the process alive */
+        channel->tsfn.Unref(env);
+        channel->active = true;
+    }
+    this->_tuner->SetReporter([channel](std::vector<BalloonAction> &&actions) {
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        if (!channel->active) return;
+        auto batch = new std::vector<BalloonAction>(std::move(actions));
+        auto status = channel->tsfn.NonBlockingCall(batch, [](Napi::Env env, Napi::Function listener,
+                                                               std::vector<BalloonAction> *batch) {
+            auto array = ActionsToArray(env, *batch);
+            delete batch;
+            listener.Call({array});
+        });
+        if (status != napi_ok) delete batch;
+    });
+}
+
+BalloonController::~BalloonController() {
+    if (this->_tuner) this->_tuner->Stop();
+    if (this->_channel) {
+        std::lock_guard<std::mutex> lock(this->_channel->mutex);
+        if (this->_channel->active) this->_channel->tsfn.Release();
+        this->_channel->active = false;
+    }
+}
+
+//region ACCESSORS
+
+Napi::Value BalloonController::Size(const Napi::CallbackInfo &info) {
+    assert(this->_tuner, "Controller not defined");
+    return Napi::Number::New(info.Env(), static_cast<double>(this->_tuner->Size()));
+}
+
+Napi::Value BalloonController::Running(const Napi::CallbackInfo &info) {
+    assert(this->_tuner, "Controller not defined");
+    return Napi::Boolean::New(info.Env(), this->_tuner->Running());
+}
+
+Napi::Value BalloonController::Policy(const Napi::CallbackInfo &info) {
+    assert(this->_tuner, "Controller not defined");
+    auto env = info.Env();
+    auto policy = this->_tuner->Policy();
+    auto obj = Napi::Object::New(env);
+    obj.Set("minFreeKiB", Napi::Number::New(env, static_cast<double>(policy.minFreeKiB)));
+    obj.Set("maxFreeKiB", Napi::Number::New(env, static_cast<double>(policy.maxFreeKiB)));
+    obj.Set("stepKiB", Napi::Number::New(env, static_cast<double>(policy.stepKiB)));
+    obj.Set("floorKiB", Napi::Number::New(env, static_cast<double>(policy.floorKiB)));
+    obj.Set("batchSize", Napi::Number::New(env, static_cast<double>(policy.batchSize)));
+    obj.Set("intervalMs", Napi::Number::New(env, static_cast<double>(policy.interval.count())));
+    obj.Set("cooldownMs", Napi::Number::New(env, static_cast<double>(policy.cooldown.count())));
+    obj.Set("statsPeriod", Napi::Number::New(env, policy.statsPeriod));
+    return obj;
+}
+
+Napi::Value BalloonController::Stats(const Napi::CallbackInfo &info) {
+    assert(this->_tuner, "Controller not defined");
+    auto env = info.Env();
+    auto stats = this->_tuner->GetStats();
+    auto obj = Napi::Object::New(env);
+    obj.Set("rounds", Napi::Number::New(env, static_cast<double>(stats.rounds)));
+    obj.Set("grown", Napi::Number::New(env, static_cast<double>(stats.grown)));
+    obj.Set("shrunk", Napi::Number::New(env, static_cast<double>(stats.shrunk)));
+    obj.Set("errors", Napi::Number::New(env, static_cast<double>(stats.errors)));
+    return obj;
+}
+
+//endregion
+
+//region INSTANCE METHODS
+
+Napi::Value BalloonController::Start(const Napi::CallbackInfo &info) {
+    assert(this->_tuner, "Controller not defined");
+    this->_tuner->Start();
+    return info.Env().Undefined();
+}
+
+Napi::Value BalloonController::Stop(const Napi::CallbackInfo &info) {
+    assert(this->_tuner, "Controller not defined");
+    this->_tuner->Stop();
+    return info.Env().Undefined();
+}
+
+Napi::Value BalloonController::SetPolicy(const Napi::CallbackInfo &info) {
+    assert(this->_tuner, "Controller not defined");
+    auto env = info.Env();
+    auto policy = this->_tuner->Policy();
+    if (info.Length() <= 0 || !ReadBalloonPolicy(env, info[0], policy)) {
+        if (!env.IsExceptionPending()) {
+            Napi::TypeError::New(env, "Expected a policy object").ThrowAsJavaScriptException();
+        }
+        return env.Undefined();
+    }
+    this->_tuner->SetPolicy(policy);
+    return env.Undefined();
+}
+
+//endregion
+
+//endregion
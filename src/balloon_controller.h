@@ -0,0 +1,197 @@
+//
+// Created by root on 4/25/24.
+//
+
+#ifndef NODE_LIBVIRT_BALLOON_CONTROLLER_H
+#define NODE_LIBVIRT_BALLOON_CONTROLLER_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Watermarks of a BalloonTuner, sizes in KiB. Free memory is the guest's usable memory, or its unused memory for
+ * balloon drivers that don't report usable.
+ */
+struct BalloonPolicy {
+    /** Give memory back to a guest whose free memory falls below */
+    uint64_t minFreeKiB = 262144;
+    /** Reclaim memory from a guest whose free memory exceeds, 0 never reclaims */
+    uint64_t maxFreeKiB = 0;
+    /** Largest change of one domain per adjustment */
+    uint64_t stepKiB = 262144;
+    /** Never shrink a guest below */
+    uint64_t floorKiB = 524288;
+    /** Domains adjusted per round, the most starved first */
+    size_t batchSize = 8;
+    std::chrono::milliseconds interval{5000};
+    /** Time between two adjustments of a domain so the balloon settles and its stats catch up */
+    std::chrono::milliseconds cooldown{15000};
+    /** Balloon stats period (seconds) set on the domains when started, 0 leaves it unchanged */
+    int statsPeriod = 0;
+};
+
+struct BalloonAction {
+    enum Kind {
+        Grow, Shrink, Error
+    } kind;
+    /** Index into the domains of the tuner */
+    size_t domain;
+    uint64_t fromKiB = 0;
+    uint64_t toKiB = 0;
+    uint64_t freeKiB = 0;
+    std::string error;
+};
+
+/**
+ * Samples virDomainMemoryStats of a fixed set of guests on its own thread and moves their balloon targets
+ * (virDomainSetMemoryFlags, live only) to keep free memory between the policy watermarks.
+ *
+ * Every round reads all running guests, then applies at most batchSize adjustments: guests below minFree first,
+ * ordered by their shortfall, then guests above maxFree by their surplus. The target moves towards the middle of
+ * the watermarks by at most stepKiB and stays between floorKiB and the maximum memory of the guest. Inactive guests
+ * and guests without balloon stats are skipped. Each round's actions are handed to the reporter.
+ */
+class BalloonTuner : public std::enable_shared_from_this<BalloonTuner> {
+public:
+    /**
+     * Called on the tuner thread once per round that adjusted or failed something.
+     */
+    typedef std::function<void(std::vector<BalloonAction> &&actions)> Reporter;
+
+    struct Stats {
+        uint64_t rounds;
+        uint64_t grown;
+        uint64_t shrunk;
+        uint64_t errors;
+    };
+
+    /**
+     * Takes ownership of the domain references.
+     */
+    BalloonTuner(std::vector<virDomainPtr> &&domains, const BalloonPolicy &policy);
+
+    ~BalloonTuner();
+
+    /**
+     * Start the tuner thread, it holds a reference on the tuner until Stop.
+     */
+    void Start();
+
+    /**
+     * The thread exits after its current round and starts no further balloon changes, thread safe.
+     */
+    void Stop();
+
+    bool Running();
+
+    BalloonPolicy Policy();
+
+    /**
+     * Takes effect with the next round.
+     */
+    void SetPolicy(const BalloonPolicy &policy);
+
+    void SetReporter(Reporter reporter);
+
+    Stats GetStats();
+
+    size_t Size() const {
+        return _domains.size();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void Run(unsigned long generation);
+
+    /**
+     * Sample every domain and apply the adjustments of one round, stops adjusting once generation is stale.
+     * _roundMutex must be held.
+     */
+    std::vector<BalloonAction> Round(const BalloonPolicy &policy, unsigned long generation);
+
+    bool Current(unsigned long generation);
+
+    std::vector<virDomainPtr> _domains;
+
+    /** Serializes the rounds of a thread that was stopped and the one of the following Start */
+    std::mutex _roundMutex;
+    /** Guarded by _roundMutex */
+    std::vector<Clock::time_point> _adjustedAt;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _running = false;
+    unsigned long _generation = 0;
+    BalloonPolicy _policy;
+    Reporter _reporter;
+    Stats _stats{0, 0, 0, 0};
+};
+
+/**
+ * Read a policy object over base, throws a JavaScript exception and returns false when it is invalid.
+ * { minFreeKiB?, maxFreeKiB?, stepKiB?, floorKiB?, batchSize?, intervalMs? (at least 500), cooldownMs?, statsPeriod? }
+ */
+bool ReadBalloonPolicy(Napi::Env env, const Napi::Value &value, BalloonPolicy &policy);
+
+struct BalloonActionChannel;
+
+/**
+ * JavaScript handle of a BalloonTuner, created by Hypervisor.createBalloonController. Collecting it stops the tuner.
+ */
+class BalloonController : public Napi::ObjectWrap<BalloonController> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+    static Napi::Object New(Napi::Env env, const std::initializer_list<napi_value> &args);
+
+    /**
+     * @param info External<std::shared_ptr<BalloonTuner>> (the wrapper takes ownership of the heap allocated
+     * pointer), listener?
+     */
+    explicit BalloonController(const Napi::CallbackInfo &info);
+
+    ~BalloonController() override;
+
+private:
+
+//region ACCESSORS
+
+    Napi::Value Size(const Napi::CallbackInfo &info);
+
+    Napi::Value Running(const Napi::CallbackInfo &info);
+
+    Napi::Value Policy(const Napi::CallbackInfo &info);
+
+    /**
+     * { rounds, grown, shrunk, errors }
+     */
+    Napi::Value Stats(const Napi::CallbackInfo &info);
+//endregion
+
+//region INSTANCE METHODS
+
+    Napi::Value Start(const Napi::CallbackInfo &info);
+
+    Napi::Value Stop(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info policy, unset fields keep their current value
+     */
+    Napi::Value SetPolicy(const Napi::CallbackInfo &info);
+//endregion
+
+    std::shared_ptr<BalloonTuner> _tuner;
+    std::shared_ptr<BalloonActionChannel> _channel;
+};
+
+#endif //NODE_LIBVIRT_BALLOON_CONTROLLER_H
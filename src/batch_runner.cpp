@@ -0,0 +1,165 @@
+//
+// Created by root on 4/27/24.
+//
+
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <exception>
+
+const char *BatchRunner::StatusName(Status status) {
+    switch (status) {
+        case Status::Ok:
+            return "ok";
+        case Status::Failed:
+            return "error";
+        case Status::TimedOut:
+            return "timeout";
+        case Status::Cancelled:
+            return "cancelled";
+        default:
+            return "pending";
+    }
+}
+
+BatchRunner::BatchRunner(size_t count, size_t concurrency, unsigned int timeoutMs, Task task)
+        : _concurrency(std::max<size_t>(concurrency, 1)), _timeoutMs(timeoutMs), _task(std::move(task)),
+          _items(count) {
+}
+
+static double MillisecondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+void BatchRunner::Fail(size_t index, const std::string &error) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &item = _items.at(index);
+    if (item.status == Status::Pending) Settle(item, Status::Failed, error);
+}
+
+std::vector<BatchRunner::Outcome> BatchRunner::Run(Executor::Lane coordinatorLane) {
+    auto &executor = Executor::Instance();
+    /* Waiting must not take a thread from the lane, the runners may need it */
+    executor.Detach(coordinatorLane);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _startedAt = Clock::now();
+    auto runners = std::min(_concurrency, _items.size() - _settled);
+    for (size_t i = 0; i < runners; i++) {
+        StartRunner();
+    }
+
+    auto timeout = std::chrono::milliseconds(_timeoutMs);
+    while (_settled < _items.size()) {
+        if (_cancelled || _active == 0) {
+            for (auto &item: _items) {
+                if (item.started || item.status != Status::Pending) continue;
+                if (_cancelled) Settle(item, Status::Cancelled);
+                else Settle(item, Status::Failed, "Not started, too many operations timed out");
+            }
+            _next = _items.size();
+            if (_settled == _items.size()) break;
+        }
+
+        if (_timeoutMs == 0) {
+            _changed.wait(lock);
+            continue;
+        }
+        auto now = Clock::now();
+        auto wakeAt = Clock::time_point::max();
+        for (auto &item: _items) {
+            if (!item.running || item.status != Status::Pending) continue;
+            auto deadline = item.startedAt + timeout;
+            if (deadline <= now) {
+                Settle(item, Status::TimedOut, "Operation timed out");
+                /* The stuck runner reattaches once its call returns, the lane gets a thread meanwhile */
+                executor.Detach(Executor::Lane::Bulk);
+                _active--;
+                if (_next < _items.size() && !_cancelled && _replacements < _concurrency) {
+                    _replacements++;
+                    StartRunner();
+                }
+            } else {
+                wakeAt = std::min(wakeAt, deadline);
+            }
+        }
+        if (_settled == _items.size()) break;
+        if (wakeAt == Clock::time_point::max()) {
+            _changed.wait(lock);
+        } else {
+            _changed.wait_until(lock, wakeAt);
+        }
+    }
+
+    std::vector<Outcome> outcomes;
+    outcomes.reserve(_items.size());
+    for (auto &item: _items) {
+        Outcome outcome;
+        outcome.status = item.status;
+        outcome.error = item.error;
+        outcome.startedMs = item.started ? MillisecondsBetween(_startedAt, item.startedAt) : -1;
+        outcome.durationMs = item.durationMs;
+        outcomes.push_back(std::move(outcome));
+    }
+    lock.unlock();
+
+    executor.Reattach(coordinatorLane);
+    return outcomes;
+}
+
+void BatchRunner::Cancel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cancelled = true;
+    _changed.notify_all();
+}
+
+void BatchRunner::StartRunner() {
+    _active++;
+    auto self = shared_from_this();
+    Executor::Instance().Submit(Executor::Lane::Bulk, [self]() {
+        self->RunnerLoop();
+    });
+}
+
+void BatchRunner::RunnerLoop() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_cancelled && _next < _items.size()) {
+        auto index = _next++;
+        auto &item = _items[index];
+        if (item.status != Status::Pending) continue;
+        item.started = true;
+        item.running = true;
+        item.startedAt = Clock::now();
+        lock.unlock();
+
+        std::string error;
+        bool ok;
+        try {
+            ok = _task(index, error);
+        } catch (const std::exception &e) {
+            ok = false;
+            error = e.what();
+        }
+        if (!ok && error.empty()) error = "Operation failed";
+
+        lock.lock();
+        item.running = false;
+        if (item.status != Status::Pending) {
+            /* Timed out, Run detached this thread and no longer counts the runner */
+            lock.unlock();
+            Executor::Instance().Reattach(Executor::Lane::Bulk);
+            return;
+        }
+        Settle(item, ok ? Status::Ok : Status::Failed, error);
+    }
+    _active--;
+    _changed.notify_all();
+}
+
+void BatchRunner::Settle(Item &item, Status status, const std::string &error) {
+    item.status = status;
+    item.error = error;
+    if (item.started) item.durationMs = MillisecondsBetween(item.startedAt, Clock::now());
+    _settled++;
+    _changed.notify_all();
+}
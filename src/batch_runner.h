@@ -0,0 +1,106 @@
+//
+// Created by root on 4/27/24.
+//
+
+#ifndef NODE_LIBVIRT_BATCH_RUNNER_H
+#define NODE_LIBVIRT_BATCH_RUNNER_H
+
+#include "executor.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Runs one task per item of a batch on the bulk lane of the Executor with bounded parallelism.
+ *
+ * Runners are bulk lane tasks that take the next item from a shared cursor, so a slow item only holds its own
+ * runner and the lane size caps the threads of all batches together. An item that exceeds the timeout is reported
+ * as timed out and its runner is detached from the lane while the call finishes in the background; at most
+ * concurrency replacement runners are started per batch, items left once they are used up fail. Cancelling stops
+ * handing out items, tasks already running are waited for.
+ */
+class BatchRunner : public std::enable_shared_from_this<BatchRunner> {
+public:
+    enum class Status {
+        Pending, Ok, Failed, TimedOut, Cancelled
+    };
+
+    struct Outcome {
+        Status status;
+        std::string error;
+        /** Relative to the start of the batch, negative if the item was never started */
+        double startedMs;
+        double durationMs;
+    };
+
+    /**
+     * Runs on a bulk lane thread, fills error and returns false when the item failed. Exceptions fail the item.
+     */
+    typedef std::function<bool(size_t index, std::string &error)> Task;
+
+    static const char *StatusName(Status status);
+
+    /**
+     * @param timeoutMs per item, 0 waits for every task
+     */
+    BatchRunner(size_t count, size_t concurrency, unsigned int timeoutMs, Task task);
+
+    /**
+     * Fail an item without running its task, call it before Run.
+     */
+    void Fail(size_t index, const std::string &error);
+
+    /**
+     * Run the batch and wait until every item finished, timed out or was cancelled, call it from an Executor task
+     * of coordinatorLane. The calling thread is detached from its lane while it waits.
+     * @return outcomes in item order
+     */
+    std::vector<Outcome> Run(Executor::Lane coordinatorLane);
+
+    /**
+     * Thread safe.
+     */
+    void Cancel();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Item {
+        Status status = Status::Pending;
+        std::string error;
+        bool running = false;
+        bool started = false;
+        Clock::time_point startedAt;
+        double durationMs = 0;
+    };
+
+    /** _mutex must be held */
+    void StartRunner();
+
+    void RunnerLoop();
+
+    /** Settle an item, _mutex must be held */
+    void Settle(Item &item, Status status, const std::string &error = "");
+
+    const size_t _concurrency;
+    const unsigned int _timeoutMs;
+    const Task _task;
+
+    std::mutex _mutex;
+    std::condition_variable _changed;
+    std::vector<Item> _items;
+    size_t _next = 0;
+    size_t _settled = 0;
+    /** Runners queued or running that were not given up on */
+    size_t _active = 0;
+    size_t _replacements = 0;
+    bool _cancelled = false;
+    Clock::time_point _startedAt;
+};
+
+#endif //NODE_LIBVIRT_BATCH_RUNNER_H
@@ -0,0 +1,122 @@
+//
+// Created by root on 4/14/24.
+//
+
+#include "bulk_operation.h"
+#include "helper/libvirt_error.h"
+
+#include <libvirt/virterror.h>
+
+bool BulkOperation::ParseOp(const std::string &name, Op &op) {
+    if (name == "start" || name == "create") op = Op::Start;
+    else if (name == "shutdown") op = Op::Shutdown;
+    else if (name == "destroy") op = Op::Destroy;
+    else if (name == "reboot") op = Op::Reboot;
+    else if (name == "suspend") op = Op::Suspend;
+    else if (name == "resume") op = Op::Resume;
+    else if (name == "managedSave") op = Op::ManagedSave;
+    else if (name == "save") op = Op::Save;
+    else return false;
+    return true;
+}
+
+BulkOperation::BulkOperation(Op op, std::shared_ptr<ConnectionPool> pool, std::vector<std::string> &&uuids,
+                             Options options)
+        : _op(op), _pool(std::move(pool)), _uuids(std::move(uuids)), _options(std::move(options)) {
+}
+
+std::vector<BulkOperation::Result> BulkOperation::Run() {
+    auto self = shared_from_this();
+    auto runner = std::make_shared<BatchRunner>(_uuids.size(), _options.concurrency, _options.timeoutMs,
+                                                [self](size_t index, std::string &error) -> bool {
+                                                    return self->Execute(index, error);
+                                                });
+    for (size_t i = 0; i < _uuids.size(); i++) {
+        if (_uuids[i].empty()) runner->Fail(i, "Domain has no handle");
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _runner = runner;
+        if (_cancelled) runner->Cancel();
+    }
+    return runner->Run(Executor::Lane::Bulk);
+}
+
+void BulkOperation::Cancel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cancelled = true;
+    auto runner = _runner.lock();
+    if (runner) runner->Cancel();
+}
+
+bool BulkOperation::Execute(size_t index, std::string &error) {
+    /* Throws when the pool is closed or the reconnect gives up, the runner fails the item with its message */
+    auto lease = _pool->Acquire();
+    auto domain = virDomainLookupByUUID(lease.Handle(),
+                                        reinterpret_cast<const unsigned char *>(_uuids[index].data()));
+    if (!domain) {
+        error = LastErrorMessage("Domain not found");
+        return false;
+    }
+    auto ok = Execute(domain, error);
+    virDomainFree(domain);
+    return ok;
+}
+
+bool BulkOperation::Execute(virDomainPtr domain, std::string &error) {
+    auto flags = _options.flags;
+    int result = -1;
+    switch (_op) {
+        case Op::Start:
+            result = flags ? virDomainCreateWithFlags(domain, flags) : virDomainCreate(domain);
+            break;
+        case Op::Shutdown:
+            result = flags ? virDomainShutdownFlags(domain, flags) : virDomainShutdown(domain);
+            break;
+        case Op::Destroy:
+            result = virDomainDestroyFlags(domain, flags);
+            break;
+        case Op::Reboot:
+            result = virDomainReboot(domain, flags);
+            break;
+        case Op::Suspend:
+            result = virDomainSuspend(domain);
+            break;
+        case Op::Resume:
+            result = virDomainResume(domain);
+            break;
+        case Op::ManagedSave:
+            result = virDomainManagedSave(domain, flags);
+            break;
+        case Op::Save: {
+            char uuid[VIR_UUID_STRING_BUFLEN];
+            if (virDomainGetUUIDString(domain, uuid) < 0) break;
+            auto path = _options.saveDir + "/" + uuid + ".save";
+            if (_options.saveParams.empty() && !(flags & VIR_DOMAIN_SAVE_PARALLEL)) {
+                result = virDomainSaveFlags(domain, path.c_str(), nullptr, flags);
+                break;
+            }
+            auto params = _options.saveParams;
+            TypedParam file;
+            file.field = VIR_DOMAIN_SAVE_PARAM_FILE;
+            file.type = VIR_TYPED_PARAM_STRING;
+            file.s = path;
+            params.push_back(std::move(file));
+            virTypedParameterPtr vparams;
+            int nparams;
+            if (!ToVirTypedParams(params, &vparams, &nparams)) {
+                /* The last libvirt error would belong to an earlier call of this thread */
+                error = "Failed to prepare save parameters";
+                return false;
+            }
+            result = virDomainSaveParams(domain, vparams, nparams, flags);
+            virTypedParamsFree(vparams, nparams);
+            break;
+        }
+    }
+    if (result < 0) {
+        error = LastErrorMessage("Operation failed");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,88 @@
+//
+// Created by root on 4/14/24.
+//
+
+#ifndef NODE_LIBVIRT_BULK_OPERATION_H
+#define NODE_LIBVIRT_BULK_OPERATION_H
+
+#include <libvirt/libvirt.h>
+
+#include "batch_runner.h"
+#include "connection_pool.h"
+#include "helper/typed_params.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * One lifecycle operation applied to many domains with bounded parallelism, see BatchRunner.
+ *
+ * Domains are addressed by UUID and looked up on a leased pool connection for each call, so the batch shares the
+ * pool's in-flight cap with every other worker and continues on the new connections after a reconnect. Calls are
+ * not retried, the operations are not idempotent. An operation that exceeds the timeout is reported as timed out;
+ * the libvirt call itself cannot be interrupted and finishes in the background.
+ */
+class BulkOperation : public std::enable_shared_from_this<BulkOperation> {
+public:
+    enum class Op {
+        Start, Shutdown, Destroy, Reboot, Suspend, Resume, ManagedSave, Save
+    };
+
+    typedef BatchRunner::Status Status;
+
+    struct Options {
+        size_t concurrency = 8;
+        /** Per domain, 0 waits for every call */
+        unsigned int timeoutMs = 0;
+        unsigned int flags = 0;
+        /** Target directory of Save, files are named <uuid>.save */
+        std::string saveDir;
+        /**
+         * virDomainSaveParams parameters of Save besides the file (image format, parallel channels). Save goes
+         * through virDomainSaveParams when set or with VIR_DOMAIN_SAVE_PARALLEL in flags.
+         */
+        TypedParams saveParams;
+    };
+
+    typedef BatchRunner::Outcome Result;
+
+    static const size_t MaxConcurrency = 256;
+
+    static bool ParseOp(const std::string &name, Op &op);
+
+    /**
+     * @param uuids raw VIR_UUID_BUFLEN UUIDs, empty entries fail without a libvirt call
+     */
+    BulkOperation(Op op, std::shared_ptr<ConnectionPool> pool, std::vector<std::string> &&uuids, Options options);
+
+    /**
+     * Run the batch and wait until every domain finished, timed out or was cancelled, call it from a bulk lane
+     * worker.
+     * @return results in input order
+     */
+    std::vector<Result> Run();
+
+    /**
+     * Thread safe.
+     */
+    void Cancel();
+
+private:
+    bool Execute(size_t index, std::string &error);
+
+    bool Execute(virDomainPtr domain, std::string &error);
+
+    const Op _op;
+    const std::shared_ptr<ConnectionPool> _pool;
+    const std::vector<std::string> _uuids;
+    const Options _options;
+
+    std::mutex _mutex;
+    /** Weak, the runner holds this operation through its task */
+    std::weak_ptr<BatchRunner> _runner;
+    bool _cancelled = false;
+};
+
+#endif //NODE_LIBVIRT_BULK_OPERATION_H
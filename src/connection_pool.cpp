@@ -0,0 +1,453 @@
+//
+// Created by root on 3/16/24.
+//
+
+#include "connection_pool.h"
+#include "executor.h"
+#include "helper/libvirt_error.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include <libvirt/virterror.h>
+
+const char *ConnectionPool::StateName(State state) {
+    switch (state) {
+        case State::Connected:
+            return "connected";
+        case State::Disconnected:
+            return "disconnected";
+        case State::Reconnecting:
+            return "reconnecting";
+        default:
+            return "closed";
+    }
+}
+
+//region LEASE
+
+ConnectionPool::Lease::Lease(ConnectionPool *pool, size_t index, uint64_t generation, virConnectPtr handle)
+        : _pool(pool), _index(index), _generation(generation), _handle(handle) {}
+
+ConnectionPool::Lease::Lease(Lease &&other) noexcept
+        : _pool(other._pool), _index(other._index), _generation(other._generation), _handle(other._handle) {
+    other._pool = nullptr;
+    other._handle = nullptr;
+}
+
+ConnectionPool::Lease::~Lease() {
+    if (_pool) _pool->Release(_index, _generation);
+    if (_handle) virConnectClose(_handle);
+}
+
+//endregion
+
+ConnectionPool::ConnectionPool(size_t size, size_t maxInFlight, ReconnectOptions reconnect)
+        : _size(std::max<size_t>(size, 1)), _maxInFlight(maxInFlight), _reconnect(reconnect) {}
+
+ConnectionPool::~ConnectionPool() {
+    Close();
+}
+
+//region CONNECTION LIFECYCLE
+
+std::vector<ConnectionPool::Slot> ConnectionPool::OpenSlots() {
+    std::vector<Slot> slots(_size);
+    for (size_t i = 0; i < _size; i++) {
+        slots[i].handle = _readonly ? virConnectOpenReadOnly(_uri.c_str()) : virConnectOpen(_uri.c_str());
+        if (!slots[i].handle) {
+            auto message = LastErrorMessage("Failed to open connection");
+            for (size_t j = 0; j < i; j++) {
+                Unwatch(slots[j].handle);
+                virConnectClose(slots[j].handle);
+            }
+            throw std::runtime_error(message);
+        }
+        Watch(slots[i].handle);
+    }
+    return slots;
+}
+
+void ConnectionPool::Watch(virConnectPtr conn) {
+    if (!_reconnect.enabled) return;
+    /* Local drivers don't support keepalive, they report a dropped daemon through the close callback only */
+    if (_reconnect.keepAliveInterval > 0) {
+        virConnectSetKeepAlive(conn, _reconnect.keepAliveInterval, _reconnect.keepAliveCount);
+    }
+    auto opaque = new std::weak_ptr<ConnectionPool>(shared_from_this());
+    if (virConnectRegisterCloseCallback(conn, ConnectionPool::CloseCallback, opaque,
+                                        [](void *opaque) {
+                                            delete static_cast<std::weak_ptr<ConnectionPool> *>(opaque);
+                                        }) < 0) {
+        delete opaque;
+    }
+    virResetLastError();
+}
+
+void ConnectionPool::Unwatch(virConnectPtr conn) {
+    virConnectUnregisterCloseCallback(conn, ConnectionPool::CloseCallback);
+    virResetLastError();
+}
+
+void ConnectionPool::CloseCallback(virConnectPtr conn, int reason, void *opaque) {
+    if (reason == VIR_CONNECT_CLOSE_REASON_CLIENT) return;
+    auto pool = static_cast<std::weak_ptr<ConnectionPool> *>(opaque)->lock();
+    if (!pool) return;
+    switch (reason) {
+        case VIR_CONNECT_CLOSE_REASON_EOF:
+            pool->ConnectionLost(conn, "eof");
+            break;
+        case VIR_CONNECT_CLOSE_REASON_KEEPALIVE:
+            pool->ConnectionLost(conn, "keepalive");
+            break;
+        default:
+            pool->ConnectionLost(conn, "error");
+            break;
+    }
+}
+
+void ConnectionPool::Open(const std::string &uri, bool readonly) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_state != State::Closed || _opening) {
+            throw std::runtime_error("Hypervisor already connected");
+        }
+        _opening = true;
+        _uri = uri;
+        _readonly = readonly;
+    }
+    std::vector<Slot> slots;
+    try {
+        slots = OpenSlots();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _opening = false;
+        throw;
+    }
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_opening) {
+            /* Closed while the connections were opening */
+            lock.unlock();
+            for (auto &slot: slots) {
+                Unwatch(slot.handle);
+                virConnectClose(slot.handle);
+            }
+            throw std::runtime_error("Hypervisor disconnected");
+        }
+        _opening = false;
+        _slots = std::move(slots);
+        _generation++;
+        _next = 0;
+        _state = State::Connected;
+        if (_reconnect.enabled && !_reconnector.joinable()) {
+            _reconnector = std::thread(&ConnectionPool::ReconnectLoop, this,
+                                       std::weak_ptr<ConnectionPool>(shared_from_this()));
+        }
+        _available.notify_all();
+    }
+    Notify(State::Connected);
+}
+
+int ConnectionPool::Close() {
+    std::vector<Slot> slots;
+    std::vector<virConnectPtr> retired;
+    bool wasOpen;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        wasOpen = _state != State::Closed;
+        _state = State::Closed;
+        _opening = false;
+        slots.swap(_slots);
+        retired.swap(_retired);
+        _available.notify_all();
+    }
+    if (_reconnector.joinable()) {
+        /* A listener may close the pool from the reconnect thread itself */
+        if (_reconnector.get_id() == std::this_thread::get_id()) {
+            _reconnector.detach();
+        } else {
+            _reconnector.join();
+        }
+    }
+
+    int result = 0;
+    for (auto &slot: slots) {
+        Unwatch(slot.handle);
+        if (virConnectClose(slot.handle) < 0) result = -1;
+    }
+    for (auto handle: retired) {
+        virConnectClose(handle);
+    }
+    if (wasOpen) Notify(State::Closed);
+    return result;
+}
+
+void ConnectionPool::ConnectionLost(virConnectPtr conn, const std::string &reason) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_state != State::Connected) return;
+        auto current = std::find_if(_slots.begin(), _slots.end(), [conn](const Slot &slot) {
+            return slot.handle == conn;
+        });
+        /* A connection replaced by an earlier reconnect */
+        if (current == _slots.end()) return;
+        _state = _reconnect.enabled ? State::Reconnecting : State::Disconnected;
+        _available.notify_all();
+    }
+    Notify(State::Disconnected, reason);
+}
+
+bool ConnectionPool::RunCallbacks(const std::weak_ptr<ConnectionPool> &weak, const std::function<void()> &callbacks) {
+    auto self = std::make_shared<std::shared_ptr<ConnectionPool>>(weak.lock());
+    if (!*self) return false;
+    callbacks();
+    /* Destroying the pool joins the reconnect thread, never drop what may be the last reference on it */
+    Executor::Instance().Submit(Executor::Lane::Fast, [self]() {
+        self->reset();
+    });
+    return true;
+}
+
+void ConnectionPool::ReconnectLoop(std::weak_ptr<ConnectionPool> weak) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _available.wait(lock, [this]() {
+            return _state == State::Reconnecting || _state == State::Closed;
+        });
+        if (_state == State::Closed) return;
+
+        unsigned int delay = _reconnect.initialDelayMs;
+        unsigned int attempt = 0;
+        std::string lastError;
+        while (_state == State::Reconnecting) {
+            attempt++;
+            lock.unlock();
+            if (!RunCallbacks(weak, [&]() {
+                Notify(State::Reconnecting, lastError, attempt, delay);
+            })) {
+                return;
+            }
+            lock.lock();
+            if (_available.wait_for(lock, std::chrono::milliseconds(delay), [this]() {
+                return _state == State::Closed;
+            })) {
+                return;
+            }
+            delay = std::min(delay * 2, _reconnect.maxDelayMs);
+
+            lock.unlock();
+            std::vector<Slot> slots;
+            try {
+                slots = OpenSlots();
+            } catch (const std::exception &e) {
+                lastError = e.what();
+            }
+            lock.lock();
+            if (slots.empty()) continue;
+            if (_state == State::Closed) {
+                lock.unlock();
+                for (auto &slot: slots) {
+                    Unwatch(slot.handle);
+                    virConnectClose(slot.handle);
+                }
+                return;
+            }
+
+//region swap in the new connections
+            auto oldPrimary = _slots.empty() ? nullptr : _slots[0].handle;
+            auto newPrimary = slots[0].handle;
+            std::vector<virConnectPtr> expired;
+            expired.swap(_retired);
+            for (auto &slot: _slots) {
+                _retired.push_back(slot.handle);
+            }
+            auto replaced = _retired;
+            _slots = std::move(slots);
+            _generation++;
+            _next = 0;
+            _reconnects++;
+            lock.unlock();
+
+            for (auto handle: replaced) Unwatch(handle);
+            for (auto handle: expired) virConnectClose(handle);
+            if (!RunCallbacks(weak, [&]() {
+                /* Held while the handlers run so removing one waits until its owner is no longer used */
+                std::lock_guard<std::mutex> handlerLock(_handlerMutex);
+                for (const auto &handler: _reconnectHandlers) handler.second(oldPrimary, newPrimary);
+            })) {
+                return;
+            }
+            auto alive = virConnectIsAlive(newPrimary) == 1;
+            lock.lock();
+//endregion
+            if (_state != State::Reconnecting) break;
+            /* Lost again while the subscriptions moved over, the close callback was ignored meanwhile */
+            if (!alive) {
+                lastError = "Connection lost during reconnect";
+                continue;
+            }
+            _state = State::Connected;
+            _available.notify_all();
+            lock.unlock();
+            if (!RunCallbacks(weak, [&]() {
+                Notify(State::Connected, "reconnected", attempt);
+            })) {
+                return;
+            }
+            lock.lock();
+        }
+    }
+}
+
+void ConnectionPool::Notify(State state, const std::string &reason, unsigned int attempt, unsigned int delayMs) {
+    std::vector<StateListener> listeners;
+    {
+        std::lock_guard<std::mutex> lock(_listenerMutex);
+        for (const auto &listener: _stateListeners) listeners.push_back(listener.second);
+    }
+    for (const auto &listener: listeners) listener(state, reason, attempt, delayMs);
+}
+
+void ConnectionPool::AddStateListener(const void *owner, StateListener listener) {
+    std::lock_guard<std::mutex> lock(_listenerMutex);
+    _stateListeners[owner] = std::move(listener);
+}
+
+void ConnectionPool::AddReconnectHandler(const void *owner, ReconnectHandler handler) {
+    std::lock_guard<std::mutex> lock(_handlerMutex);
+    _reconnectHandlers[owner] = std::move(handler);
+}
+
+void ConnectionPool::RemoveListeners(const void *owner) {
+    {
+        std::lock_guard<std::mutex> lock(_listenerMutex);
+        _stateListeners.erase(owner);
+    }
+    std::lock_guard<std::mutex> lock(_handlerMutex);
+    _reconnectHandlers.erase(owner);
+}
+
+bool ConnectionPool::Reconnect(const std::string &reason) {
+    virConnectPtr primary;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_reconnect.enabled || _state != State::Connected || _slots.empty()) return false;
+        primary = _slots[0].handle;
+    }
+    ConnectionLost(primary, reason);
+    return true;
+}
+
+void ConnectionPool::WaitForReconnectHandlers() {
+    std::lock_guard<std::mutex> lock(_handlerMutex);
+}
+
+bool ConnectionPool::ShouldRetry(const Lease &lease, unsigned int attempt) {
+    if (!_reconnect.enabled || attempt >= _reconnect.maxRetries) return false;
+    if (virConnectIsAlive(lease.Handle()) == 1) return false;
+    /* The close callback may not have run yet, don't wait for it */
+    ConnectionLost(lease.Handle(), LastErrorMessage("error"));
+    return true;
+}
+
+//endregion
+
+bool ConnectionPool::HasCapacity(size_t index) const {
+    return _maxInFlight == 0 || _slots[index].inFlight < _maxInFlight;
+}
+
+void ConnectionPool::AdvanceTicket() {
+    _servingTicket++;
+    while (!_abandoned.empty() && *_abandoned.begin() == _servingTicket) {
+        _abandoned.erase(_abandoned.begin());
+        _servingTicket++;
+    }
+}
+
+ConnectionPool::Lease ConnectionPool::Acquire() {
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds(_reconnect.replayTimeoutMs);
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_state == State::Closed) {
+        throw std::runtime_error("Hypervisor not connected");
+    }
+
+    auto ticket = _nextTicket++;
+    size_t index = 0;
+    auto ready = [&]() {
+        if (_state == State::Closed || _state == State::Disconnected) return true;
+        if (_state != State::Connected || ticket != _servingTicket) return false;
+        for (size_t i = 0; i < _slots.size(); i++) {
+            index = (_next + i) % _slots.size();
+            if (HasCapacity(index)) return true;
+        }
+        return false;
+    };
+    _waiting++;
+    while (!ready()) {
+        if (_state != State::Reconnecting) {
+            _available.wait(lock);
+        } else if (_available.wait_until(lock, deadline) == std::cv_status::timeout && !ready()) {
+            /* Give up the place in the queue without blocking the tickets behind it */
+            _waiting--;
+            if (ticket == _servingTicket) {
+                AdvanceTicket();
+            } else {
+                _abandoned.insert(ticket);
+            }
+            _available.notify_all();
+            throw std::runtime_error("Timed out waiting for the hypervisor to reconnect");
+        }
+    }
+    _waiting--;
+    AdvanceTicket();
+
+    if (_state != State::Connected) {
+        _available.notify_all();
+        throw std::runtime_error(_state == State::Closed ? "Hypervisor disconnected" : "Hypervisor connection lost");
+    }
+
+    _next = (index + 1) % _slots.size();
+    auto &slot = _slots[index];
+    slot.inFlight++;
+    slot.leases++;
+    _leases++;
+    virConnectRef(slot.handle);
+    auto waitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    _totalWaitMs += waitMs;
+    _maxWaitMs = std::max(_maxWaitMs, waitMs);
+    /* Let the next ticket holder check for capacity */
+    _available.notify_all();
+    return {this, index, _generation, slot.handle};
+}
+
+void ConnectionPool::Release(size_t index, uint64_t generation) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    /* Leases of replaced connections don't count against the new ones */
+    if (generation == _generation && index < _slots.size() && _slots[index].inFlight > 0) {
+        _slots[index].inFlight--;
+    }
+    _available.notify_all();
+}
+
+virConnectPtr ConnectionPool::Primary() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _slots.empty() ? nullptr : _slots[0].handle;
+}
+
+ConnectionPool::State ConnectionPool::GetState() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _state;
+}
+
+ConnectionPool::Stats ConnectionPool::GetStats() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Stats stats{_size, _maxInFlight, 0, _waiting, _leases, _totalWaitMs, _maxWaitMs, _state, _reconnects, {}};
+    for (const auto &slot: _slots) {
+        stats.inFlight += slot.inFlight;
+        stats.connections.push_back({slot.inFlight, slot.leases});
+    }
+    return stats;
+}
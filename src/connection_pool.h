@@ -0,0 +1,275 @@
+//
+// Created by root on 3/16/24.
+//
+
+#ifndef NODE_LIBVIRT_CONNECTION_POOL_H
+#define NODE_LIBVIRT_CONNECTION_POOL_H
+
+#include <libvirt/libvirt.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Connection watching and reconnect behaviour of a ConnectionPool.
+ */
+struct ReconnectOptions {
+    bool enabled = true;
+    /** Seconds between keepalive probes, <= 0 disables keepalive */
+    int keepAliveInterval = 5;
+    unsigned int keepAliveCount = 3;
+    unsigned int initialDelayMs = 50;
+    unsigned int maxDelayMs = 5000;
+    /** How long Acquire waits for a reconnect before failing */
+    unsigned int replayTimeoutMs = 30000;
+    /** Times WithRetry repeats an operation that failed because its connection dropped */
+    unsigned int maxRetries = 2;
+};
+
+/**
+ * Set of connections to the same URI used by the asynchronous operations of a Hypervisor.
+ *
+ * Every worker of the Hypervisor and its Domains leases a connection for the duration of its libvirt calls; storage
+ * pools, volumes and streams only call through the connection they were opened on. Leases are handed out
+ * round-robin to connections below the per-connection in-flight cap, waiters are served strictly in arrival order
+ * (ticket queue) so a burst of calls cannot starve earlier ones. The first connection is the primary one, it is used
+ * for synchronous accessors and event registration.
+ *
+ * Connections are watched with keepalive and a close callback. When one drops, the pool reopens all of them on a
+ * background thread with exponential backoff; Acquire blocks meanwhile (up to the replay timeout) so queued
+ * operations continue on the new connections. Idempotent operations that fail on the dropped connection are
+ * repeated through WithRetry. Replaced connections stay open until the next reconnect or Close, so handles
+ * already read from Primary() remain valid objects.
+ */
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
+public:
+    enum class State {
+        Closed, Connected, Disconnected, Reconnecting
+    };
+
+    static const char *StateName(State state);
+
+    /**
+     * Called on the state transition: the reason for Disconnected, attempt and delay for Reconnecting.
+     */
+    typedef std::function<void(State state, const std::string &reason, unsigned int attempt,
+                               unsigned int delayMs)> StateListener;
+
+    /**
+     * Called on the reconnect thread after new connections are open and before waiting operations continue,
+     * to move subscriptions from the old primary connection to the new one.
+     */
+    typedef std::function<void(virConnectPtr oldPrimary, virConnectPtr newPrimary)> ReconnectHandler;
+
+    struct ConnectionStats {
+        size_t inFlight;
+        uint64_t leases;
+    };
+
+    struct Stats {
+        size_t size;
+        /** 0 means unlimited */
+        size_t maxInFlight;
+        size_t inFlight;
+        /** Workers currently waiting for a lease */
+        size_t waiting;
+        uint64_t leases;
+        double totalWaitMs;
+        double maxWaitMs;
+        State state;
+        uint64_t reconnects;
+        std::vector<ConnectionStats> connections;
+    };
+
+    /**
+     * A leased connection, holds its own reference so the handle stays valid across a reconnect.
+     */
+    class Lease {
+    public:
+        Lease(ConnectionPool *pool, size_t index, uint64_t generation, virConnectPtr handle);
+
+        Lease(Lease &&other) noexcept;
+
+        Lease(const Lease &) = delete;
+
+        Lease &operator=(const Lease &) = delete;
+
+        ~Lease();
+
+        virConnectPtr Handle() const {
+            return _handle;
+        }
+
+    private:
+        ConnectionPool *_pool;
+        size_t _index;
+        uint64_t _generation;
+        virConnectPtr _handle;
+    };
+
+    explicit ConnectionPool(size_t size = 1, size_t maxInFlight = 0, ReconnectOptions reconnect = ReconnectOptions());
+
+    ~ConnectionPool();
+
+    /**
+     * Open all connections, blocks so call it from a worker. Throws std::runtime_error on failure, while another
+     * Open runs or when Close was called meanwhile; connections opened so far are closed again.
+     */
+    void Open(const std::string &uri, bool readonly);
+
+    /**
+     * Close all connections and stop reconnecting, blocks so call it from a worker.
+     * @return -1 if any of the connections failed to close
+     */
+    int Close();
+
+    /**
+     * Lease a connection, blocks while all connections are at their in-flight cap or a reconnect is running.
+     * Throws std::runtime_error when the pool is closed or the reconnect takes longer than the replay timeout.
+     */
+    Lease Acquire();
+
+    /**
+     * Run an idempotent operation on a leased connection. fn throws std::runtime_error on failure with the libvirt
+     * error still set; when the connection turned out to be dead the operation is repeated after the reconnect.
+     */
+    template<typename F>
+    auto WithRetry(F fn) -> decltype(fn(std::declval<virConnectPtr>())) {
+        for (unsigned int attempt = 0;; attempt++) {
+            auto lease = Acquire();
+            try {
+                return fn(lease.Handle());
+            } catch (const std::runtime_error &) {
+                if (!ShouldRetry(lease, attempt)) throw;
+            }
+        }
+    }
+
+    /**
+     * Whether the failed call on lease should be repeated, marks the pool disconnected if its connection is dead.
+     * Reads the calling thread's last libvirt error.
+     */
+    bool ShouldRetry(const Lease &lease, unsigned int attempt);
+
+    virConnectPtr Primary();
+
+    State GetState();
+
+    Stats GetStats();
+
+    size_t Size() const {
+        return _size;
+    }
+
+    /**
+     * Listeners and handlers are kept per owner, a shared pool has one of each per Hypervisor using it.
+     * Adding again for the same owner replaces the previous one.
+     */
+    void AddStateListener(const void *owner, StateListener listener);
+
+    /**
+     * Blocks while a reconnect handler runs.
+     */
+    void AddReconnectHandler(const void *owner, ReconnectHandler handler);
+
+    /**
+     * Drop the listener and handler of owner, blocks while a reconnect handler runs.
+     */
+    void RemoveListeners(const void *owner);
+
+    /**
+     * Replace the connections through the regular reconnect path without waiting for a drop.
+     * @return false if the pool is not connected or reconnecting is disabled
+     */
+    bool Reconnect(const std::string &reason);
+
+    /**
+     * Blocks while a reconnect handler runs. Handlers running later see every change made before the call, so
+     * state a handler works on can be torn down afterwards.
+     */
+    void WaitForReconnectHandlers();
+
+private:
+    struct Slot {
+        virConnectPtr handle = nullptr;
+        size_t inFlight = 0;
+        uint64_t leases = 0;
+    };
+
+    std::vector<Slot> OpenSlots();
+
+    void Watch(virConnectPtr conn);
+
+    static void Unwatch(virConnectPtr conn);
+
+    static void CloseCallback(virConnectPtr conn, int reason, void *opaque);
+
+    /**
+     * A connection of the current generation dropped, start reconnecting.
+     */
+    void ConnectionLost(virConnectPtr conn, const std::string &reason);
+
+    void ReconnectLoop(std::weak_ptr<ConnectionPool> weak);
+
+    /**
+     * Run listeners on the reconnect thread with a strong reference, so they can drop theirs. Returns false when
+     * the pool is already being destroyed by another thread.
+     */
+    static bool RunCallbacks(const std::weak_ptr<ConnectionPool> &weak, const std::function<void()> &callbacks);
+
+    void Notify(State state, const std::string &reason = "", unsigned int attempt = 0, unsigned int delayMs = 0);
+
+    void Release(size_t index, uint64_t generation);
+
+    bool HasCapacity(size_t index) const;
+
+    /**
+     * Move on to the next ticket, skipping those whose holders gave up waiting.
+     */
+    void AdvanceTicket();
+
+    const size_t _size;
+    const size_t _maxInFlight;
+    const ReconnectOptions _reconnect;
+
+    std::string _uri;
+    bool _readonly = false;
+
+    std::mutex _mutex;
+    std::condition_variable _available;
+    std::vector<Slot> _slots;
+    /** Connections replaced by a reconnect, closed on the next one or on Close */
+    std::vector<virConnectPtr> _retired;
+    State _state = State::Closed;
+    /** Open is running, a concurrent Open fails and Close makes it discard its connections */
+    bool _opening = false;
+    uint64_t _generation = 0;
+    uint64_t _reconnects = 0;
+    std::thread _reconnector;
+
+    size_t _next = 0;
+    uint64_t _nextTicket = 0;
+    uint64_t _servingTicket = 0;
+    std::set<uint64_t> _abandoned;
+    size_t _waiting = 0;
+    uint64_t _leases = 0;
+    double _totalWaitMs = 0;
+    double _maxWaitMs = 0;
+
+    std::mutex _listenerMutex;
+    std::map<const void *, StateListener> _stateListeners;
+    std::mutex _handlerMutex;
+    std::map<const void *, ReconnectHandler> _reconnectHandlers;
+};
+
+#endif //NODE_LIBVIRT_CONNECTION_POOL_H
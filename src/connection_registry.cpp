@@ -0,0 +1,78 @@
+//
+// Created by root on 4/24/24.
+//
+
+#include "connection_registry.h"
+
+#include <iterator>
+
+/**
+ * Decrement users unless it is already 0, Detach runs without the entry mutex.
+ * @return whether this was the last user
+ */
+static bool ReleaseUser(std::atomic<size_t> &users) {
+    auto current = users.load();
+    while (current > 0 && !users.compare_exchange_weak(current, current - 1)) {}
+    return current == 1;
+}
+
+std::shared_ptr<ConnectionPool> ConnectionRegistry::Get(const std::string &uri, bool readonly, size_t size,
+                                                        size_t maxInFlight, const ReconnectOptions &reconnect) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &entry = _entries[Key(uri, readonly)];
+    auto pool = entry ? entry->pool.lock() : nullptr;
+    if (pool) return pool;
+
+    pool = std::make_shared<ConnectionPool>(size, maxInFlight, reconnect);
+    entry = std::make_shared<Entry>();
+    entry->uri = uri;
+    entry->readonly = readonly;
+    entry->pool = pool;
+    /* Drop the entries of pools nobody holds anymore */
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        it = it->second->pool.expired() ? _entries.erase(it) : std::next(it);
+    }
+    return pool;
+}
+
+std::shared_ptr<ConnectionRegistry::Entry> ConnectionRegistry::Find(const std::shared_ptr<ConnectionPool> &pool,
+                                                                    const std::string &uri, bool readonly) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(Key(uri, readonly));
+    if (it == _entries.end() || it->second->pool.lock() != pool) return nullptr;
+    return it->second;
+}
+
+void ConnectionRegistry::Open(const std::shared_ptr<ConnectionPool> &pool, const std::string &uri, bool readonly) {
+    auto entry = Find(pool, uri, readonly);
+    if (!entry) throw std::runtime_error("Connection is not shared");
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (pool->GetState() == ConnectionPool::State::Closed) pool->Open(uri, readonly);
+    entry->users++;
+}
+
+int ConnectionRegistry::Close(const std::shared_ptr<ConnectionPool> &pool, const std::string &uri, bool readonly) {
+    auto entry = Find(pool, uri, readonly);
+    if (!entry) return pool->Close();
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    return ReleaseUser(entry->users) ? pool->Close() : 0;
+}
+
+void ConnectionRegistry::Detach(const std::shared_ptr<ConnectionPool> &pool, const std::string &uri, bool readonly) {
+    auto entry = Find(pool, uri, readonly);
+    /* Runs on the JavaScript thread when the wrapper is collected, must not wait for an open in progress */
+    if (entry) ReleaseUser(entry->users);
+}
+
+std::vector<ConnectionRegistry::Stats> ConnectionRegistry::GetStats() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<Stats> result;
+    for (const auto &item: _entries) {
+        auto pool = item.second->pool.lock();
+        if (!pool) continue;
+        /* Not counting the reference taken here */
+        result.push_back({item.second->uri, item.second->readonly, item.second->users.load(),
+                          static_cast<size_t>(pool.use_count() - 1), pool->GetState()});
+    }
+    return result;
+}
@@ -0,0 +1,93 @@
+//
+// Created by root on 4/24/24.
+//
+
+#ifndef NODE_LIBVIRT_CONNECTION_REGISTRY_H
+#define NODE_LIBVIRT_CONNECTION_REGISTRY_H
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "connection_pool.h"
+
+/**
+ * Process wide map of the connection pools shared between JavaScript environments (the main thread and
+ * worker_threads), keyed by URI and read-only flag.
+ *
+ * Hypervisors created with shared: true use the pool of their URI instead of their own. The first one to connect
+ * opens it and the last one to disconnect closes it; size and reconnect options are those of the Hypervisor that
+ * created the pool. Only weak references are kept, a pool goes away with the last Hypervisor holding it.
+ */
+class ConnectionRegistry {
+public:
+    struct Stats {
+        std::string uri;
+        bool readonly;
+        /** Connected Hypervisors */
+        size_t users;
+        /** Hypervisors and workers holding the pool */
+        size_t holders;
+        ConnectionPool::State state;
+    };
+
+    static ConnectionRegistry &Instance() {
+        static auto *instance = new ConnectionRegistry();
+        return *instance;
+    }
+
+    /**
+     * The pool shared for uri, created with the given settings if nobody holds one yet. Does not connect.
+     */
+    std::shared_ptr<ConnectionPool> Get(const std::string &uri, bool readonly, size_t size, size_t maxInFlight,
+                                        const ReconnectOptions &reconnect);
+
+    /**
+     * Count one more connected user of pool, opening it if it is closed.
+     * Blocks so call it from a worker, throws std::runtime_error like ConnectionPool::Open.
+     */
+    void Open(const std::shared_ptr<ConnectionPool> &pool, const std::string &uri, bool readonly);
+
+    /**
+     * Count one user less, the last one closes the pool. Blocks so call it from a worker.
+     * @return -1 if any of the connections failed to close
+     */
+    int Close(const std::shared_ptr<ConnectionPool> &pool, const std::string &uri, bool readonly);
+
+    /**
+     * Count one user less without closing, for a connected Hypervisor that is collected. The pool then closes
+     * with its last reference.
+     */
+    void Detach(const std::shared_ptr<ConnectionPool> &pool, const std::string &uri, bool readonly);
+
+    std::vector<Stats> GetStats();
+
+private:
+    struct Entry {
+        std::string uri;
+        bool readonly;
+        std::weak_ptr<ConnectionPool> pool;
+        /** Held while opening or closing so concurrent users wait for the first one */
+        std::mutex mutex;
+        std::atomic<size_t> users{0};
+    };
+
+    ConnectionRegistry() = default;
+
+    static std::string Key(const std::string &uri, bool readonly) {
+        return (readonly ? "ro:" : "rw:") + uri;
+    }
+
+    /**
+     * Entry of a pool obtained through Get, nullptr for a pool that is not shared.
+     */
+    std::shared_ptr<Entry> Find(const std::shared_ptr<ConnectionPool> &pool, const std::string &uri, bool readonly);
+
+    std::mutex _mutex;
+    std::map<std::string, std::shared_ptr<Entry>> _entries;
+};
+
+#endif //NODE_LIBVIRT_CONNECTION_REGISTRY_H
@@ -0,0 +1,313 @@
+//
+// Created by root on 4/19/24.
+//
+
+#include "cpu_stats.h"
+#include "helper/libvirt_error.h"
+#include "domain_stats.h"
+
+#include <libvirt/virterror.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+//region HELPERS
+
+/**
+ * Number of host CPUs, the size of the CPU maps libvirt returns.
+ */
+static int HostCpuCount(virConnectPtr conn) {
+    auto count = virNodeGetCPUMap(conn, nullptr, nullptr, 0);
+    if (count < 0) throw LibvirtError("Failed to get the host CPU count");
+    return count;
+}
+
+static std::vector<unsigned int> CpuMapToList(const unsigned char *cpumaps, int maplen, int index, int hostCpus) {
+    std::vector<unsigned int> cpus;
+    for (int cpu = 0; cpu < hostCpus; cpu++) {
+        if (VIR_CPU_USABLE(cpumaps, maplen, index, cpu)) cpus.push_back(static_cast<unsigned int>(cpu));
+    }
+    return cpus;
+}
+
+static bool ParseIndex(const std::string &value, unsigned long &index) {
+    if (value.empty()) return false;
+    char *end = nullptr;
+    index = strtoul(value.c_str(), &end, 10);
+    return end && *end == '\0';
+}
+
+static Napi::Float64Array SlotsToArray(Napi::Env env, const uint64_t *slots, size_t count) {
+    auto array = Napi::Float64Array::New(env, count);
+    WriteStats(array, 0, slots, count);
+    return array;
+}
+
+//endregion
+
+NodeCpuStats GetNodeCpuStats(virConnectPtr conn, int cpuNum, unsigned int flags) {
+    int nparams = 0;
+    if (virNodeGetCPUStats(conn, cpuNum, nullptr, &nparams, flags) < 0) {
+        throw LibvirtError("Failed to get host CPU stats");
+    }
+    std::vector<virNodeCPUStats> params(nparams);
+    if (nparams > 0 && virNodeGetCPUStats(conn, cpuNum, params.data(), &nparams, flags) < 0) {
+        throw LibvirtError("Failed to get host CPU stats");
+    }
+    NodeCpuStats result;
+    result.reserve(nparams);
+    for (int i = 0; i < nparams; i++) {
+        result.emplace_back(params[i].field, params[i].value);
+    }
+    return result;
+}
+
+std::vector<unsigned long long> GetCellsFreeMemory(virConnectPtr conn, int startCell, int maxCells) {
+    if (maxCells <= 0) {
+        virNodeInfo nodeInfo;
+        if (virNodeGetInfo(conn, &nodeInfo) < 0) throw LibvirtError("Failed to get node info");
+        maxCells = static_cast<int>(nodeInfo.nodes) - startCell;
+    }
+    std::vector<unsigned long long> cells(maxCells > 0 ? maxCells : 0);
+    if (cells.empty()) return cells;
+    auto count = virNodeGetCellsFreeMemory(conn, cells.data(), startCell, maxCells);
+    if (count < 0) throw LibvirtError("Failed to get free memory of the NUMA cells");
+    cells.resize(count);
+    return cells;
+}
+
+std::vector<TypedParams> GetDomainCpuStats(virDomainPtr domain, int startCpu, int ncpus, unsigned int flags) {
+    std::vector<TypedParams> result;
+    if (startCpu < 0) {
+        auto nparams = virDomainGetCPUStats(domain, nullptr, 0, -1, 1, flags);
+        if (nparams < 0) throw LibvirtError("Failed to get domain CPU stats");
+        std::vector<virTypedParameter> params(nparams);
+        auto count = nparams > 0 ? virDomainGetCPUStats(domain, params.data(), nparams, -1, 1, flags) : 0;
+        if (count < 0) throw LibvirtError("Failed to get domain CPU stats");
+        result.push_back(CopyTypedParams(params.data(), count));
+        return result;
+    }
+
+    auto hostCpus = virDomainGetCPUStats(domain, nullptr, 0, 0, 0, flags);
+    if (hostCpus < 0) throw LibvirtError("Failed to get domain CPU stats");
+    if (ncpus <= 0 || startCpu + ncpus > hostCpus) ncpus = hostCpus - startCpu;
+    if (ncpus <= 0) return result;
+    auto nparams = virDomainGetCPUStats(domain, nullptr, 0, 0, 1, flags);
+    if (nparams < 0) throw LibvirtError("Failed to get domain CPU stats");
+    result.reserve(ncpus);
+    /* libvirt returns at most 128 CPUs per call */
+    const int batch = 128;
+    std::vector<virTypedParameter> params;
+    for (int first = startCpu; first < startCpu + ncpus; first += batch) {
+        auto count = std::min(batch, startCpu + ncpus - first);
+        params.assign(static_cast<size_t>(nparams) * count, virTypedParameter());
+        auto filled = nparams > 0 ? virDomainGetCPUStats(domain, params.data(), nparams, first, count, flags) : 0;
+        if (filled < 0) throw LibvirtError("Failed to get domain CPU stats");
+        for (int i = 0; i < count; i++) {
+            /* CPUs offline on the host leave their entries zeroed, CopyTypedParams skips those */
+            result.push_back(CopyTypedParams(params.data() + static_cast<size_t>(i) * nparams, filled));
+        }
+    }
+    return result;
+}
+
+std::vector<VcpuInfo> GetVcpus(virDomainPtr domain) {
+    virDomainInfo domainInfo;
+    if (virDomainGetInfo(domain, &domainInfo) < 0) throw LibvirtError("Failed to get domain info");
+    auto hostCpus = HostCpuCount(virDomainGetConnect(domain));
+    auto maplen = VIR_CPU_MAPLEN(hostCpus);
+    int nvcpus = domainInfo.nrVirtCpu;
+    std::vector<virVcpuInfo> infos(nvcpus);
+    std::vector<unsigned char> cpumaps(static_cast<size_t>(nvcpus) * maplen);
+    auto count = virDomainGetVcpus(domain, infos.data(), nvcpus, cpumaps.data(), maplen);
+    if (count < 0) throw LibvirtError("Failed to get vCPU info");
+
+    std::vector<VcpuInfo> result(count);
+    for (int i = 0; i < count; i++) {
+        result[i].number = infos[i].number;
+        result[i].state = infos[i].state;
+        result[i].cpuTime = infos[i].cpuTime;
+        result[i].cpu = infos[i].cpu;
+        result[i].affinity = CpuMapToList(cpumaps.data(), maplen, i, hostCpus);
+    }
+    return result;
+}
+
+std::vector<std::vector<unsigned int>> GetVcpuPinInfo(virDomainPtr domain, unsigned int flags) {
+    auto ncpumaps = virDomainGetVcpusFlags(domain, flags | VIR_DOMAIN_VCPU_MAXIMUM);
+    if (ncpumaps < 0) throw LibvirtError("Failed to get the vCPU count");
+    auto hostCpus = HostCpuCount(virDomainGetConnect(domain));
+    auto maplen = VIR_CPU_MAPLEN(hostCpus);
+    std::vector<unsigned char> cpumaps(static_cast<size_t>(ncpumaps) * maplen);
+    auto count = virDomainGetVcpuPinInfo(domain, ncpumaps, cpumaps.data(), maplen, flags);
+    if (count < 0) throw LibvirtError("Failed to get vCPU pinning");
+
+    std::vector<std::vector<unsigned int>> result;
+    result.reserve(count);
+    for (int i = 0; i < count; i++) {
+        result.push_back(CpuMapToList(cpumaps.data(), maplen, i, hostCpus));
+    }
+    return result;
+}
+
+Napi::Array CpuListToArray(Napi::Env env, const std::vector<unsigned int> &cpus) {
+    auto array = Napi::Array::New(env, cpus.size());
+    for (size_t i = 0; i < cpus.size(); i++) {
+        array.Set(static_cast<uint32_t>(i), Napi::Number::New(env, cpus[i]));
+    }
+    return array;
+}
+
+Napi::Object VcpuInfoToObject(Napi::Env env, const VcpuInfo &vcpu) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("number", Napi::Number::New(env, vcpu.number));
+    obj.Set("state", Napi::Number::New(env, vcpu.state));
+    obj.Set("cpuTime", Napi::Number::New(env, static_cast<double>(vcpu.cpuTime)));
+    obj.Set("cpu", Napi::Number::New(env, vcpu.cpu));
+    obj.Set("affinity", CpuListToArray(env, vcpu.affinity));
+    return obj;
+}
+
+//region TOPOLOGY
+
+HostTopology CollectHostTopology(virConnectPtr conn, std::shared_ptr<const HostData> hostData) {
+    HostTopology topology;
+    topology.takenAtMs = std::chrono::duration<double, std::milli>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    topology.hostData = std::move(hostData);
+    if (virNodeGetInfo(conn, &topology.node) < 0) throw LibvirtError("Failed to get node info");
+
+    /* CPU times and cell memory are not available from every driver, their slots stay missing */
+    std::fill(topology.hostCpu, topology.hostCpu + HOST_CPU_STRIDE, STATS_MISSING);
+    try {
+        static const struct {
+            const char *field;
+            HostCpuSlot slot;
+        } fields[] = {
+                {VIR_NODE_CPU_STATS_KERNEL, HOST_CPU_KERNEL},
+                {VIR_NODE_CPU_STATS_USER,   HOST_CPU_USER},
+                {VIR_NODE_CPU_STATS_IDLE,   HOST_CPU_IDLE},
+                {VIR_NODE_CPU_STATS_IOWAIT, HOST_CPU_IOWAIT},
+        };
+        for (const auto &stat: GetNodeCpuStats(conn, VIR_NODE_CPU_STATS_ALL_CPUS, 0)) {
+            for (const auto &field: fields) {
+                if (stat.first == field.field) topology.hostCpu[field.slot] = stat.second;
+            }
+        }
+    } catch (const std::exception &) {
+    }
+
+    int cells = static_cast<int>(topology.node.nodes);
+    if (topology.hostData) {
+        for (const auto &cell: topology.hostData->parsed.cells) {
+            cells = std::max(cells, static_cast<int>(cell.id) + 1);
+        }
+    }
+    try {
+        topology.cellFreeMemory = GetCellsFreeMemory(conn, 0, cells);
+    } catch (const std::exception &) {
+    }
+
+    auto records = CollectAllDomainStats(conn, VIR_DOMAIN_STATS_CPU_TOTAL | VIR_DOMAIN_STATS_VCPU,
+                                         VIR_CONNECT_GET_ALL_DOMAINS_STATS_ACTIVE);
+    topology.domains.reserve(records.size());
+    topology.domainCpu.assign(records.size() * DOMAIN_CPU_STRIDE, STATS_MISSING);
+    for (size_t i = 0; i < records.size(); i++) {
+        topology.domains.push_back(records[i].Release());
+        auto domainCpu = topology.domainCpu.data() + i * DOMAIN_CPU_STRIDE;
+        std::map<unsigned long, std::vector<uint64_t>> vcpus;
+        for (const auto &param: records[i].params) {
+            auto value = static_cast<uint64_t>(TypedParamNumber(param));
+            if (param.field == "cpu.time") domainCpu[DOMAIN_CPU_TIME] = value;
+            else if (param.field == "cpu.user") domainCpu[DOMAIN_CPU_USER] = value;
+            else if (param.field == "cpu.system") domainCpu[DOMAIN_CPU_SYSTEM] = value;
+            else if (param.field == "vcpu.current") domainCpu[DOMAIN_CPU_VCPUS] = value;
+            else if (param.field.compare(0, 5, "vcpu.") == 0) {
+                /* vcpu.<n>.<name> */
+                auto dot = param.field.find('.', 5);
+                unsigned long number;
+                if (dot == std::string::npos || !ParseIndex(param.field.substr(5, dot - 5), number)) continue;
+                auto &slots = vcpus[number];
+                if (slots.empty()) {
+                    slots.assign(VCPU_STRIDE, STATS_MISSING);
+                    slots[VCPU_DOMAIN] = i;
+                    slots[VCPU_NUMBER] = number;
+                }
+                auto name = param.field.substr(dot + 1);
+                if (name == "state") slots[VCPU_STATE] = value;
+                else if (name == "time") slots[VCPU_TIME] = value;
+                else if (name == "wait") slots[VCPU_WAIT] = value;
+                else if (name == "delay") slots[VCPU_DELAY] = value;
+            }
+        }
+        for (const auto &vcpu: vcpus) {
+            topology.vcpus.insert(topology.vcpus.end(), vcpu.second.begin(), vcpu.second.end());
+        }
+    }
+    return topology;
+}
+
+HostTopology::~HostTopology() {
+    for (auto domainPtr: domains) {
+        if (domainPtr) virDomainFree(domainPtr);
+    }
+}
+
+Napi::Object HostTopologyToObject(Napi::Env env, HostTopology &topology, DomainRegistry &registry) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("takenAt", Napi::Number::New(env, topology.takenAtMs));
+
+    auto node = Napi::Object::New(env);
+    node.Set("model", Napi::String::New(env, topology.node.model));
+    node.Set("memory", Napi::Number::New(env, topology.node.memory));
+    node.Set("cpus", Napi::Number::New(env, topology.node.cpus));
+    node.Set("mhz", Napi::Number::New(env, topology.node.mhz));
+    node.Set("nodes", Napi::Number::New(env, topology.node.nodes));
+    node.Set("sockets", Napi::Number::New(env, topology.node.sockets));
+    node.Set("cores", Napi::Number::New(env, topology.node.cores));
+    node.Set("threads", Napi::Number::New(env, topology.node.threads));
+    obj.Set("node", node);
+    obj.Set("hostCpu", SlotsToArray(env, topology.hostCpu, HOST_CPU_STRIDE));
+
+    auto cells = Napi::Array::New(env);
+    auto freeMemory = [&topology, env](unsigned int id) -> Napi::Value {
+        if (id >= topology.cellFreeMemory.size()) return env.Null();
+        return Napi::Number::New(env, static_cast<double>(topology.cellFreeMemory[id]));
+    };
+    if (topology.hostData && !topology.hostData->parsed.cells.empty()) {
+        for (const auto &cell: topology.hostData->parsed.cells) {
+            auto item = Napi::Object::New(env);
+            item.Set("id", Napi::Number::New(env, cell.id));
+            item.Set("memory", Napi::Number::New(env, static_cast<double>(cell.memoryKiB)));
+            item.Set("freeMemory", freeMemory(cell.id));
+            std::vector<unsigned int> cpus;
+            for (const auto &cpu: cell.cpus) cpus.push_back(cpu.id);
+            item.Set("cpus", CpuListToArray(env, cpus));
+            cells.Set(cells.Length(), item);
+        }
+    } else {
+        for (unsigned int id = 0; id < topology.cellFreeMemory.size(); id++) {
+            auto item = Napi::Object::New(env);
+            item.Set("id", Napi::Number::New(env, id));
+            item.Set("freeMemory", freeMemory(id));
+            cells.Set(cells.Length(), item);
+        }
+    }
+    obj.Set("cells", cells);
+
+    auto domains = Napi::Array::New(env, topology.domains.size());
+    for (size_t i = 0; i < topology.domains.size(); i++) {
+        domains.Set(static_cast<uint32_t>(i), registry.Wrap(env, topology.domains[i]));
+    }
+    topology.domains.clear();
+    obj.Set("domains", domains);
+    obj.Set("domainCpu", SlotsToArray(env, topology.domainCpu.data(), topology.domainCpu.size()));
+    obj.Set("vcpus", SlotsToArray(env, topology.vcpus.data(), topology.vcpus.size()));
+    return obj;
+}
+
+//endregion
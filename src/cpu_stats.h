@@ -0,0 +1,109 @@
+//
+// Created by root on 4/19/24.
+//
+
+#ifndef NODE_LIBVIRT_CPU_STATS_H
+#define NODE_LIBVIRT_CPU_STATS_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "helper/stats_layout.h"
+#include "helper/typed_params.h"
+#include "domain_registry.h"
+#include "host_data.h"
+
+/**
+ * Fields of virNodeGetCPUStats (kernel, user, idle, iowait, ...) in nanoseconds, or percentages with
+ * VIR_NODE_CPU_STATS_UTILIZATION.
+ */
+typedef std::vector<std::pair<std::string, unsigned long long>> NodeCpuStats;
+
+struct VcpuInfo {
+    unsigned int number = 0;
+    int state = 0;
+    unsigned long long cpuTime = 0;
+    /** Host CPU the vCPU runs on, -1 when offline */
+    int cpu = -1;
+    std::vector<unsigned int> affinity;
+};
+
+/**
+ * The calls below block and throw std::runtime_error with the libvirt error, use them on a worker thread.
+ */
+NodeCpuStats GetNodeCpuStats(virConnectPtr conn, int cpuNum, unsigned int flags);
+
+/**
+ * Free memory in bytes of maxCells cells starting at startCell, maxCells <= 0 reads every cell.
+ */
+std::vector<unsigned long long> GetCellsFreeMemory(virConnectPtr conn, int startCell, int maxCells);
+
+/**
+ * virDomainGetCPUStats, one entry for startCpu -1 (totals) or one per host CPU otherwise.
+ * @param ncpus host CPUs to read starting at startCpu, <= 0 reads up to the last one
+ */
+std::vector<TypedParams> GetDomainCpuStats(virDomainPtr domain, int startCpu, int ncpus, unsigned int flags);
+
+/**
+ * virDomainGetVcpus with the affinity of every vCPU, the domain must be running.
+ */
+std::vector<VcpuInfo> GetVcpus(virDomainPtr domain);
+
+/**
+ * virDomainGetVcpuPinInfo, host CPUs every vCPU may run on.
+ * @param flags virDomainModificationImpact, the persistent config also works for inactive domains
+ */
+std::vector<std::vector<unsigned int>> GetVcpuPinInfo(virDomainPtr domain, unsigned int flags);
+
+Napi::Object VcpuInfoToObject(Napi::Env env, const VcpuInfo &vcpu);
+
+Napi::Array CpuListToArray(Napi::Env env, const std::vector<unsigned int> &cpus);
+
+/**
+ * Host and guest CPU accounting gathered in a few round trips: node info and CPU times, free memory per NUMA cell and
+ * one virConnectGetAllDomainStats for the CPU and vCPU counters of every running domain.
+ */
+struct HostTopology {
+    HostTopology() = default;
+
+    HostTopology(HostTopology &&) = default;
+
+    HostTopology(const HostTopology &) = delete;
+
+    HostTopology &operator=(const HostTopology &) = delete;
+
+    /**
+     * Frees the domains not handed to the registry, e.g. when the snapshot was cancelled.
+     */
+    ~HostTopology();
+
+    double takenAtMs = 0;
+    virNodeInfo node{};
+    uint64_t hostCpu[HOST_CPU_STRIDE];
+    /** Indexed by cell id */
+    std::vector<unsigned long long> cellFreeMemory;
+    std::shared_ptr<const HostData> hostData;
+    /** Referenced domains, ownership moves to the registry in HostTopologyToObject */
+    std::vector<virDomainPtr> domains;
+    /** DOMAIN_CPU_STRIDE slots per domain */
+    std::vector<uint64_t> domainCpu;
+    /** VCPU_STRIDE slots per vCPU */
+    std::vector<uint64_t> vcpus;
+};
+
+/**
+ * @param hostData snapshot used for the cell layout, may be null
+ */
+HostTopology CollectHostTopology(virConnectPtr conn, std::shared_ptr<const HostData> hostData);
+
+/**
+ * Must be called on the JavaScript thread.
+ */
+Napi::Object HostTopologyToObject(Napi::Env env, HostTopology &topology, DomainRegistry &registry);
+
+#endif //NODE_LIBVIRT_CPU_STATS_H
@@ -3,10 +3,25 @@
 //
 
 #include "domain.h"
+#include "addon.h"
 #include "helper/assert.h"
 #include "helper/error.h"
+#include "helper/libvirt_error.h"
 #include "hypervisor.h"
+#include "domain_registry.h"
+#include "connection_pool.h"
+#include "stream.h"
 #include "helper/promise_worker.h"
+#include "helper/stats_layout.h"
+#include "xml_projection.h"
+#include "migration.h"
+#include "cpu_stats.h"
+#include "snapshots.h"
+#include "address_inventory.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
 
 //region STATIC
 
@@ -19,12 +34,33 @@ Napi::Object Domain::Init(Napi::Env env, Napi::Object exports) {
                     InstanceAccessor("id", &Domain::Id, nullptr),
                     InstanceAccessor("name", &Domain::Name, nullptr),
                     InstanceAccessor("uuid", &Domain::UUIDString, nullptr),
+                    InstanceAccessor("handle", &Domain::GetHandle, nullptr),
 
                     /* Instance Methods */
                     InstanceMethod("shutdown", &Domain::Shutdown),
                     InstanceMethod("create", &Domain::Create),
                     InstanceMethod("save", &Domain::Save),
                     InstanceMethod("toXML", &Domain::ToXML),
+                    InstanceMethod("queryXML", &Domain::QueryXML),
+                    InstanceMethod("openConsole", &Domain::OpenConsole),
+                    InstanceMethod("infoInto", &Domain::InfoInto),
+                    InstanceMethod("blockStats", &Domain::BlockStats),
+                    InstanceMethod("interfaceStats", &Domain::InterfaceStats),
+                    InstanceMethod("interfaceAddresses", &Domain::InterfaceAddresses),
+                    InstanceMethod("cpuStats", &Domain::CPUStats),
+                    InstanceMethod("vcpus", &Domain::Vcpus),
+                    InstanceMethod("vcpuPinInfo", &Domain::VcpuPinInfo),
+                    InstanceMethod("migrate", &Domain::Migrate),
+                    InstanceMethod("jobStats", &Domain::JobStats),
+                    InstanceMethod("migrateSetMaxDowntime", &Domain::MigrateSetMaxDowntime),
+                    InstanceMethod("migrateSetMaxSpeed", &Domain::MigrateSetMaxSpeed),
+                    InstanceMethod("memoryStats", &Domain::MemoryStats),
+                    InstanceMethod("setMemory", &Domain::SetMemory),
+                    InstanceMethod("setMemoryStatsPeriod", &Domain::SetMemoryStatsPeriod),
+                    InstanceMethod("createSnapshot", &Domain::CreateSnapshot),
+                    InstanceMethod("snapshots", &Domain::ListSnapshots),
+                    InstanceMethod("revertToSnapshot", &Domain::RevertToSnapshot),
+                    InstanceMethod("deleteSnapshot", &Domain::DeleteSnapshot),
 
                     /* Static Methods */
                     StaticMethod("DefineXML", &Domain::DefineXML),
@@ -32,54 +68,80 @@ Napi::Object Domain::Init(Napi::Env env, Napi::Object exports) {
             });
 
 
-    auto *constructor = new Napi::FunctionReference();
-    *constructor = Napi::Persistent(func);
-    env.SetInstanceData(constructor);
+    AddonData::Get(env)->domainConstructor = Napi::Persistent(func);
     exports.Set("Domain", func);
     return exports;
 }
 
 Napi::Object Domain::New(Napi::Env env, const std::initializer_list<napi_value> &args) {
     Napi::EscapableHandleScope scope(env);
-    Napi::Object obj = env.GetInstanceData<Napi::FunctionReference>()->New(args);
+    Napi::Object obj = AddonData::Get(env)->domainConstructor.New(args);
     return scope.Escape(napi_value(obj)).ToObject();
 }
 
 
 Napi::Value Domain::DefineXML(const Napi::CallbackInfo &info) {
     auto env = info.Env();
-    if (info.Length() <= 0 || !info[0].IsString() || !info[1].IsObject()) {
+    if (info.Length() <= 1 || !info[0].IsString() || !info[1].IsObject()) {
         Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
         return env.Undefined();
     }
     auto xml = info[0].ToString().Utf8Value();
     auto pHypervisor = Napi::ObjectWrap<Hypervisor>::Unwrap(info[1].ToObject());
-    virDomainPtr domainPtr;
-    if (info[2].IsNumber()) {
-        domainPtr = virDomainDefineXMLFlags(pHypervisor->Handle(), xml.c_str(), info[2].ToNumber().Uint32Value());
-    } else {
-        domainPtr = virDomainDefineXML(pHypervisor->Handle(), xml.c_str());
-    }
-    virt_error_check_last()
-    return Domain::New(env, {Napi::External<virDomain>::New(env, domainPtr)});
+    assert(pHypervisor->Handle(), "Hypervisor not connected");
+    auto pool = pHypervisor->Pool();
+    auto registry = pHypervisor->Registry();
+    auto hasFlags = info.Length() > 2 && info[2].IsNumber();
+    auto flags = hasFlags ? info[2].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto worker = new PromiseWorker(deferred, [pool, registry, xml, hasFlags, flags](PromiseWorker *worker) {
+        auto lease = pool->Acquire();
+        auto domainPtr = hasFlags ? virDomainDefineXMLFlags(lease.Handle(), xml.c_str(), flags)
+                                  : virDomainDefineXML(lease.Handle(), xml.c_str());
+        if (!domainPtr) {
+            worker->Error(LastErrorMessage("Failed to define domain"));
+            return;
+        }
+        worker->Result([registry, domainPtr](Napi::Env env) -> Napi::Value {
+            return registry->Wrap(env, domainPtr);
+        });
+    });
+    worker->Cancellable(info, 3);
+    worker->Measure("Domain.DefineXML");
+    worker->Queue();
+    return deferred.Promise();
 }
 
 Napi::Value Domain::CreateXML(const Napi::CallbackInfo &info) {
     auto env = info.Env();
-    if (info.Length() <= 0 || !info[0].IsString() || !info[1].IsObject()) {
+    if (info.Length() <= 1 || !info[0].IsString() || !info[1].IsObject()) {
         Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
         return env.Undefined();
     }
     auto xml = info[0].ToString().Utf8Value();
-    virDomainPtr domainPtr;
     auto pHypervisor = Napi::ObjectWrap<Hypervisor>::Unwrap(info[1].ToObject());
-    if (info[2].IsNumber()) {
-        domainPtr = virDomainCreateXML(pHypervisor->Handle(), xml.c_str(), info[2].ToNumber().Uint32Value());
-    } else {
-        domainPtr = virDomainCreateXML(pHypervisor->Handle(), xml.c_str(), 0);
-    }
-    virt_error_check(domainPtr);
-    return Domain::New(env, {Napi::External<virDomain>::New(env, domainPtr)});
+    assert(pHypervisor->Handle(), "Hypervisor not connected");
+    auto pool = pHypervisor->Pool();
+    auto registry = pHypervisor->Registry();
+    auto flags = info.Length() > 2 && info[2].IsNumber() ? info[2].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto worker = new PromiseWorker(deferred, [pool, registry, xml, flags](PromiseWorker *worker) {
+        auto lease = pool->Acquire();
+        auto domainPtr = virDomainCreateXML(lease.Handle(), xml.c_str(), flags);
+        if (!domainPtr) {
+            worker->Error(LastErrorMessage("Failed to create domain"));
+            return;
+        }
+        worker->Result([registry, domainPtr](Napi::Env env) -> Napi::Value {
+            return registry->Wrap(env, domainPtr);
+        });
+    }, Executor::Lane::Bulk);
+    worker->Cancellable(info, 3);
+    worker->Measure("Domain.CreateXML");
+    worker->Queue();
+    return deferred.Promise();
 }
 
 //endregion
@@ -90,74 +152,969 @@ Napi::Value Domain::CreateXML(const Napi::CallbackInfo &info) {
 Domain::Domain(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Domain>(info) {
     Napi::Env env = info.Env();
     if (info.Length() <= 0 || !info[0].IsExternal()) {
+        this->_handle = std::make_shared<DomainHandle>(nullptr);
         Napi::TypeError::New(env, "Expected an external.")
                 .ThrowAsJavaScriptException();
         return;
     }
-    this->_domain = info[0].As<Napi::External<virDomain>>().Data();
+    this->_handle = std::make_shared<DomainHandle>(info[0].As<Napi::External<virDomain>>().Data());
 }
 
 Domain::~Domain() {
-    if (this->_domain) virDomainFree(this->_domain);
+    if (this->_registry) this->_registry->Forget(this->_registryKey, this);
 }
 
-//region INSTANCE METHODS
+void Domain::Track(std::shared_ptr<DomainRegistry> registry, const std::string &key) {
+    this->_handle->SetPool(registry->Pool());
+    this->_registry = std::move(registry);
+    this->_registryKey = key;
+}
+
+void Domain::Untrack() {
+    this->_registry.reset();
+    this->_registryKey.clear();
+}
 
+void Domain::ReplaceHandle(virDomainPtr domainPtr) {
+    this->_handle->Offer(domainPtr);
+}
 
-void Domain::Create(const Napi::CallbackInfo &info) {
-    assert_void(this->_domain, "Domain is not defined")
-    int ret;
-    if (info[0] && info[0].IsNumber()) {
-        ret = virDomainCreateWithFlags(this->_domain, info[1].ToNumber().Uint32Value());
-    } else {
-        ret = virDomainCreate(this->_domain);
+virDomainPtr Domain::Current() {
+    this->_handle->RefreshInBackground();
+    return this->_handle->Get();
+}
+
+//region HANDLE
+
+DomainHandle::~DomainHandle() {
+    if (_domain) virDomainFree(_domain);
+    for (auto domainPtr: _retired) virDomainFree(domainPtr);
+}
+
+void DomainHandle::SetPool(std::weak_ptr<ConnectionPool> pool) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pool = std::move(pool);
+}
+
+virDomainPtr DomainHandle::Get() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _domain;
+}
+
+virDomainPtr DomainHandle::Acquire() {
+    virDomainPtr current;
+    std::shared_ptr<ConnectionPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_domain) return nullptr;
+        current = _domain;
+        virDomainRef(current);
+        pool = _pool.lock();
+    }
+    if (!pool || virConnectIsAlive(virDomainGetConnect(current)) == 1) return current;
+    auto conn = pool->Primary();
+    if (!conn || conn == virDomainGetConnect(current) || virConnectIsAlive(conn) != 1) return current;
+
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    auto domainPtr = virDomainGetUUID(current, uuid) == 0 ? virDomainLookupByUUID(conn, uuid) : nullptr;
+    /* On failure the call goes to the old handle and reports the connection error */
+    virResetLastError();
+    if (!domainPtr) return current;
+    virDomainFree(current);
+    /* One reference for the caller, Offer owns the other */
+    virDomainRef(domainPtr);
+    Offer(domainPtr);
+    return domainPtr;
+}
+
+std::shared_ptr<ConnectionPool::Lease> DomainHandle::LeaseConnection() {
+    std::shared_ptr<ConnectionPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        pool = _pool.lock();
     }
-    virt_error_check_void(ret < 0)
+    if (!pool) return nullptr;
+    auto lease = new ConnectionPool::Lease(pool->Acquire());
+    return std::shared_ptr<ConnectionPool::Lease>(lease, [pool](ConnectionPool::Lease *lease) {
+        delete lease;
+    });
 }
 
-void Domain::Save(const Napi::CallbackInfo &info) {
-    assert_void(this->_domain, "Domain is not defined")
+void DomainHandle::RefreshInBackground() {
+    auto domainPtr = Get();
+    if (!domainPtr || virConnectIsAlive(virDomainGetConnect(domainPtr)) == 1) return;
+    if (_refreshing.exchange(true)) return;
+    auto self = shared_from_this();
+    Executor::Instance().Submit(Executor::Lane::Fast, [self]() {
+        auto domainPtr = self->Acquire();
+        if (domainPtr) virDomainFree(domainPtr);
+        self->_refreshing = false;
+    });
+}
 
-    auto env = info.Env();
-    if (info.Length() <= 0 || !info[0].IsString()) {
-        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+void DomainHandle::Offer(virDomainPtr domainPtr) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_domain && virConnectIsAlive(virDomainGetConnect(_domain)) == 1) {
+        virDomainFree(domainPtr);
         return;
     }
-    virt_error_check_void(
-            virDomainSaveFlags(
-                    this->_domain,
-                    info[0].ToString().Utf8Value().c_str(),
-                    info[2].IsString() ? info[2].ToString().Utf8Value().c_str() : nullptr,
-                    info[1].IsNumber() ? info[1].ToNumber().Int32Value() : 0)
-            < 0)
+    if (_domain) _retired.push_back(_domain);
+    _domain = domainPtr;
 }
 
-void Domain::Shutdown(const Napi::CallbackInfo &info) {
-    assert_void(this->_domain, "Domain not defined");
-    int ret;
-    if (info.Length() > 0 && info[0].IsNumber()) { /* Check if shutdown request is with flags */
-        ret = virDomainShutdownFlags(this->_domain, info[0].ToNumber().Uint32Value());
+//endregion
+
+//region INSTANCE METHODS
+
+/**
+ * Cancel hook aborting the current job of the domain, holds its own reference.
+ */
+static std::function<void()> AbortJobHook(virDomainPtr domainPtr) {
+    virDomainRef(domainPtr);
+    std::shared_ptr<virDomain> domain(domainPtr, virDomainFree);
+    return [domain]() {
+        virDomainAbortJob(domain.get());
+    };
+}
+
+
+Napi::Value Domain::Create(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain is not defined")
+
+    auto env = info.Env();
+    auto hasFlags = info.Length() > 0 && info[0].IsNumber();
+    auto flags = hasFlags ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, hasFlags, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        int ret = hasFlags ? virDomainCreateWithFlags(domainPtr, flags) : virDomainCreate(domainPtr);
+        if (ret < 0) {
+            worker->Error(LastErrorMessage("Failed to start domain"));
+        }
+        virDomainFree(domainPtr);
+    }, Executor::Lane::Bulk);
+    worker->Cancellable(info, 1);
+    worker->Measure("Domain.create");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::Save(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain is not defined")
+
+    auto env = info.Env();
+//region validate arguments
+    /* save(filename, dxml?, flags?, options?) or save(params, flags?, options?) */
+    auto useParams = info.Length() > 0 && info[0].IsObject();
+    if (info.Length() <= 0 || !(info[0].IsString() || useParams)) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::string filename;
+    std::string dxml;
+    TypedParams params;
+    unsigned int flags = 0;
+    size_t optionsIndex = 3;
+    if (useParams) {
+        std::string error;
+        if (!ParseSaveParams(info[0], params, error)) {
+            Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        auto hasFile = std::any_of(params.begin(), params.end(), [](const TypedParam &param) -> bool {
+            return param.field == VIR_DOMAIN_SAVE_PARAM_FILE;
+        });
+        if (!hasFile) {
+            Napi::TypeError::New(env, "'file' is required").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+        optionsIndex = 2;
     } else {
-        ret = virDomainShutdown(this->_domain);
+        filename = info[0].ToString().Utf8Value();
+        /* flags may also be passed second for backwards compatibility */
+        for (size_t i = 1; i < info.Length() && i < 3; i++) {
+            if (info[i].IsString()) {
+                dxml = info[i].ToString().Utf8Value();
+            } else if (info[i].IsNumber()) {
+                flags = info[i].ToNumber().Uint32Value();
+            }
+        }
+        /* virDomainSaveFlags rejects parallel saves */
+        if (flags & VIR_DOMAIN_SAVE_PARALLEL) {
+            params = SaveFileParams(filename, dxml);
+            useParams = true;
+        }
     }
-    virt_error_check_void(ret < 0);
+
+    Napi::ThreadSafeFunction progress;
+    std::chrono::milliseconds interval;
+    auto hasProgress = ReadProgressOptions(env, info.Length() > optionsIndex ? info[optionsIndex] : env.Undefined(),
+                                           "libvirt.saveProgress", progress, interval);
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, useParams, params, filename, dxml, flags, progress,
+            hasProgress, interval](PromiseWorker *worker) mutable {
+        std::shared_ptr<ConnectionPool::Lease> lease;
+        try {
+            lease = handle->LeaseConnection();
+        } catch (const std::exception &) {
+            if (hasProgress) progress.Release();
+            throw;
+        }
+        auto domainPtr = handle->Acquire();
+        virTypedParameterPtr vparams = nullptr;
+        int nparams = 0;
+        if (!worker->OnCancel(AbortJobHook(domainPtr)) ||
+            (useParams && !ToVirTypedParams(params, &vparams, &nparams))) {
+            if (!worker->Cancelled()) worker->Error("Failed to prepare save parameters");
+            if (hasProgress) progress.Release();
+            virDomainFree(domainPtr);
+            return;
+        }
+
+        int ret;
+        {
+            std::unique_ptr<JobProgressSampler> sampler;
+            if (hasProgress) sampler.reset(new JobProgressSampler(domainPtr, progress, interval));
+            ret = useParams ? virDomainSaveParams(domainPtr, vparams, nparams, flags)
+                            : virDomainSaveFlags(domainPtr, filename.c_str(), dxml.empty() ? nullptr : dxml.c_str(),
+                                                 flags);
+        }
+        if (ret < 0) worker->Error(LastErrorMessage("Failed to save domain"));
+        if (hasProgress) progress.Release();
+        virTypedParamsFree(vparams, nparams);
+        virDomainFree(domainPtr);
+    }, Executor::Lane::Bulk);
+    if (hasProgress) {
+        worker->OnDiscard([progress]() {
+            progress.Release();
+        });
+    }
+    worker->Cancellable(info, optionsIndex);
+    worker->Measure("Domain.save");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::Shutdown(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    /* Check if shutdown request is with flags */
+    auto hasFlags = info.Length() > 0 && info[0].IsNumber();
+    auto flags = hasFlags ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, hasFlags, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        int ret = hasFlags ? virDomainShutdownFlags(domainPtr, flags) : virDomainShutdown(domainPtr);
+        if (ret < 0) {
+            worker->Error(LastErrorMessage("Failed to shut down domain"));
+        }
+        virDomainFree(domainPtr);
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Domain.shutdown");
+    worker->Queue();
+    return deferred.Promise();
 }
 
 Napi::Value Domain::ToXML(const Napi::CallbackInfo &info) {
-    assert(this->_domain, "Domain not defined");
+    assert(this->_handle->Get(), "Domain not defined");
 
+    auto env = info.Env();
     if (info.Length() <= 0 || !info[0].IsNumber()) {
-        Napi::Error::New(info.Env(), "Invalid arguments").ThrowAsJavaScriptException();
-        return info.Env().Undefined();
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
     }
-
     auto flags = info[0].ToNumber().Uint32Value();
 
-    auto xmlDesc = virDomainGetXMLDesc(this->_domain, flags);
-    virt_error_check(xmlDesc == nullptr);
-    auto ret = Napi::String::New(info.Env(), xmlDesc);
-    free(xmlDesc);
-    return ret;
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        auto xmlDesc = virDomainGetXMLDesc(domainPtr, flags);
+        if (xmlDesc == nullptr) {
+            worker->Error(LastErrorMessage("Failed to get domain XML"));
+            virDomainFree(domainPtr);
+            return;
+        }
+        auto xml = std::make_shared<std::string>(xmlDesc);
+        free(xmlDesc);
+        virDomainFree(domainPtr);
+        worker->Result([xml](Napi::Env env) -> Napi::Value {
+            return Napi::String::New(env, *xml);
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Domain.toXML");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::QueryXML(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    auto selectors = std::make_shared<XmlSelectors>();
+    if (!ReadXmlSelectors(env, info.Length() > 0 ? info[0] : env.Undefined(), *selectors)) {
+        return env.Undefined();
+    }
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, selectors, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        auto xmlDesc = virDomainGetXMLDesc(domainPtr, flags);
+        virDomainFree(domainPtr);
+        if (!xmlDesc) {
+            worker->Error(LastErrorMessage("Failed to get domain XML"));
+            return;
+        }
+        std::string xml(xmlDesc);
+        free(xmlDesc);
+        auto projection = std::make_shared<XmlProjection>(ProjectXml(xml, *selectors));
+        worker->Result([projection](Napi::Env env) -> Napi::Value {
+            return XmlProjectionToObject(env, *projection);
+        });
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Domain.queryXML");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::OpenConsole(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    auto devName = info.Length() > 0 && info[0].IsString() ? info[0].ToString().Utf8Value() : "";
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, devName, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        auto stream = virStreamNew(virDomainGetConnect(domainPtr), VIR_STREAM_NONBLOCK);
+        if (!stream) {
+            worker->Error(LastErrorMessage("Failed to create stream"));
+            virDomainFree(domainPtr);
+            return;
+        }
+        if (virDomainOpenConsole(domainPtr, devName.empty() ? nullptr : devName.c_str(), stream, flags) < 0) {
+            worker->Error(LastErrorMessage("Failed to open console"));
+            virStreamFree(stream);
+            virDomainFree(domainPtr);
+            return;
+        }
+        virDomainFree(domainPtr);
+        worker->Result([stream](Napi::Env env) -> Napi::Value {
+            return Stream::New(env, {Napi::External<virStream>::New(env, stream)});
+        });
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Domain.openConsole");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::BlockStats(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected a disk name").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto disk = info[0].ToString().Utf8Value();
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, disk, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        int nparams = 0;
+        std::vector<virTypedParameter> params;
+        auto ret = virDomainBlockStatsFlags(domainPtr, disk.c_str(), nullptr, &nparams, flags);
+        if (ret == 0 && nparams > 0) {
+            params.resize(nparams);
+            ret = virDomainBlockStatsFlags(domainPtr, disk.c_str(), params.data(), &nparams, flags);
+        }
+        if (ret < 0) {
+            worker->Error(LastErrorMessage("Failed to get block stats"));
+            virDomainFree(domainPtr);
+            return;
+        }
+        auto stats = std::make_shared<TypedParams>(CopyTypedParams(params.data(), nparams));
+        virDomainFree(domainPtr);
+        worker->Result([stats](Napi::Env env) -> Napi::Value {
+            auto obj = Napi::Object::New(env);
+            for (const auto &param: *stats) {
+                obj.Set(CamelCaseField(param.field), TypedParamToValue(env, param));
+            }
+            return obj;
+        });
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Domain.blockStats");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::InterfaceStats(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Expected an interface name").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto device = info[0].ToString().Utf8Value();
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, device](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        virDomainInterfaceStatsStruct stats;
+        if (virDomainInterfaceStats(domainPtr, device.c_str(), &stats, sizeof(stats)) < 0) {
+            worker->Error(LastErrorMessage("Failed to get interface stats"));
+            virDomainFree(domainPtr);
+            return;
+        }
+        virDomainFree(domainPtr);
+        worker->Result([stats](Napi::Env env) -> Napi::Value {
+            auto obj = Napi::Object::New(env);
+            obj.Set("rxBytes", Napi::Number::New(env, static_cast<double>(stats.rx_bytes)));
+            obj.Set("rxPackets", Napi::Number::New(env, static_cast<double>(stats.rx_packets)));
+            obj.Set("rxErrs", Napi::Number::New(env, static_cast<double>(stats.rx_errs)));
+            obj.Set("rxDrop", Napi::Number::New(env, static_cast<double>(stats.rx_drop)));
+            obj.Set("txBytes", Napi::Number::New(env, static_cast<double>(stats.tx_bytes)));
+            obj.Set("txPackets", Napi::Number::New(env, static_cast<double>(stats.tx_packets)));
+            obj.Set("txErrs", Napi::Number::New(env, static_cast<double>(stats.tx_errs)));
+            obj.Set("txDrop", Napi::Number::New(env, static_cast<double>(stats.tx_drop)));
+            return obj;
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Domain.interfaceStats");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::InterfaceAddresses(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    AddressSource source = ADDRESS_SOURCE_LEASE;
+    if (info.Length() > 0 && !info[0].IsUndefined() &&
+        (!info[0].IsString() || !ParseAddressSource(info[0].ToString().Utf8Value(), source) ||
+         source == ADDRESS_SOURCE_DHCP)) {
+        Napi::TypeError::New(env, "Source must be \"lease\", \"agent\" or \"arp\"").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, source](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        std::shared_ptr<std::vector<::InterfaceAddresses>> interfaces;
+        try {
+            interfaces = std::make_shared<std::vector<::InterfaceAddresses>>(GetInterfaceAddresses(domainPtr, source));
+        } catch (const std::exception &) {
+            virDomainFree(domainPtr);
+            throw;
+        }
+        virDomainFree(domainPtr);
+        worker->Result([interfaces](Napi::Env env) -> Napi::Value {
+            return InterfaceAddressesToArray(env, *interfaces);
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Domain.interfaceAddresses");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::CPUStats(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    auto startCpu = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Int32Value() : -1;
+    auto ncpus = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Int32Value() : 0;
+    auto flags = info.Length() > 2 && info[2].IsNumber() ? info[2].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, startCpu, ncpus, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        std::shared_ptr<std::vector<TypedParams>> stats;
+        try {
+            stats = std::make_shared<std::vector<TypedParams>>(GetDomainCpuStats(domainPtr, startCpu, ncpus, flags));
+        } catch (const std::exception &) {
+            virDomainFree(domainPtr);
+            throw;
+        }
+        virDomainFree(domainPtr);
+        worker->Result([stats, startCpu](Napi::Env env) -> Napi::Value {
+            auto toObject = [env](const TypedParams &params) -> Napi::Object {
+                auto obj = Napi::Object::New(env);
+                for (const auto &param: params) {
+                    obj.Set(CamelCaseField(param.field), TypedParamToValue(env, param));
+                }
+                return obj;
+            };
+            if (startCpu < 0) return toObject(stats->empty() ? TypedParams() : stats->front());
+            auto array = Napi::Array::New(env, stats->size());
+            for (size_t i = 0; i < stats->size(); i++) {
+                array.Set(static_cast<uint32_t>(i), toObject(stats->at(i)));
+            }
+            return array;
+        });
+    });
+    worker->Cancellable(info, 3);
+    worker->Measure("Domain.cpuStats");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::Vcpus(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        std::shared_ptr<std::vector<VcpuInfo>> vcpus;
+        try {
+            vcpus = std::make_shared<std::vector<VcpuInfo>>(GetVcpus(domainPtr));
+        } catch (const std::exception &) {
+            virDomainFree(domainPtr);
+            throw;
+        }
+        virDomainFree(domainPtr);
+        worker->Result([vcpus](Napi::Env env) -> Napi::Value {
+            auto array = Napi::Array::New(env, vcpus->size());
+            for (size_t i = 0; i < vcpus->size(); i++) {
+                array.Set(static_cast<uint32_t>(i), VcpuInfoToObject(env, vcpus->at(i)));
+            }
+            return array;
+        });
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("Domain.vcpus");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::VcpuPinInfo(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    auto flags = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        std::shared_ptr<std::vector<std::vector<unsigned int>>> pins;
+        try {
+            pins = std::make_shared<std::vector<std::vector<unsigned int>>>(GetVcpuPinInfo(domainPtr, flags));
+        } catch (const std::exception &) {
+            virDomainFree(domainPtr);
+            throw;
+        }
+        virDomainFree(domainPtr);
+        worker->Result([pins](Napi::Env env) -> Napi::Value {
+            auto array = Napi::Array::New(env, pins->size());
+            for (size_t i = 0; i < pins->size(); i++) {
+                array.Set(static_cast<uint32_t>(i), CpuListToArray(env, pins->at(i)));
+            }
+            return array;
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Domain.vcpuPinInfo");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::Migrate(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+//region validate arguments
+    if (info.Length() <= 0 || !(info[0].IsString() || info[0].IsNull() || info[0].IsUndefined())) {
+        Napi::TypeError::New(env, "Invalid destination URI").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto dconnuri = info[0].IsString() ? info[0].ToString().Utf8Value() : "";
+    TypedParams params;
+    std::string error;
+    if (!ParseMigrationParams(info.Length() > 1 ? info[1] : env.Undefined(), params, error)) {
+        Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto flags = info.Length() > 2 && info[2].IsNumber() ? info[2].ToNumber().Uint32Value() : 0;
+
+    Napi::ThreadSafeFunction progress;
+    std::chrono::milliseconds interval;
+    auto hasProgress = ReadProgressOptions(env, info.Length() > 3 ? info[3] : env.Undefined(),
+                                           "libvirt.migrationProgress", progress, interval);
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, dconnuri, params, flags, progress, hasProgress, interval](
+            PromiseWorker *worker) mutable {
+        std::shared_ptr<ConnectionPool::Lease> lease;
+        try {
+            lease = handle->LeaseConnection();
+        } catch (const std::exception &) {
+            if (hasProgress) progress.Release();
+            throw;
+        }
+        auto domainPtr = handle->Acquire();
+        virTypedParameterPtr vparams = nullptr;
+        int nparams = 0;
+        if (!worker->OnCancel(AbortJobHook(domainPtr)) || !ToVirTypedParams(params, &vparams, &nparams)) {
+            if (!worker->Cancelled()) worker->Error("Failed to prepare migration parameters");
+            if (hasProgress) progress.Release();
+            virDomainFree(domainPtr);
+            return;
+        }
+
+        int ret;
+        {
+            std::unique_ptr<JobProgressSampler> sampler;
+            if (hasProgress) sampler.reset(new JobProgressSampler(domainPtr, progress, interval));
+            ret = virDomainMigrateToURI3(domainPtr, dconnuri.empty() ? nullptr : dconnuri.c_str(), vparams,
+                                         nparams, flags);
+        }
+        if (ret < 0) worker->Error(LastErrorMessage("Failed to migrate domain"));
+        if (hasProgress) progress.Release();
+        virTypedParamsFree(vparams, nparams);
+        if (ret < 0) {
+            virDomainFree(domainPtr);
+            return;
+        }
+
+        /* Statistics of the finished job, not every driver keeps them */
+        auto stats = std::make_shared<::JobStats>();
+        try {
+            *stats = GetJobStats(domainPtr, VIR_DOMAIN_JOB_STATS_COMPLETED);
+        } catch (const std::exception &) {
+        }
+        virDomainFree(domainPtr);
+        worker->Result([stats](Napi::Env env) -> Napi::Value {
+            return JobStatsToObject(env, *stats);
+        });
+    }, Executor::Lane::Bulk);
+    if (hasProgress) {
+        worker->OnDiscard([progress]() {
+            progress.Release();
+        });
+    }
+    worker->Cancellable(info, 3);
+    worker->Measure("Domain.migrate");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::JobStats(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    auto flags = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        std::shared_ptr<::JobStats> stats;
+        try {
+            stats = std::make_shared<::JobStats>(GetJobStats(domainPtr, flags));
+        } catch (const std::exception &) {
+            virDomainFree(domainPtr);
+            throw;
+        }
+        virDomainFree(domainPtr);
+        worker->Result([stats](Napi::Env env) -> Napi::Value {
+            return JobStatsToObject(env, *stats);
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Domain.jobStats");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::MigrateSetMaxDowntime(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsNumber() || info[0].ToNumber().DoubleValue() < 0) {
+        Napi::TypeError::New(env, "Invalid downtime").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto downtime = static_cast<unsigned long long>(info[0].ToNumber().Int64Value());
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, downtime, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        if (virDomainMigrateSetMaxDowntime(domainPtr, downtime, flags) < 0) {
+            worker->Error(LastErrorMessage("Failed to set the maximum downtime"));
+        }
+        virDomainFree(domainPtr);
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Domain.migrateSetMaxDowntime");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::MigrateSetMaxSpeed(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsNumber() || info[0].ToNumber().DoubleValue() < 0) {
+        Napi::TypeError::New(env, "Invalid bandwidth").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto bandwidth = static_cast<unsigned long>(info[0].ToNumber().Int64Value());
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, bandwidth, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        if (virDomainMigrateSetMaxSpeed(domainPtr, bandwidth, flags) < 0) {
+            worker->Error(LastErrorMessage("Failed to set the maximum migration speed"));
+        }
+        virDomainFree(domainPtr);
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Domain.migrateSetMaxSpeed");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::MemoryStats(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        virDomainMemoryStatStruct stats[VIR_DOMAIN_MEMORY_STAT_NR];
+        auto count = virDomainMemoryStats(domainPtr, stats, VIR_DOMAIN_MEMORY_STAT_NR, 0);
+        if (count < 0) {
+            worker->Error(LastErrorMessage("Failed to get memory stats"));
+            virDomainFree(domainPtr);
+            return;
+        }
+        virDomainFree(domainPtr);
+        auto slots = std::make_shared<std::vector<uint64_t>>(MEMORY_STAT_STRIDE);
+        MemoryStatsSlots(stats, count, slots->data());
+        worker->Result([slots](Napi::Env env) -> Napi::Value {
+            auto array = Napi::Float64Array::New(env, MEMORY_STAT_STRIDE);
+            WriteStats(array, 0, slots->data(), MEMORY_STAT_STRIDE);
+            return array;
+        });
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("Domain.memoryStats");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::SetMemory(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsNumber() || info[0].ToNumber().DoubleValue() < 0) {
+        Napi::TypeError::New(env, "Invalid memory size").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto memory = static_cast<unsigned long>(info[0].ToNumber().Int64Value());
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, memory, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        if (virDomainSetMemoryFlags(domainPtr, memory, flags) < 0) {
+            worker->Error(LastErrorMessage("Failed to set memory"));
+        }
+        virDomainFree(domainPtr);
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Domain.setMemory");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::SetMemoryStatsPeriod(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsNumber() || info[0].ToNumber().DoubleValue() < 0) {
+        Napi::TypeError::New(env, "Invalid period").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto period = info[0].ToNumber().Int32Value();
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, period, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        if (virDomainSetMemoryStatsPeriod(domainPtr, period, flags) < 0) {
+            worker->Error(LastErrorMessage("Failed to set the memory stats period"));
+        }
+        virDomainFree(domainPtr);
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Domain.setMemoryStatsPeriod");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::CreateSnapshot(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Invalid snapshot XML").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto xml = info[0].ToString().Utf8Value();
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, xml, flags](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        auto snapshotPtr = virDomainSnapshotCreateXML(domainPtr, xml.c_str(), flags);
+        virDomainFree(domainPtr);
+        if (!snapshotPtr) {
+            worker->Error(LastErrorMessage("Failed to create snapshot"));
+            return;
+        }
+        std::shared_ptr<SnapshotInfo> snapshot;
+        try {
+            snapshot = std::make_shared<SnapshotInfo>(DescribeSnapshot(snapshotPtr, false));
+        } catch (const std::exception &) {
+            virDomainSnapshotFree(snapshotPtr);
+            throw;
+        }
+        virDomainSnapshotFree(snapshotPtr);
+        worker->Result([snapshot](Napi::Env env) -> Napi::Value {
+            return SnapshotInfoToObject(env, *snapshot);
+        });
+    }, Executor::Lane::Bulk);
+    worker->Cancellable(info, 2);
+    worker->Measure("Domain.createSnapshot");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::ListSnapshots(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+
+    auto env = info.Env();
+    SnapshotListOptions options;
+    ReadSnapshotListOptions(info.Length() > 0 ? info[0] : env.Undefined(), options);
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto handle = this->_handle;
+    auto worker = new PromiseWorker(deferred, [handle, options](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        std::shared_ptr<std::vector<SnapshotInfo>> snapshots;
+        try {
+            snapshots = std::make_shared<std::vector<SnapshotInfo>>(::ListSnapshots(domainPtr, options));
+        } catch (const std::exception &) {
+            virDomainFree(domainPtr);
+            throw;
+        }
+        virDomainFree(domainPtr);
+        worker->Result([snapshots](Napi::Env env) -> Napi::Value {
+            return SnapshotsToArray(env, *snapshots);
+        });
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("Domain.snapshots");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+/**
+ * Look up a snapshot by name and run fn on it, for the revert and delete bindings.
+ */
+static Napi::Value WithSnapshot(const Napi::CallbackInfo &info, std::shared_ptr<DomainHandle> handle,
+                                const char *operation, std::function<int(virDomainSnapshotPtr, unsigned int)> &&fn) {
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Invalid snapshot name").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto name = info[0].ToString().Utf8Value();
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto worker = new PromiseWorker(deferred, [handle, name, flags, fn](PromiseWorker *worker) {
+        auto lease = handle->LeaseConnection();
+        auto domainPtr = handle->Acquire();
+        auto snapshotPtr = virDomainSnapshotLookupByName(domainPtr, name.c_str(), 0);
+        if (!snapshotPtr || fn(snapshotPtr, flags) < 0) {
+            worker->Error(LastErrorMessage("Snapshot operation failed"));
+        }
+        if (snapshotPtr) virDomainSnapshotFree(snapshotPtr);
+        virDomainFree(domainPtr);
+    }, Executor::Lane::Bulk);
+    worker->Cancellable(info, 2);
+    worker->Measure(operation);
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Domain::RevertToSnapshot(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+    return WithSnapshot(info, this->_handle, "Domain.revertToSnapshot", virDomainRevertToSnapshot);
+}
+
+Napi::Value Domain::DeleteSnapshot(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+    return WithSnapshot(info, this->_handle, "Domain.deleteSnapshot", virDomainSnapshotDelete);
 }
 
 //endregion
@@ -165,11 +1122,12 @@ Napi::Value Domain::ToXML(const Napi::CallbackInfo &info) {
 //region ACCESSORS
 
 Napi::Value Domain::Info(const Napi::CallbackInfo &info) {
-    assert(this->_domain, "Domain not defined");
+    assert(this->_handle->Get(), "Domain not defined");
     auto env = info.Env();
+    auto domainPtr = Current();
 //region request virDomainInfo
     virDomainInfo domainInfo;
-    virt_error_check(virDomainGetInfo(this->_domain, &domainInfo) < 0);
+    virt_error_check(virDomainGetInfo(domainPtr, &domainInfo) < 0);
 //endregion
 //region virDomainInfo to Javascript object
     auto infoObj = Napi::Object::New(env);
@@ -182,12 +1140,31 @@ Napi::Value Domain::Info(const Napi::CallbackInfo &info) {
 //endregion
 }
 
+Napi::Value Domain::InfoInto(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+    auto env = info.Env();
+    auto domainPtr = Current();
+//region validate target
+    size_t offset;
+    if (!StatsOffset(info, 1, offset) || !CheckStatsTarget(env, info[0], offset, DOMAIN_INFO_STRIDE)) {
+        return env.Undefined();
+    }
+//endregion
+    virDomainInfo domainInfo;
+    virt_error_check(virDomainGetInfo(domainPtr, &domainInfo) < 0);
+
+    uint64_t slots[DOMAIN_INFO_STRIDE];
+    DomainInfoSlots(domainInfo, slots);
+    WriteStats(info[0].As<Napi::TypedArray>(), offset, slots, DOMAIN_INFO_STRIDE);
+    return Napi::Number::New(env, static_cast<double>(offset + DOMAIN_INFO_STRIDE));
+}
+
 Napi::Value Domain::Id(const Napi::CallbackInfo &info) {
-    assert(this->_domain, "Domain not defined");
+    assert(this->_handle->Get(), "Domain not defined");
 
     auto env = info.Env();
 //region request Domain id
-    auto id = virDomainGetID(this->_domain);
+    auto id = virDomainGetID(this->_handle->Get());
     /*
      * Inactive domains don't have an id, so virDomainGetID will return -1,
      * but not set an error. This will cause SetVirtError to throw an
@@ -202,17 +1179,32 @@ Napi::Value Domain::Id(const Napi::CallbackInfo &info) {
 }
 
 Napi::Value Domain::Name(const Napi::CallbackInfo &info) {
-    assert(this->_domain, "Domain not defined");
-    return Napi::String::New(info.Env(), virDomainGetName(this->_domain));
+    assert(this->_handle->Get(), "Domain not defined");
+    return Napi::String::New(info.Env(), virDomainGetName(this->_handle->Get()));
 }
 
 Napi::Value Domain::UUIDString(const Napi::CallbackInfo &info) {
-    assert(this->_domain, "Domain not defined");
+    assert(this->_handle->Get(), "Domain not defined");
     char uuid[VIR_UUID_STRING_BUFLEN];
-    virt_error_check(virDomainGetUUIDString(this->_domain, uuid) < 0);
+    virt_error_check(virDomainGetUUIDString(this->_handle->Get(), uuid) < 0);
     return Napi::String::New(Env(), uuid, VIR_UUID_STRING_BUFLEN - 1);
 }
 
+Napi::Value Domain::GetHandle(const Napi::CallbackInfo &info) {
+    assert(this->_handle->Get(), "Domain not defined");
+    auto env = info.Env();
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    virt_error_check(virDomainGetUUIDString(this->_handle->Get(), uuid) < 0);
+    /* Formatted locally, no call to the daemon */
+    auto uri = virConnectGetURI(virDomainGetConnect(this->_handle->Get()));
+    virt_error_check(!uri);
+    auto handle = Napi::Object::New(env);
+    handle.Set("uri", Napi::String::New(env, uri));
+    handle.Set("uuid", Napi::String::New(env, uuid, VIR_UUID_STRING_BUFLEN - 1));
+    free(uri);
+    return handle;
+}
+
 //endregion
 //endregion
 
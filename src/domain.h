@@ -10,6 +10,76 @@
 #include <libvirt/virterror.h>
 #include <libvirt/libvirt-domain.h>
 
+#include "connection_pool.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class DomainRegistry;
+
+/**
+ * libvirt handle of a Domain wrapper, shared with the workers using it.
+ *
+ * After a reconnect the handle still belongs to the dropped connection. Workers call Acquire, which looks the domain
+ * up again by UUID on the pool's primary connection, so the lookup never blocks the JavaScript thread and the
+ * wrapper picks up the fresh handle. Replaced handles are kept until the last owner goes away, pointers read with
+ * Get stay valid meanwhile.
+ */
+class DomainHandle : public std::enable_shared_from_this<DomainHandle> {
+public:
+    /**
+     * Takes ownership of domainPtr, which may be null for a wrapper without handle.
+     */
+    explicit DomainHandle(virDomainPtr domainPtr) : _domain(domainPtr) {}
+
+    DomainHandle(const DomainHandle &) = delete;
+
+    DomainHandle &operator=(const DomainHandle &) = delete;
+
+    ~DomainHandle();
+
+    void SetPool(std::weak_ptr<ConnectionPool> pool);
+
+    /**
+     * Current handle without taking a reference, does not block.
+     */
+    virDomainPtr Get();
+
+    /**
+     * Lease a connection of the pool for the duration of a worker's calls, so they count against its in-flight cap
+     * and queue. Take it before Acquire; the lease keeps the pool alive and is null once the pool is gone. Blocks,
+     * throws std::runtime_error like ConnectionPool::Acquire.
+     */
+    std::shared_ptr<ConnectionPool::Lease> LeaseConnection();
+
+    /**
+     * Referenced handle for a worker, rebound first if its connection dropped. Blocks on the lookup, release the
+     * handle with virDomainFree.
+     */
+    virDomainPtr Acquire();
+
+    /**
+     * Rebind on the executor if the connection dropped, for callers on the JavaScript thread.
+     */
+    void RefreshInBackground();
+
+    /**
+     * Offer a fresh handle of the same domain, takes ownership of domainPtr.
+     * It replaces the current handle only if that one belongs to a dropped connection.
+     */
+    void Offer(virDomainPtr domainPtr);
+
+private:
+    std::mutex _mutex;
+    virDomainPtr _domain;
+    std::vector<virDomainPtr> _retired;
+    std::weak_ptr<ConnectionPool> _pool;
+    std::atomic<bool> _refreshing{false};
+};
+
 class Domain : public Napi::ObjectWrap<Domain> {
 
 public:
@@ -22,6 +92,26 @@ public:
 
     ~Domain() override;
 
+    /**
+     * Register the wrapper in the identity map of its hypervisor, it is removed again on destruction.
+     */
+    void Track(std::shared_ptr<DomainRegistry> registry, const std::string &key);
+
+    void Untrack();
+
+    /**
+     * Handle shared with a worker, which calls DomainHandle::Acquire on its own thread so the wrapper may be
+     * collected meanwhile.
+     */
+    std::shared_ptr<DomainHandle> SharedHandle() {
+        return this->_handle;
+    }
+
+    /**
+     * Offer a fresh handle of the same domain, takes ownership of domainPtr.
+     * It replaces the current handle only if that one belongs to a dropped connection.
+     */
+    void ReplaceHandle(virDomainPtr domainPtr);
 
 private:
 
@@ -34,11 +124,24 @@ private:
     Napi::Value Name(const Napi::CallbackInfo &info);
 
     Napi::Value UUIDString(const Napi::CallbackInfo &info);
+
+    /**
+     * Plain { uri, uuid } identifying the domain, can be posted to another worker_thread and resolved there with
+     * Hypervisor.domainFromHandle.
+     */
+    Napi::Value GetHandle(const Napi::CallbackInfo &info);
+
+    /**
+     * Write virDomainInfo into a Float64Array / BigUint64Array using the DomainInfoSlot layout, no objects are created.
+     * @param info target, offset? (element index, defaults to 0)
+     * @return offset of the next record
+     */
+    Napi::Value InfoInto(const Napi::CallbackInfo &info);
 //endregion
 
 //region INSTANCE METHODS
 
-    void Shutdown(const Napi::CallbackInfo &info);
+    Napi::Value Shutdown(const Napi::CallbackInfo &info);
 
     /**
      * Launch a defined domain. If the call succeeds the domain moves from the defined to the running domains pools.
@@ -59,12 +162,155 @@ private:
      * | [domain](https://libvirt.org/acl.html#object_domain) | [start](https://libvirt.org/acl.html#perm_domain_start) |x    |
      *
      * @param info
+     * @return Promise<void>
      */
-    void Create(const Napi::CallbackInfo &info);
+    Napi::Value Create(const Napi::CallbackInfo &info);
 
-    void Save(const Napi::CallbackInfo &info);
+    /**
+     * Suspend the domain and write its memory to a file, runs on a worker thread as it can take minutes.
+     * The params form uses virDomainSaveParams, for parallel channels (VIR_DOMAIN_SAVE_PARALLEL) and image format.
+     * @param info filename, dxml?, flags?, options? | params, flags?, options?;
+     * options { onProgress?, progressIntervalMs?, signal?, timeoutMs? }
+     * @return Promise<void>
+     */
+    Napi::Value Save(const Napi::CallbackInfo &info);
 
     Napi::Value ToXML(const Napi::CallbackInfo &info);
+
+    /**
+     * Evaluate XPath selectors against the domain XML on a worker thread, only the selected values cross into
+     * JavaScript. Node sets resolve to arrays of their string values, other expressions to a string, number or boolean.
+     * @param info selectors ({ key: xpath } or xpath[]), flags? (virDomainXMLFlags)
+     * @return Promise<Record<string, string[] | string | number | boolean>>
+     */
+    Napi::Value QueryXML(const Napi::CallbackInfo &info);
+
+    /**
+     * Open a non-blocking stream to the guest console or serial device.
+     * @param info devName? (console/serial alias, defaults to the first console), flags? (virDomainConsoleFlags)
+     * @return Promise<Stream>
+     */
+    Napi::Value OpenConsole(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainBlockStatsFlags, fields in camelCase (rdOperations, wrBytes, flushTotalTimes, ...).
+     * Use Hypervisor::CreateIoSampler to follow rates of many disks.
+     * @param info disk (target or source path), flags? (virDomainStatsFlags), options?
+     * @return Promise<Record<string, number>>
+     */
+    Napi::Value BlockStats(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainInterfaceStats, unsupported counters are -1.
+     * @param info device (vnet0 or MAC address), options?
+     * @return Promise<InterfaceStats>
+     */
+    Napi::Value InterfaceStats(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainInterfaceAddresses. The agent and ARP sources need a running domain.
+     * @param info source? ("lease" (default), "agent" or "arp"), options?
+     * @return Promise<{ name, hwaddr, addrs: { type, addr, prefix }[] }[]>
+     */
+    Napi::Value InterfaceAddresses(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainGetCPUStats in nanoseconds, fields in camelCase (cpuTime, userTime, systemTime, vcpuTime).
+     * @param info startCpu? (-1 for the totals, the default), ncpus? (defaults to the remaining host CPUs), flags?,
+     * options?
+     * @return Promise<object> for the totals, Promise<object[]> per host CPU otherwise
+     */
+    Napi::Value CPUStats(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainGetVcpus, host CPU and affinity of every vCPU of a running domain.
+     * @param info options?
+     * @return Promise<{ number, state, cpuTime, cpu, affinity: number[] }[]>
+     */
+    Napi::Value Vcpus(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainGetVcpuPinInfo, host CPUs every vCPU may run on.
+     * @param info flags? (virDomainModificationImpact), options?
+     * @return Promise<number[][]>
+     */
+    Napi::Value VcpuPinInfo(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainMigrateToURI3 on a worker thread. While it runs, virDomainGetJobStats is sampled on a separate
+     * thread and passed to onProgress, so the caller can adjust downtime and bandwidth. Cancelling aborts the job.
+     * @param info dconnuri | null, params? (camelCase migration parameters), flags? (virDomainMigrateFlags),
+     * options? { onProgress?, progressIntervalMs? (default 1000), signal?, timeoutMs? }
+     * @return Promise<JobStats> statistics of the completed job
+     */
+    Napi::Value Migrate(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info flags? (virDomainGetJobStatsFlags)
+     * @return Promise<JobStats>
+     */
+    Napi::Value JobStats(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info downtime (ms), flags?
+     * @return Promise<void>
+     */
+    Napi::Value MigrateSetMaxDowntime(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info bandwidth (MiB/s), flags? (virDomainMigrateMaxSpeedFlags)
+     * @return Promise<void>
+     */
+    Napi::Value MigrateSetMaxSpeed(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainMemoryStats in the MemoryStatSlot layout, NaN for stats the guest did not report.
+     * The balloon driver only refreshes most of them when a stats period is set.
+     * @param info options?
+     * @return Promise<Float64Array>
+     */
+    Napi::Value MemoryStats(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainSetMemoryFlags, resizes the balloon of a running domain.
+     * @param info memory (KiB), flags? (virDomainMemoryModFlags), options?
+     * @return Promise<void>
+     */
+    Napi::Value SetMemory(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainSetMemoryStatsPeriod, 0 disables the balloon stats collection.
+     * @param info period (seconds), flags? (virDomainMemoryModFlags), options?
+     * @return Promise<void>
+     */
+    Napi::Value SetMemoryStatsPeriod(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainSnapshotCreateXML on the bulk lane, memory snapshots can take a while.
+     * @param info xml (domainsnapshot document), flags? (virDomainSnapshotCreateFlags), options?
+     * @return Promise<DomainSnapshot> with the details of the new snapshot
+     */
+    Napi::Value CreateSnapshot(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainListAllSnapshots as a tree: parents before children, with parent and children names.
+     * The snapshot XML is only fetched with details or xml.
+     * @param info options? { flags? (virDomainSnapshotListFlags), details?, xml?, signal?, timeoutMs? }
+     * @return Promise<DomainSnapshot[]>
+     */
+    Napi::Value ListSnapshots(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info name, flags? (virDomainSnapshotRevertFlags), options?
+     * @return Promise<void>
+     */
+    Napi::Value RevertToSnapshot(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info name, flags? (virDomainSnapshotDeleteFlags), options?
+     * @return Promise<void>
+     */
+    Napi::Value DeleteSnapshot(const Napi::CallbackInfo &info);
     //endregion
 
 private:
@@ -78,7 +324,7 @@ private:
      *
      * A previous definition for this domain with the same UUID and name would be overridden if it already exists.
      * @param info
-     * @return Domain
+     * @return Promise<Domain>
      */
     static Napi::Value DefineXML(const Napi::CallbackInfo &info);
 
@@ -89,8 +335,15 @@ private:
 //endregion
 
 private:
-    virDomainPtr _domain = nullptr;
+    /**
+     * Handle for the synchronous accessors, a handle of a dropped connection is rebound in the background.
+     */
+    virDomainPtr Current();
+
+    std::shared_ptr<DomainHandle> _handle;
 
+    std::shared_ptr<DomainRegistry> _registry;
+    std::string _registryKey;
 };
 
 
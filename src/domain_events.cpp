@@ -0,0 +1,281 @@
+//
+// Created by root on 3/9/24.
+//
+
+#include "domain_events.h"
+#include "helper/libvirt_error.h"
+
+#include <chrono>
+
+#include <libvirt/virterror.h>
+
+//region CALLBACKS
+
+static const struct {
+    int id;
+    const char *name;
+} eventTypes[] = {
+        {VIR_DOMAIN_EVENT_ID_LIFECYCLE,       "lifecycle"},
+        {VIR_DOMAIN_EVENT_ID_REBOOT,          "reboot"},
+        {VIR_DOMAIN_EVENT_ID_WATCHDOG,        "watchdog"},
+        {VIR_DOMAIN_EVENT_ID_IO_ERROR_REASON, "ioError"},
+        {VIR_DOMAIN_EVENT_ID_DEVICE_REMOVED,  "deviceRemoved"},
+};
+
+static const char *EventTypeName(int id) {
+    for (const auto &type: eventTypes) {
+        if (type.id == id) return type.name;
+    }
+    return "unknown";
+}
+
+static DomainEvent MakeEvent(int type, virDomainPtr dom) {
+    DomainEvent event;
+    event.type = type;
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    if (virDomainGetUUIDString(dom, uuid) == 0) {
+        event.uuid = uuid;
+    }
+    auto name = virDomainGetName(dom);
+    event.name = name ? name : "";
+    event.id = static_cast<int>(virDomainGetID(dom));
+    event.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    return event;
+}
+
+static int LifecycleCallback(virConnectPtr, virDomainPtr dom, int event, int detail, void *opaque) {
+    auto domainEvent = MakeEvent(VIR_DOMAIN_EVENT_ID_LIFECYCLE, dom);
+    domainEvent.event = event;
+    domainEvent.detail = detail;
+    static_cast<DomainEventSubscription *>(opaque)->Push(std::move(domainEvent));
+    return 0;
+}
+
+static void RebootCallback(virConnectPtr, virDomainPtr dom, void *opaque) {
+    static_cast<DomainEventSubscription *>(opaque)->Push(MakeEvent(VIR_DOMAIN_EVENT_ID_REBOOT, dom));
+}
+
+static void WatchdogCallback(virConnectPtr, virDomainPtr dom, int action, void *opaque) {
+    auto domainEvent = MakeEvent(VIR_DOMAIN_EVENT_ID_WATCHDOG, dom);
+    domainEvent.event = action;
+    static_cast<DomainEventSubscription *>(opaque)->Push(std::move(domainEvent));
+}
+
+static void IOErrorCallback(virConnectPtr, virDomainPtr dom, const char *srcPath, const char *devAlias, int action,
+                            const char *reason, void *opaque) {
+    auto domainEvent = MakeEvent(VIR_DOMAIN_EVENT_ID_IO_ERROR_REASON, dom);
+    domainEvent.event = action;
+    domainEvent.srcPath = srcPath ? srcPath : "";
+    domainEvent.devAlias = devAlias ? devAlias : "";
+    domainEvent.reason = reason ? reason : "";
+    static_cast<DomainEventSubscription *>(opaque)->Push(std::move(domainEvent));
+}
+
+static void DeviceRemovedCallback(virConnectPtr, virDomainPtr dom, const char *devAlias, void *opaque) {
+    auto domainEvent = MakeEvent(VIR_DOMAIN_EVENT_ID_DEVICE_REMOVED, dom);
+    domainEvent.devAlias = devAlias ? devAlias : "";
+    static_cast<DomainEventSubscription *>(opaque)->Push(std::move(domainEvent));
+}
+
+static virConnectDomainEventGenericCallback CallbackFor(int id) {
+    switch (id) {
+        case VIR_DOMAIN_EVENT_ID_LIFECYCLE:
+            return VIR_DOMAIN_EVENT_CALLBACK(LifecycleCallback);
+        case VIR_DOMAIN_EVENT_ID_REBOOT:
+            return VIR_DOMAIN_EVENT_CALLBACK(RebootCallback);
+        case VIR_DOMAIN_EVENT_ID_WATCHDOG:
+            return VIR_DOMAIN_EVENT_CALLBACK(WatchdogCallback);
+        case VIR_DOMAIN_EVENT_ID_IO_ERROR_REASON:
+            return VIR_DOMAIN_EVENT_CALLBACK(IOErrorCallback);
+        case VIR_DOMAIN_EVENT_ID_DEVICE_REMOVED:
+            return VIR_DOMAIN_EVENT_CALLBACK(DeviceRemovedCallback);
+        default:
+            return nullptr;
+    }
+}
+
+//endregion
+
+DomainEventSubscription::DomainEventSubscription(Napi::Env env, const Napi::Function &listener, virConnectPtr conn,
+                                                 Options options)
+        : _conn(conn), _options(std::move(options)) {
+    _tsfn = Napi::ThreadSafeFunction::New(env, listener, "libvirt.domainEvents", 0, 1,
+                                          [this](Napi::Env) { delete this; });
+}
+
+DomainEventSubscription::Options DomainEventSubscription::ParseOptions(const Napi::Value &value) {
+    Options options;
+    if (value.IsObject()) {
+        auto obj = value.ToObject();
+        if (obj.Get("maxQueue").IsNumber()) {
+            auto maxQueue = obj.Get("maxQueue").ToNumber().Int64Value();
+            options.maxQueue = maxQueue > 0 ? static_cast<size_t>(maxQueue) : 1;
+        }
+        if (obj.Get("coalesce").IsBoolean()) {
+            options.coalesce = obj.Get("coalesce").ToBoolean();
+        }
+        auto events = obj.Get("events");
+        if (events.IsArray()) {
+            auto array = events.As<Napi::Array>();
+            for (uint32_t i = 0; i < array.Length(); i++) {
+                auto name = array.Get(i).ToString().Utf8Value();
+                for (const auto &type: eventTypes) {
+                    if (name == type.name) options.events.push_back(type.id);
+                }
+            }
+        }
+    }
+    if (options.events.empty()) {
+        for (const auto &type: eventTypes) {
+            options.events.push_back(type.id);
+        }
+    }
+    return options;
+}
+
+std::string DomainEventSubscription::Register() {
+    std::lock_guard<std::mutex> lock(_registration);
+    return RegisterCallbacks();
+}
+
+std::string DomainEventSubscription::RegisterCallbacks() {
+    for (int id: _options.events) {
+        _registered++;
+        int callbackId = virConnectDomainEventRegisterAny(_conn, nullptr, id, CallbackFor(id), this,
+                                                          DomainEventSubscription::FreeCallback);
+        if (callbackId < 0) {
+            _registered--;
+            return LastErrorMessage("Failed to register domain event callback");
+        }
+        _callbackIds.push_back(callbackId);
+    }
+    return "";
+}
+
+std::string DomainEventSubscription::Rebind(virConnectPtr conn) {
+    std::lock_guard<std::mutex> lock(_registration);
+    if (_released) return "";
+    auto oldConn = _conn;
+    std::vector<int> oldIds;
+    oldIds.swap(_callbackIds);
+    /* Register on the new connection first so the registration count never drops to zero in between */
+    _conn = conn;
+    auto error = RegisterCallbacks();
+    for (int callbackId: oldIds) {
+        virConnectDomainEventDeregisterAny(oldConn, callbackId);
+    }
+    virResetLastError();
+    return error;
+}
+
+void DomainEventSubscription::Deregister() {
+    std::lock_guard<std::mutex> lock(_registration);
+    for (int callbackId: _callbackIds) {
+        virConnectDomainEventDeregisterAny(_conn, callbackId);
+    }
+    _callbackIds.clear();
+    /* Without registered callbacks no FreeCallback will come to release the function */
+    if (_registered == 0) {
+        Release();
+    }
+}
+
+void DomainEventSubscription::FreeCallback(void *opaque) {
+    auto subscription = static_cast<DomainEventSubscription *>(opaque);
+    if (--subscription->_registered == 0) {
+        subscription->Release();
+    }
+}
+
+void DomainEventSubscription::Release() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_released) return;
+        _released = true;
+    }
+    _tsfn.Release();
+}
+
+void DomainEventSubscription::Push(DomainEvent &&event) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_released) return;
+
+    if (_options.coalesce) {
+        event.key = std::to_string(event.type) + ':' + event.uuid + ':' + std::to_string(event.event) + ':' +
+                    std::to_string(event.detail) + ':' + event.devAlias + ':' + event.srcPath;
+        auto pending = _pending.find(event.key);
+        if (pending != _pending.end()) {
+            pending->second->count++;
+            pending->second->timestamp = event.timestamp;
+            pending->second->id = event.id;
+            return;
+        }
+    }
+
+    if (_queue.size() >= _options.maxQueue) {
+        if (_options.coalesce) _pending.erase(_queue.front().key);
+        _queue.pop_front();
+        _dropped++;
+    }
+    _queue.push_back(std::move(event));
+    if (_options.coalesce) _pending[_queue.back().key] = &_queue.back();
+
+    if (!_scheduled) {
+        auto status = _tsfn.NonBlockingCall(this, [](Napi::Env env, Napi::Function listener,
+                                                     DomainEventSubscription *subscription) {
+            subscription->Drain(env, listener);
+        });
+        /* Queue full or closing: the events stay queued and the next one tries again */
+        _scheduled = status == napi_ok;
+    }
+}
+
+void DomainEventSubscription::Drain(Napi::Env env, Napi::Function listener) {
+    std::deque<DomainEvent> events;
+    uint64_t dropped;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        events.swap(_queue);
+        _pending.clear();
+        dropped = _dropped;
+        _dropped = 0;
+        _scheduled = false;
+    }
+    if (env == nullptr || listener.IsEmpty()) return;
+
+    Napi::HandleScope scope(env);
+    auto batch = Napi::Array::New(env, events.size());
+    uint32_t i = 0;
+    for (const auto &event: events) {
+        auto obj = Napi::Object::New(env);
+        obj.Set("type", Napi::String::New(env, EventTypeName(event.type)));
+        obj.Set("uuid", Napi::String::New(env, event.uuid));
+        obj.Set("name", Napi::String::New(env, event.name));
+        obj.Set("id", Napi::Number::New(env, event.id));
+        obj.Set("timestamp", Napi::Number::New(env, static_cast<double>(event.timestamp)));
+        obj.Set("count", Napi::Number::New(env, event.count));
+        switch (event.type) {
+            case VIR_DOMAIN_EVENT_ID_LIFECYCLE:
+                obj.Set("event", Napi::Number::New(env, event.event));
+                obj.Set("detail", Napi::Number::New(env, event.detail));
+                break;
+            case VIR_DOMAIN_EVENT_ID_WATCHDOG:
+                obj.Set("action", Napi::Number::New(env, event.event));
+                break;
+            case VIR_DOMAIN_EVENT_ID_IO_ERROR_REASON:
+                obj.Set("action", Napi::Number::New(env, event.event));
+                obj.Set("srcPath", Napi::String::New(env, event.srcPath));
+                obj.Set("devAlias", Napi::String::New(env, event.devAlias));
+                obj.Set("reason", Napi::String::New(env, event.reason));
+                break;
+            case VIR_DOMAIN_EVENT_ID_DEVICE_REMOVED:
+                obj.Set("devAlias", Napi::String::New(env, event.devAlias));
+                break;
+            default:
+                break;
+        }
+        batch.Set(i++, obj);
+    }
+    listener.Call({batch, Napi::Number::New(env, static_cast<double>(dropped))});
+}
@@ -0,0 +1,111 @@
+//
+// Created by root on 3/9/24.
+//
+
+#ifndef NODE_LIBVIRT_DOMAIN_EVENTS_H
+#define NODE_LIBVIRT_DOMAIN_EVENTS_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct DomainEvent {
+    /** virDomainEventID */
+    int type = 0;
+    std::string uuid;
+    std::string name;
+    int id = -1;
+    /** lifecycle event/detail, watchdog and io-error action */
+    int event = 0;
+    int detail = 0;
+    /** io-error source path and device alias, removed device alias */
+    std::string srcPath;
+    std::string devAlias;
+    std::string reason;
+    /** Milliseconds since epoch of the latest occurrence */
+    uint64_t timestamp = 0;
+    /** Number of identical events folded into this one */
+    uint32_t count = 1;
+    /** Coalescing key */
+    std::string key;
+};
+
+/**
+ * Domain event subscription of one connection.
+ *
+ * libvirt invokes the callbacks on the event loop thread, events are queued there and handed to JavaScript in
+ * batches through a ThreadSafeFunction: at most one delivery is scheduled at a time, so a burst arriving while
+ * JavaScript is busy ends up in a single listener call. Identical events waiting in the queue are coalesced and
+ * the queue is bounded, the oldest events are dropped once it is full and the count reported to the listener.
+ */
+class DomainEventSubscription {
+public:
+    struct Options {
+        std::vector<int> events;
+        size_t maxQueue = 1024;
+        bool coalesce = true;
+    };
+
+    /**
+     * Must be called on the JavaScript thread.
+     * The subscription deletes itself once all callbacks are deregistered and the last batch was delivered.
+     */
+    DomainEventSubscription(Napi::Env env, const Napi::Function &listener, virConnectPtr conn, Options options);
+
+    /**
+     * Register the libvirt callbacks, may block on the connection so call it from a worker.
+     * @return error message, empty on success
+     */
+    std::string Register();
+
+    /**
+     * Remove the libvirt callbacks, may block on the connection so call it from a worker.
+     */
+    void Deregister();
+
+    /**
+     * Move the callbacks to a new connection after a reconnect, callbacks on the old one are dropped.
+     * @return error message, empty on success
+     */
+    std::string Rebind(virConnectPtr conn);
+
+    static Options ParseOptions(const Napi::Value &value);
+
+    void Push(DomainEvent &&event);
+
+private:
+    ~DomainEventSubscription() = default;
+
+    void Drain(Napi::Env env, Napi::Function listener);
+
+    std::string RegisterCallbacks();
+
+    void Release();
+
+    static void FreeCallback(void *opaque);
+
+    virConnectPtr _conn;
+    Options _options;
+    Napi::ThreadSafeFunction _tsfn;
+
+    /** Serializes Register, Deregister and Rebind */
+    std::mutex _registration;
+    std::vector<int> _callbackIds;
+    std::atomic<int> _registered{0};
+    std::atomic<bool> _released{false};
+
+    std::mutex _mutex;
+    std::deque<DomainEvent> _queue;
+    std::unordered_map<std::string, DomainEvent *> _pending;
+    uint64_t _dropped = 0;
+    bool _scheduled = false;
+};
+
+#endif //NODE_LIBVIRT_DOMAIN_EVENTS_H
@@ -0,0 +1,229 @@
+//
+// Created by root on 3/30/24.
+//
+
+#include "domain_registry.h"
+#include "domain.h"
+
+#include <cctype>
+
+//region HELPERS
+
+/**
+ * Parse a UUID string into the 16 byte key, empty on malformed input.
+ */
+static std::string RawUUID(const std::string &uuid) {
+    std::string raw;
+    int high = -1;
+    for (char c: uuid) {
+        if (c == '-') continue;
+        if (!std::isxdigit(static_cast<unsigned char>(c))) return "";
+        int nibble = std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                                                                : std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+        if (high < 0) {
+            high = nibble;
+        } else {
+            raw.push_back(static_cast<char>((high << 4) | nibble));
+            high = -1;
+        }
+    }
+    return raw.size() == VIR_UUID_BUFLEN && high < 0 ? raw : "";
+}
+
+//endregion
+
+Napi::Object DomainRegistry::Wrap(Napi::Env env, virDomainPtr domainPtr) {
+    ApplyInvalidations();
+
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(domainPtr, uuid) < 0) {
+        return Domain::New(env, {Napi::External<virDomain>::New(env, domainPtr)});
+    }
+    std::string key(reinterpret_cast<const char *>(uuid), VIR_UUID_BUFLEN);
+
+    auto entry = Find(key);
+    if (entry) {
+        Index(key, *entry, domainPtr);
+        /* A wrapper from before a reconnect takes the fresh handle */
+        entry->domain->ReplaceHandle(domainPtr);
+        return entry->ref.Value();
+    }
+
+    auto obj = Domain::New(env, {Napi::External<virDomain>::New(env, domainPtr)});
+    auto domain = Napi::ObjectWrap<Domain>::Unwrap(obj);
+    domain->Track(shared_from_this(), key);
+
+    auto &created = _entries[key];
+    created.ref = Napi::Weak(obj);
+    created.domain = domain;
+    Index(key, created, domainPtr);
+    return obj;
+}
+
+Napi::Value DomainRegistry::FindByUUIDString(const std::string &uuid) {
+    ApplyInvalidations();
+    auto entry = Find(RawUUID(uuid));
+    if (!entry || !entry->valid) return {};
+    return entry->ref.Value();
+}
+
+Napi::Value DomainRegistry::FindByName(const std::string &name) {
+    ApplyInvalidations();
+    auto key = _byName.find(name);
+    if (key == _byName.end()) return {};
+    auto entry = Find(key->second);
+    if (!entry || !entry->valid) return {};
+    return entry->ref.Value();
+}
+
+Napi::Value DomainRegistry::FindById(int id) {
+    ApplyInvalidations();
+    auto key = _byId.find(id);
+    if (key == _byId.end()) return {};
+    auto entry = Find(key->second);
+    if (!entry || !entry->valid) return {};
+    return entry->ref.Value();
+}
+
+void DomainRegistry::Forget(const std::string &key, Domain *domain) {
+    auto entry = _entries.find(key);
+    if (entry == _entries.end() || entry->second.domain != domain) return;
+    Unindex(entry->second);
+    _entries.erase(entry);
+}
+
+void DomainRegistry::Invalidate(const std::string &key, bool removed) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _invalidations.emplace_back(key, removed);
+}
+
+void DomainRegistry::Clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _invalidations.clear();
+    _cleared = true;
+}
+
+void DomainRegistry::Subscribe(virConnectPtr conn) {
+    std::lock_guard<std::mutex> lock(_subscriptionMutex);
+    _subscribed = true;
+    DeregisterCallback(conn);
+    RegisterCallback(conn);
+}
+
+void DomainRegistry::Rebind(virConnectPtr oldConn, virConnectPtr newConn) {
+    std::lock_guard<std::mutex> lock(_subscriptionMutex);
+    DeregisterCallback(oldConn);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stale = true;
+    }
+    if (_subscribed) RegisterCallback(newConn);
+}
+
+void DomainRegistry::Unsubscribe(virConnectPtr conn) {
+    {
+        std::lock_guard<std::mutex> lock(_subscriptionMutex);
+        _subscribed = false;
+        DeregisterCallback(conn);
+    }
+    Clear();
+}
+
+void DomainRegistry::RegisterCallback(virConnectPtr conn) {
+    /* The callback keeps the registry alive until libvirt releases it */
+    auto opaque = new std::shared_ptr<DomainRegistry>(shared_from_this());
+    _callbackId = virConnectDomainEventRegisterAny(
+            conn, nullptr, VIR_DOMAIN_EVENT_ID_LIFECYCLE, VIR_DOMAIN_EVENT_CALLBACK(DomainRegistry::LifecycleCallback),
+            opaque, [](void *opaque) { delete static_cast<std::shared_ptr<DomainRegistry> *>(opaque); });
+    if (_callbackId < 0) {
+        delete opaque;
+        virResetLastError();
+    }
+    _tracking = _callbackId >= 0;
+}
+
+void DomainRegistry::DeregisterCallback(virConnectPtr conn) {
+    _tracking = false;
+    if (_callbackId < 0) return;
+    virConnectDomainEventDeregisterAny(conn, _callbackId);
+    virResetLastError();
+    _callbackId = -1;
+}
+
+int DomainRegistry::LifecycleCallback(virConnectPtr, virDomainPtr dom, int event, int, void *opaque) {
+    auto registry = *static_cast<std::shared_ptr<DomainRegistry> *>(opaque);
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    if (virDomainGetUUID(dom, uuid) == 0) {
+        registry->Invalidate(std::string(reinterpret_cast<const char *>(uuid), VIR_UUID_BUFLEN),
+                             event == VIR_DOMAIN_EVENT_UNDEFINED);
+    }
+    return 0;
+}
+
+void DomainRegistry::ApplyInvalidations() {
+    std::vector<std::pair<std::string, bool>> invalidations;
+    bool cleared;
+    bool stale;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        invalidations.swap(_invalidations);
+        cleared = _cleared;
+        _cleared = false;
+        stale = _stale;
+        _stale = false;
+    }
+    if (stale) {
+        for (auto &entry: _entries) {
+            entry.second.valid = false;
+        }
+        _byName.clear();
+        _byId.clear();
+    }
+    if (cleared) {
+        /* Wrappers stay alive on their own, they just aren't handed out again */
+        for (auto &entry: _entries) {
+            entry.second.domain->Untrack();
+        }
+        _entries.clear();
+        _byName.clear();
+        _byId.clear();
+    }
+    for (const auto &invalidation: invalidations) {
+        auto entry = _entries.find(invalidation.first);
+        if (entry == _entries.end()) continue;
+        Unindex(entry->second);
+        if (invalidation.second) {
+            entry->second.domain->Untrack();
+            _entries.erase(entry);
+        } else {
+            entry->second.valid = false;
+        }
+    }
+}
+
+DomainRegistry::Entry *DomainRegistry::Find(const std::string &key) {
+    auto entry = _entries.find(key);
+    if (entry == _entries.end() || entry->second.ref.Value().IsEmpty()) return nullptr;
+    return &entry->second;
+}
+
+void DomainRegistry::Index(const std::string &key, Entry &entry, virDomainPtr domainPtr) {
+    Unindex(entry);
+    auto name = virDomainGetName(domainPtr);
+    entry.name = name ? name : "";
+    entry.id = static_cast<int>(virDomainGetID(domainPtr));
+    entry.valid = _tracking;
+    if (!entry.name.empty()) _byName[entry.name] = key;
+    if (entry.id >= 0) _byId[entry.id] = key;
+}
+
+void DomainRegistry::Unindex(Entry &entry) {
+    auto name = _byName.find(entry.name);
+    if (name != _byName.end() && _entries.count(name->second) && &_entries[name->second] == &entry) {
+        _byName.erase(name);
+    }
+    auto id = _byId.find(entry.id);
+    if (id != _byId.end() && _entries.count(id->second) && &_entries[id->second] == &entry) {
+        _byId.erase(id);
+    }
+}
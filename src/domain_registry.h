@@ -0,0 +1,131 @@
+//
+// Created by root on 3/30/24.
+//
+
+#ifndef NODE_LIBVIRT_DOMAIN_REGISTRY_H
+#define NODE_LIBVIRT_DOMAIN_REGISTRY_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Domain;
+
+class ConnectionPool;
+
+/**
+ * Identity map of the Domain wrappers of one Hypervisor, keyed by raw UUID.
+ *
+ * Wrapping a domain that already has a live wrapper returns that wrapper and drops the new virDomainPtr, so a
+ * guest is represented by one JavaScript object. Entries hold weak references and are removed when the wrapper is
+ * collected. The registry follows lifecycle events on the primary connection: any event marks the entry stale and
+ * UNDEFINED removes it. Only entries that are still valid answer lookups without a libvirt call.
+ *
+ * All methods except Invalidate, Clear and the event callback must be called on the JavaScript thread.
+ */
+class DomainRegistry : public std::enable_shared_from_this<DomainRegistry> {
+public:
+    explicit DomainRegistry(std::weak_ptr<ConnectionPool> pool = std::weak_ptr<ConnectionPool>()) : _pool(pool) {}
+
+    /**
+     * Pool of the owning hypervisor, wrappers use it to rebind their handle after a reconnect.
+     */
+    std::shared_ptr<ConnectionPool> Pool() const {
+        return _pool.lock();
+    }
+
+    /**
+     * Return the wrapper of the domain, takes ownership of domainPtr.
+     */
+    Napi::Object Wrap(Napi::Env env, virDomainPtr domainPtr);
+
+    /**
+     * Cached wrapper or an empty value when the domain is not known or may have changed.
+     */
+    Napi::Value FindByUUIDString(const std::string &uuid);
+
+    Napi::Value FindByName(const std::string &name);
+
+    Napi::Value FindById(int id);
+
+    /**
+     * Called by the Domain destructor.
+     */
+    void Forget(const std::string &key, Domain *domain);
+
+    /**
+     * Thread safe, applied on the next call from the JavaScript thread.
+     */
+    void Invalidate(const std::string &key, bool removed);
+
+    void Clear();
+
+    /**
+     * Follow lifecycle events of the connection, blocks so call it from a worker.
+     * Without a subscription cached wrappers are still reused but lookups always go to libvirt.
+     */
+    void Subscribe(virConnectPtr conn);
+
+    void Unsubscribe(virConnectPtr conn);
+
+    /**
+     * Follow the new primary connection after a reconnect, blocks so call it from a worker.
+     * All entries become stale as events may have been missed while disconnected. Does not subscribe a registry
+     * that was never subscribed or already unsubscribed.
+     */
+    void Rebind(virConnectPtr oldConn, virConnectPtr newConn);
+
+    size_t Size() const {
+        return _entries.size();
+    }
+
+private:
+    struct Entry {
+        Napi::ObjectReference ref;
+        Domain *domain = nullptr;
+        std::string name;
+        int id = -1;
+        bool valid = false;
+    };
+
+    void ApplyInvalidations();
+
+    Entry *Find(const std::string &key);
+
+    void Index(const std::string &key, Entry &entry, virDomainPtr domainPtr);
+
+    void Unindex(Entry &entry);
+
+    static int LifecycleCallback(virConnectPtr conn, virDomainPtr dom, int event, int detail, void *opaque);
+
+    /**
+     * Called with _subscriptionMutex held.
+     */
+    void RegisterCallback(virConnectPtr conn);
+
+    void DeregisterCallback(virConnectPtr conn);
+
+    std::unordered_map<std::string, Entry> _entries;
+    std::unordered_map<std::string, std::string> _byName;
+    std::unordered_map<int, std::string> _byId;
+
+    std::mutex _mutex;
+    std::vector<std::pair<std::string, bool>> _invalidations;
+    bool _cleared = false;
+    bool _stale = false;
+    std::weak_ptr<ConnectionPool> _pool;
+    std::atomic<bool> _tracking{false};
+
+    /** Serializes Subscribe, Unsubscribe and Rebind, which run on different threads */
+    std::mutex _subscriptionMutex;
+    bool _subscribed = false;
+    int _callbackId = -1;
+};
+
+#endif //NODE_LIBVIRT_DOMAIN_REGISTRY_H
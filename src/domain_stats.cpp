@@ -0,0 +1,115 @@
+//
+// Created by root on 3/2/24.
+//
+
+#include "domain_stats.h"
+#include "helper/libvirt_error.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include <libvirt/virterror.h>
+
+//region HELPERS
+
+/**
+ * Join a dotted/underscored libvirt field name into camelCase: `rd.total.times` -> `rdTotalTimes`.
+ */
+static std::string CamelCase(const std::string &field) {
+    std::string result;
+    result.reserve(field.size());
+    bool upper = false;
+    for (char c: field) {
+        if (c == '.' || c == '_' || c == '-') {
+            upper = !result.empty();
+            continue;
+        }
+        result.push_back(upper ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : c);
+        upper = false;
+    }
+    return result;
+}
+
+static bool IsIndex(const std::string &segment) {
+    if (segment.empty()) return false;
+    for (char c: segment) {
+        if (!std::isdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+/**
+ * Name of the array holding the indexed entries of a group.
+ */
+static const char *ListName(const std::string &group) {
+    if (group == "vcpu") return "vcpus";
+    if (group == "net") return "interfaces";
+    if (group == "block") return "devices";
+    return "entries";
+}
+
+static Napi::Object GetOrCreateObject(Napi::Env env, Napi::Object parent, const std::string &key) {
+    auto value = parent.Get(key);
+    if (value.IsObject()) {
+        return value.ToObject();
+    }
+    auto obj = Napi::Object::New(env);
+    parent.Set(key, obj);
+    return obj;
+}
+
+//endregion
+
+std::vector<DomainStatsRecord> CollectAllDomainStats(virConnectPtr conn, unsigned int stats, unsigned int flags) {
+    virDomainStatsRecordPtr *records = nullptr;
+    int count = virConnectGetAllDomainStats(conn, stats, &records, flags);
+    if (count < 0) {
+        throw LibvirtError("Failed to get domain stats");
+    }
+    std::vector<DomainStatsRecord> result;
+    result.reserve(count);
+    for (int i = 0; i < count; i++) {
+        DomainStatsRecord record;
+        /* The record list owns its domain references, take our own before freeing it */
+        virDomainRef(records[i]->dom);
+        record.domain = records[i]->dom;
+        record.params = CopyTypedParams(records[i]->params, records[i]->nparams);
+        result.push_back(std::move(record));
+    }
+    virDomainStatsRecordListFree(records);
+    return result;
+}
+
+Napi::Object DomainStatsRecordToObject(Napi::Env env, DomainStatsRecord &record, DomainRegistry &registry) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("domain", registry.Wrap(env, record.Release()));
+
+    for (const auto &param: record.params) {
+        auto dot = param.field.find('.');
+        if (dot == std::string::npos) {
+            obj.Set(CamelCase(param.field), TypedParamToValue(env, param));
+            continue;
+        }
+        auto groupName = param.field.substr(0, dot);
+        auto rest = param.field.substr(dot + 1);
+        auto group = GetOrCreateObject(env, obj, CamelCase(groupName));
+
+        /* Indexed entries: vcpu.<n>.*, net.<n>.*, block.<n>.* */
+        auto next = rest.find('.');
+        auto head = rest.substr(0, next);
+        if (next != std::string::npos && IsIndex(head)) {
+            auto list = group.Get(ListName(groupName));
+            if (!list.IsArray()) {
+                list = Napi::Array::New(env);
+                group.Set(ListName(groupName), list);
+            }
+            auto entry = GetOrCreateObject(env, list.ToObject(), head);
+            entry.Set(CamelCase(rest.substr(next + 1)), TypedParamToValue(env, param));
+            continue;
+        }
+        group.Set(CamelCase(rest), TypedParamToValue(env, param));
+    }
+    return obj;
+}
@@ -0,0 +1,73 @@
+//
+// Created by root on 3/2/24.
+//
+
+#ifndef NODE_LIBVIRT_DOMAIN_STATS_H
+#define NODE_LIBVIRT_DOMAIN_STATS_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+#include <vector>
+
+#include "helper/typed_params.h"
+#include "domain_registry.h"
+
+/**
+ * Stats groups requested by default, see virDomainStatsTypes.
+ */
+#define DEFAULT_DOMAIN_STATS (VIR_DOMAIN_STATS_STATE | VIR_DOMAIN_STATS_CPU_TOTAL | VIR_DOMAIN_STATS_BALLOON | \
+                              VIR_DOMAIN_STATS_VCPU | VIR_DOMAIN_STATS_INTERFACE | VIR_DOMAIN_STATS_BLOCK)
+
+struct DomainStatsRecord {
+    /** Referenced domain, ownership moves to the registry in DomainStatsRecordToObject */
+    virDomainPtr domain = nullptr;
+    TypedParams params;
+
+    DomainStatsRecord() = default;
+
+    DomainStatsRecord(const DomainStatsRecord &) = delete;
+
+    DomainStatsRecord &operator=(const DomainStatsRecord &) = delete;
+
+    DomainStatsRecord(DomainStatsRecord &&other) noexcept: domain(other.domain), params(std::move(other.params)) {
+        other.domain = nullptr;
+    }
+
+    DomainStatsRecord &operator=(DomainStatsRecord &&other) noexcept {
+        if (this != &other) {
+            if (domain) virDomainFree(domain);
+            domain = other.domain;
+            other.domain = nullptr;
+            params = std::move(other.params);
+        }
+        return *this;
+    }
+
+    /** Records never converted (error, cancellation) drop their reference here */
+    ~DomainStatsRecord() {
+        if (domain) virDomainFree(domain);
+    }
+
+    /**
+     * Hand the domain reference over to the caller.
+     */
+    virDomainPtr Release() {
+        auto released = domain;
+        domain = nullptr;
+        return released;
+    }
+};
+
+/**
+ * Fetch the statistics of all domains in a single virConnectGetAllDomainStats round trip.
+ * Safe to call from a worker thread; throws std::runtime_error on failure.
+ */
+std::vector<DomainStatsRecord> CollectAllDomainStats(virConnectPtr conn, unsigned int stats, unsigned int flags);
+
+/**
+ * Convert a record into a grouped object, e.g. `block.0.rd.reqs` becomes `record.block.devices[0].rdReqs`.
+ * Must be called on the JavaScript thread.
+ */
+Napi::Object DomainStatsRecordToObject(Napi::Env env, DomainStatsRecord &record, DomainRegistry &registry);
+
+#endif //NODE_LIBVIRT_DOMAIN_STATS_H
@@ -0,0 +1,38 @@
+//
+// Created by root on 3/9/24.
+//
+
+#include "event_loop.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <libvirt/libvirt.h>
+
+static std::once_flag startOnce;
+static std::atomic<bool> running{false};
+static int startResult = 0;
+
+int EventLoop::Start() {
+    std::call_once(startOnce, []() {
+        if (virEventRegisterDefaultImpl() < 0) {
+            startResult = -1;
+            return;
+        }
+        /* The loop lives as long as the process, it is shared by every environment loading the addon */
+        std::thread(EventLoop::Run).detach();
+        running = true;
+    });
+    return startResult;
+}
+
+bool EventLoop::Running() {
+    return running;
+}
+
+void EventLoop::Run() {
+    while (true) {
+        virEventRunDefaultImpl();
+    }
+}
@@ -0,0 +1,30 @@
+//
+// Created by root on 3/9/24.
+//
+
+#ifndef NODE_LIBVIRT_EVENT_LOOP_H
+#define NODE_LIBVIRT_EVENT_LOOP_H
+
+/**
+ * Process wide libvirt event loop.
+ *
+ * libvirt dispatches domain events, stream callbacks and keepalive messages from the event loop implementation
+ * registered with virEventRegisterDefaultImpl. The loop is driven by a dedicated native thread so none of this
+ * depends on the JavaScript thread; results are handed over to JavaScript through thread-safe functions.
+ */
+class EventLoop {
+public:
+    /**
+     * Register the default implementation and spawn the loop thread, only the first call has an effect.
+     * Must happen before connections are opened so remote drivers pick up the event loop.
+     * @return 0 on success, -1 if the implementation could not be registered
+     */
+    static int Start();
+
+    static bool Running();
+
+private:
+    static void Run();
+};
+
+#endif //NODE_LIBVIRT_EVENT_LOOP_H
@@ -0,0 +1,128 @@
+//
+// Created by root on 3/23/24.
+//
+
+#include "executor.h"
+
+#include <algorithm>
+#include <thread>
+
+Executor &Executor::Instance() {
+    /* Never destroyed: detached threads may still reference it while the process exits */
+    static auto *instance = new Executor();
+    return *instance;
+}
+
+const char *Executor::LaneName(Lane lane) {
+    return lane == Lane::Fast ? "fast" : "bulk";
+}
+
+void Executor::Configure(Lane lane, size_t threads) {
+    auto &state = _lanes[static_cast<size_t>(lane)];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.targetThreads = std::max<size_t>(threads, 1);
+    if (state.liveThreads > 0) {
+        Grow(state);
+    }
+    state.available.notify_all();
+}
+
+void Executor::Submit(Lane lane, std::function<void()> &&task) {
+    auto &state = _lanes[static_cast<size_t>(lane)];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.queue.push_back({std::move(task), std::chrono::steady_clock::now()});
+    state.submitted++;
+    Grow(state);
+    state.available.notify_one();
+}
+
+Executor::LaneStats Executor::Stats(Lane lane) {
+    auto &state = _lanes[static_cast<size_t>(lane)];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return {state.liveThreads, state.queue.size(), state.running, state.detached, state.submitted, state.completed,
+            state.totalWaitMs, state.maxWaitMs, state.totalRunMs, state.maxRunMs};
+}
+
+void Executor::Detach(Lane lane) {
+    auto &state = _lanes[static_cast<size_t>(lane)];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.detached++;
+    Grow(state);
+    state.available.notify_one();
+}
+
+void Executor::Reattach(Lane lane) {
+    auto &state = _lanes[static_cast<size_t>(lane)];
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.detached > 0) state.detached--;
+    state.available.notify_all();
+}
+
+void Executor::Schedule(std::chrono::steady_clock::time_point deadline, std::function<void()> &&task) {
+    std::lock_guard<std::mutex> lock(_timerMutex);
+    _timers.emplace(deadline, std::move(task));
+    if (!_timerStarted) {
+        _timerStarted = true;
+        std::thread(&Executor::Tick, this).detach();
+    }
+    _timerChanged.notify_one();
+}
+
+void Executor::Tick() {
+    std::unique_lock<std::mutex> lock(_timerMutex);
+    while (true) {
+        if (_timers.empty()) {
+            _timerChanged.wait(lock);
+            continue;
+        }
+        auto next = _timers.begin();
+        if (next->first > std::chrono::steady_clock::now()) {
+            _timerChanged.wait_until(lock, next->first);
+            continue;
+        }
+        auto task = std::move(next->second);
+        _timers.erase(next);
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+void Executor::Grow(LaneState &lane) {
+    /* Detached threads are blocked in a cancelled task and don't count towards the capacity */
+    while (lane.liveThreads < lane.targetThreads + lane.detached) {
+        lane.liveThreads++;
+        std::thread(&Executor::Work, this, &lane).detach();
+    }
+}
+
+void Executor::Work(LaneState *lane) {
+    std::unique_lock<std::mutex> lock(lane->mutex);
+    while (true) {
+        lane->available.wait(lock, [lane]() {
+            return !lane->queue.empty() || lane->liveThreads > lane->targetThreads + lane->detached;
+        });
+        if (lane->liveThreads > lane->targetThreads + lane->detached) {
+            lane->liveThreads--;
+            return;
+        }
+
+        auto task = std::move(lane->queue.front());
+        lane->queue.pop_front();
+        lane->running++;
+        auto start = std::chrono::steady_clock::now();
+        auto waitMs = std::chrono::duration<double, std::milli>(start - task.queuedAt).count();
+        lane->totalWaitMs += waitMs;
+        lane->maxWaitMs = std::max(lane->maxWaitMs, waitMs);
+        lock.unlock();
+
+        task.run();
+
+        auto runMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        lock.lock();
+        lane->running--;
+        lane->completed++;
+        lane->totalRunMs += runMs;
+        lane->maxRunMs = std::max(lane->maxRunMs, runMs);
+    }
+}
@@ -0,0 +1,112 @@
+//
+// Created by root on 3/23/24.
+//
+
+#ifndef NODE_LIBVIRT_EXECUTOR_H
+#define NODE_LIBVIRT_EXECUTOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+
+/**
+ * Thread pool owned by the addon for blocking libvirt calls.
+ *
+ * Keeping libvirt off the libuv threadpool means slow calls cannot starve fs, dns or crypto work of the same
+ * process. Work is split into lanes with their own threads and queue, short queries (lookups, info, stats) never
+ * wait behind long running jobs (save, restore, migrate). Threads are started lazily on first use.
+ */
+class Executor {
+public:
+    enum class Lane {
+        Fast = 0,
+        Bulk = 1,
+    };
+
+    static const size_t LaneCount = 2;
+
+    struct LaneStats {
+        size_t threads;
+        /** Tasks waiting for a thread */
+        size_t queued;
+        size_t running;
+        /** Threads still blocked in a cancelled task */
+        size_t detached;
+        uint64_t submitted;
+        uint64_t completed;
+        double totalWaitMs;
+        double maxWaitMs;
+        double totalRunMs;
+        double maxRunMs;
+    };
+
+    static Executor &Instance();
+
+    static const char *LaneName(Lane lane);
+
+    /**
+     * Change the number of threads of a lane, surplus threads exit after their current task.
+     */
+    void Configure(Lane lane, size_t threads);
+
+    void Submit(Lane lane, std::function<void()> &&task);
+
+    /**
+     * Give up on a running task of the lane, a replacement thread is started so the lane keeps its capacity.
+     * Call Reattach from the task once it returns, the surplus thread exits afterwards.
+     */
+    void Detach(Lane lane);
+
+    void Reattach(Lane lane);
+
+    /**
+     * Run task on the timer thread once deadline passed, it must not block.
+     */
+    void Schedule(std::chrono::steady_clock::time_point deadline, std::function<void()> &&task);
+
+    LaneStats Stats(Lane lane);
+
+private:
+    struct Task {
+        std::function<void()> run;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    struct LaneState {
+        std::mutex mutex;
+        std::condition_variable available;
+        std::deque<Task> queue;
+        size_t targetThreads = 4;
+        size_t liveThreads = 0;
+        size_t running = 0;
+        size_t detached = 0;
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        double totalWaitMs = 0;
+        double maxWaitMs = 0;
+        double totalRunMs = 0;
+        double maxRunMs = 0;
+    };
+
+    Executor() = default;
+
+    /** Spawn threads up to the target, lane mutex must be held */
+    void Grow(LaneState &lane);
+
+    void Work(LaneState *lane);
+
+    void Tick();
+
+    LaneState _lanes[LaneCount];
+
+    std::mutex _timerMutex;
+    std::condition_variable _timerChanged;
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> _timers;
+    bool _timerStarted = false;
+};
+
+#endif //NODE_LIBVIRT_EXECUTOR_H
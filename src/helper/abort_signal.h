@@ -0,0 +1,58 @@
+//
+// Created by root on 4/15/24.
+//
+
+#ifndef NODE_LIBVIRT_ABORT_SIGNAL_H
+#define NODE_LIBVIRT_ABORT_SIGNAL_H
+
+#include <napi.h>
+#include <functional>
+
+/**
+ * "abort" listener on an AbortSignal, JavaScript thread only.
+ */
+class AbortListener {
+public:
+    /**
+     * Call onAbort with signal.reason once the signal aborts.
+     * @return false if the signal already aborted, onAbort is not registered then
+     */
+    bool Attach(const Napi::Object &signal, std::function<void(Napi::Value reason)> &&onAbort) {
+        if (signal.Get("aborted").ToBoolean()) return false;
+        auto env = signal.Env();
+        auto listener = Napi::Function::New(env, [onAbort](const Napi::CallbackInfo &info) -> Napi::Value {
+            auto target = info.This();
+            onAbort(target.IsObject() ? target.ToObject().Get("reason") : info.Env().Undefined());
+            return info.Env().Undefined();
+        }, "abort");
+        signal.Get("addEventListener").As<Napi::Function>().Call(signal, {Napi::String::New(env, "abort"), listener});
+        _signal = Napi::Persistent(signal);
+        _listener = Napi::Persistent(listener);
+        return true;
+    }
+
+    void Remove() {
+        if (_signal.IsEmpty()) return;
+        auto signal = _signal.Value();
+        signal.Get("removeEventListener").As<Napi::Function>().Call(signal, {
+                Napi::String::New(signal.Env(), "abort"), _listener.Value()});
+        _signal.Reset();
+        _listener.Reset();
+    }
+
+    /**
+     * Error used when the signal carries no reason.
+     */
+    static Napi::Value AbortError(Napi::Env env, const Napi::Value &reason) {
+        if (!reason.IsEmpty() && !reason.IsUndefined()) return reason;
+        auto error = Napi::Error::New(env, "The operation was aborted").Value();
+        error.Set("name", Napi::String::New(env, "AbortError"));
+        return error;
+    }
+
+private:
+    Napi::ObjectReference _signal;
+    Napi::FunctionReference _listener;
+};
+
+#endif //NODE_LIBVIRT_ABORT_SIGNAL_H
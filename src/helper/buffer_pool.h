@@ -0,0 +1,58 @@
+//
+// Created by root on 4/6/24.
+//
+
+#ifndef NODE_LIBVIRT_BUFFER_POOL_H
+#define NODE_LIBVIRT_BUFFER_POOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * Process wide pool of fixed size chunks for stream data.
+ * Chunks are received into directly and handed to JavaScript as external buffers, the buffer finalizer returns
+ * them to the pool so steady streaming does not allocate.
+ */
+class BufferPool {
+public:
+    static const size_t ChunkSize = 64 * 1024;
+
+    static BufferPool &Instance() {
+        static auto *instance = new BufferPool();
+        return *instance;
+    }
+
+    char *Acquire() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_free.empty()) {
+                auto chunk = _free.back();
+                _free.pop_back();
+                return chunk;
+            }
+        }
+        return new char[ChunkSize];
+    }
+
+    void Release(char *chunk) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_free.size() < MaxFree) {
+                _free.push_back(chunk);
+                return;
+            }
+        }
+        delete[] chunk;
+    }
+
+private:
+    static const size_t MaxFree = 64;
+
+    BufferPool() = default;
+
+    std::mutex _mutex;
+    std::vector<char *> _free;
+};
+
+#endif //NODE_LIBVIRT_BUFFER_POOL_H
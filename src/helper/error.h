@@ -5,16 +5,17 @@
 #ifndef NODE_LIBVIRT_ERROR_H
 #define NODE_LIBVIRT_ERROR_H
 
+#include "libvirt_error.h"
 
 #define virt_error_check(condition) \
     if((condition)){ \
-         Napi::Error::New(info.Env(), std::string(virGetLastError()->message)).ThrowAsJavaScriptException(); \
+         Napi::Error::New(info.Env(), LastErrorMessage("Operation failed")).ThrowAsJavaScriptException(); \
          return info.Env().Undefined(); \
     }
 
 #define virt_error_check_void(condition) \
     if((condition)){ \
-        Napi::Error::New(info.Env(), std::string(virGetLastError()->message)).ThrowAsJavaScriptException(); \
+        Napi::Error::New(info.Env(), LastErrorMessage("Operation failed")).ThrowAsJavaScriptException(); \
         return; \
     }
 
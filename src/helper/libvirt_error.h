@@ -0,0 +1,28 @@
+//
+// Created by root on 4/26/24.
+//
+
+#ifndef NODE_LIBVIRT_LIBVIRT_ERROR_H
+#define NODE_LIBVIRT_LIBVIRT_ERROR_H
+
+#include <libvirt/virterror.h>
+
+#include <stdexcept>
+#include <string>
+
+/**
+ * Message of the calling thread's last libvirt error, fallback when there is none.
+ */
+inline std::string LastErrorMessage(const char *fallback) {
+    auto error = virGetLastError();
+    return error && error->message ? error->message : fallback;
+}
+
+/**
+ * Exception for a failed libvirt call on a worker thread, PromiseWorker rejects with its message.
+ */
+inline std::runtime_error LibvirtError(const char *fallback) {
+    return std::runtime_error(LastErrorMessage(fallback));
+}
+
+#endif //NODE_LIBVIRT_LIBVIRT_ERROR_H
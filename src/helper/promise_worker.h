@@ -8,15 +8,226 @@
 #include <napi.h>
 #include <libvirt/libvirt.h>
 #include <stdexcept>
+#include <functional>
+#include <memory>
+#include <mutex>
 
-class PromiseWorker : public Napi::AsyncWorker {
+#include "../addon.h"
+#include "../executor.h"
+#include "../metrics.h"
+#include "abort_signal.h"
+
+class PromiseWorker;
+
+/**
+ * Cancellation state of one PromiseWorker, shared with its executor task and deadline timer.
+ */
+struct Cancellation {
+    enum class Phase {
+        Queued, Running, Finished
+    };
+
+    std::mutex mutex;
+    Phase phase = Phase::Queued;
+    bool cancelled = false;
+    /** The executor thread running the task was given up and replaced */
+    bool detached = false;
+    std::function<void()> abortHook;
+    /** JavaScript thread only, cleared when the worker is deleted */
+    PromiseWorker *worker = nullptr;
+
+    /**
+     * @return false if the worker was cancelled while queued, the async function must not run then
+     */
+    bool Begin() {
+        std::lock_guard<std::mutex> lock(mutex);
+        phase = Phase::Running;
+        return !cancelled;
+    }
+
+    void End(Executor::Lane lane) {
+        std::function<void()> hook;
+        std::lock_guard<std::mutex> lock(mutex);
+        phase = Phase::Finished;
+        abortHook.swap(hook);
+        if (detached) Executor::Instance().Reattach(lane);
+    }
+};
+
+/**
+ * Runs a blocking libvirt call on the addon's Executor and settles a promise with the outcome.
+ * The async function runs on an executor thread, OnOK/OnError on the JavaScript thread.
+ *
+ * A worker made Cancellable rejects as soon as its signal aborts or its deadline passes. The executor thread
+ * blocked in the call is replaced meanwhile and the late outcome is discarded, converters still run to release
+ * what the async function handed over. A worker cancelled before it started skips the async function and runs
+ * its OnDiscard cleanup instead. Everything captured by the async function and the converter is destroyed on the
+ * JavaScript thread with the worker, so owning captures (shared_ptr, references) are released on every path.
+ */
+class PromiseWorker {
 public:
     PromiseWorker(const Napi::Promise::Deferred &deferred, std::function<void(PromiseWorker *)> &&asyncFunction,
-                  void *data = nullptr)
-            : Napi::AsyncWorker(deferred.Env()), deferred_(deferred), asyncFunction_(std::move(asyncFunction)),
+                  Executor::Lane lane = Executor::Lane::Fast, void *data = nullptr)
+            : env_(deferred.Env()), deferred_(deferred), asyncFunction_(std::move(asyncFunction)), lane_(lane),
               data_(data) {}
 
-    void Execute() override {
+    virtual ~PromiseWorker() = default;
+
+    /**
+     * Hand the worker to the executor, it deletes itself once the promise is settled.
+     */
+    void Queue() {
+        auto addon = AddonData::Get(env_);
+        /* Aborted before it was queued, the task only runs the OnDiscard cleanup */
+        if (!settled_) {
+            addon->BeginWork(env_);
+            queued_ = true;
+        }
+        auto completions = addon->completions;
+        auto cancellation = cancellation_;
+        if (cancellation && timeoutMs_ > 0 && !settled_) {
+            ScheduleTimeout(cancellation, completions, timeoutMs_);
+        }
+        if (metrics_) queuedAt_ = Clock::now();
+        Executor::Instance().Submit(lane_, [this, completions, cancellation]() {
+            if (cancellation && !cancellation->Begin()) {
+                if (discard_) discard_();
+                executedAt_ = Clock::now();
+            } else if (metrics_) {
+                auto start = Clock::now();
+                metrics_->Record(OperationMetrics::Queue, start - queuedAt_);
+                this->Execute();
+                executedAt_ = Clock::now();
+                metrics_->Record(OperationMetrics::Call, executedAt_ - start);
+            } else {
+                this->Execute();
+            }
+            if (cancellation) cancellation->End(lane_);
+            /*
+             * Fails only while the environment shuts down, nobody is left to settle the promise then. The worker is
+             * left to the teardown, JavaScript references among its captures must not be released off its thread.
+             */
+            completions.BlockingCall(this, [](Napi::Env env, Napi::Function, PromiseWorker *worker) {
+                worker->Complete(env);
+            });
+        });
+    }
+
+    /**
+     * Release what the async function would have released (raw handles, thread safe functions), runs on the
+     * executor instead of it when the worker was cancelled before it started. Call before Queue.
+     */
+    void OnDiscard(std::function<void()> &&cleanup) {
+        discard_ = std::move(cleanup);
+    }
+
+    /**
+     * Run fn on the JavaScript thread once the worker is done, whatever the outcome and also after it was
+     * cancelled. A cancelled worker settles its promise early, fn runs only when its async function returned.
+     */
+    void Finally(std::function<void()> &&fn) {
+        finally_ = std::move(fn);
+    }
+
+    /**
+     * Run fn on the JavaScript thread right after the promise resolved with the converted value, e.g. to start what
+     * the converter wrapped. Not run when the worker failed or was cancelled, unlike the converter.
+     */
+    void Resolved(std::function<void()> &&fn) {
+        resolved_ = std::move(fn);
+    }
+
+    /**
+     * Keep object from being collected until the worker is done, e.g. the wrapper whose state it changes.
+     */
+    void KeepAlive(const Napi::Object &object) {
+        keepAlive_ = Napi::Persistent(object);
+    }
+
+    /**
+     * Read { signal?: AbortSignal, timeoutMs?: number } from info[index], call before Queue.
+     * Other values at index are ignored.
+     */
+    void Cancellable(const Napi::CallbackInfo &info, size_t index) {
+        if (info.Length() <= index || !info[index].IsObject()) return;
+        auto options = info[index].ToObject();
+        auto timeout = options.Get("timeoutMs");
+        auto signal = options.Get("signal");
+        if (!timeout.IsNumber() && !signal.IsObject()) return;
+
+        cancellation_ = std::make_shared<Cancellation>();
+        cancellation_->worker = this;
+        if (timeout.IsNumber() && timeout.ToNumber().DoubleValue() > 0) {
+            timeoutMs_ = timeout.ToNumber().Uint32Value();
+        }
+        if (signal.IsObject()) {
+            auto cancellation = cancellation_;
+            auto attached = abort_.Attach(signal.ToObject(), [cancellation](Napi::Value reason) {
+                if (cancellation->worker) {
+                    cancellation->worker->Cancel(AbortListener::AbortError(reason.Env(), reason));
+                }
+            });
+            if (!attached) Cancel(AbortListener::AbortError(info.Env(), signal.ToObject().Get("reason")));
+        }
+    }
+
+    /**
+     * Record queue, call, delivery and conversion latency under operation ("Domain.save"), call before Queue.
+     */
+    void Measure(const char *operation) {
+        metrics_ = Metrics::Instance().Operation(operation);
+    }
+
+    /**
+     * Called from the async function before a long running call, hook runs on another thread if the worker is
+     * cancelled while the call is in progress (e.g. virDomainAbortJob).
+     * @return false if the worker was already cancelled, the call should not be started then
+     */
+    bool OnCancel(std::function<void()> &&hook) {
+        if (!cancellation_) return true;
+        std::lock_guard<std::mutex> lock(cancellation_->mutex);
+        if (cancellation_->cancelled) return false;
+        cancellation_->abortHook = std::move(hook);
+        return true;
+    }
+
+    /**
+     * Thread safe, for async functions that can stop between steps.
+     */
+    bool Cancelled() {
+        if (!cancellation_) return false;
+        std::lock_guard<std::mutex> lock(cancellation_->mutex);
+        return cancellation_->cancelled;
+    }
+
+    /**
+     * Reject the promise now, JavaScript thread only. Has no effect once the async function returned.
+     */
+    void Cancel(Napi::Value reason) {
+        if (settled_ || !cancellation_) return;
+        std::function<void()> hook;
+        {
+            std::lock_guard<std::mutex> lock(cancellation_->mutex);
+            if (cancellation_->phase == Cancellation::Phase::Finished) return;
+            cancellation_->cancelled = true;
+            if (cancellation_->phase == Cancellation::Phase::Running && !cancellation_->detached) {
+                cancellation_->detached = true;
+                Executor::Instance().Detach(lane_);
+            }
+            hook.swap(cancellation_->abortHook);
+        }
+        if (hook) Executor::Instance().Submit(Executor::Lane::Fast, std::move(hook));
+        settled_ = true;
+        abort_.Remove();
+        deferred_.Reject(reason);
+        if (queued_) {
+            /* A hung call must not keep the process alive */
+            AddonData::Get(env_)->EndWork(env_);
+            queued_ = false;
+        }
+    }
+
+    virtual void Execute() {
         try {
             asyncFunction_(this);
         } catch (const std::exception &e) {
@@ -28,23 +239,46 @@ public:
         val_ = val;
     }
 
+    /**
+     * Defer building the resolved value until OnOK, where it is safe to create JavaScript values.
+     * Execute runs on a worker thread and must only hand over plain C++ data through the converter.
+     * A JavaScript exception left pending by the converter rejects the promise. A cancelled worker runs the
+     * converter too and drops its value, so it must not have side effects beyond taking ownership; see Resolved.
+     * @param converter
+     */
+    void Result(std::function<Napi::Value(Napi::Env)> &&converter) {
+        converter_ = std::move(converter);
+    }
+
     void Error(const std::string &error) {
         SetError(error);
     }
 
-    void OnOK() override {
+    virtual void OnOK() {
         Napi::HandleScope scope(Env());
+        if (this->converter_) {
+            this->val_ = this->converter_(Env());
+            if (Env().IsExceptionPending()) {
+                deferred_.Reject(Env().GetAndClearPendingException().Value());
+                return;
+            }
+        }
         if (!this->val_) {
             this->val_ = Env().Null();
         }
         deferred_.Resolve(val_);
+        if (resolved_) resolved_();
     }
 
     Napi::Env env() {
         return Env();
     }
 
-    void OnError(const Napi::Error &e) override {
+    Napi::Env Env() const {
+        return env_;
+    }
+
+    virtual void OnError(const Napi::Error &e) {
         Napi::HandleScope scope(Env());
         deferred_.Reject(e.Value());
     }
@@ -54,11 +288,94 @@ public:
         return this->data_;
     }
 
+protected:
+    void SetError(const std::string &error) {
+        failed_ = true;
+        error_ = error;
+    }
+
 private:
+    void Complete(Napi::Env env) {
+        if (cancellation_) cancellation_->worker = nullptr;
+        if (env != nullptr) {
+            auto start = Clock::now();
+            if (metrics_) metrics_->Record(OperationMetrics::Deliver, start - executedAt_);
+            if (queued_) AddonData::Get(env)->EndWork(env);
+            if (settled_) {
+                if (metrics_) metrics_->cancelled.fetch_add(1, std::memory_order_relaxed);
+                Discard(env);
+            } else if (failed_) {
+                if (metrics_) metrics_->errors.fetch_add(1, std::memory_order_relaxed);
+                abort_.Remove();
+                Napi::HandleScope scope(env);
+                OnError(Napi::Error::New(env, error_));
+            } else {
+                abort_.Remove();
+                OnOK();
+                if (metrics_) metrics_->Record(OperationMetrics::Convert, Clock::now() - start);
+            }
+            if (finally_) finally_();
+        }
+        delete this;
+    }
+
+    /**
+     * Outcome of a cancelled worker, only run the converter for the resources it owns.
+     */
+    void Discard(Napi::Env env) {
+        if (!failed_ && converter_) {
+            Napi::HandleScope scope(env);
+            converter_(env);
+            if (env.IsExceptionPending()) env.GetAndClearPendingException();
+        }
+    }
+
+    static void ScheduleTimeout(const std::shared_ptr<Cancellation> &cancellation,
+                                const Napi::ThreadSafeFunction &completions, uint32_t timeoutMs) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        Executor::Instance().Schedule(deadline, [cancellation, completions]() {
+            {
+                /* Finished workers may outlive the environment, don't touch its completions then */
+                std::lock_guard<std::mutex> lock(cancellation->mutex);
+                if (cancellation->phase == Cancellation::Phase::Finished || cancellation->cancelled) return;
+            }
+            auto data = new std::shared_ptr<Cancellation>(cancellation);
+            auto status = completions.BlockingCall(data, [](Napi::Env env, Napi::Function,
+                                                            std::shared_ptr<Cancellation> *data) {
+                auto worker = (*data)->worker;
+                delete data;
+                if (!worker) return;
+                auto error = Napi::Error::New(env, "Operation timed out").Value();
+                error.Set("name", Napi::String::New(env, "TimeoutError"));
+                worker->Cancel(error);
+            });
+            if (status != napi_ok) delete data;
+        });
+    }
+
+    typedef std::chrono::steady_clock Clock;
+
+    Napi::Env env_;
     Napi::Promise::Deferred deferred_;
     std::function<void(PromiseWorker *)> asyncFunction_;
+    Executor::Lane lane_;
     void *data_;
     Napi::Value val_;
+    std::function<Napi::Value(Napi::Env)> converter_;
+    std::function<void()> discard_;
+    std::function<void()> finally_;
+    std::function<void()> resolved_;
+    Napi::ObjectReference keepAlive_;
+    bool failed_ = false;
+    std::string error_;
+    std::shared_ptr<Cancellation> cancellation_;
+    uint32_t timeoutMs_ = 0;
+    AbortListener abort_;
+    bool settled_ = false;
+    bool queued_ = false;
+    OperationMetrics *metrics_ = nullptr;
+    Clock::time_point queuedAt_;
+    Clock::time_point executedAt_;
 };
 
 
@@ -0,0 +1,211 @@
+//
+// Created by root on 4/6/24.
+//
+
+#ifndef NODE_LIBVIRT_STATS_LAYOUT_H
+#define NODE_LIBVIRT_STATS_LAYOUT_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+/**
+ * Fixed slot layouts for writing statistics into caller provided Float64Array / BigUint64Array buffers.
+ * Keep in sync with DomainInfoSlot / NodeInfoSlot in lib/types.
+ */
+enum DomainInfoSlot {
+    DOMAIN_INFO_STATE = 0,
+    DOMAIN_INFO_MAX_MEM,
+    DOMAIN_INFO_MEMORY,
+    DOMAIN_INFO_NR_VIRT_CPU,
+    DOMAIN_INFO_CPU_TIME,
+    DOMAIN_INFO_STRIDE
+};
+
+enum NodeInfoSlot {
+    NODE_INFO_MEMORY = 0,
+    NODE_INFO_CPUS,
+    NODE_INFO_MHZ,
+    NODE_INFO_NODES,
+    NODE_INFO_SOCKETS,
+    NODE_INFO_CORES,
+    NODE_INFO_THREADS,
+    NODE_INFO_STRIDE
+};
+
+/**
+ * Host wide CPU times of virNodeGetCPUStats in nanoseconds.
+ */
+enum HostCpuSlot {
+    HOST_CPU_KERNEL = 0,
+    HOST_CPU_USER,
+    HOST_CPU_IDLE,
+    HOST_CPU_IOWAIT,
+    HOST_CPU_STRIDE
+};
+
+/**
+ * CPU accounting of one domain in a topology snapshot, times in nanoseconds.
+ */
+enum DomainCpuSlot {
+    DOMAIN_CPU_TIME = 0,
+    DOMAIN_CPU_USER,
+    DOMAIN_CPU_SYSTEM,
+    DOMAIN_CPU_VCPUS,
+    DOMAIN_CPU_STRIDE
+};
+
+/**
+ * One vCPU in a topology snapshot. DELAY is the time spent runnable but waiting for a host CPU (steal).
+ */
+enum VcpuSlot {
+    VCPU_DOMAIN = 0,
+    VCPU_NUMBER,
+    VCPU_STATE,
+    VCPU_TIME,
+    VCPU_WAIT,
+    VCPU_DELAY,
+    VCPU_STRIDE
+};
+
+/**
+ * Per second rates of one device in an IoSampler record, block devices and interfaces share the stride.
+ * A record is IO_RECORD_TIMESTAMP followed by IO_RATE_STRIDE slots per device.
+ */
+enum BlockRateSlot {
+    BLOCK_RATE_RD_REQS = 0,
+    BLOCK_RATE_RD_BYTES,
+    BLOCK_RATE_WR_REQS,
+    BLOCK_RATE_WR_BYTES,
+    BLOCK_RATE_FLUSH_REQS,
+    /** Nanoseconds spent reading per second */
+    BLOCK_RATE_RD_TIME,
+    BLOCK_RATE_WR_TIME,
+    BLOCK_RATE_ERRS
+};
+
+enum InterfaceRateSlot {
+    INTERFACE_RATE_RX_BYTES = 0,
+    INTERFACE_RATE_RX_PACKETS,
+    INTERFACE_RATE_RX_ERRS,
+    INTERFACE_RATE_RX_DROP,
+    INTERFACE_RATE_TX_BYTES,
+    INTERFACE_RATE_TX_PACKETS,
+    INTERFACE_RATE_TX_ERRS,
+    INTERFACE_RATE_TX_DROP
+};
+
+const size_t IO_RATE_STRIDE = 8;
+
+/**
+ * virDomainMemoryStats of one domain, slots follow the VIR_DOMAIN_MEMORY_STAT_* tags. Sizes in KiB,
+ * LAST_UPDATE in seconds since the epoch. Tags newer than HUGETLB_PGFAIL are dropped so the stride stays fixed.
+ */
+enum MemoryStatSlot {
+    MEMORY_STAT_SWAP_IN = 0,
+    MEMORY_STAT_SWAP_OUT,
+    MEMORY_STAT_MAJOR_FAULT,
+    MEMORY_STAT_MINOR_FAULT,
+    MEMORY_STAT_UNUSED,
+    MEMORY_STAT_AVAILABLE,
+    MEMORY_STAT_ACTUAL_BALLOON,
+    MEMORY_STAT_RSS,
+    MEMORY_STAT_USABLE,
+    MEMORY_STAT_LAST_UPDATE,
+    MEMORY_STAT_DISK_CACHES,
+    MEMORY_STAT_HUGETLB_PGALLOC,
+    MEMORY_STAT_HUGETLB_PGFAIL,
+    MEMORY_STAT_STRIDE
+};
+
+/** Milliseconds since the epoch, device slots follow */
+const size_t IO_RECORD_TIMESTAMP = 0;
+
+/**
+ * Marks the slots of a record that could not be read, written as NaN into a Float64Array.
+ */
+const uint64_t STATS_MISSING = std::numeric_limits<uint64_t>::max();
+
+inline void DomainInfoSlots(const virDomainInfo &info, uint64_t *slots) {
+    slots[DOMAIN_INFO_STATE] = info.state;
+    slots[DOMAIN_INFO_MAX_MEM] = info.maxMem;
+    slots[DOMAIN_INFO_MEMORY] = info.memory;
+    slots[DOMAIN_INFO_NR_VIRT_CPU] = info.nrVirtCpu;
+    slots[DOMAIN_INFO_CPU_TIME] = info.cpuTime;
+}
+
+inline void NodeInfoSlots(const virNodeInfo &info, uint64_t *slots) {
+    slots[NODE_INFO_MEMORY] = info.memory;
+    slots[NODE_INFO_CPUS] = info.cpus;
+    slots[NODE_INFO_MHZ] = info.mhz;
+    slots[NODE_INFO_NODES] = info.nodes;
+    slots[NODE_INFO_SOCKETS] = info.sockets;
+    slots[NODE_INFO_CORES] = info.cores;
+    slots[NODE_INFO_THREADS] = info.threads;
+}
+
+/**
+ * Slots of the stats returned by virDomainMemoryStats, STATS_MISSING for tags the guest did not report.
+ */
+inline void MemoryStatsSlots(const virDomainMemoryStatStruct *stats, int count, uint64_t *slots) {
+    for (size_t i = 0; i < MEMORY_STAT_STRIDE; i++) slots[i] = STATS_MISSING;
+    for (int i = 0; i < count; i++) {
+        if (stats[i].tag >= 0 && stats[i].tag < static_cast<int>(MEMORY_STAT_STRIDE)) {
+            slots[stats[i].tag] = stats[i].val;
+        }
+    }
+}
+
+/**
+ * Validate target and offset for count slots, throws a JavaScript exception and returns false otherwise.
+ */
+inline bool CheckStatsTarget(Napi::Env env, const Napi::Value &target, size_t offset, size_t count) {
+    if (!target.IsTypedArray()) {
+        Napi::TypeError::New(env, "Expected a Float64Array or BigUint64Array").ThrowAsJavaScriptException();
+        return false;
+    }
+    auto array = target.As<Napi::TypedArray>();
+    auto type = array.TypedArrayType();
+    if (type != napi_float64_array && type != napi_biguint64_array) {
+        Napi::TypeError::New(env, "Expected a Float64Array or BigUint64Array").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (offset > array.ElementLength() || array.ElementLength() - offset < count) {
+        Napi::RangeError::New(env, "Target array too small for the requested slots").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Offset argument at index, 0 when omitted.
+ */
+inline bool StatsOffset(const Napi::CallbackInfo &info, size_t index, size_t &offset) {
+    offset = 0;
+    if (info.Length() <= index || info[index].IsUndefined()) return true;
+    if (!info[index].IsNumber() || info[index].ToNumber().DoubleValue() < 0) {
+        Napi::TypeError::New(info.Env(), "Offset must be a non-negative number").ThrowAsJavaScriptException();
+        return false;
+    }
+    offset = static_cast<size_t>(info[index].ToNumber().Int64Value());
+    return true;
+}
+
+/**
+ * Copy slots into a target checked by CheckStatsTarget.
+ */
+inline void WriteStats(const Napi::TypedArray &target, size_t offset, const uint64_t *slots, size_t count) {
+    if (target.TypedArrayType() == napi_biguint64_array) {
+        auto data = target.As<Napi::BigUint64Array>().Data() + offset;
+        for (size_t i = 0; i < count; i++) data[i] = slots[i];
+    } else {
+        auto data = target.As<Napi::Float64Array>().Data() + offset;
+        for (size_t i = 0; i < count; i++) {
+            data[i] = slots[i] == STATS_MISSING ? NAN : static_cast<double>(slots[i]);
+        }
+    }
+}
+
+#endif //NODE_LIBVIRT_STATS_LAYOUT_H
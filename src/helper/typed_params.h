@@ -0,0 +1,254 @@
+//
+// Created by root on 3/2/24.
+//
+
+#ifndef NODE_LIBVIRT_TYPED_PARAMS_H
+#define NODE_LIBVIRT_TYPED_PARAMS_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+#include <cctype>
+#include <string>
+#include <vector>
+
+/**
+ * Owned copy of a virTypedParameter.
+ * libvirt hands out typed parameter arrays that must be freed on the thread that fetched them,
+ * so workers copy them into this structure and convert to JavaScript later in OnOK.
+ */
+struct TypedParam {
+    std::string field;
+    int type = 0;
+    union {
+        int i;
+        unsigned int ui;
+        long long l;
+        unsigned long long ul;
+        double d;
+        bool b;
+    } value{};
+    std::string s;
+};
+
+typedef std::vector<TypedParam> TypedParams;
+
+inline TypedParams CopyTypedParams(virTypedParameterPtr params, int nparams) {
+    TypedParams result;
+    result.reserve(nparams > 0 ? nparams : 0);
+    for (int i = 0; i < nparams; i++) {
+        TypedParam param;
+        param.field = params[i].field;
+        param.type = params[i].type;
+        switch (params[i].type) {
+            case VIR_TYPED_PARAM_INT:
+                param.value.i = params[i].value.i;
+                break;
+            case VIR_TYPED_PARAM_UINT:
+                param.value.ui = params[i].value.ui;
+                break;
+            case VIR_TYPED_PARAM_LLONG:
+                param.value.l = params[i].value.l;
+                break;
+            case VIR_TYPED_PARAM_ULLONG:
+                param.value.ul = params[i].value.ul;
+                break;
+            case VIR_TYPED_PARAM_DOUBLE:
+                param.value.d = params[i].value.d;
+                break;
+            case VIR_TYPED_PARAM_BOOLEAN:
+                param.value.b = params[i].value.b != 0;
+                break;
+            case VIR_TYPED_PARAM_STRING:
+                param.s = params[i].value.s ? params[i].value.s : "";
+                break;
+            default:
+                continue;
+        }
+        result.push_back(std::move(param));
+    }
+    return result;
+}
+
+/**
+ * Numeric value of a typed parameter, strings and booleans map to 0/1 where meaningful.
+ */
+inline double TypedParamNumber(const TypedParam &param) {
+    switch (param.type) {
+        case VIR_TYPED_PARAM_INT:
+            return param.value.i;
+        case VIR_TYPED_PARAM_UINT:
+            return param.value.ui;
+        case VIR_TYPED_PARAM_LLONG:
+            return static_cast<double>(param.value.l);
+        case VIR_TYPED_PARAM_ULLONG:
+            return static_cast<double>(param.value.ul);
+        case VIR_TYPED_PARAM_DOUBLE:
+            return param.value.d;
+        case VIR_TYPED_PARAM_BOOLEAN:
+            return param.value.b ? 1 : 0;
+        default:
+            return 0;
+    }
+}
+
+inline Napi::Value TypedParamToValue(Napi::Env env, const TypedParam &param) {
+    switch (param.type) {
+        case VIR_TYPED_PARAM_STRING:
+            return Napi::String::New(env, param.s);
+        case VIR_TYPED_PARAM_BOOLEAN:
+            return Napi::Boolean::New(env, param.value.b);
+        default:
+            return Napi::Number::New(env, TypedParamNumber(param));
+    }
+}
+
+/**
+ * Flat conversion, the libvirt field names are kept as property keys.
+ */
+inline Napi::Object TypedParamsToObject(Napi::Env env, const TypedParams &params) {
+    auto obj = Napi::Object::New(env);
+    for (const auto &param: params) {
+        obj.Set(param.field, TypedParamToValue(env, param));
+    }
+    return obj;
+}
+
+/**
+ * memory_dirty_rate -> memoryDirtyRate, compression.cache -> compressionCache
+ */
+inline std::string CamelCaseField(const std::string &field) {
+    std::string result;
+    result.reserve(field.size());
+    bool upper = false;
+    for (auto c: field) {
+        if (c == '_' || c == '.') {
+            upper = !result.empty();
+            continue;
+        }
+        result.push_back(upper ? static_cast<char>(toupper(static_cast<unsigned char>(c))) : c);
+        upper = false;
+    }
+    return result;
+}
+
+/**
+ * Typed parameter accepted from JavaScript under key.
+ */
+struct TypedParamField {
+    const char *key;
+    const char *field;
+    int type;
+    /** An array value adds one parameter per element (e.g. migrate_disks) */
+    bool multiple;
+};
+
+inline bool TypedParamFromValue(const Napi::Value &value, const TypedParamField &spec, TypedParam &param) {
+    param.field = spec.field;
+    param.type = spec.type;
+    if (spec.type == VIR_TYPED_PARAM_STRING) {
+        if (!value.IsString()) return false;
+        param.s = value.ToString().Utf8Value();
+        return true;
+    }
+    if (spec.type == VIR_TYPED_PARAM_BOOLEAN) {
+        if (!value.IsBoolean()) return false;
+        param.value.b = value.ToBoolean();
+        return true;
+    }
+    if (!value.IsNumber()) return false;
+    auto number = value.ToNumber();
+    switch (spec.type) {
+        case VIR_TYPED_PARAM_INT:
+            param.value.i = number.Int32Value();
+            break;
+        case VIR_TYPED_PARAM_UINT:
+            param.value.ui = number.Uint32Value();
+            break;
+        case VIR_TYPED_PARAM_LLONG:
+            param.value.l = number.Int64Value();
+            break;
+        case VIR_TYPED_PARAM_ULLONG:
+            param.value.ul = static_cast<unsigned long long>(number.Int64Value());
+            break;
+        default:
+            param.value.d = number.DoubleValue();
+            break;
+    }
+    return true;
+}
+
+/**
+ * Read the keys of object listed in fields, other keys are ignored.
+ * @return false with the offending key in error if a value has the wrong type
+ */
+inline bool TypedParamsFromObject(const Napi::Object &object, const TypedParamField *fields, size_t count,
+                                  TypedParams &params, std::string &error) {
+    for (size_t i = 0; i < count; i++) {
+        auto value = object.Get(fields[i].key);
+        if (value.IsUndefined()) continue;
+        if (fields[i].multiple && value.IsArray()) {
+            auto array = value.As<Napi::Array>();
+            for (uint32_t j = 0; j < array.Length(); j++) {
+                TypedParam param;
+                if (!TypedParamFromValue(array.Get(j), fields[i], param)) {
+                    error = std::string("Invalid value for '") + fields[i].key + "'";
+                    return false;
+                }
+                params.push_back(std::move(param));
+            }
+            continue;
+        }
+        TypedParam param;
+        if (!TypedParamFromValue(value, fields[i], param)) {
+            error = std::string("Invalid value for '") + fields[i].key + "'";
+            return false;
+        }
+        params.push_back(std::move(param));
+    }
+    return true;
+}
+
+/**
+ * Build the libvirt array for a call on the worker thread, release it with virTypedParamsFree.
+ */
+inline bool ToVirTypedParams(const TypedParams &params, virTypedParameterPtr *result, int *nparams) {
+    *result = nullptr;
+    *nparams = 0;
+    int maxparams = 0;
+    for (const auto &param: params) {
+        auto field = param.field.c_str();
+        int ret;
+        switch (param.type) {
+            case VIR_TYPED_PARAM_INT:
+                ret = virTypedParamsAddInt(result, nparams, &maxparams, field, param.value.i);
+                break;
+            case VIR_TYPED_PARAM_UINT:
+                ret = virTypedParamsAddUInt(result, nparams, &maxparams, field, param.value.ui);
+                break;
+            case VIR_TYPED_PARAM_LLONG:
+                ret = virTypedParamsAddLLong(result, nparams, &maxparams, field, param.value.l);
+                break;
+            case VIR_TYPED_PARAM_ULLONG:
+                ret = virTypedParamsAddULLong(result, nparams, &maxparams, field, param.value.ul);
+                break;
+            case VIR_TYPED_PARAM_DOUBLE:
+                ret = virTypedParamsAddDouble(result, nparams, &maxparams, field, param.value.d);
+                break;
+            case VIR_TYPED_PARAM_BOOLEAN:
+                ret = virTypedParamsAddBoolean(result, nparams, &maxparams, field, param.value.b);
+                break;
+            default:
+                ret = virTypedParamsAddString(result, nparams, &maxparams, field, param.s.c_str());
+                break;
+        }
+        if (ret < 0) {
+            virTypedParamsFree(*result, *nparams);
+            *result = nullptr;
+            *nparams = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif //NODE_LIBVIRT_TYPED_PARAMS_H
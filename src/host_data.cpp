@@ -0,0 +1,276 @@
+//
+// Created by root on 4/10/24.
+//
+
+#include "host_data.h"
+#include "helper/libvirt_error.h"
+
+#include <libvirt/virterror.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+//region XML HELPERS
+
+static bool IsElement(xmlNodePtr node, const char *name) {
+    return node->type == XML_ELEMENT_NODE && xmlStrcmp(node->name, reinterpret_cast<const xmlChar *>(name)) == 0;
+}
+
+static xmlNodePtr Child(xmlNodePtr parent, const char *name) {
+    if (!parent) return nullptr;
+    for (auto node = parent->children; node; node = node->next) {
+        if (IsElement(node, name)) return node;
+    }
+    return nullptr;
+}
+
+static std::vector<xmlNodePtr> Children(xmlNodePtr parent, const char *name) {
+    std::vector<xmlNodePtr> result;
+    if (!parent) return result;
+    for (auto node = parent->children; node; node = node->next) {
+        if (IsElement(node, name)) result.push_back(node);
+    }
+    return result;
+}
+
+static std::string Text(xmlNodePtr node) {
+    if (!node) return "";
+    auto content = xmlNodeGetContent(node);
+    std::string result = content ? reinterpret_cast<const char *>(content) : "";
+    xmlFree(content);
+    return result;
+}
+
+static std::string Attr(xmlNodePtr node, const char *name) {
+    if (!node) return "";
+    auto value = xmlGetProp(node, reinterpret_cast<const xmlChar *>(name));
+    std::string result = value ? reinterpret_cast<const char *>(value) : "";
+    xmlFree(value);
+    return result;
+}
+
+static long long Number(const std::string &value, long long fallback) {
+    if (value.empty()) return fallback;
+    char *end = nullptr;
+    auto result = strtoll(value.c_str(), &end, 10);
+    return end && *end == '\0' ? result : fallback;
+}
+
+/**
+ * Memory sizes in capabilities carry a unit attribute, normalize to KiB.
+ */
+static unsigned long long MemoryKiB(xmlNodePtr node) {
+    auto value = static_cast<unsigned long long>(Number(Text(node), 0));
+    auto unit = Attr(node, "unit");
+    if (unit == "b" || unit == "bytes") return value / 1024;
+    if (unit == "MiB" || unit == "M") return value * 1024;
+    if (unit == "GiB" || unit == "G") return value * 1024 * 1024;
+    return value;
+}
+
+//endregion
+
+ParsedCapabilities ParseCapabilities(const std::string &xml) {
+    std::unique_ptr<xmlDoc, void (*)(xmlDocPtr)> doc(
+            xmlReadMemory(xml.data(), static_cast<int>(xml.size()), "capabilities.xml", nullptr,
+                          XML_PARSE_NONET | XML_PARSE_NOBLANKS | XML_PARSE_NOERROR | XML_PARSE_NOWARNING),
+            xmlFreeDoc);
+    auto root = doc ? xmlDocGetRootElement(doc.get()) : nullptr;
+    if (!root || !IsElement(root, "capabilities")) {
+        throw std::runtime_error("Failed to parse capabilities XML");
+    }
+
+    ParsedCapabilities caps;
+//region host
+    auto host = Child(root, "host");
+    caps.uuid = Text(Child(host, "uuid"));
+    auto cpu = Child(host, "cpu");
+    caps.arch = Text(Child(cpu, "arch"));
+    caps.cpuModel = Text(Child(cpu, "model"));
+    caps.cpuVendor = Text(Child(cpu, "vendor"));
+    auto topology = Child(cpu, "topology");
+    caps.sockets = static_cast<unsigned int>(Number(Attr(topology, "sockets"), 0));
+    caps.dies = static_cast<unsigned int>(Number(Attr(topology, "dies"), 1));
+    caps.cores = static_cast<unsigned int>(Number(Attr(topology, "cores"), 0));
+    caps.threads = static_cast<unsigned int>(Number(Attr(topology, "threads"), 0));
+    for (auto feature: Children(cpu, "feature")) {
+        caps.cpuFeatures.push_back(Attr(feature, "name"));
+    }
+    for (auto transport: Children(Child(Child(host, "migration_features"), "uri_transports"), "uri_transport")) {
+        caps.migrationTransports.push_back(Text(transport));
+    }
+//endregion
+
+//region NUMA topology
+    for (auto cellNode: Children(Child(Child(host, "topology"), "cells"), "cell")) {
+        ParsedCapabilities::NumaCell cell;
+        cell.id = static_cast<unsigned int>(Number(Attr(cellNode, "id"), 0));
+        cell.memoryKiB = MemoryKiB(Child(cellNode, "memory"));
+        for (auto sibling: Children(Child(cellNode, "distances"), "sibling")) {
+            cell.distances.emplace_back(static_cast<unsigned int>(Number(Attr(sibling, "id"), 0)),
+                                        static_cast<unsigned int>(Number(Attr(sibling, "value"), 0)));
+        }
+        for (auto cpuNode: Children(Child(cellNode, "cpus"), "cpu")) {
+            ParsedCapabilities::NumaCpu numaCpu;
+            numaCpu.id = static_cast<unsigned int>(Number(Attr(cpuNode, "id"), 0));
+            numaCpu.socketId = static_cast<int>(Number(Attr(cpuNode, "socket_id"), -1));
+            numaCpu.dieId = static_cast<int>(Number(Attr(cpuNode, "die_id"), -1));
+            numaCpu.coreId = static_cast<int>(Number(Attr(cpuNode, "core_id"), -1));
+            numaCpu.siblings = Attr(cpuNode, "siblings");
+            cell.cpus.push_back(std::move(numaCpu));
+        }
+        caps.cells.push_back(std::move(cell));
+    }
+//endregion
+
+//region guests
+    for (auto guestNode: Children(root, "guest")) {
+        ParsedCapabilities::Guest guest;
+        guest.osType = Text(Child(guestNode, "os_type"));
+        auto arch = Child(guestNode, "arch");
+        guest.arch = Attr(arch, "name");
+        guest.wordSize = static_cast<unsigned int>(Number(Text(Child(arch, "wordsize")), 0));
+        guest.emulator = Text(Child(arch, "emulator"));
+        for (auto machine: Children(arch, "machine")) {
+            guest.machines.push_back(Text(machine));
+        }
+        for (auto domain: Children(arch, "domain")) {
+            guest.domainTypes.push_back(Attr(domain, "type"));
+        }
+        caps.guests.push_back(std::move(guest));
+    }
+//endregion
+    return caps;
+}
+
+std::shared_ptr<const HostData> HostData::Load(virConnectPtr conn) {
+    auto data = std::make_shared<HostData>();
+
+    char *capabilities = virConnectGetCapabilities(conn);
+    if (!capabilities) {
+        throw LibvirtError("Failed to get capabilities");
+    }
+    data->capabilities = capabilities;
+    free(capabilities);
+
+    char *hostname = virConnectGetHostname(conn);
+    if (!hostname) {
+        throw LibvirtError("Failed to get hostname");
+    }
+    data->hostname = hostname;
+    free(hostname);
+
+    /* Not every driver implements these, missing values stay empty */
+    char *sysInfo = virConnectGetSysinfo(conn, 0);
+    if (sysInfo) {
+        data->sysInfo = sysInfo;
+        free(sysInfo);
+    }
+    data->maxVCPUs = virConnectGetMaxVcpus(conn, nullptr);
+
+    data->parsed = ParseCapabilities(data->capabilities);
+
+    if (!data->parsed.arch.empty()) {
+        char **models = nullptr;
+        int count = virConnectGetCPUModelNames(conn, data->parsed.arch.c_str(), &models, 0);
+        for (int i = 0; i < count; i++) {
+            data->cpuModels.emplace_back(models[i]);
+            free(models[i]);
+        }
+        free(models);
+    }
+    virResetLastError();
+
+    data->loadedAt = std::chrono::steady_clock::now();
+    data->loadedAtMs = static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    return data;
+}
+
+//region CONVERSION
+
+static Napi::Array StringArray(Napi::Env env, const std::vector<std::string> &values) {
+    auto array = Napi::Array::New(env, values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        array.Set(i, Napi::String::New(env, values[i]));
+    }
+    return array;
+}
+
+static Napi::Object CapabilitiesToObject(Napi::Env env, const ParsedCapabilities &caps) {
+    auto obj = Napi::Object::New(env);
+
+    auto host = Napi::Object::New(env);
+    host.Set("uuid", Napi::String::New(env, caps.uuid));
+    host.Set("arch", Napi::String::New(env, caps.arch));
+    host.Set("cpuModel", Napi::String::New(env, caps.cpuModel));
+    host.Set("cpuVendor", Napi::String::New(env, caps.cpuVendor));
+    auto topology = Napi::Object::New(env);
+    topology.Set("sockets", Napi::Number::New(env, caps.sockets));
+    topology.Set("dies", Napi::Number::New(env, caps.dies));
+    topology.Set("cores", Napi::Number::New(env, caps.cores));
+    topology.Set("threads", Napi::Number::New(env, caps.threads));
+    host.Set("topology", topology);
+    host.Set("cpuFeatures", StringArray(env, caps.cpuFeatures));
+    host.Set("migrationTransports", StringArray(env, caps.migrationTransports));
+    obj.Set("host", host);
+
+    auto cells = Napi::Array::New(env, caps.cells.size());
+    for (size_t i = 0; i < caps.cells.size(); i++) {
+        const auto &cell = caps.cells[i];
+        auto cellObj = Napi::Object::New(env);
+        cellObj.Set("id", Napi::Number::New(env, cell.id));
+        cellObj.Set("memory", Napi::Number::New(env, static_cast<double>(cell.memoryKiB)));
+        auto cpus = Napi::Array::New(env, cell.cpus.size());
+        for (size_t j = 0; j < cell.cpus.size(); j++) {
+            const auto &cpu = cell.cpus[j];
+            auto cpuObj = Napi::Object::New(env);
+            cpuObj.Set("id", Napi::Number::New(env, cpu.id));
+            cpuObj.Set("socketId", Napi::Number::New(env, cpu.socketId));
+            cpuObj.Set("dieId", Napi::Number::New(env, cpu.dieId));
+            cpuObj.Set("coreId", Napi::Number::New(env, cpu.coreId));
+            cpuObj.Set("siblings", Napi::String::New(env, cpu.siblings));
+            cpus.Set(j, cpuObj);
+        }
+        cellObj.Set("cpus", cpus);
+        auto distances = Napi::Object::New(env);
+        for (const auto &distance: cell.distances) {
+            distances.Set(std::to_string(distance.first), Napi::Number::New(env, distance.second));
+        }
+        cellObj.Set("distances", distances);
+        cells.Set(i, cellObj);
+    }
+    obj.Set("numa", cells);
+
+    auto guests = Napi::Array::New(env, caps.guests.size());
+    for (size_t i = 0; i < caps.guests.size(); i++) {
+        const auto &guest = caps.guests[i];
+        auto guestObj = Napi::Object::New(env);
+        guestObj.Set("osType", Napi::String::New(env, guest.osType));
+        guestObj.Set("arch", Napi::String::New(env, guest.arch));
+        guestObj.Set("wordSize", Napi::Number::New(env, guest.wordSize));
+        guestObj.Set("emulator", Napi::String::New(env, guest.emulator));
+        guestObj.Set("machines", StringArray(env, guest.machines));
+        guestObj.Set("domainTypes", StringArray(env, guest.domainTypes));
+        guests.Set(i, guestObj);
+    }
+    obj.Set("guests", guests);
+    return obj;
+}
+
+Napi::Object HostDataToObject(Napi::Env env, const HostData &data) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("hostname", Napi::String::New(env, data.hostname));
+    obj.Set("sysInfo", Napi::String::New(env, data.sysInfo));
+    obj.Set("maxVCPUs", Napi::Number::New(env, data.maxVCPUs));
+    obj.Set("capabilities", Napi::String::New(env, data.capabilities));
+    obj.Set("parsedCapabilities", CapabilitiesToObject(env, data.parsed));
+    obj.Set("cpuModels", StringArray(env, data.cpuModels));
+    obj.Set("loadedAt", Napi::Number::New(env, data.loadedAtMs));
+    return obj;
+}
+
+//endregion
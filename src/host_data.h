@@ -0,0 +1,144 @@
+//
+// Created by root on 4/10/24.
+//
+
+#ifndef NODE_LIBVIRT_HOST_DATA_H
+#define NODE_LIBVIRT_HOST_DATA_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Capabilities XML reduced to the parts used for placement decisions.
+ */
+struct ParsedCapabilities {
+    struct NumaCpu {
+        unsigned int id = 0;
+        int socketId = -1;
+        int dieId = -1;
+        int coreId = -1;
+        std::string siblings;
+    };
+
+    struct NumaCell {
+        unsigned int id = 0;
+        unsigned long long memoryKiB = 0;
+        std::vector<NumaCpu> cpus;
+        /** sibling cell id, distance */
+        std::vector<std::pair<unsigned int, unsigned int>> distances;
+    };
+
+    struct Guest {
+        std::string osType;
+        std::string arch;
+        unsigned int wordSize = 0;
+        std::string emulator;
+        std::vector<std::string> machines;
+        std::vector<std::string> domainTypes;
+    };
+
+    std::string uuid;
+    std::string arch;
+    std::string cpuModel;
+    std::string cpuVendor;
+    unsigned int sockets = 0;
+    unsigned int dies = 0;
+    unsigned int cores = 0;
+    unsigned int threads = 0;
+    std::vector<std::string> cpuFeatures;
+    std::vector<std::string> migrationTransports;
+    std::vector<NumaCell> cells;
+    std::vector<Guest> guests;
+};
+
+/**
+ * Mostly static host information of one connection, immutable once loaded.
+ */
+struct HostData {
+    std::string capabilities;
+    std::string sysInfo;
+    std::string hostname;
+    int maxVCPUs = -1;
+    /** CPU models libvirt knows for the host architecture */
+    std::vector<std::string> cpuModels;
+    ParsedCapabilities parsed;
+    std::chrono::steady_clock::time_point loadedAt;
+    /** Wall clock time of the load in milliseconds since the epoch, for reporting */
+    double loadedAtMs = 0;
+
+    /**
+     * Fetch everything from the connection, blocks so call it from a worker.
+     * Throws std::runtime_error if the capabilities or hostname cannot be read, the other fields are optional.
+     */
+    static std::shared_ptr<const HostData> Load(virConnectPtr conn);
+};
+
+/**
+ * Thread safe holder of the current HostData snapshot of a connection.
+ * Snapshots older than the TTL are stale, a TTL of zero never expires. Readers keep using the snapshot they got.
+ */
+class HostDataCache {
+public:
+    explicit HostDataCache(std::chrono::milliseconds ttl) : _ttl(ttl) {}
+
+    /**
+     * Current snapshot, stale or not, nullptr before the first load.
+     */
+    std::shared_ptr<const HostData> Get() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _data;
+    }
+
+    bool IsStale(const std::shared_ptr<const HostData> &data) const {
+        if (!data) return true;
+        return _ttl.count() > 0 && std::chrono::steady_clock::now() - data->loadedAt >= _ttl;
+    }
+
+    void Store(std::shared_ptr<const HostData> data) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _data = std::move(data);
+    }
+
+    void Invalidate() {
+        Store(nullptr);
+    }
+
+    /**
+     * Mark a background refresh as running, false if one already is.
+     */
+    bool BeginRefresh() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_refreshing) return false;
+        _refreshing = true;
+        return true;
+    }
+
+    void EndRefresh() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _refreshing = false;
+    }
+
+private:
+    std::chrono::milliseconds _ttl;
+    mutable std::mutex _mutex;
+    std::shared_ptr<const HostData> _data;
+    bool _refreshing = false;
+};
+
+/**
+ * Parse a capabilities document, throws std::runtime_error on malformed XML.
+ */
+ParsedCapabilities ParseCapabilities(const std::string &xml);
+
+/**
+ * Convert a snapshot, must be called on the JavaScript thread.
+ */
+Napi::Object HostDataToObject(Napi::Env env, const HostData &data);
+
+#endif //NODE_LIBVIRT_HOST_DATA_H
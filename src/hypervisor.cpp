@@ -4,11 +4,37 @@
 
 #include "hypervisor.h"
 #include "domain.h"
+#include "domain_stats.h"
+#include "domain_events.h"
+#include "stream.h"
 #include "helper/promise_worker.h"
+#include "helper/abort_signal.h"
 #include "helper/assert.h"
+#include "helper/stats_layout.h"
+#include "helper/libvirt_error.h"
+#include "xml_projection.h"
+#include "bulk_operation.h"
+#include "io_sampler.h"
+#include "balloon_controller.h"
+#include "cpu_stats.h"
+#include "snapshots.h"
+#include "migration.h"
+#include "storage_pool.h"
+#include "address_inventory.h"
+#include "connection_registry.h"
+#include "addon.h"
 
 #include <libvirt/libvirt.h>
 #include <libvirt/virterror.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
 
 
 Napi::Object Hypervisor::Init(Napi::Env env, Napi::Object exports) {
@@ -20,24 +46,127 @@ Napi::Object Hypervisor::Init(Napi::Env env, Napi::Object exports) {
                     InstanceAccessor("sysInfo", &Hypervisor::GetSysInfo, nullptr),
                     InstanceAccessor("maxVCPUs", &Hypervisor::GetMaxVCPUs, nullptr),
                     InstanceAccessor("info", &Hypervisor::GetInfo, nullptr),
+                    InstanceAccessor("poolStats", &Hypervisor::GetPoolStats, nullptr),
+                    InstanceAccessor("connectionState", &Hypervisor::GetConnectionState, nullptr),
                     /* Instance Methods */
                     InstanceMethod("connect", &Hypervisor::Connect),
                     InstanceMethod("disconnect", &Hypervisor::Disconnect),
+                    InstanceMethod("hostData", &Hypervisor::GetHostData),
+                    InstanceMethod("refreshHostData", &Hypervisor::RefreshHostData),
+                    InstanceMethod("setConnectionListener", &Hypervisor::SetConnectionListener),
+                    InstanceMethod("reconnect", &Hypervisor::Reconnect),
 
                     InstanceMethod("domains", &Hypervisor::ListAllDomains),
+                    InstanceMethod("allDomainStats", &Hypervisor::GetAllDomainStats),
+                    InstanceMethod("nodeInfoInto", &Hypervisor::NodeInfoInto),
+                    InstanceMethod("nodeCPUStats", &Hypervisor::NodeCPUStats),
+                    InstanceMethod("nodeCellsFreeMemory", &Hypervisor::NodeCellsFreeMemory),
+                    InstanceMethod("hostTopologySnapshot", &Hypervisor::HostTopologySnapshot),
+                    InstanceMethod("domainsInfoInto", &Hypervisor::DomainsInfoInto),
+                    InstanceMethod("queryDomainsXML", &Hypervisor::QueryDomainsXML),
+                    InstanceMethod("domainsSnapshots", &Hypervisor::DomainsSnapshots),
+                    InstanceMethod("networkDHCPLeases", &Hypervisor::NetworkDHCPLeases),
+                    InstanceMethod("addressInventory", &Hypervisor::AddressInventory),
                     InstanceMethod("lookupDomainById", &Hypervisor::LookupDomainById),
                     InstanceMethod("lookupDomainByName", &Hypervisor::LookupDomainByName),
                     InstanceMethod("lookupDomainByUUIDString", &Hypervisor::LookupDomainByUUIDString),
-                    InstanceMethod("restoreDomain", &Hypervisor::RestoreDomain)
+                    InstanceMethod("domainFromHandle", &Hypervisor::DomainFromHandle),
+                    InstanceMethod("lookupDomains", &Hypervisor::LookupDomains),
+                    InstanceMethod("bulk", &Hypervisor::Bulk),
+                    InstanceMethod("createIoSampler", &Hypervisor::CreateIoSampler),
+                    InstanceMethod("createBalloonController", &Hypervisor::CreateBalloonController),
+                    InstanceMethod("restoreDomain", &Hypervisor::RestoreDomain),
+                    InstanceMethod("volumeUpload", &Hypervisor::VolumeUpload),
+                    InstanceMethod("volumeDownload", &Hypervisor::VolumeDownload),
+                    InstanceMethod("storagePools", &Hypervisor::ListAllStoragePools),
+                    InstanceMethod("lookupStoragePoolByName", &Hypervisor::LookupStoragePoolByName),
+
+                    InstanceMethod("registerDomainEvents", &Hypervisor::RegisterDomainEvents),
+                    InstanceMethod("deregisterDomainEvents", &Hypervisor::DeregisterDomainEvents)
 
             });
 
-    auto constructor = Napi::Persistent(func);
-    constructor.SuppressDestruct(); // Prevent the destructor, as it will be handled by N-API.
+    AddonData::Get(env)->hypervisorConstructor = Napi::Persistent(func);
     exports.Set("Hypervisor", func);
     return exports;
 }
 
+/**
+ * Listener of the connection state, shared with the pool so a transition after the Hypervisor is gone is dropped.
+ */
+struct ConnectionStateChannel {
+    std::mutex mutex;
+    Napi::ThreadSafeFunction tsfn;
+    bool active = false;
+};
+
+/**
+ * JavaScript object of a host data snapshot, rebuilt only when the snapshot changes. JavaScript thread only.
+ */
+struct HostDataObject {
+    /** Snapshot the object was built from */
+    std::shared_ptr<const HostData> converted;
+    Napi::ObjectReference object;
+};
+
+/**
+ * Object of data, reused while it is the snapshot the cached object was built from.
+ */
+static Napi::Value HostDataValue(Napi::Env env, HostDataObject &cache, const std::shared_ptr<const HostData> &data) {
+    if (data != cache.converted || cache.object.IsEmpty()) {
+        cache.object.Reset(HostDataToObject(env, *data), 1);
+        cache.converted = data;
+    }
+    return cache.object.Value();
+}
+
+namespace {
+    struct ConnectionStateEvent {
+        ConnectionPool::State state;
+        std::string reason;
+        unsigned int attempt;
+        unsigned int delayMs;
+    };
+
+    /**
+     * Remove the callbacks of a subscription no longer reachable from its Hypervisor, blocks.
+     */
+    void DeregisterSubscription(const std::shared_ptr<ConnectionPool> &pool, DomainEventSubscription *subscription) {
+        /* A running reconnect handler may still be moving this subscription to the new connection */
+        pool->WaitForReconnectHandlers();
+        subscription->Deregister();
+    }
+
+    /**
+     * reconnect: false disables it, an object overrides single options.
+     */
+    bool ParseReconnectOptions(const Napi::Value &value, ReconnectOptions &options) {
+        if (value.IsUndefined()) return true;
+        if (value.IsBoolean()) {
+            options.enabled = value.ToBoolean();
+            return true;
+        }
+        if (!value.IsObject()) return false;
+        auto object = value.ToObject();
+        auto readUnsigned = [&object](const char *key, unsigned int &target) -> bool {
+            auto item = object.Get(key);
+            if (item.IsUndefined()) return true;
+            if (!item.IsNumber() || item.ToNumber().DoubleValue() < 0) return false;
+            target = item.ToNumber().Uint32Value();
+            return true;
+        };
+        if (object.Get("enabled").IsBoolean()) options.enabled = object.Get("enabled").ToBoolean();
+        if (object.Get("keepAliveInterval").IsNumber()) {
+            options.keepAliveInterval = object.Get("keepAliveInterval").ToNumber().Int32Value();
+        }
+        return readUnsigned("keepAliveCount", options.keepAliveCount)
+               && readUnsigned("initialDelayMs", options.initialDelayMs)
+               && readUnsigned("maxDelayMs", options.maxDelayMs)
+               && readUnsigned("replayTimeoutMs", options.replayTimeoutMs)
+               && readUnsigned("maxRetries", options.maxRetries);
+    }
+}
+
 Hypervisor::Hypervisor(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Hypervisor>(info) {
     auto env = info.Env();
     if (info.Length() != 1 || !info[0].IsObject()) {
@@ -51,26 +180,139 @@ Hypervisor::Hypervisor(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Hyperv
     this->_username = config.Has("username") ? config.Get("username").ToString().Utf8Value() : "";
     this->_password = config.Has("password") ? config.Get("password").ToString().Utf8Value() : "";
     this->_readonly = config.Has("readOnly") ? config.Get("readOnly").ToBoolean() : false;
+    auto poolSize = config.Get("poolSize").IsNumber() ? config.Get("poolSize").ToNumber().Int64Value() : 1;
+    auto maxInFlight = config.Get("maxInFlight").IsNumber() ? config.Get("maxInFlight").ToNumber().Int64Value() : 0;
+    if (poolSize < 1 || maxInFlight < 0) {
+        Napi::RangeError::New(env, "Invalid 'poolSize' or 'maxInFlight'").ThrowAsJavaScriptException();
+        return;
+    }
+    ReconnectOptions reconnect;
+    if (!ParseReconnectOptions(config.Get("reconnect"), reconnect)) {
+        Napi::TypeError::New(env, "Invalid 'reconnect' option").ThrowAsJavaScriptException();
+        return;
+    }
+    this->_shared = config.Has("shared") && config.Get("shared").ToBoolean();
+    if (this->_shared) {
+        this->_pool = ConnectionRegistry::Instance().Get(this->_uri, this->_readonly, static_cast<size_t>(poolSize),
+                                                         static_cast<size_t>(maxInFlight), reconnect);
+    } else {
+        this->_pool = std::make_shared<ConnectionPool>(static_cast<size_t>(poolSize),
+                                                       static_cast<size_t>(maxInFlight), reconnect);
+    }
+    this->_registry = std::make_shared<DomainRegistry>(this->_pool);
+    this->_events = std::make_shared<std::atomic<DomainEventSubscription *>>(nullptr);
+    auto hostDataTtl = config.Get("hostDataTtlMs").IsNumber() ? config.Get("hostDataTtlMs").ToNumber().Int64Value()
+                                                              : 300000;
+    this->_hostData = std::make_shared<HostDataCache>(std::chrono::milliseconds(hostDataTtl > 0 ? hostDataTtl : 0));
+    this->_hostDataObject = std::make_shared<HostDataObject>();
+
+    auto channel = std::make_shared<ConnectionStateChannel>();
+    this->_stateChannel = channel;
+    this->_pool->AddStateListener(this, [channel](ConnectionPool::State state, const std::string &reason,
+                                                  unsigned int attempt, unsigned int delayMs) {
+        std::lock_guard<std::mutex> lock(channel->mutex);
+        if (!channel->active) return;
+        auto event = new ConnectionStateEvent{state, reason, attempt, delayMs};
+        auto status = channel->tsfn.NonBlockingCall(event, [](Napi::Env env, Napi::Function listener,
+                                                              ConnectionStateEvent *event) {
+            auto object = Napi::Object::New(env);
+            object.Set("state", Napi::String::New(env, ConnectionPool::StateName(event->state)));
+            if (!event->reason.empty()) object.Set("reason", Napi::String::New(env, event->reason));
+            if (event->state == ConnectionPool::State::Reconnecting) {
+                object.Set("attempt", Napi::Number::New(env, event->attempt));
+                object.Set("delayMs", Napi::Number::New(env, event->delayMs));
+            }
+            delete event;
+            listener.Call({object});
+        });
+        if (status != napi_ok) delete event;
+    });
+    this->_pool->AddReconnectHandler(this, [this](virConnectPtr oldPrimary, virConnectPtr newPrimary) {
+        this->Reconnected(oldPrimary, newPrimary);
+    });
 }
 
 Hypervisor::~Hypervisor() {
+    if (this->_pool) {
+        /* Workers and other Hypervisors may keep the pool alive, nothing may call back into this object */
+        this->_pool->RemoveListeners(this);
+        auto subscription = this->_events ? this->_events->exchange(nullptr) : nullptr;
+        if (subscription) {
+            /* Deregistering talks to the daemon, the task keeps the pool open until it is done */
+            auto pool = this->_pool;
+            Executor::Instance().Submit(Executor::Lane::Fast, [pool, subscription]() {
+                DeregisterSubscription(pool, subscription);
+            });
+        }
+        if (this->_shared && this->_handle) {
+            ConnectionRegistry::Instance().Detach(this->_pool, this->_uri, this->_readonly);
+        }
+    }
+    if (this->_stateChannel) {
+        std::lock_guard<std::mutex> lock(this->_stateChannel->mutex);
+        if (this->_stateChannel->active) this->_stateChannel->tsfn.Release();
+        this->_stateChannel->active = false;
+    }
     this->_uri.clear();
     this->_username.clear();
     this->_password.clear();
 }
 
+void Hypervisor::Reconnected(virConnectPtr oldPrimary, virConnectPtr newPrimary) {
+    /* Only follow a connected Hypervisor, connect and disconnect set the handle on the JavaScript thread */
+    auto expected = oldPrimary;
+    this->_handle.compare_exchange_strong(expected, newPrimary);
+    this->_registry->Rebind(oldPrimary, newPrimary);
+    auto events = this->_events->load();
+    if (events) events->Rebind(newPrimary);
+    /* A reconnect may reach a different host, preload instead of serving the old data */
+    this->_hostData->Invalidate();
+    try {
+        this->_hostData->Store(HostData::Load(newPrimary));
+    } catch (const std::exception &) {
+        /* Loaded lazily on first use, where the error is reported */
+    }
+}
+
 Napi::Value Hypervisor::Connect(const Napi::CallbackInfo &info) {
     auto env = info.Env();
     auto deferred = Napi::Promise::Deferred::New(env);
-    if (this->_handle) {
+    if (this->_transitioning) {
+        deferred.Reject(Napi::String::New(env, "Hypervisor connect or disconnect in progress"));
+    } else if (this->_handle) {
         deferred.Reject(Napi::String::New(env, "Hypervisor already connected"));
     } else {
-        auto worker = new PromiseWorker(deferred, [this](PromiseWorker *worker) {
-            this->_handle = virConnectOpen(this->_uri.c_str());
-            if (!this->_handle) {
-                worker->Error(std::string(virGetLastError()->message));
+        /* Written by the worker, read by Finally once it returned */
+        auto opened = std::make_shared<bool>(false);
+        auto worker = new PromiseWorker(deferred, [this, opened](PromiseWorker *worker) {
+            this->OpenPool();
+            auto primary = this->_pool->Primary();
+            this->_registry->Subscribe(primary);
+            /* A reconnect may reach a different host, preload instead of serving the old data */
+            this->_hostData->Invalidate();
+            try {
+                this->_hostData->Store(HostData::Load(primary));
+            } catch (const std::exception &) {
+                /* Loaded lazily on first use, where the error is reported */
+            }
+            if (worker->Cancelled()) {
+                /* The caller already saw the connect fail */
+                this->_registry->Unsubscribe(primary);
+                this->ClosePool();
+                return;
             }
+            *opened = true;
+        }, Executor::Lane::Bulk);
+        /* A cancelled connect may still be opening the pool, the next one waits until it closed it again */
+        this->_transitioning = true;
+        worker->KeepAlive(info.This().ToObject());
+        worker->Finally([this, opened]() {
+            this->_transitioning = false;
+            /* Current primary, a reconnect may have replaced the one the worker saw */
+            this->_handle = *opened ? this->_pool->Primary() : nullptr;
         });
+        worker->Cancellable(info, 0);
+        worker->Measure("Hypervisor.connect");
         worker->Queue();
     }
     return deferred.Promise();
@@ -82,53 +324,197 @@ Napi::Value Hypervisor::Disconnect(const Napi::CallbackInfo &info) {
     auto env = info.Env();
 
     auto deferred = Napi::Promise::Deferred::New(env);
+    if (this->_transitioning) {
+        deferred.Reject(Napi::String::New(env, "Hypervisor connect or disconnect in progress"));
+        return deferred.Promise();
+    }
+
+    auto close = [this]() -> int {
+        this->_registry->Unsubscribe(this->_pool->Primary());
+        this->_hostData->Invalidate();
+        return this->ClosePool();
+    };
+    auto worker = new PromiseWorker(deferred, [close](PromiseWorker *worker) {
+        if (close() == -1) {
+            worker->Error(LastErrorMessage("Failed to close connection"));
+        }
+    });
+    /* A cancelled disconnect still closes, the caller only stops waiting for it */
+    worker->OnDiscard([close]() {
+        close();
+    });
+    this->_transitioning = true;
+    worker->KeepAlive(info.This().ToObject());
+    worker->Finally([this]() {
+        this->_transitioning = false;
+        this->_handle = nullptr;
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("Hypervisor.disconnect");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+void Hypervisor::OpenPool() {
+    if (this->_shared) {
+        ConnectionRegistry::Instance().Open(this->_pool, this->_uri, this->_readonly);
+    } else {
+        this->_pool->Open(this->_uri, this->_readonly);
+    }
+}
+
+int Hypervisor::ClosePool() {
+    if (this->_shared) return ConnectionRegistry::Instance().Close(this->_pool, this->_uri, this->_readonly);
+    return this->_pool->Close();
+}
+
+std::shared_ptr<const HostData> Hypervisor::CurrentHostData() {
+    auto data = this->_hostData->Get();
+    if (this->_hostData->IsStale(data)) RefreshHostDataInBackground();
+    return data;
+}
 
-    auto worker = new PromiseWorker(deferred, [this](PromiseWorker *worker) {
-        int result = virConnectClose(this->_handle);
-        if (result == -1) {
-            worker->Error(virSaveLastError()->message);
+void Hypervisor::RefreshHostDataInBackground() {
+    if (!this->_hostData->BeginRefresh()) return;
+    auto pool = this->_pool;
+    auto hostData = this->_hostData;
+    Executor::Instance().Submit(Executor::Lane::Bulk, [pool, hostData]() {
+        /* Nobody waits for this load, failures keep the stale snapshot */
+        try {
+            hostData->Store(pool->WithRetry([](virConnectPtr conn) -> std::shared_ptr<const HostData> {
+                return HostData::Load(conn);
+            }));
+        } catch (const std::exception &) {
         }
+        hostData->EndRefresh();
     });
+}
+
+Napi::Value Hypervisor::GetHostData(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+
+    auto data = this->_hostData->Get();
+    if (!this->_hostData->IsStale(data)) {
+        deferred.Resolve(HostDataValue(env, *this->_hostDataObject, data));
+        return deferred.Promise();
+    }
+    return RefreshHostData(info);
+}
+
+Napi::Value Hypervisor::RefreshHostData(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+
+    auto pool = this->_pool;
+    auto hostData = this->_hostData;
+    auto hostDataObject = this->_hostDataObject;
+    auto worker = new PromiseWorker(deferred, [pool, hostData, hostDataObject](PromiseWorker *worker) {
+        auto data = pool->WithRetry([](virConnectPtr conn) -> std::shared_ptr<const HostData> {
+            return HostData::Load(conn);
+        });
+        hostData->Store(data);
+        worker->Result([hostDataObject, data](Napi::Env env) -> Napi::Value {
+            return HostDataValue(env, *hostDataObject, data);
+        });
+    }, Executor::Lane::Bulk);
+    worker->Cancellable(info, 0);
+    worker->Measure("Hypervisor.refreshHostData");
     worker->Queue();
     return deferred.Promise();
 }
 
 Napi::Value Hypervisor::GetCapabilities(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
-    return Napi::String::New(info.Env(), virConnectGetCapabilities(this->_handle));
+    auto data = CurrentHostData();
+    if (!data) return info.Env().Undefined();
+    return Napi::String::New(info.Env(), data->capabilities);
 }
 
 Napi::Value Hypervisor::GetHostname(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
-    return Napi::String::New(info.Env(), virConnectGetHostname(this->_handle));
+    auto data = CurrentHostData();
+    if (!data) return info.Env().Undefined();
+    return Napi::String::New(info.Env(), data->hostname);
 }
 
 Napi::Value Hypervisor::GetSysInfo(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
-    auto env = info.Env();
-    char *result = virConnectGetSysinfo(this->_handle, 0);
-    if (result == nullptr) {
-        Napi::Error::New(env, virSaveLastError()->message).ThrowAsJavaScriptException();
-        return env.Undefined();
-    }
-    return Napi::String::New(env, result);
+    auto data = CurrentHostData();
+    if (!data) return info.Env().Undefined();
+    return Napi::String::New(info.Env(), data->sysInfo);
 }
 
+/**
+ * Accessors take no arguments, so this reports the limit for the connection's default guest type.
+ */
 Napi::Value Hypervisor::GetMaxVCPUs(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
+    auto data = CurrentHostData();
+    if (!data) return info.Env().Undefined();
+    return Napi::Number::New(info.Env(), data->maxVCPUs);
+}
 
-    if (info.Length() <= 0 || !info[0].IsString()) {
-        Napi::TypeError::New(info.Env(), "Invalid argument").ThrowAsJavaScriptException();
-        return info.Env().Undefined();
+Napi::Value Hypervisor::GetPoolStats(const Napi::CallbackInfo &info) {
+    auto env = info.Env();
+    auto stats = this->_pool->GetStats();
+
+    auto connections = Napi::Array::New(env, stats.connections.size());
+    for (size_t i = 0; i < stats.connections.size(); i++) {
+        auto connection = Napi::Object::New(env);
+        connection.Set("inFlight", Napi::Number::New(env, stats.connections[i].inFlight));
+        connection.Set("leases", Napi::Number::New(env, stats.connections[i].leases));
+        connections.Set(i, connection);
     }
 
+    auto statsObj = Napi::Object::New(env);
+    statsObj.Set("size", Napi::Number::New(env, stats.size));
+    statsObj.Set("maxInFlight", Napi::Number::New(env, stats.maxInFlight));
+    statsObj.Set("inFlight", Napi::Number::New(env, stats.inFlight));
+    statsObj.Set("waiting", Napi::Number::New(env, stats.waiting));
+    statsObj.Set("leases", Napi::Number::New(env, stats.leases));
+    statsObj.Set("totalWaitMs", Napi::Number::New(env, stats.totalWaitMs));
+    statsObj.Set("maxWaitMs", Napi::Number::New(env, stats.maxWaitMs));
+    statsObj.Set("state", Napi::String::New(env, ConnectionPool::StateName(stats.state)));
+    statsObj.Set("reconnects", Napi::Number::New(env, static_cast<double>(stats.reconnects)));
+    statsObj.Set("connections", connections);
+    return statsObj;
+}
+
+Napi::Value Hypervisor::GetConnectionState(const Napi::CallbackInfo &info) {
+    return Napi::String::New(info.Env(), ConnectionPool::StateName(this->_pool->GetState()));
+}
+
+Napi::Value Hypervisor::SetConnectionListener(const Napi::CallbackInfo &info) {
     auto env = info.Env();
-    auto result = virConnectGetMaxVcpus(this->_handle, info[0].ToString().Utf8Value().c_str());
-    if (result < 0) {
-        Napi::Error::New(env, virSaveLastError()->message).ThrowAsJavaScriptException();
+    if (info.Length() <= 0 || !(info[0].IsFunction() || info[0].IsNull() || info[0].IsUndefined())) {
+        Napi::TypeError::New(env, "Expected a function or null").ThrowAsJavaScriptException();
         return env.Undefined();
     }
-    return Napi::Number::New(env, result);
+
+    std::lock_guard<std::mutex> lock(this->_stateChannel->mutex);
+    if (this->_stateChannel->active) {
+        this->_stateChannel->tsfn.Release();
+        this->_stateChannel->active = false;
+    }
+    if (info[0].IsFunction()) {
+        this->_stateChannel->tsfn = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(),
+                                                                  "libvirt.connectionState", 0, 1);
+        /* A listener alone must not keep the process alive */
+        this->_stateChannel->tsfn.Unref(env);
+        this->_stateChannel->active = true;
+    }
+    return env.Undefined();
+}
+
+Napi::Value Hypervisor::Reconnect(const Napi::CallbackInfo &info) {
+    auto env = info.Env();
+    if (!this->_pool->Reconnect("requested")) {
+        Napi::Error::New(env, "Hypervisor not connected or reconnect disabled").ThrowAsJavaScriptException();
+    }
+    return env.Undefined();
 }
 
 Napi::Value Hypervisor::GetInfo(const Napi::CallbackInfo &info) {
@@ -138,7 +524,7 @@ Napi::Value Hypervisor::GetInfo(const Napi::CallbackInfo &info) {
     virNodeInfo nodeInfo;
     auto result = virNodeGetInfo(this->_handle, &nodeInfo);
     if (result < 0) {
-        Napi::Error::New(env, virSaveLastError()->message).ThrowAsJavaScriptException();
+        Napi::Error::New(env, LastErrorMessage("Failed to get node info")).ThrowAsJavaScriptException();
         return env.Undefined();
     }
 
@@ -154,123 +540,1456 @@ Napi::Value Hypervisor::GetInfo(const Napi::CallbackInfo &info) {
     return infoObj;
 }
 
-Napi::Value Hypervisor::ListAllDomains(const Napi::CallbackInfo &info) {
+Napi::Value Hypervisor::NodeCPUStats(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
     auto env = info.Env();
-//region extract flags
-    int flags = 0;
-    if (info.Length() > 0 && info[0].IsNumber()) {
-        flags = info[0].ToNumber().Int32Value();
+    auto cpuNum = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Int32Value()
+                                                          : VIR_NODE_CPU_STATS_ALL_CPUS;
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, cpuNum, flags](PromiseWorker *worker) {
+        auto stats = pool->WithRetry([cpuNum, flags](virConnectPtr conn) -> std::shared_ptr<NodeCpuStats> {
+            return std::make_shared<NodeCpuStats>(GetNodeCpuStats(conn, cpuNum, flags));
+        });
+        worker->Result([stats](Napi::Env env) -> Napi::Value {
+            auto obj = Napi::Object::New(env);
+            for (const auto &stat: *stats) {
+                obj.Set(stat.first, Napi::Number::New(env, static_cast<double>(stat.second)));
+            }
+            return obj;
+        });
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Hypervisor.nodeCPUStats");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::NodeCellsFreeMemory(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+    auto startCell = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Int32Value() : 0;
+    auto maxCells = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Int32Value() : 0;
+    if (startCell < 0) {
+        Napi::RangeError::New(env, "Invalid start cell").ThrowAsJavaScriptException();
+        return env.Undefined();
     }
-//endregion
 
-//region Get domains and create Javascript class object of type Domain
-    virDomainPtr *pVirDomains;
-    int numDomains = virConnectListAllDomains(this->_handle, &pVirDomains, flags);
-    Napi::Array domains = Napi::Array::New(env);
-    for (int i = 0; i < numDomains; i++) {
-        Napi::Object domain = Domain::New(env, {Napi::External<virDomain>::New(env, pVirDomains[i])});
-        domains.Set(i, domain);
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, startCell, maxCells](PromiseWorker *worker) {
+        auto cells = pool->WithRetry(
+                [startCell, maxCells](virConnectPtr conn) -> std::shared_ptr<std::vector<unsigned long long>> {
+                    return std::make_shared<std::vector<unsigned long long>>(
+                            GetCellsFreeMemory(conn, startCell, maxCells));
+                });
+        worker->Result([cells](Napi::Env env) -> Napi::Value {
+            auto array = Napi::Array::New(env, cells->size());
+            for (size_t i = 0; i < cells->size(); i++) {
+                array.Set(static_cast<uint32_t>(i), Napi::Number::New(env, static_cast<double>(cells->at(i))));
+            }
+            return array;
+        });
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Hypervisor.nodeCellsFreeMemory");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::HostTopologySnapshot(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+
+    auto pool = this->_pool;
+    auto registry = this->_registry;
+    auto hostData = this->_hostData;
+    auto worker = new PromiseWorker(deferred, [pool, registry, hostData](PromiseWorker *worker) {
+        auto topology = pool->WithRetry([hostData](virConnectPtr conn) -> std::shared_ptr<HostTopology> {
+            /* The cell layout comes from the cached capabilities, loaded here on first use */
+            auto data = hostData->Get();
+            if (!data) {
+                try {
+                    data = HostData::Load(conn);
+                    hostData->Store(data);
+                } catch (const std::exception &) {
+                }
+            }
+            return std::make_shared<HostTopology>(CollectHostTopology(conn, data));
+        });
+        worker->Result([topology, registry](Napi::Env env) -> Napi::Value {
+            return HostTopologyToObject(env, *topology, *registry);
+        });
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("Hypervisor.hostTopologySnapshot");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+/**
+ * Handles of every Domain in array for a worker, entries of wrappers without handle hold null.
+ * Throws a JavaScript exception and returns false if an element is not a Domain.
+ */
+static bool DomainHandles(Napi::Env env, const Napi::Array &array, std::vector<std::shared_ptr<DomainHandle>> &handles) {
+    auto constructor = AddonData::Get(env)->domainConstructor.Value();
+    handles.reserve(array.Length());
+    for (uint32_t i = 0; i < array.Length(); i++) {
+        auto item = array.Get(i);
+        if (!item.IsObject() || !item.ToObject().InstanceOf(constructor)) {
+            handles.clear();
+            Napi::TypeError::New(env, "Expected an array of domains").ThrowAsJavaScriptException();
+            return false;
+        }
+        handles.push_back(Napi::ObjectWrap<Domain>::Unwrap(item.ToObject())->SharedHandle());
     }
-    free(pVirDomains);
-//endregion
+    return true;
+}
+
+/**
+ * Referenced domains of the handles, rebound where their connection dropped. Blocks, call it from a worker.
+ */
+static std::vector<virDomainPtr> AcquireDomains(const std::vector<std::shared_ptr<DomainHandle>> &handles) {
+    std::vector<virDomainPtr> domains;
+    domains.reserve(handles.size());
+    for (const auto &handle: handles) domains.push_back(handle ? handle->Acquire() : nullptr);
     return domains;
+}
+
+/**
+ * Raw UUIDs of the current domains of the handles without blocking, empty for a handle without domain.
+ */
+static std::vector<std::string> DomainUuids(const std::vector<std::shared_ptr<DomainHandle>> &handles) {
+    std::vector<std::string> uuids;
+    uuids.reserve(handles.size());
+    for (const auto &handle: handles) {
+        auto domainPtr = handle ? handle->Get() : nullptr;
+        unsigned char uuid[VIR_UUID_BUFLEN];
+        if (domainPtr && virDomainGetUUID(domainPtr, uuid) == 0) {
+            uuids.emplace_back(reinterpret_cast<const char *>(uuid), VIR_UUID_BUFLEN);
+        } else {
+            uuids.emplace_back();
+        }
+    }
+    return uuids;
+}
 
+/**
+ * Referenced current domains of the handles without blocking, for consumers outside a worker. Handles of a dropped
+ * connection are rebound in the background.
+ */
+static std::vector<virDomainPtr> RefDomains(const std::vector<std::shared_ptr<DomainHandle>> &handles) {
+    std::vector<virDomainPtr> domains;
+    domains.reserve(handles.size());
+    for (const auto &handle: handles) {
+        auto domainPtr = handle ? handle->Get() : nullptr;
+        if (domainPtr) {
+            virDomainRef(domainPtr);
+            handle->RefreshInBackground();
+        }
+        domains.push_back(domainPtr);
+    }
+    return domains;
 }
 
-Napi::Value Hypervisor::LookupDomainById(const Napi::CallbackInfo &info) {
+Napi::Value Hypervisor::NodeInfoInto(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+    size_t offset;
+    if (!StatsOffset(info, 1, offset) || !CheckStatsTarget(env, info[0], offset, NODE_INFO_STRIDE)) {
+        return env.Undefined();
+    }
+
+    virNodeInfo nodeInfo;
+    if (virNodeGetInfo(this->_handle, &nodeInfo) < 0) {
+        Napi::Error::New(env, LastErrorMessage("Failed to get node info")).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    uint64_t slots[NODE_INFO_STRIDE];
+    NodeInfoSlots(nodeInfo, slots);
+    WriteStats(info[0].As<Napi::TypedArray>(), offset, slots, NODE_INFO_STRIDE);
+    return Napi::Number::New(env, static_cast<double>(offset + NODE_INFO_STRIDE));
+}
 
+Napi::Value Hypervisor::DomainsInfoInto(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
     auto env = info.Env();
 
-    if (info.Length() <= 0 || !info[0].IsNumber()) {
-        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+//region validate domains and target
+    if (info.Length() <= 0 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Expected an array of domains").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto array = info[0].As<Napi::Array>();
+    size_t offset;
+    if (!StatsOffset(info, 2, offset) ||
+        !CheckStatsTarget(env, info[1], offset, static_cast<size_t>(array.Length()) * DOMAIN_INFO_STRIDE)) {
         return env.Undefined();
     }
 
-    auto id = info[0].ToNumber().Int32Value();
+    /* Null for a wrapper without handle, its slots are reported as missing */
+    auto handles = std::make_shared<std::vector<std::shared_ptr<DomainHandle>>>();
+    if (!DomainHandles(env, array, *handles)) {
+        return env.Undefined();
+    }
+//endregion
 
     auto deferred = Napi::Promise::Deferred::New(env);
-    auto worker = new PromiseWorker(deferred, [this, id](PromiseWorker *worker) {
-        auto domainPtr = virDomainLookupByID(this->_handle, id);
-        if (!domainPtr) {
-            worker->Error(virSaveLastError()->message);
+    /* Keeps the buffer alive until the converter copied the samples, released with the worker */
+    auto target = std::make_shared<Napi::ObjectReference>(Napi::Persistent(info[1].ToObject()));
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, handles, target, offset](PromiseWorker *worker) {
+        auto lease = pool->Acquire();
+        auto domains = AcquireDomains(*handles);
+        auto slots = std::make_shared<std::vector<uint64_t>>(domains.size() * DOMAIN_INFO_STRIDE, STATS_MISSING);
+        for (size_t i = 0; i < domains.size(); i++) {
+            auto domainPtr = domains[i];
+            if (!domainPtr) continue;
+            virDomainInfo domainInfo;
+            if (virDomainGetInfo(domainPtr, &domainInfo) == 0) {
+                DomainInfoSlots(domainInfo, slots->data() + i * DOMAIN_INFO_STRIDE);
+            }
+            virDomainFree(domainPtr);
         }
-        worker->Result(Domain::New(worker->env(), {Napi::External<virDomain>::New(worker->env(), domainPtr)}));
+        worker->Result([slots, target, offset](Napi::Env env) -> Napi::Value {
+            auto array = target->Value().As<Napi::TypedArray>();
+            /* The buffer could have been detached while the worker ran */
+            if (offset + slots->size() > array.ElementLength()) {
+                Napi::Error::New(env, "Target array was detached or shrunk").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            WriteStats(array, offset, slots->data(), slots->size());
+            return Napi::Number::New(env, static_cast<double>(offset + slots->size()));
+        });
     });
+    worker->Cancellable(info, 3);
+    worker->Measure("Hypervisor.domainsInfoInto");
     worker->Queue();
     return deferred.Promise();
 }
 
-Napi::Value Hypervisor::LookupDomainByName(const Napi::CallbackInfo &info) {
+Napi::Value Hypervisor::QueryDomainsXML(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
-
     auto env = info.Env();
 
-    if (info.Length() <= 0 || !info[0].IsString()) {
-        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+//region validate domains and selectors
+    if (info.Length() <= 0 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Expected an array of domains").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto selectors = std::make_shared<XmlSelectors>();
+    if (!ReadXmlSelectors(env, info.Length() > 1 ? info[1] : env.Undefined(), *selectors)) {
         return env.Undefined();
     }
+    auto flags = info.Length() > 2 && info[2].IsNumber() ? info[2].ToNumber().Uint32Value() : 0;
+    auto handles = std::make_shared<std::vector<std::shared_ptr<DomainHandle>>>();
+    if (!DomainHandles(env, info[0].As<Napi::Array>(), *handles)) {
+        return env.Undefined();
+    }
+//endregion
 
-    auto name = info[0].ToString().Utf8Value();
+    struct Outcome {
+        XmlProjection projection;
+        std::string error;
+    };
 
     auto deferred = Napi::Promise::Deferred::New(env);
-    auto worker = new PromiseWorker(deferred, [this, name](PromiseWorker *worker) {
-        auto domainPtr = virDomainLookupByName(this->_handle, name.c_str());
-        if (!domainPtr) {
-            worker->Error(virSaveLastError()->message);
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, handles, selectors, flags](PromiseWorker *worker) {
+        /* A broken selector fails the whole batch, everything after that is reported per domain */
+        CompileXmlSelectors(*selectors);
+        auto lease = pool->Acquire();
+
+        auto domains = AcquireDomains(*handles);
+        auto outcomes = std::make_shared<std::vector<Outcome>>(domains.size());
+        for (size_t i = 0; i < domains.size(); i++) {
+            auto domainPtr = domains[i];
+            auto &outcome = outcomes->at(i);
+            if (!domainPtr) {
+                outcome.error = "Domain not defined";
+                continue;
+            }
+            auto xmlDesc = virDomainGetXMLDesc(domainPtr, flags);
+            if (!xmlDesc) {
+                outcome.error = LastErrorMessage("Failed to get domain XML");
+            } else {
+                std::string xml(xmlDesc);
+                free(xmlDesc);
+                try {
+                    outcome.projection = ProjectXml(xml, *selectors);
+                } catch (const std::exception &e) {
+                    outcome.error = e.what();
+                }
+            }
+            virDomainFree(domainPtr);
         }
-        worker->Result(Domain::New(worker->env(), {Napi::External<virDomain>::New(worker->env(), domainPtr)}));
-    });
+        worker->Result([outcomes](Napi::Env env) -> Napi::Value {
+            auto result = Napi::Array::New(env, outcomes->size());
+            for (size_t i = 0; i < outcomes->size(); i++) {
+                const auto &outcome = outcomes->at(i);
+                if (outcome.error.empty()) {
+                    result.Set(i, XmlProjectionToObject(env, outcome.projection));
+                } else {
+                    result.Set(i, Napi::Error::New(env, outcome.error).Value());
+                }
+            }
+            return result;
+        });
+    }, Executor::Lane::Bulk);
+    worker->Cancellable(info, 3);
+    worker->Measure("Hypervisor.queryDomainsXML");
     worker->Queue();
     return deferred.Promise();
 }
 
-Napi::Value Hypervisor::LookupDomainByUUIDString(const Napi::CallbackInfo &info) {
+Napi::Value Hypervisor::DomainsSnapshots(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+
+//region validate domains and options
+    auto handles = std::make_shared<std::vector<std::shared_ptr<DomainHandle>>>();
+    auto listAll = info.Length() <= 0 || info[0].IsNull() || info[0].IsUndefined();
+    if (!listAll) {
+        if (!info[0].IsArray()) {
+            Napi::TypeError::New(env, "Expected an array of domains").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        if (!DomainHandles(env, info[0].As<Napi::Array>(), *handles)) {
+            return env.Undefined();
+        }
+    }
+    SnapshotListOptions options;
+    ReadSnapshotListOptions(info.Length() > 1 ? info[1] : env.Undefined(), options);
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto registry = this->_registry;
+    auto worker = new PromiseWorker(deferred, [pool, registry, handles, listAll, options](PromiseWorker *worker) {
+        std::vector<virDomainPtr> domains;
+        if (listAll) {
+            pool->WithRetry([&domains](virConnectPtr conn) -> int {
+                virDomainPtr *list = nullptr;
+                auto count = virConnectListAllDomains(conn, &list, 0);
+                if (count < 0) {
+                    throw LibvirtError("Failed to list domains");
+                }
+                domains.assign(list, list + count);
+                free(list);
+                return count;
+            });
+        }
+        /* Not held across WithRetry, a second lease of the same worker could wait for the first */
+        std::unique_ptr<ConnectionPool::Lease> lease;
+        try {
+            lease.reset(new ConnectionPool::Lease(pool->Acquire()));
+        } catch (const std::exception &) {
+            for (auto domainPtr: domains) virDomainFree(domainPtr);
+            throw;
+        }
+        if (!listAll) domains = AcquireDomains(*handles);
+        auto batch = std::make_shared<std::vector<DomainSnapshots>>(ListDomainsSnapshots(std::move(domains), options));
+        worker->Result([batch, registry](Napi::Env env) -> Napi::Value {
+            return DomainSnapshotsToArray(env, *batch, *registry);
+        });
+    }, Executor::Lane::Bulk);
+    worker->Cancellable(info, 1);
+    worker->Measure("Hypervisor.domainsSnapshots");
+    worker->Queue();
+    return deferred.Promise();
+}
 
+Napi::Value Hypervisor::NetworkDHCPLeases(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
     auto env = info.Env();
 
     if (info.Length() <= 0 || !info[0].IsString()) {
-        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        Napi::TypeError::New(env, "Invalid network name").ThrowAsJavaScriptException();
         return env.Undefined();
     }
-    auto uuid = info[0].ToString().Utf8Value();
-
+    auto name = info[0].ToString().Utf8Value();
+    auto mac = info.Length() > 1 && info[1].IsString() ? info[1].ToString().Utf8Value() : "";
 
     auto deferred = Napi::Promise::Deferred::New(env);
-    auto worker = new PromiseWorker(deferred, [this, uuid](PromiseWorker *worker) {
-        auto domainPtr = virDomainLookupByName(this->_handle, uuid.c_str());
-        if (!domainPtr) {
-            worker->Error(virSaveLastError()->message);
-        }
-        worker->Result(Domain::New(worker->env(), {Napi::External<virDomain>::New(worker->env(), domainPtr)}));
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, name, mac](PromiseWorker *worker) {
+        auto leases = pool->WithRetry([&name, &mac](virConnectPtr conn) -> std::shared_ptr<std::vector<DhcpLease>> {
+            auto network = virNetworkLookupByName(conn, name.c_str());
+            if (!network) throw std::runtime_error(LastErrorMessage("Network not found"));
+            std::shared_ptr<std::vector<DhcpLease>> leases;
+            try {
+                leases = std::make_shared<std::vector<DhcpLease>>(GetDhcpLeases(network, mac));
+            } catch (const std::exception &) {
+                virNetworkFree(network);
+                throw;
+            }
+            virNetworkFree(network);
+            return leases;
+        });
+        worker->Result([leases](Napi::Env env) -> Napi::Value {
+            return DhcpLeasesToArray(env, *leases);
+        });
     });
+    worker->Cancellable(info, 2);
+    worker->Measure("Hypervisor.networkDHCPLeases");
     worker->Queue();
     return deferred.Promise();
 }
 
-Napi::Value Hypervisor::RestoreDomain(const Napi::CallbackInfo &info) {
+Napi::Value Hypervisor::AddressInventory(const Napi::CallbackInfo &info) {
     assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+
+//region validate options
+    AddressInventoryOptions options;
+    if (info.Length() > 0 && info[0].IsObject()) {
+        auto object = info[0].ToObject();
+        auto sources = object.Get("sources");
+        if (!sources.IsUndefined()) {
+            if (!sources.IsArray()) {
+                Napi::TypeError::New(env, "'sources' must be an array").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            auto array = sources.As<Napi::Array>();
+            options.sources = 0;
+            for (uint32_t i = 0; i < array.Length(); i++) {
+                AddressSource source;
+                if (!array.Get(i).IsString() || !ParseAddressSource(array.Get(i).ToString().Utf8Value(), source)) {
+                    Napi::TypeError::New(env, "Unknown address source").ThrowAsJavaScriptException();
+                    return env.Undefined();
+                }
+                options.sources |= 1u << source;
+            }
+        }
+        if (object.Get("concurrency").IsNumber()) {
+            auto concurrency = object.Get("concurrency").ToNumber().Int64Value();
+            if (concurrency < 1 || concurrency > 64) {
+                Napi::RangeError::New(env, "'concurrency' must be between 1 and 64").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.concurrency = static_cast<size_t>(concurrency);
+        }
+    }
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, options](PromiseWorker *worker) {
+        auto inventory = pool->WithRetry([&options](virConnectPtr conn) -> std::shared_ptr<::AddressInventory> {
+            return std::make_shared<::AddressInventory>(CollectAddressInventory(conn, options));
+        });
+        worker->Result([inventory](Napi::Env env) -> Napi::Value {
+            return AddressInventoryToObject(env, *inventory);
+        });
+    }, Executor::Lane::Bulk);
+    worker->Cancellable(info, 0);
+    worker->Measure("Hypervisor.addressInventory");
+    worker->Queue();
+    return deferred.Promise();
+}
 
+Napi::Value Hypervisor::Bulk(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
     auto env = info.Env();
 
-    if (info.Length() <= 0 || !info[0].IsString()) {
-        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+//region validate arguments
+    BulkOperation::Op op;
+    if (info.Length() < 2 || !info[0].IsString() || !BulkOperation::ParseOp(info[0].ToString().Utf8Value(), op)) {
+        Napi::TypeError::New(env, "Unknown bulk operation").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!info[1].IsArray()) {
+        Napi::TypeError::New(env, "Expected an array of domains").ThrowAsJavaScriptException();
         return env.Undefined();
     }
-    auto xml = info[0].ToString().Utf8Value();
-    auto dxml = info[1].IsString() ? info[1].ToString().Utf8Value() : "";
-    auto flags = info[2].IsString() ? info[2].ToNumber().Uint32Value() : 0;
 
+    BulkOperation::Options options;
+    Napi::Object signal;
+    if (info.Length() > 2 && info[2].IsObject()) {
+        auto object = info[2].ToObject();
+        if (object.Get("concurrency").IsNumber()) {
+            auto concurrency = object.Get("concurrency").ToNumber().Int64Value();
+            if (concurrency < 1 || concurrency > static_cast<int64_t>(BulkOperation::MaxConcurrency)) {
+                Napi::RangeError::New(env, "'concurrency' must be between 1 and 256").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.concurrency = static_cast<size_t>(concurrency);
+        }
+        /* Uint32Value would wrap a negative timeout or flags into a huge one */
+        auto readUnsigned = [&env, &object](const char *key, unsigned int &target) -> bool {
+            auto item = object.Get(key);
+            if (item.IsUndefined()) return true;
+            if (!item.IsNumber()) {
+                Napi::TypeError::New(env, std::string("'") + key + "' must be a number").ThrowAsJavaScriptException();
+                return false;
+            }
+            auto number = item.ToNumber().DoubleValue();
+            if (!(number >= 0 && number <= UINT_MAX) || number != std::floor(number)) {
+                Napi::RangeError::New(env, std::string("'") + key + "' must be a non-negative integer")
+                        .ThrowAsJavaScriptException();
+                return false;
+            }
+            target = static_cast<unsigned int>(number);
+            return true;
+        };
+        if (!readUnsigned("timeoutMs", options.timeoutMs) || !readUnsigned("flags", options.flags)) {
+            return env.Undefined();
+        }
+        if (object.Get("saveDir").IsString()) options.saveDir = object.Get("saveDir").ToString().Utf8Value();
+        std::string error;
+        if (!ParseSaveParams(object.Get("saveParams"), options.saveParams, error)) {
+            Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        /* The file is per domain and a single domain XML cannot apply to the batch */
+        options.saveParams.erase(std::remove_if(options.saveParams.begin(), options.saveParams.end(),
+                                                [](const TypedParam &param) -> bool {
+                                                    return param.field == VIR_DOMAIN_SAVE_PARAM_FILE ||
+                                                           param.field == VIR_DOMAIN_SAVE_PARAM_DXML;
+                                                }), options.saveParams.end());
+        if (object.Get("signal").IsObject()) signal = object.Get("signal").ToObject();
+    }
+    if (op == BulkOperation::Op::Save && options.saveDir.empty()) {
+        Napi::TypeError::New(env, "'saveDir' is required for save").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    /* Null for a wrapper without handle, reported as failed */
+    std::vector<std::shared_ptr<DomainHandle>> handles;
+    if (!DomainHandles(env, info[1].As<Napi::Array>(), handles)) {
+        return env.Undefined();
+    }
+//endregion
 
     auto deferred = Napi::Promise::Deferred::New(env);
-    auto worker = new PromiseWorker(deferred, [this, xml, dxml, flags](PromiseWorker *worker) {
-        int result = virDomainRestoreFlags(this->_handle, xml.c_str(), dxml.empty() ? dxml.c_str() : nullptr, flags);
-        if (result < 0) {
-            worker->Error(virSaveLastError()->message);
+    auto operation = std::make_shared<BulkOperation>(op, this->_pool, DomainUuids(handles), options);
+
+    auto abort = std::make_shared<AbortListener>();
+    if (!signal.IsEmpty() && !abort->Attach(signal, [operation](Napi::Value) { operation->Cancel(); })) {
+        operation->Cancel();
+    }
+
+    auto worker = new PromiseWorker(deferred, [operation](PromiseWorker *worker) {
+        auto results = std::make_shared<std::vector<BulkOperation::Result>>(operation->Run());
+        worker->Result([results](Napi::Env env) -> Napi::Value {
+            auto array = Napi::Array::New(env, results->size());
+            for (size_t i = 0; i < results->size(); i++) {
+                auto &result = results->at(i);
+                auto object = Napi::Object::New(env);
+                object.Set("status", Napi::String::New(env, BatchRunner::StatusName(result.status)));
+                if (!result.error.empty()) object.Set("error", Napi::String::New(env, result.error));
+                if (result.startedMs >= 0) object.Set("startedMs", Napi::Number::New(env, result.startedMs));
+                object.Set("durationMs", Napi::Number::New(env, result.durationMs));
+                array.Set(i, object);
+            }
+            return array;
+        });
+    }, Executor::Lane::Bulk);
+    worker->Finally([abort]() { abort->Remove(); });
+    worker->Measure("Hypervisor.bulk");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+namespace {
+    /**
+     * Devices of one domain to sample, lists that are not given are read from the domain XML.
+     */
+    struct IoSamplerTarget {
+        bool hasDisks = false;
+        std::vector<std::string> disks;
+        bool hasInterfaces = false;
+        std::vector<std::string> interfaces;
+    };
+
+    bool ReadDeviceNames(const Napi::Value &value, bool &present, std::vector<std::string> &names) {
+        if (value.IsUndefined()) return true;
+        if (!value.IsArray()) return false;
+        auto array = value.As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); i++) {
+            if (!array.Get(i).IsString()) return false;
+            names.push_back(array.Get(i).ToString().Utf8Value());
         }
+        present = true;
+        return true;
+    }
+}
+
+Napi::Value Hypervisor::CreateIoSampler(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+
+//region validate targets and options
+    if (info.Length() <= 0 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Expected an array of domains or sampler targets").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto array = info[0].As<Napi::Array>();
+    auto constructor = AddonData::Get(env)->domainConstructor.Value();
+    auto targets = std::make_shared<std::vector<IoSamplerTarget>>(array.Length());
+    auto domainObjects = Napi::Array::New(env, array.Length());
+    for (uint32_t i = 0; i < array.Length(); i++) {
+        auto item = array.Get(i);
+        if (item.IsObject() && !item.ToObject().InstanceOf(constructor)) {
+            auto target = item.ToObject();
+            if (!ReadDeviceNames(target.Get("disks"), targets->at(i).hasDisks, targets->at(i).disks) ||
+                !ReadDeviceNames(target.Get("interfaces"), targets->at(i).hasInterfaces, targets->at(i).interfaces)) {
+                Napi::TypeError::New(env, "'disks' and 'interfaces' must be arrays of strings")
+                        .ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            item = target.Get("domain");
+        }
+        domainObjects.Set(i, item);
+    }
+
+    auto interval = std::chrono::milliseconds(1000);
+    size_t capacity = 60;
+    if (info.Length() > 1 && info[1].IsObject()) {
+        auto options = info[1].ToObject();
+        if (options.Get("intervalMs").IsNumber()) {
+            auto ms = options.Get("intervalMs").ToNumber().Int64Value();
+            interval = std::chrono::milliseconds(ms < 100 ? 100 : ms);
+        }
+        if (options.Get("capacity").IsNumber()) {
+            auto records = options.Get("capacity").ToNumber().Int64Value();
+            if (records < 1 || records > static_cast<int64_t>(IoRateSampler::MaxCapacity)) {
+                Napi::RangeError::New(env, "'capacity' must be between 1 and 65536").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            capacity = static_cast<size_t>(records);
+        }
+    }
+
+    auto handles = std::make_shared<std::vector<std::shared_ptr<DomainHandle>>>();
+    if (!DomainHandles(env, domainObjects, *handles)) {
+        return env.Undefined();
+    }
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, handles, targets, interval, capacity](PromiseWorker *worker) {
+        auto lease = pool->Acquire();
+        auto domains = AcquireDomains(*handles);
+        XmlSelectors selectors = {
+                {"disks",      "/domain/devices/disk/target/@dev"},
+                {"interfaces", "/domain/devices/interface/target/@dev"}
+        };
+        std::vector<IoDevice> devices;
+        for (size_t i = 0; i < domains.size(); i++) {
+            auto &target = targets->at(i);
+            auto domainPtr = domains[i];
+            if (domainPtr && (!target.hasDisks || !target.hasInterfaces)) {
+                /* Interfaces only have a target device while the domain runs */
+                auto xml = virDomainGetXMLDesc(domainPtr, 0);
+                if (xml) {
+                    XmlProjection projection;
+                    try {
+                        projection = ProjectXml(xml, selectors);
+                    } catch (const std::exception &) {
+                        free(xml);
+                        for (auto handle: domains) {
+                            if (handle) virDomainFree(handle);
+                        }
+                        throw;
+                    }
+                    free(xml);
+                    if (!target.hasDisks) target.disks = projection[0].second.nodes;
+                    if (!target.hasInterfaces) target.interfaces = projection[1].second.nodes;
+                }
+            }
+            for (const auto &disk: target.disks) devices.push_back({IoDevice::Block, i, disk});
+            for (const auto &interface: target.interfaces) devices.push_back({IoDevice::Interface, i, interface});
+        }
+        auto sampler = std::make_shared<IoRateSampler>(std::move(domains), std::move(devices), interval, capacity);
+        worker->Result([sampler](Napi::Env env) -> Napi::Value {
+            return IoSampler::New(env, {Napi::External<std::shared_ptr<IoRateSampler>>::New(
+                    env, new std::shared_ptr<IoRateSampler>(sampler))});
+        });
+        /* A cancelled call still wraps the sampler, only a resolved one may start polling */
+        worker->Resolved([sampler]() {
+            sampler->Start();
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Hypervisor.createIoSampler");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::CreateBalloonController(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsArray()) {
+        Napi::TypeError::New(env, "Expected an array of domains").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    BalloonPolicy policy;
+    if (!ReadBalloonPolicy(env, info.Length() > 1 ? info[1] : env.Undefined(), policy)) {
+        return env.Undefined();
+    }
+    auto listener = info.Length() > 2 && info[2].IsFunction() ? info[2] : env.Undefined();
+
+    std::vector<std::shared_ptr<DomainHandle>> handles;
+    if (!DomainHandles(env, info[0].As<Napi::Array>(), handles)) {
+        return env.Undefined();
+    }
+    auto tuner = std::make_shared<BalloonTuner>(RefDomains(handles), policy);
+    return BalloonController::New(env, {Napi::External<std::shared_ptr<BalloonTuner>>::New(
+            env, new std::shared_ptr<BalloonTuner>(tuner)), listener});
+}
+
+Napi::Value Hypervisor::ListAllDomains(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+    auto env = info.Env();
+//region extract flags
+    int flags = 0;
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        flags = info[0].ToNumber().Int32Value();
+    }
+//endregion
+
+//region Get domains and create Javascript class object of type Domain
+    virDomainPtr *pVirDomains;
+    int numDomains = virConnectListAllDomains(this->_handle, &pVirDomains, flags);
+    Napi::Array domains = Napi::Array::New(env);
+    for (int i = 0; i < numDomains; i++) {
+        Napi::Object domain = this->_registry->Wrap(env, pVirDomains[i]);
+        domains.Set(i, domain);
+    }
+    free(pVirDomains);
+//endregion
+    return domains;
+
+}
+
+Napi::Value Hypervisor::GetAllDomainStats(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+//region extract stats and flags
+    unsigned int stats = DEFAULT_DOMAIN_STATS;
+    unsigned int flags = 0;
+    if (info.Length() > 0 && info[0].IsNumber()) {
+        stats = info[0].ToNumber().Uint32Value();
+    }
+    if (info.Length() > 1 && info[1].IsNumber()) {
+        flags = info[1].ToNumber().Uint32Value();
+    }
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto registry = this->_registry;
+    auto worker = new PromiseWorker(deferred, [pool, registry, stats, flags](PromiseWorker *worker) {
+        auto records = pool->WithRetry([stats, flags](virConnectPtr conn) -> std::shared_ptr<std::vector<DomainStatsRecord>> {
+            return std::make_shared<std::vector<DomainStatsRecord>>(CollectAllDomainStats(conn, stats, flags));
+        });
+        worker->Result([records, registry](Napi::Env env) -> Napi::Value {
+            auto result = Napi::Array::New(env, records->size());
+            for (size_t i = 0; i < records->size(); i++) {
+                result.Set(i, DomainStatsRecordToObject(env, records->at(i), *registry));
+            }
+            return result;
+        });
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("Hypervisor.allDomainStats");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::LookupDomainById(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+
+    if (info.Length() <= 0 || !info[0].IsNumber()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto id = info[0].ToNumber().Int32Value();
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto cached = this->_registry->FindById(id);
+    if (!cached.IsEmpty()) {
+        deferred.Resolve(cached);
+        return deferred.Promise();
+    }
+
+    auto pool = this->_pool;
+    auto registry = this->_registry;
+    auto worker = new PromiseWorker(deferred, [pool, registry, id](PromiseWorker *worker) {
+        auto domainPtr = pool->WithRetry([&id](virConnectPtr conn) -> virDomainPtr {
+            auto domainPtr = virDomainLookupByID(conn, id);
+            if (!domainPtr) throw std::runtime_error(LastErrorMessage("Domain not found"));
+            return domainPtr;
+        });
+        worker->Result([registry, domainPtr](Napi::Env env) -> Napi::Value {
+            return registry->Wrap(env, domainPtr);
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Hypervisor.lookupDomainById");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::LookupDomainByName(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto name = info[0].ToString().Utf8Value();
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto cached = this->_registry->FindByName(name);
+    if (!cached.IsEmpty()) {
+        deferred.Resolve(cached);
+        return deferred.Promise();
+    }
+
+    auto pool = this->_pool;
+    auto registry = this->_registry;
+    auto worker = new PromiseWorker(deferred, [pool, registry, name](PromiseWorker *worker) {
+        auto domainPtr = pool->WithRetry([&name](virConnectPtr conn) -> virDomainPtr {
+            auto domainPtr = virDomainLookupByName(conn, name.c_str());
+            if (!domainPtr) throw std::runtime_error(LastErrorMessage("Domain not found"));
+            return domainPtr;
+        });
+        worker->Result([registry, domainPtr](Napi::Env env) -> Napi::Value {
+            return registry->Wrap(env, domainPtr);
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Hypervisor.lookupDomainByName");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::LookupDomainByUUIDString(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    return LookupDomainByUUID(info, info[0].ToString().Utf8Value(), "Hypervisor.lookupDomainByUUIDString");
+}
+
+Napi::Value Hypervisor::DomainFromHandle(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+
+    if (info.Length() <= 0 || !info[0].IsObject() || !info[0].ToObject().Get("uuid").IsString()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto handle = info[0].ToObject();
+    if (handle.Get("uri").IsString()) {
+        auto uri = handle.Get("uri").ToString().Utf8Value();
+        /* Domain.handle reports the URI as libvirt normalized it, which may differ from the configured one */
+        bool matches = uri == this->_uri;
+        if (!matches) {
+            auto connectUri = virConnectGetURI(this->_handle);
+            matches = connectUri && uri == connectUri;
+            free(connectUri);
+        }
+        if (!matches) {
+            auto deferred = Napi::Promise::Deferred::New(env);
+            deferred.Reject(Napi::Error::New(env, "Handle belongs to another connection (" + uri + ")").Value());
+            return deferred.Promise();
+        }
+    }
+    return LookupDomainByUUID(info, handle.Get("uuid").ToString().Utf8Value(), "Hypervisor.domainFromHandle");
+}
+
+Napi::Value Hypervisor::LookupDomainByUUID(const Napi::CallbackInfo &info, const std::string &uuid,
+                                           const char *operation) {
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto cached = this->_registry->FindByUUIDString(uuid);
+    if (!cached.IsEmpty()) {
+        deferred.Resolve(cached);
+        return deferred.Promise();
+    }
+
+    auto pool = this->_pool;
+    auto registry = this->_registry;
+    auto worker = new PromiseWorker(deferred, [pool, registry, uuid](PromiseWorker *worker) {
+        auto domainPtr = pool->WithRetry([&uuid](virConnectPtr conn) -> virDomainPtr {
+            auto domainPtr = virDomainLookupByUUIDString(conn, uuid.c_str());
+            if (!domainPtr) throw std::runtime_error(LastErrorMessage("Domain not found"));
+            return domainPtr;
+        });
+        worker->Result([registry, domainPtr](Napi::Env env) -> Napi::Value {
+            return registry->Wrap(env, domainPtr);
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure(operation);
+    worker->Queue();
+    return deferred.Promise();
+}
+
+namespace {
+    /**
+     * One requested key of lookupDomains and its outcome, filled in on the worker thread.
+     */
+    struct DomainLookup {
+        enum Kind {
+            UUID, Name, Id
+        } kind;
+        std::string key;
+        int id = -1;
+        virDomainPtr domain = nullptr;
+        std::string error;
+    };
+
+    /**
+     * From this many unresolved keys on, one virConnectListAllDomains snapshot is cheaper than a round trip per key.
+     */
+    const size_t LOOKUP_SNAPSHOT_THRESHOLD = 4;
+
+    bool ReadLookupKeys(const Napi::Object &query, const char *property, DomainLookup::Kind kind,
+                        std::vector<DomainLookup> &lookups) {
+        if (!query.Has(property)) return true;
+        auto value = query.Get(property);
+        if (value.IsUndefined()) return true;
+        if (!value.IsArray()) return false;
+        auto array = value.As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); i++) {
+            auto item = array.Get(i);
+            DomainLookup lookup;
+            lookup.kind = kind;
+            if (kind == DomainLookup::Id) {
+                if (!item.IsNumber()) return false;
+                lookup.id = item.ToNumber().Int32Value();
+            } else {
+                if (!item.IsString()) return false;
+                lookup.key = item.ToString().Utf8Value();
+            }
+            lookups.push_back(std::move(lookup));
+        }
+        return true;
+    }
+
+    /**
+     * libvirt accepts UUIDs in either case and with dashes or spaces between digits, compare the hex digits only.
+     */
+    std::string NormalizeUUID(const std::string &uuid) {
+        std::string result;
+        result.reserve(VIR_UUID_BUFLEN * 2);
+        for (auto c: uuid) {
+            if (isxdigit(static_cast<unsigned char>(c))) result.push_back(static_cast<char>(tolower(c)));
+        }
+        return result;
+    }
+
+    void LookupEach(virConnectPtr conn, std::vector<DomainLookup> &lookups) {
+        for (auto &lookup: lookups) {
+            switch (lookup.kind) {
+                case DomainLookup::UUID:
+                    lookup.domain = virDomainLookupByUUIDString(conn, lookup.key.c_str());
+                    break;
+                case DomainLookup::Name:
+                    lookup.domain = virDomainLookupByName(conn, lookup.key.c_str());
+                    break;
+                case DomainLookup::Id:
+                    lookup.domain = virDomainLookupByID(conn, lookup.id);
+                    break;
+            }
+            if (!lookup.domain) lookup.error = LastErrorMessage("Domain not found");
+        }
+    }
+
+    void ResetLookups(std::vector<DomainLookup> &lookups) {
+        for (auto &lookup: lookups) {
+            if (lookup.domain) virDomainFree(lookup.domain);
+            lookup.domain = nullptr;
+            lookup.error.clear();
+        }
+    }
+
+    /**
+     * Match all keys against a single listing, name, UUID and ID are cached in the virDomainPtr so this costs one RPC.
+     */
+    void LookupFromSnapshot(virConnectPtr conn, std::vector<DomainLookup> &lookups) {
+        virDomainPtr *domains = nullptr;
+        int count = virConnectListAllDomains(conn, &domains, 0);
+        if (count < 0) {
+            throw std::runtime_error(LastErrorMessage("Failed to list domains"));
+        }
+
+        std::unordered_map<std::string, int> byUUID;
+        std::unordered_map<std::string, int> byName;
+        std::unordered_map<int, int> byId;
+        char uuid[VIR_UUID_STRING_BUFLEN];
+        for (int i = 0; i < count; i++) {
+            if (virDomainGetUUIDString(domains[i], uuid) == 0) byUUID[NormalizeUUID(uuid)] = i;
+            auto name = virDomainGetName(domains[i]);
+            if (name) byName[name] = i;
+            auto id = virDomainGetID(domains[i]);
+            if (id != static_cast<unsigned int>(-1)) byId[static_cast<int>(id)] = i;
+        }
+
+        std::vector<bool> used(count, false);
+        for (auto &lookup: lookups) {
+            int index = -1;
+            switch (lookup.kind) {
+                case DomainLookup::UUID: {
+                    auto found = byUUID.find(NormalizeUUID(lookup.key));
+                    if (found != byUUID.end()) index = found->second;
+                    break;
+                }
+                case DomainLookup::Name: {
+                    auto found = byName.find(lookup.key);
+                    if (found != byName.end()) index = found->second;
+                    break;
+                }
+                case DomainLookup::Id: {
+                    auto found = byId.find(lookup.id);
+                    if (found != byId.end()) index = found->second;
+                    break;
+                }
+            }
+            if (index < 0) {
+                lookup.error = "Domain not found";
+                continue;
+            }
+            if (used[index]) {
+                /* Every result owns its own reference, the registry drops duplicates */
+                virDomainRef(domains[index]);
+            }
+            used[index] = true;
+            lookup.domain = domains[index];
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (!used[i]) virDomainFree(domains[i]);
+        }
+        free(domains);
+    }
+}
+
+Napi::Value Hypervisor::LookupDomains(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+
+    if (info.Length() <= 0 || !info[0].IsObject()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+//region extract keys, answer what the registry already knows
+    auto query = info[0].ToObject();
+    std::vector<DomainLookup> requested;
+    if (!ReadLookupKeys(query, "uuids", DomainLookup::UUID, requested) ||
+        !ReadLookupKeys(query, "names", DomainLookup::Name, requested) ||
+        !ReadLookupKeys(query, "ids", DomainLookup::Id, requested)) {
+        Napi::TypeError::New(env, "Expected { uuids?: string[], names?: string[], ids?: number[] }")
+                .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto result = env.Global().Get("Map").As<Napi::Function>().New({});
+    auto set = result.Get("set").As<Napi::Function>();
+    /* Domains a failed or cancelled worker resolved are freed with the last owner */
+    std::shared_ptr<std::vector<DomainLookup>> lookups(new std::vector<DomainLookup>(),
+                                                       [](std::vector<DomainLookup> *lookups) {
+                                                           ResetLookups(*lookups);
+                                                           delete lookups;
+                                                       });
+    std::set<std::pair<int, std::string>> seen;
+    for (auto &lookup: requested) {
+        auto key = lookup.kind == DomainLookup::Id ? std::to_string(lookup.id) : lookup.key;
+        if (!seen.insert(std::make_pair(static_cast<int>(lookup.kind), key)).second) continue;
+
+        Napi::Value cached;
+        switch (lookup.kind) {
+            case DomainLookup::UUID:
+                cached = this->_registry->FindByUUIDString(lookup.key);
+                break;
+            case DomainLookup::Name:
+                cached = this->_registry->FindByName(lookup.key);
+                break;
+            case DomainLookup::Id:
+                cached = this->_registry->FindById(lookup.id);
+                break;
+        }
+        if (!cached.IsEmpty()) {
+            Napi::Value mapKey = lookup.kind == DomainLookup::Id
+                                 ? static_cast<Napi::Value>(Napi::Number::New(env, lookup.id))
+                                 : static_cast<Napi::Value>(Napi::String::New(env, lookup.key));
+            set.Call(result, {mapKey, cached});
+            continue;
+        }
+        lookups->push_back(std::move(lookup));
+    }
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    if (lookups->empty()) {
+        deferred.Resolve(result);
+        return deferred.Promise();
+    }
+
+    auto pool = this->_pool;
+    auto registry = this->_registry;
+    /* Released with the worker on the JavaScript thread, whether or not the converter ran */
+    auto partial = std::make_shared<Napi::ObjectReference>(Napi::Persistent(result));
+    auto worker = new PromiseWorker(deferred, [pool, registry, lookups, partial](PromiseWorker *worker) {
+        pool->WithRetry([lookups](virConnectPtr conn) -> bool {
+            ResetLookups(*lookups);
+            if (lookups->size() >= LOOKUP_SNAPSHOT_THRESHOLD) {
+                LookupFromSnapshot(conn, *lookups);
+                return true;
+            }
+            LookupEach(conn, *lookups);
+            /* Per key failures are results, unless the connection dropped midway */
+            for (auto &lookup: *lookups) {
+                if (!lookup.domain && virConnectIsAlive(conn) != 1) throw std::runtime_error(lookup.error);
+            }
+            return true;
+        });
+        worker->Result([registry, lookups, partial](Napi::Env env) -> Napi::Value {
+            auto result = partial->Value();
+            auto set = result.Get("set").As<Napi::Function>();
+            for (auto &lookup: *lookups) {
+                Napi::Value mapKey = lookup.kind == DomainLookup::Id
+                                     ? static_cast<Napi::Value>(Napi::Number::New(env, lookup.id))
+                                     : static_cast<Napi::Value>(Napi::String::New(env, lookup.key));
+                Napi::Value value = lookup.domain
+                                    ? static_cast<Napi::Value>(registry->Wrap(env, lookup.domain))
+                                    : static_cast<Napi::Value>(Napi::Error::New(env, lookup.error).Value());
+                lookup.domain = nullptr;
+                set.Call(result, {mapKey, value});
+            }
+            return result;
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Hypervisor.lookupDomains");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+/**
+ * UUID the domain will have once restored, empty if the image header cannot be read.
+ */
+static std::string RestoredUUID(virConnectPtr conn, const std::string &file, const std::string &dxml) {
+    std::string xml = dxml;
+    if (xml.empty()) {
+        auto desc = virSaveImageGetXMLDesc(conn, file.c_str(), 0);
+        if (!desc) return "";
+        xml = desc;
+        free(desc);
+    }
+    try {
+        return ProjectXml(xml, {{"uuid", "string(/domain/uuid)"}})[0].second.string;
+    } catch (const std::exception &) {
+        return "";
+    }
+}
+
+Napi::Value Hypervisor::RestoreDomain(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+//region validate arguments
+    /* restoreDomain(file, dxml?, flags?, options?) or restoreDomain(params, flags?, options?) */
+    auto useParams = info.Length() > 0 && info[0].IsObject();
+    if (info.Length() <= 0 || !(info[0].IsString() || useParams)) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    std::string file;
+    std::string dxml;
+    TypedParams params;
+    unsigned int flags = 0;
+    size_t optionsIndex = 3;
+    if (useParams) {
+        std::string error;
+        if (!ParseSaveParams(info[0], params, error)) {
+            Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        for (const auto &param: params) {
+            if (param.field == VIR_DOMAIN_SAVE_PARAM_FILE) file = param.s;
+            else if (param.field == VIR_DOMAIN_SAVE_PARAM_DXML) dxml = param.s;
+        }
+        if (file.empty()) {
+            Napi::TypeError::New(env, "'file' is required").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+        optionsIndex = 2;
+    } else {
+        file = info[0].ToString().Utf8Value();
+        dxml = info.Length() > 1 && info[1].IsString() ? info[1].ToString().Utf8Value() : "";
+        flags = info.Length() > 2 && info[2].IsNumber() ? info[2].ToNumber().Uint32Value() : 0;
+        /* virDomainRestoreFlags rejects parallel restores */
+        if (flags & VIR_DOMAIN_SAVE_PARALLEL) {
+            params = SaveFileParams(file, dxml);
+            useParams = true;
+        }
+    }
+
+    Napi::ThreadSafeFunction progress;
+    std::chrono::milliseconds interval;
+    auto hasProgress = ReadProgressOptions(env, info.Length() > optionsIndex ? info[optionsIndex] : env.Undefined(),
+                                           "libvirt.restoreProgress", progress, interval);
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto registry = this->_registry;
+    auto worker = new PromiseWorker(deferred, [pool, registry, useParams, params, file, dxml, flags, progress,
+            hasProgress, interval](PromiseWorker *worker) mutable {
+        std::unique_ptr<ConnectionPool::Lease> lease;
+        virTypedParameterPtr vparams = nullptr;
+        int nparams = 0;
+        try {
+            lease.reset(new ConnectionPool::Lease(pool->Acquire()));
+        } catch (const std::exception &) {
+            if (hasProgress) progress.Release();
+            throw;
+        }
+        if (useParams && !ToVirTypedParams(params, &vparams, &nparams)) {
+            if (hasProgress) progress.Release();
+            worker->Error("Failed to prepare restore parameters");
+            return;
+        }
+        auto conn = lease->Handle();
+        /* The restored domain keeps the UUID of the saved one, read it first to resolve the Domain */
+        auto uuid = RestoredUUID(conn, file, dxml);
+
+        int ret;
+        {
+            std::unique_ptr<JobProgressSampler> sampler;
+            if (hasProgress && !uuid.empty()) sampler.reset(new JobProgressSampler(conn, uuid, progress, interval));
+            ret = useParams ? virDomainRestoreParams(conn, vparams, nparams, flags)
+                            : virDomainRestoreFlags(conn, file.c_str(), dxml.empty() ? nullptr : dxml.c_str(), flags);
+        }
+        if (ret < 0) worker->Error(LastErrorMessage("Failed to restore domain"));
+        if (hasProgress) progress.Release();
+        virTypedParamsFree(vparams, nparams);
+        if (ret < 0) return;
+
+        auto domainPtr = uuid.empty() ? nullptr : virDomainLookupByUUIDString(conn, uuid.c_str());
+        worker->Result([registry, domainPtr](Napi::Env env) -> Napi::Value {
+            if (!domainPtr) return env.Null();
+            return registry->Wrap(env, domainPtr);
+        });
+    }, Executor::Lane::Bulk);
+    if (hasProgress) {
+        worker->OnDiscard([progress]() {
+            progress.Release();
+        });
+    }
+    worker->Cancellable(info, optionsIndex);
+    worker->Measure("Hypervisor.restoreDomain");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::RegisterDomainEvents(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+
+    if (info.Length() <= 0 || !info[0].IsFunction()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto subscription = new DomainEventSubscription(env, info[0].As<Napi::Function>(), this->_handle,
+                                                    DomainEventSubscription::ParseOptions(info[1]));
+    DomainEventSubscription *expected = nullptr;
+    if (!this->_events->compare_exchange_strong(expected, subscription)) {
+        subscription->Deregister();
+        deferred.Reject(Napi::String::New(env, "Domain events already registered"));
+        return deferred.Promise();
+    }
+
+    auto events = this->_events;
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [events, pool, subscription](PromiseWorker *worker) {
+        auto error = subscription->Register();
+        if (!error.empty()) {
+            auto expected = subscription;
+            events->compare_exchange_strong(expected, nullptr);
+            subscription->Deregister();
+            worker->Error(error);
+            return;
+        }
+        /* The caller already saw the registration fail, unless deregisterDomainEvents took it meanwhile */
+        auto expected = subscription;
+        if (worker->Cancelled() && events->compare_exchange_strong(expected, nullptr)) {
+            DeregisterSubscription(pool, subscription);
+        }
+    });
+    worker->OnDiscard([events, subscription]() {
+        auto expected = subscription;
+        if (events->compare_exchange_strong(expected, nullptr)) subscription->Deregister();
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Hypervisor.registerDomainEvents");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::DeregisterDomainEvents(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto subscription = this->_events->exchange(nullptr);
+    if (!subscription) {
+        deferred.Resolve(env.Undefined());
+        return deferred.Promise();
+    }
+
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, subscription](PromiseWorker *) {
+        DeregisterSubscription(pool, subscription);
+    });
+    /* Already taken from the Hypervisor, a cancelled call still deregisters in the background */
+    worker->OnDiscard([pool, subscription]() {
+        DeregisterSubscription(pool, subscription);
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("Hypervisor.deregisterDomainEvents");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::VolumeUpload(const Napi::CallbackInfo &info) {
+    return this->VolumeTransfer(info, true);
+}
+
+Napi::Value Hypervisor::VolumeDownload(const Napi::CallbackInfo &info) {
+    return this->VolumeTransfer(info, false);
+}
+
+Napi::Value Hypervisor::VolumeTransfer(const Napi::CallbackInfo &info, bool upload) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto path = info[0].ToString().Utf8Value();
+    auto offset = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Int64Value() : 0;
+    auto length = info.Length() > 2 && info[2].IsNumber() ? info[2].ToNumber().Int64Value() : 0;
+    auto flags = info.Length() > 3 && info[3].IsNumber() ? info[3].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, path, offset, length, flags, upload](PromiseWorker *worker) {
+        auto lease = pool->Acquire();
+        auto volume = virStorageVolLookupByPath(lease.Handle(), path.c_str());
+        if (!volume) {
+            worker->Error(LastErrorMessage("Failed to look up volume"));
+            return;
+        }
+        auto stream = virStreamNew(lease.Handle(), VIR_STREAM_NONBLOCK);
+        if (!stream) {
+            worker->Error(LastErrorMessage("Failed to create stream"));
+            virStorageVolFree(volume);
+            return;
+        }
+        int result = upload ? virStorageVolUpload(volume, stream, offset, length, flags)
+                            : virStorageVolDownload(volume, stream, offset, length, flags);
+        if (result < 0) {
+            worker->Error(LastErrorMessage("Volume transfer failed"));
+            virStreamFree(stream);
+            virStorageVolFree(volume);
+            return;
+        }
+        virStorageVolFree(volume);
+        worker->Result([stream](Napi::Env env) -> Napi::Value {
+            return Stream::New(env, {Napi::External<virStream>::New(env, stream)});
+        });
+    });
+    worker->Cancellable(info, 4);
+    worker->Measure(upload ? "Hypervisor.volumeUpload" : "Hypervisor.volumeDownload");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::ListAllStoragePools(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+    auto flags = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, flags](PromiseWorker *worker) {
+        auto pools = pool->WithRetry([flags](virConnectPtr conn) -> std::shared_ptr<std::vector<virStoragePoolPtr>> {
+            virStoragePoolPtr *list = nullptr;
+            auto count = virConnectListAllStoragePools(conn, &list, flags);
+            if (count < 0) throw std::runtime_error(LastErrorMessage("Failed to list storage pools"));
+            auto pools = std::make_shared<std::vector<virStoragePoolPtr>>(list, list + count);
+            free(list);
+            return pools;
+        });
+        worker->Result([pools](Napi::Env env) -> Napi::Value {
+            auto array = Napi::Array::New(env, pools->size());
+            for (size_t i = 0; i < pools->size(); i++) {
+                array.Set(static_cast<uint32_t>(i), StoragePool::Wrap(env, pools->at(i)));
+            }
+            return array;
+        });
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("Hypervisor.storagePools");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Hypervisor::LookupStoragePoolByName(const Napi::CallbackInfo &info) {
+    assert(this->_handle, "Hypervisor not connected");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Invalid storage pool name").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto name = info[0].ToString().Utf8Value();
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto pool = this->_pool;
+    auto worker = new PromiseWorker(deferred, [pool, name](PromiseWorker *worker) {
+        auto poolPtr = pool->WithRetry([&name](virConnectPtr conn) -> virStoragePoolPtr {
+            auto poolPtr = virStoragePoolLookupByName(conn, name.c_str());
+            if (!poolPtr) throw std::runtime_error(LastErrorMessage("Storage pool not found"));
+            return poolPtr;
+        });
+        worker->Result([poolPtr](Napi::Env env) -> Napi::Value {
+            return StoragePool::Wrap(env, poolPtr);
+        });
     });
+    worker->Cancellable(info, 1);
+    worker->Measure("Hypervisor.lookupStoragePoolByName");
     worker->Queue();
     return deferred.Promise();
 }
@@ -8,7 +8,18 @@
 #include <napi.h>
 
 #include <libvirt/libvirt.h>
+#include <atomic>
+#include <memory>
 
+#include "connection_pool.h"
+#include "domain_registry.h"
+#include "host_data.h"
+
+class DomainEventSubscription;
+
+struct ConnectionStateChannel;
+
+struct HostDataObject;
 
 class Hypervisor : public Napi::ObjectWrap<Hypervisor> {
 
@@ -17,8 +28,27 @@ private:
     std::string _password;
     bool _readonly = false;
     std::string _uri;
+    /** Pool obtained from the ConnectionRegistry, shared with other Hypervisors of the same URI */
+    bool _shared = false;
+
+    /** Primary connection, set by connect and disconnect on the JavaScript thread and followed by reconnects */
+    std::atomic<virConnectPtr> _handle{nullptr};
+
+    /** A connect or disconnect worker is running, JavaScript thread only */
+    bool _transitioning = false;
+
+    std::shared_ptr<ConnectionPool> _pool;
+
+    std::shared_ptr<DomainRegistry> _registry;
 
-    virConnectPtr _handle = nullptr;
+    /** Shared with registration workers, which may finish after this object was collected */
+    std::shared_ptr<std::atomic<DomainEventSubscription *>> _events;
+
+    std::shared_ptr<HostDataCache> _hostData;
+    /** JavaScript object of the latest snapshot, shared with the refreshHostData converters */
+    std::shared_ptr<HostDataObject> _hostDataObject;
+
+    std::shared_ptr<ConnectionStateChannel> _stateChannel;
 
 public:
     static Napi::Object Init(Napi::Env env, Napi::Object exports);
@@ -31,12 +61,54 @@ public:
         return this->_handle;
     }
 
+    /**
+     * Connections used by asynchronous operations, workers lease one for the duration of their libvirt calls.
+     */
+    std::shared_ptr<ConnectionPool> Pool() {
+        return this->_pool;
+    }
+
+    /**
+     * Identity map of the Domain wrappers created through this hypervisor.
+     */
+    std::shared_ptr<DomainRegistry> Registry() {
+        return this->_registry;
+    }
+
 private:
 
     Napi::Value Connect(const Napi::CallbackInfo &info);
 
     Napi::Value Disconnect(const Napi::CallbackInfo &info);
 
+    /**
+     * Open or close the pool, through the ConnectionRegistry when it is shared. Block, call them from a worker.
+     */
+    void OpenPool();
+
+    int ClosePool();
+
+    /**
+     * Cached host data for the accessors, never blocks. A missing or stale snapshot is refreshed in the background.
+     * @return the stale snapshot meanwhile, nullptr until the first load finished
+     */
+    std::shared_ptr<const HostData> CurrentHostData();
+
+    void RefreshHostDataInBackground();
+
+    /**
+     * Host data (capabilities, parsed capabilities, sysinfo, hostname, max vCPUs, CPU models), loaded on a worker
+     * if the cached snapshot is missing or older than the TTL.
+     * @return Promise<HostData>
+     */
+    Napi::Value GetHostData(const Napi::CallbackInfo &info);
+
+    /**
+     * Reload the host data on a worker regardless of its age.
+     * @return Promise<HostData>
+     */
+    Napi::Value RefreshHostData(const Napi::CallbackInfo &info);
+
     Napi::Value GetCapabilities(const Napi::CallbackInfo &info);
 
     Napi::Value GetHostname(const Napi::CallbackInfo &info);
@@ -45,6 +117,29 @@ private:
 
     Napi::Value GetMaxVCPUs(const Napi::CallbackInfo &info);
 
+    Napi::Value GetPoolStats(const Napi::CallbackInfo &info);
+
+    /**
+     * 'closed', 'connected', 'disconnected' or 'reconnecting'.
+     */
+    Napi::Value GetConnectionState(const Napi::CallbackInfo &info);
+
+    /**
+     * Set the function called on connection state changes, null removes it.
+     * @param info listener({ state, reason?, attempt?, delayMs? }) | null
+     */
+    Napi::Value SetConnectionListener(const Napi::CallbackInfo &info);
+
+    /**
+     * Reopen the connections as if they dropped, returns without waiting for the reconnect.
+     */
+    Napi::Value Reconnect(const Napi::CallbackInfo &info);
+
+    /**
+     * Runs on the pool's reconnect thread: move subscriptions and cached data to the new primary connection.
+     */
+    void Reconnected(virConnectPtr oldPrimary, virConnectPtr newPrimary);
+
     /**
      * Extract hardware information about the node.
      * Use of this API is strongly discouraged as the information provided is not guaranteed to be accurate on all hardware platforms.
@@ -59,15 +154,182 @@ private:
      */
     Napi::Value GetInfo(const Napi::CallbackInfo &info);
 
+    /**
+     * Write virNodeInfo into a Float64Array / BigUint64Array using the NodeInfoSlot layout.
+     * @param info target, offset? (element index, defaults to 0)
+     * @return offset of the next record
+     */
+    Napi::Value NodeInfoInto(const Napi::CallbackInfo &info);
+
+    /**
+     * virNodeGetCPUStats, nanoseconds per field (kernel, user, idle, iowait, ...).
+     * @param info cpuNum? (defaults to all CPUs), flags?, options?
+     * @return Promise<Record<string, number>>
+     */
+    Napi::Value NodeCPUStats(const Napi::CallbackInfo &info);
+
+    /**
+     * virNodeGetCellsFreeMemory in bytes.
+     * @param info startCell? (default 0), maxCells? (defaults to every cell), options?
+     * @return Promise<number[]>
+     */
+    Napi::Value NodeCellsFreeMemory(const Napi::CallbackInfo &info);
+
+    /**
+     * Host CPU times, free memory per NUMA cell and CPU / vCPU counters of every running domain gathered on one
+     * worker task, see HostTopology.
+     * @param info options?
+     * @return Promise<HostTopologySnapshot>
+     */
+    Napi::Value HostTopologySnapshot(const Napi::CallbackInfo &info);
+
+    /**
+     * Sample virDomainInfo of many domains on a worker and write them back to back (DomainInfoSlot layout, stride 5).
+     * Domains that could not be read have all their slots set to NaN, or 2^64-1 in a BigUint64Array.
+     * @param info domains, target, offset? (element index, defaults to 0)
+     * @return Promise<number> offset after the last record
+     */
+    Napi::Value DomainsInfoInto(const Napi::CallbackInfo &info);
+
+    /**
+     * Evaluate XPath selectors against the XML of many domains in one worker task, see Domain::QueryXML.
+     * An invalid selector rejects the batch, a domain that fails resolves to an Error at its position.
+     * @param info domains, selectors ({ key: xpath } or xpath[]), flags? (virDomainXMLFlags)
+     * @return Promise<(Record<string, string[] | string | number | boolean> | Error)[]>
+     */
+    Napi::Value QueryDomainsXML(const Napi::CallbackInfo &info);
+
+    /**
+     * Snapshot trees of many domains in one worker task, see ListSnapshots. Without domains every domain of the
+     * connection is listed. A domain that fails carries an error instead of its snapshots.
+     * @param info domains? (Domain[] | null), options? { flags?, details?, xml?, signal?, timeoutMs? }
+     * @return Promise<{ domain, snapshots?, error? }[]>
+     */
+    Napi::Value DomainsSnapshots(const Napi::CallbackInfo &info);
+
+    /**
+     * virNetworkGetDHCPLeases of one network.
+     * @param info network name, mac? (only leases of this MAC address), options?
+     * @return Promise<DhcpLease[]>
+     */
+    Napi::Value NetworkDHCPLeases(const Napi::CallbackInfo &info);
+
+    /**
+     * Addresses of every active guest in one worker task as columns, see AddressInventory.
+     * @param info options? { sources? (("lease" | "agent" | "arp" | "dhcp")[], default ["lease"]), concurrency?
+     * (default 8, at most 64), signal?, timeoutMs? }
+     * @return Promise<AddressInventory>
+     */
+    Napi::Value AddressInventory(const Napi::CallbackInfo &info);
+
+    /**
+     * Apply a lifecycle operation to many domains with bounded concurrency, off the JavaScript thread.
+     * Resolves once every domain finished, timed out or was cancelled through options.signal.
+     * @param info op, domains, options? { concurrency?, timeoutMs?, flags?, saveDir?, saveParams?, signal? }
+     * @return Promise<BulkResult[]> in input order
+     */
+    Napi::Value Bulk(const Napi::CallbackInfo &info);
+
+    /**
+     * Create a running IoSampler for the disks and interfaces of the given domains, see IoRateSampler.
+     * @param info (Domain | { domain, disks?, interfaces? })[], options? { intervalMs? (default 1000), capacity? (records,
+     * default 60), signal?, timeoutMs? }
+     * @return Promise<IoSampler>
+     */
+    Napi::Value CreateIoSampler(const Napi::CallbackInfo &info);
+
+    /**
+     * Create a stopped BalloonController for the given domains, see BalloonTuner.
+     * @param info domains, policy? (see ReadBalloonPolicy), listener?(actions)
+     * @return BalloonController
+     */
+    Napi::Value CreateBalloonController(const Napi::CallbackInfo &info);
+
     Napi::Value ListAllDomains(const Napi::CallbackInfo &info);
 
+    /**
+     * Collect statistics for all domains with a single virConnectGetAllDomainStats call on a worker thread.
+     * Resolves to one grouped record (state, cpu, balloon, vcpu, net, block, ...) per domain.
+     * @param info statsMask (virDomainStatsTypes, defaults to state|cpu|balloon|vcpu|interface|block), flags
+     * @return Promise<DomainStatsRecord[]>
+     */
+    Napi::Value GetAllDomainStats(const Napi::CallbackInfo &info);
+
     Napi::Value LookupDomainById(const Napi::CallbackInfo &info);
 
     Napi::Value LookupDomainByName(const Napi::CallbackInfo &info);
 
     Napi::Value LookupDomainByUUIDString(const Napi::CallbackInfo &info);
 
+    /**
+     * Resolve a handle read from Domain.handle, possibly in another worker_thread.
+     * Rejects when the handle belongs to another URI.
+     * @param info handle { uri, uuid }, options?
+     * @return Promise<Domain>
+     */
+    Napi::Value DomainFromHandle(const Napi::CallbackInfo &info);
+
+    /**
+     * Registry wrapper or a lookup on a worker, options are read from info[1].
+     */
+    Napi::Value LookupDomainByUUID(const Napi::CallbackInfo &info, const std::string &uuid, const char *operation);
+
+    /**
+     * Resolve many domains with one worker task, reading a single virConnectListAllDomains snapshot for larger sets.
+     * Keys the registry already knows are answered without a libvirt call. A missing domain sets an Error for its key
+     * instead of rejecting the batch.
+     * @param info { uuids?: string[], names?: string[], ids?: number[] }
+     * @return Promise<Map<string | number, Domain | Error>>
+     */
+    Napi::Value LookupDomains(const Napi::CallbackInfo &info);
+
+    /**
+     * virDomainRestoreFlags, or virDomainRestoreParams for the params form (parallel channels, image format).
+     * Progress is sampled from the job of the restored domain where the driver reports one.
+     * @param info file, dxml?, flags?, options? | params, flags?, options?;
+     * options { onProgress?, progressIntervalMs?, signal?, timeoutMs? }
+     * @return Promise<Domain | null>, null when the UUID of the image could not be read
+     */
     Napi::Value RestoreDomain(const Napi::CallbackInfo &info);
+
+    /**
+     * Subscribe to lifecycle, reboot, watchdog, io-error and device-removed events of all domains.
+     * Events are dispatched by the native event loop thread and delivered to the listener in batches.
+     * @param info listener(events, dropped), options { events?: string[], maxQueue?: number, coalesce?: boolean }
+     * @return Promise<void>
+     */
+    Napi::Value RegisterDomainEvents(const Napi::CallbackInfo &info);
+
+    Napi::Value DeregisterDomainEvents(const Napi::CallbackInfo &info);
+
+    /**
+     * Open a stream uploading into the storage volume at path.
+     * @param info path, offset?, length? (0 for the whole volume), flags? (virStorageVolUploadFlags)
+     * @return Promise<Stream>
+     */
+    Napi::Value VolumeUpload(const Napi::CallbackInfo &info);
+
+    /**
+     * Open a stream downloading the storage volume at path.
+     * @param info path, offset?, length? (0 for the whole volume), flags? (virStorageVolDownloadFlags)
+     * @return Promise<Stream>
+     */
+    Napi::Value VolumeDownload(const Napi::CallbackInfo &info);
+
+    Napi::Value VolumeTransfer(const Napi::CallbackInfo &info, bool upload);
+
+    /**
+     * virConnectListAllStoragePools.
+     * @param info flags? (virConnectListAllStoragePoolsFlags), options?
+     * @return Promise<StoragePool[]>
+     */
+    Napi::Value ListAllStoragePools(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info name, options?
+     * @return Promise<StoragePool>
+     */
+    Napi::Value LookupStoragePoolByName(const Napi::CallbackInfo &info);
 };
 
 #endif // NODE_LIBVIRT_HYPERVISOR_H
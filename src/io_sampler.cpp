@@ -0,0 +1,305 @@
+//
+// Created by root on 4/18/24.
+//
+
+#include "io_sampler.h"
+#include "addon.h"
+#include "helper/assert.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+//region SAMPLER
+
+IoRateSampler::IoRateSampler(std::vector<virDomainPtr> &&domains, std::vector<IoDevice> &&devices,
+                             std::chrono::milliseconds interval, size_t capacity)
+        : _domains(std::move(domains)), _devices(std::move(devices)), _interval(interval), _capacity(capacity),
+          _previous(_devices.size() * IO_RATE_STRIDE, STATS_MISSING), _ring(capacity * Stride()) {
+}
+
+IoRateSampler::~IoRateSampler() {
+    for (auto domainPtr: _domains) {
+        if (domainPtr) virDomainFree(domainPtr);
+    }
+}
+
+void IoRateSampler::Start() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_running) return;
+    _running = true;
+    _primed = false;
+    auto generation = ++_generation;
+    auto self = shared_from_this();
+    std::thread([self, generation]() {
+        self->Run(generation);
+    }).detach();
+}
+
+void IoRateSampler::Stop() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_running) return;
+    _running = false;
+    /* A thread still inside a poll discards its sample */
+    _generation++;
+    _wake.notify_all();
+}
+
+bool IoRateSampler::Running() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _running;
+}
+
+size_t IoRateSampler::Read(double *target, size_t maxRecords) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto stride = Stride();
+    auto records = std::min(maxRecords, _count);
+    for (size_t i = 0; i < records; i++) {
+        std::memcpy(target + i * stride, _ring.data() + ((_head + i) % _capacity) * stride, stride * sizeof(double));
+    }
+    _head = (_head + records) % _capacity;
+    _count -= records;
+    return records;
+}
+
+size_t IoRateSampler::Pending() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _count;
+}
+
+size_t IoRateSampler::Dropped() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _dropped;
+}
+
+void IoRateSampler::Run(unsigned long generation) {
+    std::vector<uint64_t> counters(_previous.size());
+    std::vector<int> nparams(_devices.size(), 0);
+    auto stride = Stride();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_generation == generation) {
+        lock.unlock();
+        for (size_t i = 0; i < _devices.size(); i++) {
+            ReadCounters(_devices[i], counters.data() + i * IO_RATE_STRIDE, nparams[i]);
+        }
+        auto sampledAt = Clock::now();
+        auto timestamp = std::chrono::duration<double, std::milli>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        lock.lock();
+        if (_generation != generation) break;
+
+        if (_primed) {
+            auto seconds = std::chrono::duration<double>(sampledAt - _previousAt).count();
+            if (_count == _capacity) {
+                _head = (_head + 1) % _capacity;
+                _count--;
+                _dropped++;
+            }
+            auto record = _ring.data() + ((_head + _count) % _capacity) * stride;
+            record[IO_RECORD_TIMESTAMP] = timestamp;
+            for (size_t slot = 0; slot < counters.size(); slot++) {
+                auto current = counters[slot];
+                auto previous = _previous[slot];
+                record[1 + slot] = current == STATS_MISSING || previous == STATS_MISSING || current < previous ||
+                                   seconds <= 0 ? NAN : static_cast<double>(current - previous) / seconds;
+            }
+            _count++;
+        }
+        _previous.swap(counters);
+        _previousAt = sampledAt;
+        _primed = true;
+
+        auto deadline = sampledAt + _interval;
+        _wake.wait_until(lock, deadline, [this, generation]() { return _generation != generation; });
+    }
+}
+
+/**
+ * Negative libvirt counters mean unsupported.
+ */
+static uint64_t Counter(long long value) {
+    return value < 0 ? STATS_MISSING : static_cast<uint64_t>(value);
+}
+
+void IoRateSampler::ReadCounters(const IoDevice &device, uint64_t *counters, int &nparams) {
+    std::fill(counters, counters + IO_RATE_STRIDE, STATS_MISSING);
+    auto domainPtr = _domains[device.domain];
+    if (!domainPtr) return;
+
+    if (device.kind == IoDevice::Interface) {
+        virDomainInterfaceStatsStruct stats;
+        if (virDomainInterfaceStats(domainPtr, device.name.c_str(), &stats, sizeof(stats)) < 0) return;
+        counters[INTERFACE_RATE_RX_BYTES] = Counter(stats.rx_bytes);
+        counters[INTERFACE_RATE_RX_PACKETS] = Counter(stats.rx_packets);
+        counters[INTERFACE_RATE_RX_ERRS] = Counter(stats.rx_errs);
+        counters[INTERFACE_RATE_RX_DROP] = Counter(stats.rx_drop);
+        counters[INTERFACE_RATE_TX_BYTES] = Counter(stats.tx_bytes);
+        counters[INTERFACE_RATE_TX_PACKETS] = Counter(stats.tx_packets);
+        counters[INTERFACE_RATE_TX_ERRS] = Counter(stats.tx_errs);
+        counters[INTERFACE_RATE_TX_DROP] = Counter(stats.tx_drop);
+        return;
+    }
+
+    if (nparams <= 0 && (virDomainBlockStatsFlags(domainPtr, device.name.c_str(), nullptr, &nparams, 0) < 0 ||
+                         nparams <= 0)) {
+        nparams = 0;
+        return;
+    }
+    std::vector<virTypedParameter> params(nparams);
+    auto count = nparams;
+    if (virDomainBlockStatsFlags(domainPtr, device.name.c_str(), params.data(), &count, 0) < 0) {
+        /* The disk may have been replaced, ask for the parameter count again */
+        nparams = 0;
+        return;
+    }
+    static const struct {
+        const char *field;
+        BlockRateSlot slot;
+    } fields[] = {
+            {VIR_DOMAIN_BLOCK_STATS_READ_REQ,          BLOCK_RATE_RD_REQS},
+            {VIR_DOMAIN_BLOCK_STATS_READ_BYTES,        BLOCK_RATE_RD_BYTES},
+            {VIR_DOMAIN_BLOCK_STATS_WRITE_REQ,         BLOCK_RATE_WR_REQS},
+            {VIR_DOMAIN_BLOCK_STATS_WRITE_BYTES,       BLOCK_RATE_WR_BYTES},
+            {VIR_DOMAIN_BLOCK_STATS_FLUSH_REQ,         BLOCK_RATE_FLUSH_REQS},
+            {VIR_DOMAIN_BLOCK_STATS_READ_TOTAL_TIMES,  BLOCK_RATE_RD_TIME},
+            {VIR_DOMAIN_BLOCK_STATS_WRITE_TOTAL_TIMES, BLOCK_RATE_WR_TIME},
+            {VIR_DOMAIN_BLOCK_STATS_ERRS,              BLOCK_RATE_ERRS},
+    };
+    for (int i = 0; i < count; i++) {
+        if (params[i].type != VIR_TYPED_PARAM_LLONG) continue;
+        for (const auto &field: fields) {
+            if (std::strcmp(params[i].field, field.field) == 0) {
+                counters[field.slot] = Counter(params[i].value.l);
+                break;
+            }
+        }
+    }
+}
+
+//endregion
+
+//region STATIC
+
+Napi::Object IoSampler::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func =
+            DefineClass(env, "IoSampler", {
+                    /* Instance accessors */
+                    InstanceAccessor("devices", &IoSampler::Devices, nullptr),
+                    InstanceAccessor("stride", &IoSampler::Stride, nullptr),
+                    InstanceAccessor("pending", &IoSampler::Pending, nullptr),
+                    InstanceAccessor("dropped", &IoSampler::Dropped, nullptr),
+                    InstanceAccessor("running", &IoSampler::Running, nullptr),
+
+                    /* Instance Methods */
+                    InstanceMethod("start", &IoSampler::Start),
+                    InstanceMethod("stop", &IoSampler::Stop),
+                    InstanceMethod("read", &IoSampler::Read)
+            });
+
+    AddonData::Get(env)->ioSamplerConstructor = Napi::Persistent(func);
+    exports.Set("IoSampler", func);
+    return exports;
+}
+
+Napi::Object IoSampler::New(Napi::Env env, const std::initializer_list<napi_value> &args) {
+    Napi::EscapableHandleScope scope(env);
+    Napi::Object obj = AddonData::Get(env)->ioSamplerConstructor.New(args);
+    return scope.Escape(napi_value(obj)).ToObject();
+}
+
+//endregion
+
+//region INSTANCE
+
+IoSampler::IoSampler(const Napi::CallbackInfo &info) : Napi::ObjectWrap<IoSampler>(info) {
+    Napi::Env env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsExternal()) {
+        Napi::TypeError::New(env, "Expected an external.")
+                .ThrowAsJavaScriptException();
+        return;
+    }
+    auto sampler = info[0].As<Napi::External<std::shared_ptr<IoRateSampler>>>().Data();
+    this->_sampler = std::move(*sampler);
+    delete sampler;
+}
+
+IoSampler::~IoSampler() {
+    if (this->_sampler) this->_sampler->Stop();
+}
+
+//region ACCESSORS
+
+Napi::Value IoSampler::Devices(const Napi::CallbackInfo &info) {
+    assert(this->_sampler, "Sampler not defined");
+    auto env = info.Env();
+    const auto &devices = this->_sampler->Devices();
+    auto result = Napi::Array::New(env, devices.size());
+    for (size_t i = 0; i < devices.size(); i++) {
+        auto device = Napi::Object::New(env);
+        device.Set("domain", Napi::Number::New(env, static_cast<double>(devices[i].domain)));
+        device.Set("type", Napi::String::New(env, devices[i].kind == IoDevice::Block ? "block" : "interface"));
+        device.Set("name", Napi::String::New(env, devices[i].name));
+        result.Set(static_cast<uint32_t>(i), device);
+    }
+    return result;
+}
+
+Napi::Value IoSampler::Stride(const Napi::CallbackInfo &info) {
+    assert(this->_sampler, "Sampler not defined");
+    return Napi::Number::New(info.Env(), static_cast<double>(this->_sampler->Stride()));
+}
+
+Napi::Value IoSampler::Pending(const Napi::CallbackInfo &info) {
+    assert(this->_sampler, "Sampler not defined");
+    return Napi::Number::New(info.Env(), static_cast<double>(this->_sampler->Pending()));
+}
+
+Napi::Value IoSampler::Dropped(const Napi::CallbackInfo &info) {
+    assert(this->_sampler, "Sampler not defined");
+    return Napi::Number::New(info.Env(), static_cast<double>(this->_sampler->Dropped()));
+}
+
+Napi::Value IoSampler::Running(const Napi::CallbackInfo &info) {
+    assert(this->_sampler, "Sampler not defined");
+    return Napi::Boolean::New(info.Env(), this->_sampler->Running());
+}
+
+//endregion
+
+//region INSTANCE METHODS
+
+Napi::Value IoSampler::Start(const Napi::CallbackInfo &info) {
+    assert(this->_sampler, "Sampler not defined");
+    this->_sampler->Start();
+    return info.Env().Undefined();
+}
+
+Napi::Value IoSampler::Stop(const Napi::CallbackInfo &info) {
+    assert(this->_sampler, "Sampler not defined");
+    this->_sampler->Stop();
+    return info.Env().Undefined();
+}
+
+Napi::Value IoSampler::Read(const Napi::CallbackInfo &info) {
+    assert(this->_sampler, "Sampler not defined");
+    auto env = info.Env();
+    size_t offset;
+    if (!StatsOffset(info, 1, offset)) return env.Undefined();
+    if (info.Length() <= 0 || !info[0].IsTypedArray() ||
+        info[0].As<Napi::TypedArray>().TypedArrayType() != napi_float64_array) {
+        Napi::TypeError::New(env, "Expected a Float64Array").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto target = info[0].As<Napi::Float64Array>();
+    if (offset > target.ElementLength()) {
+        Napi::RangeError::New(env, "Offset out of range").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto records = (target.ElementLength() - offset) / this->_sampler->Stride();
+    return Napi::Number::New(env, static_cast<double>(this->_sampler->Read(target.Data() + offset, records)));
+}
+
+//endregion
+
+//endregion
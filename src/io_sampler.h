@@ -0,0 +1,167 @@
+//
+// Created by root on 4/18/24.
+//
+
+#ifndef NODE_LIBVIRT_IO_SAMPLER_H
+#define NODE_LIBVIRT_IO_SAMPLER_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "helper/stats_layout.h"
+
+struct IoDevice {
+    enum Kind {
+        Block, Interface
+    } kind;
+    /** Index into the domains of the sampler */
+    size_t domain;
+    /** Disk target (vda) or interface device (vnet0) */
+    std::string name;
+};
+
+/**
+ * Polls virDomainBlockStatsFlags / virDomainInterfaceStats of a fixed device set on its own thread and keeps the
+ * per second rates in a ring buffer of records, see BlockRateSlot / InterfaceRateSlot for the layout.
+ *
+ * The first record is written one interval after Start since rates need two samples. When JavaScript falls behind,
+ * the oldest records are overwritten and counted as dropped. A counter that went backwards (guest restarted) or
+ * could not be read yields NaN for that interval.
+ */
+class IoRateSampler : public std::enable_shared_from_this<IoRateSampler> {
+public:
+    static const size_t MaxCapacity = 65536;
+
+    /**
+     * Takes ownership of the domain references.
+     */
+    IoRateSampler(std::vector<virDomainPtr> &&domains, std::vector<IoDevice> &&devices,
+                  std::chrono::milliseconds interval, size_t capacity);
+
+    ~IoRateSampler();
+
+    /**
+     * Start the sampling thread, it holds a reference on the sampler until Stop.
+     */
+    void Start();
+
+    /**
+     * The thread exits after its current poll, thread safe.
+     */
+    void Stop();
+
+    bool Running();
+
+    /** Slots per record */
+    size_t Stride() const {
+        return 1 + _devices.size() * IO_RATE_STRIDE;
+    }
+
+    const std::vector<IoDevice> &Devices() const {
+        return _devices;
+    }
+
+    std::chrono::milliseconds Interval() const {
+        return _interval;
+    }
+
+    /**
+     * Move up to maxRecords of the oldest records into target.
+     * @return number of records written
+     */
+    size_t Read(double *target, size_t maxRecords);
+
+    size_t Pending();
+
+    size_t Dropped();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    void Run(unsigned long generation);
+
+    /**
+     * Raw counters of a device in slot order, STATS_MISSING where unavailable.
+     * @param nparams cached virDomainBlockStatsFlags parameter count, 0 to query it
+     */
+    void ReadCounters(const IoDevice &device, uint64_t *counters, int &nparams);
+
+    std::vector<virDomainPtr> _domains;
+    const std::vector<IoDevice> _devices;
+    const std::chrono::milliseconds _interval;
+    const size_t _capacity;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    bool _running = false;
+    unsigned long _generation = 0;
+
+    std::vector<uint64_t> _previous;
+    Clock::time_point _previousAt;
+    bool _primed = false;
+
+    std::vector<double> _ring;
+    size_t _head = 0;
+    size_t _count = 0;
+    size_t _dropped = 0;
+};
+
+/**
+ * JavaScript handle of an IoRateSampler, created by Hypervisor.createIoSampler. Collecting it stops the sampler.
+ */
+class IoSampler : public Napi::ObjectWrap<IoSampler> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+    static Napi::Object New(Napi::Env env, const std::initializer_list<napi_value> &args);
+
+    /**
+     * @param info External<std::shared_ptr<IoRateSampler>>, the wrapper takes ownership of the heap allocated pointer
+     */
+    explicit IoSampler(const Napi::CallbackInfo &info);
+
+    ~IoSampler() override;
+
+private:
+
+//region ACCESSORS
+
+    /**
+     * [{ domain: index, type: "block" | "interface", name }] in record order
+     */
+    Napi::Value Devices(const Napi::CallbackInfo &info);
+
+    Napi::Value Stride(const Napi::CallbackInfo &info);
+
+    Napi::Value Pending(const Napi::CallbackInfo &info);
+
+    Napi::Value Dropped(const Napi::CallbackInfo &info);
+
+    Napi::Value Running(const Napi::CallbackInfo &info);
+//endregion
+
+//region INSTANCE METHODS
+
+    Napi::Value Start(const Napi::CallbackInfo &info);
+
+    Napi::Value Stop(const Napi::CallbackInfo &info);
+
+    /**
+     * Move the buffered records into a Float64Array, oldest first; only whole records are written.
+     * @param info target, offset? (element index, defaults to 0)
+     * @return number of records written
+     */
+    Napi::Value Read(const Napi::CallbackInfo &info);
+//endregion
+
+    std::shared_ptr<IoRateSampler> _sampler;
+};
+
+#endif //NODE_LIBVIRT_IO_SAMPLER_H
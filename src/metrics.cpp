@@ -0,0 +1,213 @@
+//
+// Created by root on 4/20/24.
+//
+
+#include "metrics.h"
+#include "executor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+//region HISTOGRAM
+
+/**
+ * Stripe of the calling thread, assigned round robin on first use.
+ */
+static unsigned ThreadStripe() {
+    static std::atomic<unsigned> next{0};
+    static thread_local unsigned stripe = next.fetch_add(1, std::memory_order_relaxed);
+    return stripe;
+}
+
+static unsigned HighestBit(uint64_t value) {
+    unsigned bit = 0;
+    while (value >>= 1) bit++;
+    return bit;
+}
+
+unsigned LatencyHistogram::BucketIndex(uint64_t micros) {
+    if (micros < SubBuckets) return static_cast<unsigned>(micros);
+    auto shift = HighestBit(micros) - SubBucketBits;
+    if (shift > MaxShift) return BucketCount - 1;
+    auto sub = static_cast<unsigned>((micros >> shift) & (SubBuckets - 1));
+    return SubBuckets + shift * SubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::BucketLimit(unsigned index) {
+    if (index < SubBuckets) return index + 1;
+    auto shift = (index - SubBuckets) / SubBuckets;
+    auto sub = (index - SubBuckets) % SubBuckets;
+    return static_cast<uint64_t>(SubBuckets + sub + 1) << shift;
+}
+
+void LatencyHistogram::Record(uint64_t micros) {
+    auto &stripe = _stripes[ThreadStripe() % Stripes];
+    stripe.buckets[BucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+    stripe.sum.fetch_add(micros, std::memory_order_relaxed);
+    auto max = stripe.max.load(std::memory_order_relaxed);
+    while (micros > max && !stripe.max.compare_exchange_weak(max, micros, std::memory_order_relaxed)) {
+    }
+    stripe.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::Read() const {
+    Snapshot snapshot;
+    snapshot.buckets.assign(BucketCount, 0);
+    for (const auto &stripe: _stripes) {
+        snapshot.count += stripe.count.load(std::memory_order_relaxed);
+        snapshot.sum += stripe.sum.load(std::memory_order_relaxed);
+        snapshot.max = std::max(snapshot.max, stripe.max.load(std::memory_order_relaxed));
+        for (unsigned i = 0; i < BucketCount; i++) {
+            snapshot.buckets[i] += stripe.buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+void LatencyHistogram::Reset() {
+    for (auto &stripe: _stripes) {
+        stripe.count.store(0, std::memory_order_relaxed);
+        stripe.sum.store(0, std::memory_order_relaxed);
+        stripe.max.store(0, std::memory_order_relaxed);
+        for (auto &bucket: stripe.buckets) bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+double LatencyHistogram::Snapshot::Percentile(double q) const {
+    uint64_t total = 0;
+    for (auto bucket: buckets) total += bucket;
+    if (total == 0) return 0;
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return static_cast<double>(std::min<uint64_t>(BucketLimit(i) - 1, max));
+        }
+    }
+    return static_cast<double>(max);
+}
+
+//endregion
+
+const char *OperationMetrics::PhaseName(Phase phase) {
+    switch (phase) {
+        case Queue:
+            return "queue";
+        case Call:
+            return "call";
+        case Deliver:
+            return "deliver";
+        default:
+            return "convert";
+    }
+}
+
+//region REGISTRY
+
+OperationMetrics *Metrics::Operation(const char *name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &operation = _operations[name];
+    if (!operation) operation = new OperationMetrics();
+    return operation;
+}
+
+std::vector<std::pair<std::string, OperationMetrics *>> Metrics::Operations() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return std::vector<std::pair<std::string, OperationMetrics *>>(_operations.begin(), _operations.end());
+}
+
+void Metrics::Reset() {
+    for (auto &operation: Operations()) {
+        for (auto &phase: operation.second->phases) phase.Reset();
+        operation.second->errors.store(0, std::memory_order_relaxed);
+        operation.second->cancelled.store(0, std::memory_order_relaxed);
+    }
+}
+
+static std::string Number(double value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+static std::string Label(const std::string &value) {
+    std::string result;
+    for (auto c: value) {
+        if (c == '\\' || c == '"') result.push_back('\\');
+        if (c == '\n') {
+            result += "\\n";
+            continue;
+        }
+        result.push_back(c);
+    }
+    return result;
+}
+
+std::string Metrics::Prometheus() {
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    auto operations = Operations();
+    std::string out;
+
+    out += "# HELP libvirt_operation_seconds Latency of asynchronous bindings by phase.\n";
+    out += "# TYPE libvirt_operation_seconds summary\n";
+    for (const auto &operation: operations) {
+        for (unsigned phase = 0; phase < OperationMetrics::PhaseCount; phase++) {
+            auto snapshot = operation.second->phases[phase].Read();
+            auto labels = "operation=\"" + Label(operation.first) + "\",phase=\"" +
+                          OperationMetrics::PhaseName(static_cast<OperationMetrics::Phase>(phase)) + "\"";
+            for (auto q: quantiles) {
+                /* Quantiles of an empty summary are NaN by convention */
+                out += "libvirt_operation_seconds{" + labels + ",quantile=\"" + Number(q) + "\"} " +
+                       (snapshot.count ? Number(snapshot.Percentile(q) / 1e6) : "NaN") + "\n";
+            }
+            out += "libvirt_operation_seconds_sum{" + labels + "} " + Number(snapshot.sum / 1e6) + "\n";
+            out += "libvirt_operation_seconds_count{" + labels + "} " + Number(snapshot.count) + "\n";
+        }
+    }
+
+    out += "# HELP libvirt_operation_errors_total Asynchronous bindings that rejected with a libvirt error.\n";
+    out += "# TYPE libvirt_operation_errors_total counter\n";
+    for (const auto &operation: operations) {
+        out += "libvirt_operation_errors_total{operation=\"" + Label(operation.first) + "\"} " +
+               Number(operation.second->errors.load(std::memory_order_relaxed)) + "\n";
+    }
+    out += "# HELP libvirt_operation_cancelled_total Asynchronous bindings aborted or timed out.\n";
+    out += "# TYPE libvirt_operation_cancelled_total counter\n";
+    for (const auto &operation: operations) {
+        out += "libvirt_operation_cancelled_total{operation=\"" + Label(operation.first) + "\"} " +
+               Number(operation.second->cancelled.load(std::memory_order_relaxed)) + "\n";
+    }
+
+    static const struct {
+        const char *name;
+        const char *help;
+        const char *type;
+        std::function<double(const Executor::LaneStats &)> value;
+    } gauges[] = {
+            {"libvirt_executor_threads",         "Threads of the executor lane.",                 "gauge",
+                    [](const Executor::LaneStats &stats) -> double { return stats.threads; }},
+            {"libvirt_executor_queued",          "Tasks waiting for an executor thread.",         "gauge",
+                    [](const Executor::LaneStats &stats) -> double { return stats.queued; }},
+            {"libvirt_executor_running",         "Tasks running on the executor lane.",           "gauge",
+                    [](const Executor::LaneStats &stats) -> double { return stats.running; }},
+            {"libvirt_executor_detached",        "Threads still blocked in a cancelled task.",    "gauge",
+                    [](const Executor::LaneStats &stats) -> double { return stats.detached; }},
+            {"libvirt_executor_completed_total", "Tasks completed by the executor lane.",         "counter",
+                    [](const Executor::LaneStats &stats) -> double { return stats.completed; }},
+    };
+    Executor::LaneStats lanes[] = {Executor::Instance().Stats(Executor::Lane::Fast),
+                                   Executor::Instance().Stats(Executor::Lane::Bulk)};
+    for (const auto &gauge: gauges) {
+        out += std::string("# HELP ") + gauge.name + " " + gauge.help + "\n";
+        out += std::string("# TYPE ") + gauge.name + " " + gauge.type + "\n";
+        for (auto lane: {Executor::Lane::Fast, Executor::Lane::Bulk}) {
+            out += std::string(gauge.name) + "{lane=\"" + Executor::LaneName(lane) + "\"} " +
+                   Number(gauge.value(lanes[static_cast<size_t>(lane)])) + "\n";
+        }
+    }
+    return out;
+}
+
+//endregion
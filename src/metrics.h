@@ -0,0 +1,129 @@
+//
+// Created by root on 4/20/24.
+//
+
+#ifndef NODE_LIBVIRT_METRICS_H
+#define NODE_LIBVIRT_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Log-linear latency histogram in microseconds, 8 sub-buckets per power of two (about 12% relative error).
+ *
+ * Recording is a handful of relaxed atomic increments on the stripe of the calling thread, so executor threads
+ * never contend on a lock. Reading sums the stripes and may see a sample that is counted but not yet in its bucket.
+ */
+class LatencyHistogram {
+public:
+    static const unsigned SubBucketBits = 3;
+    static const unsigned SubBuckets = 1u << SubBucketBits;
+    /** Values from 2^(MaxShift + 3) µs (about 76 hours) on share the last bucket */
+    static const unsigned MaxShift = 34;
+    static const unsigned BucketCount = SubBuckets + (MaxShift + 1) * SubBuckets;
+
+    struct Snapshot {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        std::vector<uint64_t> buckets;
+
+        /**
+         * Upper bound of the bucket holding quantile q (0..1), capped at max.
+         */
+        double Percentile(double q) const;
+    };
+
+    void Record(uint64_t micros);
+
+    Snapshot Read() const;
+
+    void Reset();
+
+    static unsigned BucketIndex(uint64_t micros);
+
+    /** First value past the bucket */
+    static uint64_t BucketLimit(unsigned index);
+
+private:
+    static const unsigned Stripes = 4;
+
+    struct Stripe {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+        std::atomic<uint64_t> buckets[BucketCount];
+
+        Stripe() {
+            for (auto &bucket: buckets) bucket.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    Stripe _stripes[Stripes];
+};
+
+/**
+ * Latency of one asynchronous binding split by where the time goes.
+ */
+struct OperationMetrics {
+    enum Phase {
+        /** Waiting in the executor lane for a thread */
+        Queue = 0,
+        /** The async function, i.e. the blocking libvirt calls */
+        Call,
+        /** From the end of the call until the JavaScript thread picked up the result */
+        Deliver,
+        /** Building the JavaScript result and settling the promise */
+        Convert,
+        PhaseCount
+    };
+
+    LatencyHistogram phases[PhaseCount];
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> cancelled{0};
+
+    static const char *PhaseName(Phase phase);
+
+    void Record(Phase phase, std::chrono::steady_clock::duration duration) {
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        phases[phase].Record(micros > 0 ? static_cast<uint64_t>(micros) : 0);
+    }
+};
+
+/**
+ * Process wide registry of OperationMetrics by binding name ("Domain.save"). Entries live as long as the process,
+ * workers keep plain pointers to them.
+ */
+class Metrics {
+public:
+    static Metrics &Instance() {
+        static auto *instance = new Metrics();
+        return *instance;
+    }
+
+    OperationMetrics *Operation(const char *name);
+
+    /** Sorted by name */
+    std::vector<std::pair<std::string, OperationMetrics *>> Operations();
+
+    void Reset();
+
+    /**
+     * Summaries with quantiles and executor lane gauges in the Prometheus text exposition format.
+     */
+    std::string Prometheus();
+
+private:
+    Metrics() = default;
+
+    std::mutex _mutex;
+    std::map<std::string, OperationMetrics *> _operations;
+};
+
+#endif //NODE_LIBVIRT_METRICS_H
@@ -0,0 +1,177 @@
+//
+// Created by root on 4/17/24.
+//
+
+#include "migration.h"
+#include "helper/libvirt_error.h"
+
+#include <libvirt/virterror.h>
+
+#include <stdexcept>
+
+static const TypedParamField MIGRATION_PARAMS[] = {
+        {"uri",                     VIR_MIGRATE_PARAM_URI,                      VIR_TYPED_PARAM_STRING, false},
+        {"destName",                VIR_MIGRATE_PARAM_DEST_NAME,                VIR_TYPED_PARAM_STRING, false},
+        {"destXML",                 VIR_MIGRATE_PARAM_DEST_XML,                 VIR_TYPED_PARAM_STRING, false},
+        {"persistXML",              VIR_MIGRATE_PARAM_PERSIST_XML,              VIR_TYPED_PARAM_STRING, false},
+        {"bandwidth",               VIR_MIGRATE_PARAM_BANDWIDTH,                VIR_TYPED_PARAM_ULLONG, false},
+        {"bandwidthPostcopy",       VIR_MIGRATE_PARAM_BANDWIDTH_POSTCOPY,       VIR_TYPED_PARAM_ULLONG, false},
+        {"graphicsURI",             VIR_MIGRATE_PARAM_GRAPHICS_URI,             VIR_TYPED_PARAM_STRING, false},
+        {"listenAddress",           VIR_MIGRATE_PARAM_LISTEN_ADDRESS,           VIR_TYPED_PARAM_STRING, false},
+        {"migrateDisks",            VIR_MIGRATE_PARAM_MIGRATE_DISKS,            VIR_TYPED_PARAM_STRING, true},
+        {"disksPort",               VIR_MIGRATE_PARAM_DISKS_PORT,               VIR_TYPED_PARAM_INT,    false},
+        {"disksURI",                VIR_MIGRATE_PARAM_DISKS_URI,                VIR_TYPED_PARAM_STRING, false},
+        {"compression",             VIR_MIGRATE_PARAM_COMPRESSION,              VIR_TYPED_PARAM_STRING, true},
+        {"compressionMTLevel",      VIR_MIGRATE_PARAM_COMPRESSION_MT_LEVEL,     VIR_TYPED_PARAM_INT,    false},
+        {"compressionMTThreads",    VIR_MIGRATE_PARAM_COMPRESSION_MT_THREADS,   VIR_TYPED_PARAM_INT,    false},
+        {"compressionMTDThreads",   VIR_MIGRATE_PARAM_COMPRESSION_MT_DTHREADS,  VIR_TYPED_PARAM_INT,    false},
+        {"compressionXBZRLECache",  VIR_MIGRATE_PARAM_COMPRESSION_XBZRLE_CACHE, VIR_TYPED_PARAM_ULLONG, false},
+        {"autoConvergeInitial",     VIR_MIGRATE_PARAM_AUTO_CONVERGE_INITIAL,    VIR_TYPED_PARAM_INT,    false},
+        {"autoConvergeIncrement",   VIR_MIGRATE_PARAM_AUTO_CONVERGE_INCREMENT,  VIR_TYPED_PARAM_INT,    false},
+        {"parallelConnections",     VIR_MIGRATE_PARAM_PARALLEL_CONNECTIONS,     VIR_TYPED_PARAM_INT,    false},
+        {"tlsDestination",          VIR_MIGRATE_PARAM_TLS_DESTINATION,          VIR_TYPED_PARAM_STRING, false},
+};
+
+bool ParseMigrationParams(const Napi::Value &value, TypedParams &params, std::string &error) {
+    if (value.IsUndefined() || value.IsNull()) return true;
+    if (!value.IsObject()) {
+        error = "Migration parameters must be an object";
+        return false;
+    }
+    return TypedParamsFromObject(value.ToObject(), MIGRATION_PARAMS,
+                                 sizeof(MIGRATION_PARAMS) / sizeof(MIGRATION_PARAMS[0]), params, error);
+}
+
+static const TypedParamField SAVE_PARAMS[] = {
+        {"file",             VIR_DOMAIN_SAVE_PARAM_FILE,              VIR_TYPED_PARAM_STRING, false},
+        {"dxml",             VIR_DOMAIN_SAVE_PARAM_DXML,              VIR_TYPED_PARAM_STRING, false},
+        {"imageFormat",      VIR_DOMAIN_SAVE_PARAM_IMAGE_FORMAT,      VIR_TYPED_PARAM_STRING, false},
+        {"parallelChannels", VIR_DOMAIN_SAVE_PARAM_PARALLEL_CHANNELS, VIR_TYPED_PARAM_INT,    false},
+};
+
+bool ParseSaveParams(const Napi::Value &value, TypedParams &params, std::string &error) {
+    if (value.IsUndefined() || value.IsNull()) return true;
+    if (!value.IsObject()) {
+        error = "Save parameters must be an object";
+        return false;
+    }
+    return TypedParamsFromObject(value.ToObject(), SAVE_PARAMS, sizeof(SAVE_PARAMS) / sizeof(SAVE_PARAMS[0]),
+                                 params, error);
+}
+
+TypedParams SaveFileParams(const std::string &file, const std::string &dxml) {
+    TypedParams params;
+    TypedParam param;
+    param.field = VIR_DOMAIN_SAVE_PARAM_FILE;
+    param.type = VIR_TYPED_PARAM_STRING;
+    param.s = file;
+    params.push_back(param);
+    if (!dxml.empty()) {
+        param.field = VIR_DOMAIN_SAVE_PARAM_DXML;
+        param.s = dxml;
+        params.push_back(param);
+    }
+    return params;
+}
+
+bool ReadProgressOptions(Napi::Env env, const Napi::Value &options, const char *name,
+                         Napi::ThreadSafeFunction &listener, std::chrono::milliseconds &interval) {
+    interval = std::chrono::milliseconds(1000);
+    if (!options.IsObject()) return false;
+    auto object = options.ToObject();
+    if (object.Get("progressIntervalMs").IsNumber()) {
+        auto ms = object.Get("progressIntervalMs").ToNumber().Int64Value();
+        interval = std::chrono::milliseconds(ms < 50 ? 50 : ms);
+    }
+    if (!object.Get("onProgress").IsFunction()) return false;
+    /* A small queue, samples are dropped while the listener is behind */
+    listener = Napi::ThreadSafeFunction::New(env, object.Get("onProgress").As<Napi::Function>(), name, 2, 1);
+    return true;
+}
+
+JobStats GetJobStats(virDomainPtr domain, unsigned int flags) {
+    JobStats stats;
+    virTypedParameterPtr params = nullptr;
+    int nparams = 0;
+    if (virDomainGetJobStats(domain, &stats.type, &params, &nparams, flags) < 0) {
+        throw LibvirtError("Failed to get job stats");
+    }
+    stats.params = CopyTypedParams(params, nparams);
+    virTypedParamsFree(params, nparams);
+    return stats;
+}
+
+static const char *JobTypeName(int type) {
+    switch (type) {
+        case VIR_DOMAIN_JOB_BOUNDED:
+            return "bounded";
+        case VIR_DOMAIN_JOB_UNBOUNDED:
+            return "unbounded";
+        case VIR_DOMAIN_JOB_COMPLETED:
+            return "completed";
+        case VIR_DOMAIN_JOB_FAILED:
+            return "failed";
+        case VIR_DOMAIN_JOB_CANCELLED:
+            return "cancelled";
+        default:
+            return "none";
+    }
+}
+
+Napi::Object JobStatsToObject(Napi::Env env, const JobStats &stats) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("type", Napi::String::New(env, JobTypeName(stats.type)));
+    for (const auto &param: stats.params) {
+        obj.Set(CamelCaseField(param.field), TypedParamToValue(env, param));
+    }
+    return obj;
+}
+
+JobProgressSampler::JobProgressSampler(virDomainPtr domain, Napi::ThreadSafeFunction listener,
+                                       std::chrono::milliseconds interval)
+        : _domain(domain), _listener(listener), _interval(interval) {
+    _thread = std::thread(&JobProgressSampler::Run, this);
+}
+
+JobProgressSampler::JobProgressSampler(virConnectPtr conn, const std::string &uuid,
+                                       Napi::ThreadSafeFunction listener, std::chrono::milliseconds interval)
+        : _domain(nullptr), _conn(conn), _uuid(uuid), _listener(listener), _interval(interval) {
+    _thread = std::thread(&JobProgressSampler::Run, this);
+}
+
+JobProgressSampler::~JobProgressSampler() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _stopped.notify_all();
+    _thread.join();
+    if (_conn && _domain) virDomainFree(_domain);
+}
+
+void JobProgressSampler::Run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopped.wait_for(lock, _interval, [this]() { return _stop; })) {
+        lock.unlock();
+        if (!_domain && _conn) _domain = virDomainLookupByUUIDString(_conn, _uuid.c_str());
+        JobStats *stats = nullptr;
+        try {
+            if (_domain) stats = new JobStats(GetJobStats(_domain, 0));
+        } catch (const std::exception &) {
+            /* The job may not have started yet or just ended */
+        }
+        if (stats && stats->type != VIR_DOMAIN_JOB_NONE) {
+            auto status = _listener.NonBlockingCall(stats, [](Napi::Env env, Napi::Function listener, JobStats *stats) {
+                if (env != nullptr) {
+                    listener.Call({JobStatsToObject(env, *stats)});
+                }
+                delete stats;
+            });
+            /* Queue full: the listener is still busy with an earlier sample */
+            if (status != napi_ok) delete stats;
+        } else {
+            delete stats;
+        }
+        lock.lock();
+    }
+}
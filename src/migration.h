@@ -0,0 +1,99 @@
+//
+// Created by root on 4/17/24.
+//
+
+#ifndef NODE_LIBVIRT_MIGRATION_H
+#define NODE_LIBVIRT_MIGRATION_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "helper/typed_params.h"
+
+/**
+ * Copy of virDomainGetJobStats, type is a virDomainJobType.
+ */
+struct JobStats {
+    int type = VIR_DOMAIN_JOB_NONE;
+    TypedParams params;
+};
+
+/**
+ * Read virDomainMigrateToURI3 parameters from their camelCase names (destName, bandwidth, migrateDisks, ...).
+ * @return false with a message in error on a value of the wrong type
+ */
+bool ParseMigrationParams(const Napi::Value &value, TypedParams &params, std::string &error);
+
+/**
+ * Read virDomainSaveParams / virDomainRestoreParams parameters (file, dxml, imageFormat, parallelChannels).
+ * @return false with a message in error on a value of the wrong type
+ */
+bool ParseSaveParams(const Napi::Value &value, TypedParams &params, std::string &error);
+
+/**
+ * file and dxml (when not empty) as save parameters, for the positional forms of save and restore with
+ * VIR_DOMAIN_SAVE_PARALLEL which only virDomainSaveParams / virDomainRestoreParams accept.
+ */
+TypedParams SaveFileParams(const std::string &file, const std::string &dxml);
+
+/**
+ * onProgress and progressIntervalMs (default 1000, at least 50) of an options object. Creates the listener for a
+ * JobProgressSampler, the caller releases it once the job ended.
+ * @return whether options had a listener
+ */
+bool ReadProgressOptions(Napi::Env env, const Napi::Value &options, const char *name,
+                         Napi::ThreadSafeFunction &listener, std::chrono::milliseconds &interval);
+
+/**
+ * Throws std::runtime_error with the libvirt error.
+ */
+JobStats GetJobStats(virDomainPtr domain, unsigned int flags);
+
+/**
+ * type plus every job field in camelCase, e.g. data_remaining -> dataRemaining.
+ */
+Napi::Object JobStatsToObject(Napi::Env env, const JobStats &stats);
+
+/**
+ * Samples the job statistics of a domain on its own thread while a worker is blocked in a migration, save or
+ * restore call, and hands them to a JavaScript listener. Samples are dropped while the listener falls behind.
+ */
+class JobProgressSampler {
+public:
+    JobProgressSampler(virDomainPtr domain, Napi::ThreadSafeFunction listener, std::chrono::milliseconds interval);
+
+    /**
+     * For a domain that does not exist yet, as during a restore: it is looked up by UUID on every sample until
+     * found. Samples are only reported where the driver tracks the job.
+     */
+    JobProgressSampler(virConnectPtr conn, const std::string &uuid, Napi::ThreadSafeFunction listener,
+                       std::chrono::milliseconds interval);
+
+    /**
+     * Stops and joins the sampling thread, the listener is not released.
+     */
+    ~JobProgressSampler();
+
+private:
+    void Run();
+
+    virDomainPtr _domain;
+    /** Set when the domain is looked up by UUID, the reference is then owned by the sampler */
+    virConnectPtr _conn = nullptr;
+    std::string _uuid;
+    Napi::ThreadSafeFunction _listener;
+    std::chrono::milliseconds _interval;
+
+    std::mutex _mutex;
+    std::condition_variable _stopped;
+    bool _stop = false;
+    std::thread _thread;
+};
+
+#endif //NODE_LIBVIRT_MIGRATION_H
@@ -4,21 +4,178 @@
 #include <napi.h>
 #include "domain.h"
 #include "hypervisor.h"
+#include "stream.h"
+#include "io_sampler.h"
+#include "storage_pool.h"
+#include "storage_volume.h"
+#include "balloon_controller.h"
+#include "event_loop.h"
+#include "executor.h"
+#include "metrics.h"
+#include "connection_registry.h"
+#include "addon.h"
+#include "helper/libvirt_error.h"
+
+#include <libxml/parser.h>
+
+#include <mutex>
 
 
 Napi::Number GetVersion(const Napi::CallbackInfo &info) {
     return Napi::Number::New(info.Env(), LIBVIR_VERSION_NUMBER);
 }
 
+static Napi::Object LaneStatsToObject(Napi::Env env, const Executor::LaneStats &stats) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("threads", Napi::Number::New(env, stats.threads));
+    obj.Set("queued", Napi::Number::New(env, stats.queued));
+    obj.Set("running", Napi::Number::New(env, stats.running));
+    obj.Set("detached", Napi::Number::New(env, stats.detached));
+    obj.Set("submitted", Napi::Number::New(env, stats.submitted));
+    obj.Set("completed", Napi::Number::New(env, stats.completed));
+    obj.Set("totalWaitMs", Napi::Number::New(env, stats.totalWaitMs));
+    obj.Set("maxWaitMs", Napi::Number::New(env, stats.maxWaitMs));
+    obj.Set("totalRunMs", Napi::Number::New(env, stats.totalRunMs));
+    obj.Set("maxRunMs", Napi::Number::New(env, stats.maxRunMs));
+    return obj;
+}
+
+/**
+ * Queue depth and latency of each executor lane.
+ */
+Napi::Value GetExecutorStats(const Napi::CallbackInfo &info) {
+    auto env = info.Env();
+    auto result = Napi::Object::New(env);
+    for (auto lane: {Executor::Lane::Fast, Executor::Lane::Bulk}) {
+        result.Set(Executor::LaneName(lane), LaneStatsToObject(env, Executor::Instance().Stats(lane)));
+    }
+    return result;
+}
+
+/**
+ * Set the thread count of the executor lanes: { fast?: number, bulk?: number }.
+ */
+Napi::Value ConfigureExecutor(const Napi::CallbackInfo &info) {
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto config = info[0].ToObject();
+    for (auto lane: {Executor::Lane::Fast, Executor::Lane::Bulk}) {
+        auto threads = config.Get(Executor::LaneName(lane));
+        if (!threads.IsNumber()) continue;
+        if (threads.ToNumber().Int64Value() < 1) {
+            Napi::RangeError::New(env, "Thread count must be at least 1").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        Executor::Instance().Configure(lane, threads.ToNumber().Uint32Value());
+    }
+    return GetExecutorStats(info);
+}
+
+static Napi::Object HistogramToObject(Napi::Env env, const LatencyHistogram::Snapshot &snapshot) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("count", Napi::Number::New(env, static_cast<double>(snapshot.count)));
+    obj.Set("totalMs", Napi::Number::New(env, snapshot.sum / 1000.0));
+    obj.Set("maxMs", Napi::Number::New(env, snapshot.max / 1000.0));
+    obj.Set("p50", Napi::Number::New(env, snapshot.Percentile(0.5) / 1000.0));
+    obj.Set("p90", Napi::Number::New(env, snapshot.Percentile(0.9) / 1000.0));
+    obj.Set("p99", Napi::Number::New(env, snapshot.Percentile(0.99) / 1000.0));
+    obj.Set("p999", Napi::Number::New(env, snapshot.Percentile(0.999) / 1000.0));
+    return obj;
+}
+
+/**
+ * Latency histograms of the asynchronous bindings and executor lane stats.
+ * { format: "prometheus" } returns the text exposition format instead.
+ */
+Napi::Value GetMetrics(const Napi::CallbackInfo &info) {
+    auto env = info.Env();
+    if (info.Length() > 0 && info[0].IsObject()) {
+        auto format = info[0].ToObject().Get("format");
+        if (format.IsString() && format.ToString().Utf8Value() == "prometheus") {
+            return Napi::String::New(env, Metrics::Instance().Prometheus());
+        }
+    }
+    auto operations = Napi::Object::New(env);
+    for (const auto &operation: Metrics::Instance().Operations()) {
+        auto obj = Napi::Object::New(env);
+        for (unsigned phase = 0; phase < OperationMetrics::PhaseCount; phase++) {
+            obj.Set(OperationMetrics::PhaseName(static_cast<OperationMetrics::Phase>(phase)),
+                    HistogramToObject(env, operation.second->phases[phase].Read()));
+        }
+        obj.Set("errors", Napi::Number::New(env, static_cast<double>(operation.second->errors.load())));
+        obj.Set("cancelled", Napi::Number::New(env, static_cast<double>(operation.second->cancelled.load())));
+        operations.Set(operation.first, obj);
+    }
+    auto result = Napi::Object::New(env);
+    result.Set("operations", operations);
+    result.Set("executor", GetExecutorStats(info));
+    return result;
+}
+
+Napi::Value ResetMetrics(const Napi::CallbackInfo &info) {
+    Metrics::Instance().Reset();
+    return info.Env().Undefined();
+}
+
+/**
+ * Pools of the Hypervisors created with shared: true, across all worker_threads.
+ */
+Napi::Value GetSharedConnections(const Napi::CallbackInfo &info) {
+    auto env = info.Env();
+    auto stats = ConnectionRegistry::Instance().GetStats();
+    auto result = Napi::Array::New(env, stats.size());
+    for (size_t i = 0; i < stats.size(); i++) {
+        auto obj = Napi::Object::New(env);
+        obj.Set("uri", Napi::String::New(env, stats[i].uri));
+        obj.Set("readOnly", Napi::Boolean::New(env, stats[i].readonly));
+        obj.Set("users", Napi::Number::New(env, static_cast<double>(stats[i].users)));
+        obj.Set("holders", Napi::Number::New(env, static_cast<double>(stats[i].holders)));
+        obj.Set("state", Napi::String::New(env, ConnectionPool::StateName(stats[i].state)));
+        result.Set(static_cast<uint32_t>(i), obj);
+    }
+    return result;
+}
+
+/**
+ * Runs once per environment: the main thread and every worker_thread loading the addon.
+ * Process wide state (libvirt, the event loop, executor and connection registry) is shared between them,
+ * everything holding JavaScript values lives in the environment's AddonData.
+ */
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
     auto result = virInitialize();
     if (result < 0) {
-        Napi::Error::New(env, virGetLastError()->message).ThrowAsJavaScriptException();
+        Napi::Error::New(env, LastErrorMessage("Failed to initialize libvirt")).ThrowAsJavaScriptException();
         return exports;
     }
+    /* XML projections parse on executor threads, libxml2 must be initialized before that */
+    static std::once_flag xmlInitialized;
+    std::call_once(xmlInitialized, xmlInitParser);
+    if (EventLoop::Start() < 0) {
+        Napi::Error::New(env, LastErrorMessage("Failed to start the event loop")).ThrowAsJavaScriptException();
+        return exports;
+    }
+    auto addon = new AddonData();
+    addon->completions = Napi::ThreadSafeFunction::New(
+            env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "libvirt.completions", 0, 1);
+    addon->completions.Unref(env);
+    env.SetInstanceData(addon);
+
     Domain::Init(env, exports);
+    Stream::Init(env, exports);
+    IoSampler::Init(env, exports);
+    StoragePool::Init(env, exports);
+    StorageVolume::Init(env, exports);
+    BalloonController::Init(env, exports);
     Hypervisor::Init(env, exports);
     exports.Set("GetVersion", Napi::Function::New(env, GetVersion));
+    exports.Set("GetExecutorStats", Napi::Function::New(env, GetExecutorStats));
+    exports.Set("ConfigureExecutor", Napi::Function::New(env, ConfigureExecutor));
+    exports.Set("GetMetrics", Napi::Function::New(env, GetMetrics));
+    exports.Set("ResetMetrics", Napi::Function::New(env, ResetMetrics));
+    exports.Set("GetSharedConnections", Napi::Function::New(env, GetSharedConnections));
     return exports;
 }
 
@@ -0,0 +1,248 @@
+//
+// Created by root on 4/21/24.
+//
+
+#include "snapshots.h"
+#include "helper/libvirt_error.h"
+#include "xml_projection.h"
+
+#include <libvirt/virterror.h>
+
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+//region HELPERS
+
+/**
+ * Snapshot handles returned by virDomainListAllSnapshots, freed on scope exit.
+ */
+class SnapshotList {
+public:
+    SnapshotList(virDomainPtr domain, unsigned int flags) {
+        _count = virDomainListAllSnapshots(domain, &_items, flags);
+        if (_count < 0) throw LibvirtError("Failed to list snapshots");
+    }
+
+    ~SnapshotList() {
+        for (int i = 0; i < _count; i++) virDomainSnapshotFree(_items[i]);
+        free(_items);
+    }
+
+    SnapshotList(const SnapshotList &) = delete;
+
+    SnapshotList &operator=(const SnapshotList &) = delete;
+
+    size_t Size() const {
+        return static_cast<size_t>(_count);
+    }
+
+    virDomainSnapshotPtr operator[](size_t index) const {
+        return _items[index];
+    }
+
+private:
+    virDomainSnapshotPtr *_items = nullptr;
+    int _count = 0;
+};
+
+static std::string SnapshotName(virDomainSnapshotPtr snapshot) {
+    auto name = virDomainSnapshotGetName(snapshot);
+    return name ? name : "";
+}
+
+/**
+ * Fill parent, creationTime, state and description from the snapshot XML.
+ */
+static void ReadDetails(virDomainSnapshotPtr snapshot, SnapshotInfo &info, bool keepXml) {
+    static const XmlSelectors selectors = {
+            {"parent",       "string(/domainsnapshot/parent/name)"},
+            {"creationTime", "number(/domainsnapshot/creationTime)"},
+            {"state",        "string(/domainsnapshot/state)"},
+            {"description",  "string(/domainsnapshot/description)"},
+    };
+    auto xmlDesc = virDomainSnapshotGetXMLDesc(snapshot, 0);
+    if (!xmlDesc) throw LibvirtError("Failed to get snapshot XML");
+    std::string xml(xmlDesc);
+    free(xmlDesc);
+
+    for (const auto &entry: ProjectXml(xml, selectors)) {
+        if (entry.first == "parent") {
+            info.parent = entry.second.string;
+        } else if (entry.first == "creationTime") {
+            info.creationTime = entry.second.number;
+        } else if (entry.first == "state") {
+            info.state = entry.second.string;
+        } else if (entry.first == "description") {
+            info.description = entry.second.string;
+        }
+    }
+    info.detailed = true;
+    if (keepXml) info.xml = std::move(xml);
+}
+
+/**
+ * Link children to their parents and order the snapshots depth first from the roots, siblings keep the listing
+ * order. A parent filtered out of the listing makes its children roots.
+ */
+static std::vector<SnapshotInfo> BuildTree(std::vector<SnapshotInfo> &&snapshots) {
+    std::map<std::string, size_t> index;
+    for (size_t i = 0; i < snapshots.size(); i++) index[snapshots[i].name] = i;
+
+    std::vector<std::vector<size_t>> children(snapshots.size());
+    std::vector<size_t> roots;
+    for (size_t i = 0; i < snapshots.size(); i++) {
+        auto parent = snapshots[i].parent.empty() ? index.end() : index.find(snapshots[i].parent);
+        if (parent == index.end()) {
+            roots.push_back(i);
+        } else {
+            children[parent->second].push_back(i);
+            snapshots[parent->second].children.push_back(snapshots[i].name);
+        }
+    }
+
+    std::vector<SnapshotInfo> ordered;
+    ordered.reserve(snapshots.size());
+    std::vector<bool> visited(snapshots.size(), false);
+    std::vector<size_t> stack(roots.rbegin(), roots.rend());
+    while (!stack.empty()) {
+        auto i = stack.back();
+        stack.pop_back();
+        if (visited[i]) continue;
+        visited[i] = true;
+        stack.insert(stack.end(), children[i].rbegin(), children[i].rend());
+        ordered.push_back(std::move(snapshots[i]));
+    }
+    return ordered;
+}
+
+//endregion
+
+std::vector<SnapshotInfo> ListSnapshots(virDomainPtr domain, const SnapshotListOptions &options) {
+    SnapshotList list(domain, options.flags);
+    std::vector<SnapshotInfo> snapshots(list.Size());
+    for (size_t i = 0; i < list.Size(); i++) snapshots[i].name = SnapshotName(list[i]);
+
+    std::string current;
+    auto hasCurrent = virDomainHasCurrentSnapshot(domain, 0);
+    if (hasCurrent < 0) throw LibvirtError("Failed to get the current snapshot");
+    if (hasCurrent > 0) {
+        auto snapshot = virDomainSnapshotCurrent(domain, 0);
+        /* Deleted in between, there is no current snapshot anymore */
+        if (snapshot) {
+            current = SnapshotName(snapshot);
+            virDomainSnapshotFree(snapshot);
+        }
+    }
+    for (auto &snapshot: snapshots) snapshot.current = snapshot.name == current;
+
+    if (options.details || options.xml) {
+        /* The XML names the parent, no separate lookup needed */
+        for (size_t i = 0; i < list.Size(); i++) ReadDetails(list[i], snapshots[i], options.xml);
+    } else if (!snapshots.empty()) {
+        std::set<std::string> roots;
+        {
+            SnapshotList rootList(domain, VIR_DOMAIN_SNAPSHOT_LIST_ROOTS);
+            for (size_t i = 0; i < rootList.Size(); i++) roots.insert(SnapshotName(rootList[i]));
+        }
+        for (size_t i = 0; i < list.Size(); i++) {
+            if (roots.count(snapshots[i].name)) continue;
+            auto parent = virDomainSnapshotGetParent(list[i], 0);
+            if (!parent) throw LibvirtError("Failed to get snapshot parent");
+            snapshots[i].parent = SnapshotName(parent);
+            virDomainSnapshotFree(parent);
+        }
+    }
+    return BuildTree(std::move(snapshots));
+}
+
+SnapshotInfo DescribeSnapshot(virDomainSnapshotPtr snapshot, bool xml) {
+    SnapshotInfo info;
+    info.name = SnapshotName(snapshot);
+    ReadDetails(snapshot, info, xml);
+    auto current = virDomainSnapshotIsCurrent(snapshot, 0);
+    if (current < 0) throw LibvirtError("Failed to get snapshot state");
+    info.current = current > 0;
+    return info;
+}
+
+std::vector<DomainSnapshots> ListDomainsSnapshots(std::vector<virDomainPtr> &&domains,
+                                                  const SnapshotListOptions &options) {
+    std::vector<DomainSnapshots> batch(domains.size());
+    for (size_t i = 0; i < domains.size(); i++) {
+        auto &entry = batch[i];
+        entry.domain = domains[i];
+        if (!entry.domain) {
+            entry.error = "Domain not defined";
+            continue;
+        }
+        try {
+            entry.snapshots = ListSnapshots(entry.domain, options);
+        } catch (const std::exception &e) {
+            entry.error = e.what();
+        }
+    }
+    domains.clear();
+    return batch;
+}
+
+//region CONVERSION
+
+Napi::Object SnapshotInfoToObject(Napi::Env env, const SnapshotInfo &snapshot) {
+    auto obj = Napi::Object::New(env);
+    obj.Set("name", Napi::String::New(env, snapshot.name));
+    obj.Set("parent", snapshot.parent.empty() ? env.Null() : Napi::String::New(env, snapshot.parent));
+    auto children = Napi::Array::New(env, snapshot.children.size());
+    for (size_t i = 0; i < snapshot.children.size(); i++) {
+        children.Set(static_cast<uint32_t>(i), Napi::String::New(env, snapshot.children[i]));
+    }
+    obj.Set("children", children);
+    obj.Set("current", Napi::Boolean::New(env, snapshot.current));
+    if (snapshot.detailed) {
+        obj.Set("creationTime", Napi::Number::New(env, snapshot.creationTime));
+        obj.Set("state", Napi::String::New(env, snapshot.state));
+        obj.Set("description", Napi::String::New(env, snapshot.description));
+    }
+    if (!snapshot.xml.empty()) obj.Set("xml", Napi::String::New(env, snapshot.xml));
+    return obj;
+}
+
+Napi::Array SnapshotsToArray(Napi::Env env, const std::vector<SnapshotInfo> &snapshots) {
+    auto array = Napi::Array::New(env, snapshots.size());
+    for (size_t i = 0; i < snapshots.size(); i++) {
+        array.Set(static_cast<uint32_t>(i), SnapshotInfoToObject(env, snapshots[i]));
+    }
+    return array;
+}
+
+Napi::Array DomainSnapshotsToArray(Napi::Env env, std::vector<DomainSnapshots> &batch, DomainRegistry &registry) {
+    auto array = Napi::Array::New(env, batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        auto &entry = batch[i];
+        auto obj = Napi::Object::New(env);
+        if (entry.domain) {
+            obj.Set("domain", registry.Wrap(env, entry.domain));
+            entry.domain = nullptr;
+        } else {
+            obj.Set("domain", env.Null());
+        }
+        if (entry.error.empty()) {
+            obj.Set("snapshots", SnapshotsToArray(env, entry.snapshots));
+        } else {
+            obj.Set("error", Napi::Error::New(env, entry.error).Value());
+        }
+        array.Set(static_cast<uint32_t>(i), obj);
+    }
+    return array;
+}
+
+void ReadSnapshotListOptions(const Napi::Value &value, SnapshotListOptions &options) {
+    if (!value.IsObject()) return;
+    auto object = value.ToObject();
+    if (object.Get("flags").IsNumber()) options.flags = object.Get("flags").ToNumber().Uint32Value();
+    if (object.Get("details").IsBoolean()) options.details = object.Get("details").ToBoolean().Value();
+    if (object.Get("xml").IsBoolean()) options.xml = object.Get("xml").ToBoolean().Value();
+}
+
+//endregion
@@ -0,0 +1,86 @@
+//
+// Created by root on 4/21/24.
+//
+
+#ifndef NODE_LIBVIRT_SNAPSHOTS_H
+#define NODE_LIBVIRT_SNAPSHOTS_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <string>
+#include <vector>
+
+#include "domain_registry.h"
+
+struct SnapshotInfo {
+    std::string name;
+    /** Empty for a root snapshot */
+    std::string parent;
+    /** Names of the direct children among the listed snapshots */
+    std::vector<std::string> children;
+    bool current = false;
+    /** Set when details were requested */
+    bool detailed = false;
+    /** Seconds since the epoch */
+    double creationTime = 0;
+    std::string state;
+    std::string description;
+    /** Set when the XML was requested */
+    std::string xml;
+};
+
+struct SnapshotListOptions {
+    /** virDomainSnapshotListFlags filtering the listed snapshots */
+    unsigned int flags = 0;
+    /** Fetch the XML of every snapshot for creationTime, state and description */
+    bool details = false;
+    /** Keep the XML, implies details */
+    bool xml = false;
+};
+
+/**
+ * Snapshots of one domain in topological order (parents before children) with parent links.
+ *
+ * Without details this costs one round trip to list, one for the roots and the current snapshot and one
+ * virDomainSnapshotGetParent per non-root snapshot. Details replace the parent lookups with one XML fetch per
+ * snapshot, parsed on the calling thread. Blocks and throws std::runtime_error, use it on a worker thread.
+ */
+std::vector<SnapshotInfo> ListSnapshots(virDomainPtr domain, const SnapshotListOptions &options);
+
+/**
+ * Parent, current flag and the details of a single snapshot, throws std::runtime_error.
+ */
+SnapshotInfo DescribeSnapshot(virDomainSnapshotPtr snapshot, bool xml);
+
+/**
+ * Snapshots of several domains gathered in one batch. Errors are kept per domain.
+ */
+struct DomainSnapshots {
+    /** Referenced, ownership moves to the registry in DomainSnapshotsToArray */
+    virDomainPtr domain = nullptr;
+    std::vector<SnapshotInfo> snapshots;
+    std::string error;
+};
+
+/**
+ * @param domains referenced handles, null entries are reported as errors, every handle ends in the result
+ */
+std::vector<DomainSnapshots> ListDomainsSnapshots(std::vector<virDomainPtr> &&domains,
+                                                  const SnapshotListOptions &options);
+
+Napi::Object SnapshotInfoToObject(Napi::Env env, const SnapshotInfo &snapshot);
+
+Napi::Array SnapshotsToArray(Napi::Env env, const std::vector<SnapshotInfo> &snapshots);
+
+/**
+ * Must be called on the JavaScript thread.
+ */
+Napi::Array DomainSnapshotsToArray(Napi::Env env, std::vector<DomainSnapshots> &batch, DomainRegistry &registry);
+
+/**
+ * Read { flags?, details?, xml? } from options, leaves the defaults for anything else.
+ */
+void ReadSnapshotListOptions(const Napi::Value &value, SnapshotListOptions &options);
+
+#endif //NODE_LIBVIRT_SNAPSHOTS_H
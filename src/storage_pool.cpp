@@ -0,0 +1,406 @@
+//
+// Created by root on 4/22/24.
+//
+
+#include "storage_pool.h"
+#include "storage_volume.h"
+#include "volume_clone.h"
+#include "addon.h"
+#include "helper/abort_signal.h"
+#include "helper/assert.h"
+#include "helper/libvirt_error.h"
+#include "helper/promise_worker.h"
+
+#include <libvirt/virterror.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+//region STATIC
+
+Napi::Object StoragePool::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func =
+            DefineClass(env, "StoragePool", {
+                    /* Instance accessors */
+                    InstanceAccessor("name", &StoragePool::Name, nullptr),
+                    InstanceAccessor("uuid", &StoragePool::UUIDString, nullptr),
+
+                    /* Instance Methods */
+                    InstanceMethod("info", &StoragePool::GetInfo),
+                    InstanceMethod("refresh", &StoragePool::Refresh),
+                    InstanceMethod("toXML", &StoragePool::ToXML),
+                    InstanceMethod("volumes", &StoragePool::ListVolumes),
+                    InstanceMethod("lookupVolume", &StoragePool::LookupVolume),
+                    InstanceMethod("createVolume", &StoragePool::CreateVolume),
+                    InstanceMethod("cloneVolume", &StoragePool::CloneVolume),
+                    InstanceMethod("cloneVolumes", &StoragePool::CloneVolumes)
+            });
+
+    AddonData::Get(env)->storagePoolConstructor = Napi::Persistent(func);
+    exports.Set("StoragePool", func);
+    return exports;
+}
+
+Napi::Object StoragePool::New(Napi::Env env, const std::initializer_list<napi_value> &args) {
+    Napi::EscapableHandleScope scope(env);
+    Napi::Object obj = AddonData::Get(env)->storagePoolConstructor.New(args);
+    return scope.Escape(napi_value(obj)).ToObject();
+}
+
+Napi::Object StoragePool::Wrap(Napi::Env env, virStoragePoolPtr poolPtr) {
+    auto obj = New(env, {Napi::External<virStoragePool>::New(env, poolPtr)});
+    /* The constructor failed before it took ownership */
+    if (obj.IsEmpty()) virStoragePoolFree(poolPtr);
+    return obj;
+}
+
+//endregion
+
+//region INSTANCE
+
+StoragePool::StoragePool(const Napi::CallbackInfo &info) : Napi::ObjectWrap<StoragePool>(info) {
+    Napi::Env env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsExternal()) {
+        Napi::TypeError::New(env, "Expected an external.")
+                .ThrowAsJavaScriptException();
+        return;
+    }
+    this->_pool = info[0].As<Napi::External<virStoragePool>>().Data();
+}
+
+StoragePool::~StoragePool() {
+    if (this->_pool) virStoragePoolFree(this->_pool);
+}
+
+virStoragePoolPtr StoragePool::RefHandle() {
+    virStoragePoolRef(this->_pool);
+    return this->_pool;
+}
+
+//region ACCESSORS
+
+Napi::Value StoragePool::Name(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+    return Napi::String::New(info.Env(), virStoragePoolGetName(this->_pool));
+}
+
+Napi::Value StoragePool::UUIDString(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+    char uuid[VIR_UUID_STRING_BUFLEN];
+    if (virStoragePoolGetUUIDString(this->_pool, uuid) < 0) {
+        Napi::Error::New(info.Env(), virGetLastError()->message).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+    return Napi::String::New(info.Env(), uuid);
+}
+
+//endregion
+
+//region INSTANCE METHODS
+
+Napi::Value StoragePool::GetInfo(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto poolPtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [poolPtr](PromiseWorker *worker) {
+        virStoragePoolInfo poolInfo;
+        if (virStoragePoolGetInfo(poolPtr, &poolInfo) < 0) {
+            worker->Error(LastErrorMessage("Failed to get storage pool info"));
+            virStoragePoolFree(poolPtr);
+            return;
+        }
+        virStoragePoolFree(poolPtr);
+        worker->Result([poolInfo](Napi::Env env) -> Napi::Value {
+            auto obj = Napi::Object::New(env);
+            obj.Set("state", Napi::Number::New(env, poolInfo.state));
+            obj.Set("capacity", Napi::Number::New(env, static_cast<double>(poolInfo.capacity)));
+            obj.Set("allocation", Napi::Number::New(env, static_cast<double>(poolInfo.allocation)));
+            obj.Set("available", Napi::Number::New(env, static_cast<double>(poolInfo.available)));
+            return obj;
+        });
+    });
+    worker->OnDiscard([poolPtr]() {
+        virStoragePoolFree(poolPtr);
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("StoragePool.info");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StoragePool::Refresh(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+
+    auto env = info.Env();
+    auto flags = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto poolPtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [poolPtr, flags](PromiseWorker *worker) {
+        if (virStoragePoolRefresh(poolPtr, flags) < 0) {
+            worker->Error(LastErrorMessage("Failed to refresh storage pool"));
+        }
+        virStoragePoolFree(poolPtr);
+    }, Executor::Lane::Bulk);
+    worker->OnDiscard([poolPtr]() {
+        virStoragePoolFree(poolPtr);
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("StoragePool.refresh");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StoragePool::ToXML(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+
+    auto env = info.Env();
+    auto flags = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto poolPtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [poolPtr, flags](PromiseWorker *worker) {
+        auto xmlDesc = virStoragePoolGetXMLDesc(poolPtr, flags);
+        virStoragePoolFree(poolPtr);
+        if (!xmlDesc) {
+            worker->Error(LastErrorMessage("Failed to get storage pool XML"));
+            return;
+        }
+        auto xml = std::make_shared<std::string>(xmlDesc);
+        free(xmlDesc);
+        worker->Result([xml](Napi::Env env) -> Napi::Value {
+            return Napi::String::New(env, *xml);
+        });
+    });
+    worker->OnDiscard([poolPtr]() {
+        virStoragePoolFree(poolPtr);
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("StoragePool.toXML");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StoragePool::ListVolumes(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto poolPtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [poolPtr](PromiseWorker *worker) {
+        virStorageVolPtr *list = nullptr;
+        auto count = virStoragePoolListAllVolumes(poolPtr, &list, 0);
+        virStoragePoolFree(poolPtr);
+        if (count < 0) {
+            worker->Error(LastErrorMessage("Failed to list volumes"));
+            return;
+        }
+        auto volumes = std::make_shared<std::vector<virStorageVolPtr>>(list, list + count);
+        free(list);
+        worker->Result([volumes](Napi::Env env) -> Napi::Value {
+            auto array = Napi::Array::New(env, volumes->size());
+            for (size_t i = 0; i < volumes->size(); i++) {
+                array.Set(static_cast<uint32_t>(i), StorageVolume::Wrap(env, volumes->at(i)));
+            }
+            return array;
+        });
+    });
+    worker->OnDiscard([poolPtr]() {
+        virStoragePoolFree(poolPtr);
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("StoragePool.volumes");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StoragePool::LookupVolume(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Invalid volume name").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto name = info[0].ToString().Utf8Value();
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto poolPtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [poolPtr, name](PromiseWorker *worker) {
+        auto volumePtr = virStorageVolLookupByName(poolPtr, name.c_str());
+        virStoragePoolFree(poolPtr);
+        if (!volumePtr) {
+            worker->Error(LastErrorMessage("Failed to look up volume"));
+            return;
+        }
+        worker->Result([volumePtr](Napi::Env env) -> Napi::Value {
+            return StorageVolume::Wrap(env, volumePtr);
+        });
+    });
+    worker->OnDiscard([poolPtr]() {
+        virStoragePoolFree(poolPtr);
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("StoragePool.lookupVolume");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StoragePool::CreateVolume(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Invalid volume XML").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto xml = info[0].ToString().Utf8Value();
+    auto flags = info.Length() > 1 && info[1].IsNumber() ? info[1].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto poolPtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [poolPtr, xml, flags](PromiseWorker *worker) {
+        auto volumePtr = virStorageVolCreateXML(poolPtr, xml.c_str(), flags);
+        virStoragePoolFree(poolPtr);
+        if (!volumePtr) {
+            worker->Error(LastErrorMessage("Failed to create volume"));
+            return;
+        }
+        worker->Result([volumePtr](Napi::Env env) -> Napi::Value {
+            return StorageVolume::Wrap(env, volumePtr);
+        });
+    }, Executor::Lane::Bulk);
+    worker->OnDiscard([poolPtr]() {
+        virStoragePoolFree(poolPtr);
+    });
+    worker->Cancellable(info, 2);
+    worker->Measure("StoragePool.createVolume");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StoragePool::CloneVolume(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsString()) {
+        Napi::TypeError::New(env, "Invalid volume XML").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto source = StorageVolume::Unwrap(env, info.Length() > 1 ? info[1] : env.Undefined());
+    if (!source) {
+        Napi::TypeError::New(env, "Expected a source StorageVolume").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto xml = info[0].ToString().Utf8Value();
+    auto flags = info.Length() > 2 && info[2].IsNumber() ? info[2].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto poolPtr = this->RefHandle();
+    auto sourcePtr = source->RefHandle();
+    auto worker = new PromiseWorker(deferred, [poolPtr, sourcePtr, xml, flags](PromiseWorker *worker) {
+        auto volumePtr = virStorageVolCreateXMLFrom(poolPtr, xml.c_str(), sourcePtr, flags);
+        virStorageVolFree(sourcePtr);
+        virStoragePoolFree(poolPtr);
+        if (!volumePtr) {
+            worker->Error(LastErrorMessage("Failed to clone volume"));
+            return;
+        }
+        worker->Result([volumePtr](Napi::Env env) -> Napi::Value {
+            return StorageVolume::Wrap(env, volumePtr);
+        });
+    }, Executor::Lane::Bulk);
+    worker->OnDiscard([poolPtr, sourcePtr]() {
+        virStoragePoolFree(poolPtr);
+        virStorageVolFree(sourcePtr);
+    });
+    worker->Cancellable(info, 3);
+    worker->Measure("StoragePool.cloneVolume");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StoragePool::CloneVolumes(const Napi::CallbackInfo &info) {
+    assert(this->_pool, "Storage pool not defined");
+
+    auto env = info.Env();
+//region validate arguments
+    auto source = StorageVolume::Unwrap(env, info.Length() > 0 ? info[0] : env.Undefined());
+    if (!source) {
+        Napi::TypeError::New(env, "Expected a source StorageVolume").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (info.Length() < 2 || !info[1].IsArray()) {
+        Napi::TypeError::New(env, "Expected an array of volume names").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto array = info[1].As<Napi::Array>();
+    std::vector<std::string> names;
+    for (uint32_t i = 0; i < array.Length(); i++) {
+        if (!array.Get(i).IsString()) {
+            Napi::TypeError::New(env, "Expected an array of volume names").ThrowAsJavaScriptException();
+            return env.Undefined();
+        }
+        names.push_back(array.Get(i).ToString().Utf8Value());
+    }
+
+    VolumeCloneBatch::Options options;
+    Napi::Object signal;
+    if (info.Length() > 2 && info[2].IsObject()) {
+        auto object = info[2].ToObject();
+        if (object.Get("concurrency").IsNumber()) {
+            auto concurrency = object.Get("concurrency").ToNumber().Int64Value();
+            if (concurrency < 1 || concurrency > static_cast<int64_t>(VolumeCloneBatch::MaxConcurrency)) {
+                Napi::RangeError::New(env, "'concurrency' must be between 1 and 64").ThrowAsJavaScriptException();
+                return env.Undefined();
+            }
+            options.concurrency = static_cast<size_t>(concurrency);
+        }
+        if (object.Get("flags").IsNumber()) options.flags = object.Get("flags").ToNumber().Uint32Value();
+        if (object.Get("signal").IsObject()) signal = object.Get("signal").ToObject();
+    }
+//endregion
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto batch = std::make_shared<VolumeCloneBatch>(this->RefHandle(), source->RefHandle(), std::move(names),
+                                                    options);
+
+    auto abort = std::make_shared<AbortListener>();
+    if (!signal.IsEmpty() && !abort->Attach(signal, [batch](Napi::Value) { batch->Cancel(); })) {
+        batch->Cancel();
+    }
+
+    auto worker = new PromiseWorker(deferred, [batch](PromiseWorker *worker) {
+        auto results = std::make_shared<std::vector<VolumeCloneBatch::Result>>(batch->Run());
+        worker->Result([results](Napi::Env env) -> Napi::Value {
+            auto array = Napi::Array::New(env, results->size());
+            for (size_t i = 0; i < results->size(); i++) {
+                auto &result = results->at(i);
+                auto object = Napi::Object::New(env);
+                object.Set("name", Napi::String::New(env, result.name));
+                object.Set("status", Napi::String::New(env, BatchRunner::StatusName(result.status)));
+                if (result.volume) {
+                    object.Set("volume", StorageVolume::Wrap(env, result.volume));
+                    result.volume = nullptr;
+                }
+                if (!result.error.empty()) object.Set("error", Napi::String::New(env, result.error));
+                if (result.startedMs >= 0) object.Set("startedMs", Napi::Number::New(env, result.startedMs));
+                object.Set("durationMs", Napi::Number::New(env, result.durationMs));
+                array.Set(i, object);
+            }
+            return array;
+        });
+    }, Executor::Lane::Bulk);
+    worker->Finally([abort]() { abort->Remove(); });
+    worker->Measure("StoragePool.cloneVolumes");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+//endregion
+
+//endregion
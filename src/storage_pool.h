@@ -0,0 +1,103 @@
+//
+// Created by root on 4/22/24.
+//
+
+#ifndef NODE_LIBVIRT_STORAGE_POOL_H
+#define NODE_LIBVIRT_STORAGE_POOL_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+class StoragePool : public Napi::ObjectWrap<StoragePool> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+    static Napi::Object New(Napi::Env env, const std::initializer_list<napi_value> &args);
+
+    /**
+     * Wrap a referenced pool, the wrapper takes ownership of poolPtr.
+     */
+    static Napi::Object Wrap(Napi::Env env, virStoragePoolPtr poolPtr);
+
+    /**
+     * @param info External<virStoragePool>, the wrapper takes ownership of the reference
+     */
+    explicit StoragePool(const Napi::CallbackInfo &info);
+
+    ~StoragePool() override;
+
+    /**
+     * Take an extra reference on the pool for use on a worker thread, released there with virStoragePoolFree.
+     */
+    virStoragePoolPtr RefHandle();
+
+private:
+
+//region ACCESSORS
+
+    Napi::Value Name(const Napi::CallbackInfo &info);
+
+    Napi::Value UUIDString(const Napi::CallbackInfo &info);
+//endregion
+
+//region INSTANCE METHODS
+
+    /**
+     * virStoragePoolGetInfo, sizes in bytes.
+     * @param info options?
+     * @return Promise<{ state, capacity, allocation, available }>
+     */
+    Napi::Value GetInfo(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info flags?, options?
+     * @return Promise<void>
+     */
+    Napi::Value Refresh(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info flags? (virStorageXMLFlags), options?
+     * @return Promise<string>
+     */
+    Napi::Value ToXML(const Napi::CallbackInfo &info);
+
+    /**
+     * virStoragePoolListAllVolumes.
+     * @param info options?
+     * @return Promise<StorageVolume[]>
+     */
+    Napi::Value ListVolumes(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info name, options?
+     * @return Promise<StorageVolume>
+     */
+    Napi::Value LookupVolume(const Napi::CallbackInfo &info);
+
+    /**
+     * virStorageVolCreateXML on the bulk lane.
+     * @param info xml, flags? (virStorageVolCreateFlags), options?
+     * @return Promise<StorageVolume>
+     */
+    Napi::Value CreateVolume(const Napi::CallbackInfo &info);
+
+    /**
+     * virStorageVolCreateXMLFrom on the bulk lane, the source may live in another pool.
+     * @param info xml, source (StorageVolume), flags? (virStorageVolCreateFlags), options?
+     * @return Promise<StorageVolume>
+     */
+    Napi::Value CloneVolume(const Napi::CallbackInfo &info);
+
+    /**
+     * Clone source into one new volume per name with bounded parallelism, see VolumeCloneBatch.
+     * Resolves once every clone finished or was cancelled through options.signal.
+     * @param info source (StorageVolume), names, options? { concurrency? (default 4, at most 64), flags?, signal? }
+     * @return Promise<VolumeCloneResult[]> in input order
+     */
+    Napi::Value CloneVolumes(const Napi::CallbackInfo &info);
+//endregion
+
+    virStoragePoolPtr _pool = nullptr;
+};
+
+#endif //NODE_LIBVIRT_STORAGE_POOL_H
@@ -0,0 +1,211 @@
+//
+// Created by root on 4/22/24.
+//
+
+#include "storage_volume.h"
+#include "addon.h"
+#include "helper/assert.h"
+#include "helper/libvirt_error.h"
+#include "helper/promise_worker.h"
+
+#include <libvirt/virterror.h>
+
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+//region STATIC
+
+Napi::Object StorageVolume::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func =
+            DefineClass(env, "StorageVolume", {
+                    /* Instance accessors */
+                    InstanceAccessor("name", &StorageVolume::Name, nullptr),
+                    InstanceAccessor("key", &StorageVolume::Key, nullptr),
+
+                    /* Instance Methods */
+                    InstanceMethod("info", &StorageVolume::GetInfo),
+                    InstanceMethod("path", &StorageVolume::GetPath),
+                    InstanceMethod("toXML", &StorageVolume::ToXML),
+                    InstanceMethod("delete", &StorageVolume::Delete)
+            });
+
+    AddonData::Get(env)->storageVolumeConstructor = Napi::Persistent(func);
+    exports.Set("StorageVolume", func);
+    return exports;
+}
+
+Napi::Object StorageVolume::New(Napi::Env env, const std::initializer_list<napi_value> &args) {
+    Napi::EscapableHandleScope scope(env);
+    Napi::Object obj = AddonData::Get(env)->storageVolumeConstructor.New(args);
+    return scope.Escape(napi_value(obj)).ToObject();
+}
+
+Napi::Object StorageVolume::Wrap(Napi::Env env, virStorageVolPtr volumePtr) {
+    auto obj = New(env, {Napi::External<virStorageVol>::New(env, volumePtr)});
+    /* The constructor failed before it took ownership */
+    if (obj.IsEmpty()) virStorageVolFree(volumePtr);
+    return obj;
+}
+
+StorageVolume *StorageVolume::Unwrap(Napi::Env env, const Napi::Value &value) {
+    if (!value.IsObject() || !value.ToObject().InstanceOf(AddonData::Get(env)->storageVolumeConstructor.Value())) {
+        return nullptr;
+    }
+    return Napi::ObjectWrap<StorageVolume>::Unwrap(value.ToObject());
+}
+
+//endregion
+
+//region INSTANCE
+
+StorageVolume::StorageVolume(const Napi::CallbackInfo &info) : Napi::ObjectWrap<StorageVolume>(info) {
+    Napi::Env env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsExternal()) {
+        Napi::TypeError::New(env, "Expected an external.")
+                .ThrowAsJavaScriptException();
+        return;
+    }
+    this->_volume = info[0].As<Napi::External<virStorageVol>>().Data();
+}
+
+StorageVolume::~StorageVolume() {
+    if (this->_volume) virStorageVolFree(this->_volume);
+}
+
+virStorageVolPtr StorageVolume::RefHandle() {
+    virStorageVolRef(this->_volume);
+    return this->_volume;
+}
+
+//region ACCESSORS
+
+Napi::Value StorageVolume::Name(const Napi::CallbackInfo &info) {
+    assert(this->_volume, "Volume not defined");
+    return Napi::String::New(info.Env(), virStorageVolGetName(this->_volume));
+}
+
+Napi::Value StorageVolume::Key(const Napi::CallbackInfo &info) {
+    assert(this->_volume, "Volume not defined");
+    return Napi::String::New(info.Env(), virStorageVolGetKey(this->_volume));
+}
+
+//endregion
+
+//region INSTANCE METHODS
+
+Napi::Value StorageVolume::GetInfo(const Napi::CallbackInfo &info) {
+    assert(this->_volume, "Volume not defined");
+
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto volumePtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [volumePtr](PromiseWorker *worker) {
+        virStorageVolInfo volumeInfo;
+        if (virStorageVolGetInfo(volumePtr, &volumeInfo) < 0) {
+            worker->Error(LastErrorMessage("Failed to get volume info"));
+            virStorageVolFree(volumePtr);
+            return;
+        }
+        virStorageVolFree(volumePtr);
+        worker->Result([volumeInfo](Napi::Env env) -> Napi::Value {
+            auto obj = Napi::Object::New(env);
+            obj.Set("type", Napi::Number::New(env, volumeInfo.type));
+            obj.Set("capacity", Napi::Number::New(env, static_cast<double>(volumeInfo.capacity)));
+            obj.Set("allocation", Napi::Number::New(env, static_cast<double>(volumeInfo.allocation)));
+            return obj;
+        });
+    });
+    worker->OnDiscard([volumePtr]() {
+        virStorageVolFree(volumePtr);
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("StorageVolume.info");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StorageVolume::GetPath(const Napi::CallbackInfo &info) {
+    assert(this->_volume, "Volume not defined");
+
+    auto env = info.Env();
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto volumePtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [volumePtr](PromiseWorker *worker) {
+        auto pathPtr = virStorageVolGetPath(volumePtr);
+        virStorageVolFree(volumePtr);
+        if (!pathPtr) {
+            worker->Error(LastErrorMessage("Failed to get volume path"));
+            return;
+        }
+        auto path = std::make_shared<std::string>(pathPtr);
+        free(pathPtr);
+        worker->Result([path](Napi::Env env) -> Napi::Value {
+            return Napi::String::New(env, *path);
+        });
+    });
+    worker->OnDiscard([volumePtr]() {
+        virStorageVolFree(volumePtr);
+    });
+    worker->Cancellable(info, 0);
+    worker->Measure("StorageVolume.path");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StorageVolume::ToXML(const Napi::CallbackInfo &info) {
+    assert(this->_volume, "Volume not defined");
+
+    auto env = info.Env();
+    auto flags = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto volumePtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [volumePtr, flags](PromiseWorker *worker) {
+        auto xmlDesc = virStorageVolGetXMLDesc(volumePtr, flags);
+        virStorageVolFree(volumePtr);
+        if (!xmlDesc) {
+            worker->Error(LastErrorMessage("Failed to get volume XML"));
+            return;
+        }
+        auto xml = std::make_shared<std::string>(xmlDesc);
+        free(xmlDesc);
+        worker->Result([xml](Napi::Env env) -> Napi::Value {
+            return Napi::String::New(env, *xml);
+        });
+    });
+    worker->OnDiscard([volumePtr]() {
+        virStorageVolFree(volumePtr);
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("StorageVolume.toXML");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value StorageVolume::Delete(const Napi::CallbackInfo &info) {
+    assert(this->_volume, "Volume not defined");
+
+    auto env = info.Env();
+    auto flags = info.Length() > 0 && info[0].IsNumber() ? info[0].ToNumber().Uint32Value() : 0;
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto volumePtr = this->RefHandle();
+    auto worker = new PromiseWorker(deferred, [volumePtr, flags](PromiseWorker *worker) {
+        if (virStorageVolDelete(volumePtr, flags) < 0) {
+            worker->Error(LastErrorMessage("Failed to delete volume"));
+        }
+        virStorageVolFree(volumePtr);
+    }, Executor::Lane::Bulk);
+    worker->OnDiscard([volumePtr]() {
+        virStorageVolFree(volumePtr);
+    });
+    worker->Cancellable(info, 1);
+    worker->Measure("StorageVolume.delete");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+//endregion
+
+//endregion
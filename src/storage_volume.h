@@ -0,0 +1,82 @@
+//
+// Created by root on 4/22/24.
+//
+
+#ifndef NODE_LIBVIRT_STORAGE_VOLUME_H
+#define NODE_LIBVIRT_STORAGE_VOLUME_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+class StorageVolume : public Napi::ObjectWrap<StorageVolume> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+    static Napi::Object New(Napi::Env env, const std::initializer_list<napi_value> &args);
+
+    /**
+     * Wrap a referenced volume, the wrapper takes ownership of volumePtr.
+     */
+    static Napi::Object Wrap(Napi::Env env, virStorageVolPtr volumePtr);
+
+    /**
+     * The wrapper of value, or nullptr if it is not a StorageVolume.
+     */
+    static StorageVolume *Unwrap(Napi::Env env, const Napi::Value &value);
+
+    /**
+     * @param info External<virStorageVol>, the wrapper takes ownership of the reference
+     */
+    explicit StorageVolume(const Napi::CallbackInfo &info);
+
+    ~StorageVolume() override;
+
+    /**
+     * Take an extra reference on the volume for use on a worker thread, released there with virStorageVolFree.
+     */
+    virStorageVolPtr RefHandle();
+
+private:
+
+//region ACCESSORS
+
+    Napi::Value Name(const Napi::CallbackInfo &info);
+
+    /**
+     * Unique key of the volume, usually its path for file based pools.
+     */
+    Napi::Value Key(const Napi::CallbackInfo &info);
+//endregion
+
+//region INSTANCE METHODS
+
+    /**
+     * virStorageVolGetInfo, sizes in bytes.
+     * @param info options?
+     * @return Promise<{ type, capacity, allocation }>
+     */
+    Napi::Value GetInfo(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info options?
+     * @return Promise<string>
+     */
+    Napi::Value GetPath(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info flags?, options?
+     * @return Promise<string>
+     */
+    Napi::Value ToXML(const Napi::CallbackInfo &info);
+
+    /**
+     * @param info flags? (virStorageVolDeleteFlags), options?
+     * @return Promise<void>
+     */
+    Napi::Value Delete(const Napi::CallbackInfo &info);
+//endregion
+
+    virStorageVolPtr _volume = nullptr;
+};
+
+#endif //NODE_LIBVIRT_STORAGE_VOLUME_H
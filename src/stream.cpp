@@ -0,0 +1,369 @@
+//
+// Created by root on 4/6/24.
+//
+
+#include "stream.h"
+#include "addon.h"
+#include "helper/assert.h"
+#include "helper/buffer_pool.h"
+#include "helper/libvirt_error.h"
+#include "helper/promise_worker.h"
+
+#include <libvirt/virterror.h>
+
+//region STATIC
+
+Napi::Object Stream::Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func =
+            DefineClass(env, "Stream", {
+                    /* Instance Methods */
+                    InstanceMethod("readStart", &Stream::ReadStart),
+                    InstanceMethod("pause", &Stream::Pause),
+                    InstanceMethod("resume", &Stream::Resume),
+                    InstanceMethod("write", &Stream::Write),
+                    InstanceMethod("finish", &Stream::Finish),
+                    InstanceMethod("abort", &Stream::Abort)
+            });
+
+    AddonData::Get(env)->streamConstructor = Napi::Persistent(func);
+    exports.Set("Stream", func);
+    return exports;
+}
+
+Napi::Object Stream::New(Napi::Env env, const std::initializer_list<napi_value> &args) {
+    Napi::EscapableHandleScope scope(env);
+    Napi::Object obj = AddonData::Get(env)->streamConstructor.New(args);
+    return scope.Escape(napi_value(obj)).ToObject();
+}
+
+//endregion
+
+//region INSTANCE
+
+Stream::Stream(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Stream>(info) {
+    Napi::Env env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsExternal()) {
+        Napi::TypeError::New(env, "Expected an external.")
+                .ThrowAsJavaScriptException();
+        return;
+    }
+    this->_stream = info[0].As<Napi::External<virStream>>().Data();
+}
+
+Stream::~Stream() {
+    for (auto &chunk: this->_chunks) {
+        BufferPool::Instance().Release(chunk.data);
+    }
+    for (auto &write: this->_writes) {
+        delete write.buffer;
+        delete write.callback;
+    }
+    for (auto &write: this->_written) {
+        delete write.buffer;
+        delete write.callback;
+    }
+    if (this->_stream) virStreamFree(this->_stream);
+}
+
+//region INSTANCE METHODS
+
+Napi::Value Stream::ReadStart(const Napi::CallbackInfo &info) {
+    assert(this->_stream, "Stream not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsFunction()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!this->Watch(env)) return env.Undefined();
+    this->_onData = Napi::Persistent(info[0].As<Napi::Function>());
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_reading = true;
+    }
+    this->UpdateEvents();
+    return env.Undefined();
+}
+
+Napi::Value Stream::Pause(const Napi::CallbackInfo &info) {
+    assert(this->_stream, "Stream not defined");
+
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_paused = true;
+    }
+    this->UpdateEvents();
+    return info.Env().Undefined();
+}
+
+Napi::Value Stream::Resume(const Napi::CallbackInfo &info) {
+    assert(this->_stream, "Stream not defined");
+
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_paused = false;
+    }
+    this->UpdateEvents();
+    return info.Env().Undefined();
+}
+
+Napi::Value Stream::Write(const Napi::CallbackInfo &info) {
+    assert(this->_stream, "Stream not defined");
+
+    auto env = info.Env();
+    if (info.Length() <= 0 || !info[0].IsBuffer()) {
+        Napi::Error::New(env, "Invalid arguments").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    auto buffer = info[0].As<Napi::Buffer<char>>();
+    auto hasCallback = info.Length() > 1 && info[1].IsFunction();
+    if (buffer.Length() == 0) {
+        if (hasCallback) info[1].As<Napi::Function>().Call({});
+        return env.Undefined();
+    }
+    if (!this->Watch(env)) return env.Undefined();
+
+    /* Sent straight from the Buffer memory, the reference keeps it alive until then */
+    PendingWrite write{buffer.Data(), buffer.Length(), 0, new Napi::ObjectReference(Napi::Persistent(buffer)),
+                       hasCallback ? new Napi::FunctionReference(Napi::Persistent(info[1].As<Napi::Function>()))
+                                   : nullptr};
+    bool broken;
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_writes.push_back(write);
+        broken = !this->_error.empty();
+    }
+    /* Fail the write right away when the stream already broke */
+    if (broken) this->ScheduleDrain();
+    this->UpdateEvents();
+    return env.Undefined();
+}
+
+Napi::Value Stream::Finish(const Napi::CallbackInfo &info) {
+    assert(this->_stream, "Stream not defined");
+
+    auto env = info.Env();
+    this->Unwatch();
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto stream = this->_stream;
+    virStreamRef(stream);
+    auto worker = new PromiseWorker(deferred, [stream](PromiseWorker *worker) {
+        if (virStreamFinish(stream) < 0) {
+            worker->Error(LastErrorMessage("Failed to finish stream"));
+        }
+        virStreamFree(stream);
+    }, Executor::Lane::Bulk);
+    worker->Measure("Stream.finish");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+Napi::Value Stream::Abort(const Napi::CallbackInfo &info) {
+    assert(this->_stream, "Stream not defined");
+
+    auto env = info.Env();
+    this->Unwatch();
+
+    auto deferred = Napi::Promise::Deferred::New(env);
+    auto stream = this->_stream;
+    virStreamRef(stream);
+    auto worker = new PromiseWorker(deferred, [stream](PromiseWorker *worker) {
+        if (virStreamAbort(stream) < 0) {
+            worker->Error(LastErrorMessage("Failed to abort stream"));
+        }
+        virStreamFree(stream);
+    });
+    worker->Measure("Stream.abort");
+    worker->Queue();
+    return deferred.Promise();
+}
+
+//endregion
+
+//region EVENTS
+
+bool Stream::Watch(Napi::Env env) {
+    if (this->_watching) return true;
+    /* OnFree of the previous registration may still use _tsfn, a finished stream is not watched again */
+    if (this->_unwatched) {
+        Napi::Error::New(env, "Stream already finished or aborted").ThrowAsJavaScriptException();
+        return false;
+    }
+    this->_tsfn = Napi::ThreadSafeFunction::New(
+            env, Napi::Function::New(env, [](const Napi::CallbackInfo &) {}), "libvirt.stream", 0, 1);
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_released = false;
+    }
+    /* Keep the wrapper alive while libvirt may call back into it, OnFree drops the reference */
+    this->Ref();
+    if (virStreamEventAddCallback(this->_stream, 0, Stream::OnEvent, this, Stream::OnFree) < 0) {
+        auto message = LastErrorMessage("Failed to watch stream");
+        this->Unref();
+        this->_tsfn.Release();
+        Napi::Error::New(env, message).ThrowAsJavaScriptException();
+        return false;
+    }
+    this->_watching = true;
+    return true;
+}
+
+void Stream::Unwatch() {
+    if (!this->_watching) return;
+    this->_watching = false;
+    this->_unwatched = true;
+    virStreamEventRemoveCallback(this->_stream);
+}
+
+int Stream::EventMask() {
+    int events = 0;
+    if (this->_reading && !this->_paused && !this->_ended && this->_error.empty() &&
+        this->_chunks.size() < MaxPendingChunks) {
+        events |= VIR_EVENT_HANDLE_READABLE;
+    }
+    if (!this->_writes.empty() && this->_error.empty()) {
+        events |= VIR_EVENT_HANDLE_WRITABLE;
+    }
+    return events;
+}
+
+void Stream::UpdateEvents() {
+    if (!this->_watching) return;
+    int events;
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        events = this->EventMask();
+    }
+    virStreamEventUpdateCallback(this->_stream, events);
+}
+
+void Stream::ScheduleDrain() {
+    std::lock_guard<std::mutex> lock(this->_mutex);
+    if (this->_scheduled || this->_released) return;
+    this->_scheduled = true;
+    this->_tsfn.NonBlockingCall(this, [](Napi::Env env, Napi::Function, Stream *stream) {
+        if (env != nullptr) stream->Drain(env);
+    });
+}
+
+void Stream::OnEvent(virStreamPtr st, int events, void *opaque) {
+    auto stream = static_cast<Stream *>(opaque);
+    auto &pool = BufferPool::Instance();
+    bool notify = false;
+    int mask;
+    {
+        std::lock_guard<std::mutex> lock(stream->_mutex);
+        if ((events & (VIR_EVENT_HANDLE_READABLE | VIR_EVENT_HANDLE_HANGUP | VIR_EVENT_HANDLE_ERROR)) &&
+            stream->_reading && !stream->_ended && stream->_error.empty()) {
+            while (!stream->_paused && stream->_chunks.size() < MaxPendingChunks) {
+                auto chunk = pool.Acquire();
+                int received = virStreamRecv(st, chunk, BufferPool::ChunkSize);
+                if (received > 0) {
+                    stream->_chunks.push_back({chunk, static_cast<size_t>(received)});
+                    notify = true;
+                    continue;
+                }
+                pool.Release(chunk);
+                if (received == 0) {
+                    stream->_ended = true;
+                    notify = true;
+                } else if (received == -1) {
+                    stream->_error = LastErrorMessage("Failed to receive from stream");
+                    notify = true;
+                }
+                /* -2: no more data for now */
+                break;
+            }
+        }
+        if ((events & VIR_EVENT_HANDLE_WRITABLE) && stream->_error.empty()) {
+            while (!stream->_writes.empty()) {
+                auto &write = stream->_writes.front();
+                int sent = virStreamSend(st, write.data + write.offset, write.length - write.offset);
+                if (sent > 0) {
+                    write.offset += sent;
+                    if (write.offset == write.length) {
+                        stream->_written.push_back(write);
+                        stream->_writes.pop_front();
+                        notify = true;
+                    }
+                    continue;
+                }
+                if (sent == -1) {
+                    stream->_error = LastErrorMessage("Failed to send to stream");
+                    notify = true;
+                }
+                break;
+            }
+        }
+        mask = stream->EventMask();
+    }
+    virStreamEventUpdateCallback(st, mask);
+    if (notify) stream->ScheduleDrain();
+}
+
+void Stream::OnFree(void *opaque) {
+    auto stream = static_cast<Stream *>(opaque);
+    {
+        std::lock_guard<std::mutex> lock(stream->_mutex);
+        stream->_released = true;
+    }
+    /* Delivered after any pending drain */
+    stream->_tsfn.NonBlockingCall(stream, [](Napi::Env env, Napi::Function, Stream *stream) {
+        if (env != nullptr) stream->Unref();
+    });
+    stream->_tsfn.Release();
+}
+
+void Stream::Drain(Napi::Env env) {
+    std::deque<Chunk> chunks;
+    std::vector<PendingWrite> written;
+    std::vector<PendingWrite> failed;
+    std::string error;
+    bool ended;
+    {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        chunks.swap(this->_chunks);
+        written.swap(this->_written);
+        /* The error stays set so no further events are requested, it is reported once */
+        if (!this->_error.empty() && !this->_errorDelivered) {
+            error = this->_error;
+            this->_errorDelivered = true;
+        }
+        if (!this->_error.empty()) {
+            failed.assign(this->_writes.begin(), this->_writes.end());
+            this->_writes.clear();
+        }
+        ended = this->_ended && this->_reading;
+        if (ended) this->_reading = false;
+        this->_scheduled = false;
+    }
+
+    Napi::HandleScope scope(env);
+    for (auto &chunk: chunks) {
+        auto buffer = Napi::Buffer<char>::New(env, chunk.data, chunk.length, [](Napi::Env, char *data) {
+            BufferPool::Instance().Release(data);
+        });
+        if (!this->_onData.IsEmpty()) this->_onData.Call({env.Null(), buffer});
+    }
+    for (auto &write: written) {
+        if (write.callback) write.callback->Call({});
+        delete write.buffer;
+        delete write.callback;
+    }
+    for (auto &write: failed) {
+        if (write.callback) write.callback->Call({Napi::Error::New(env, "Stream failed").Value()});
+        delete write.buffer;
+        delete write.callback;
+    }
+    if (!error.empty()) {
+        auto errorValue = Napi::Error::New(env, error).Value();
+        if (!this->_onData.IsEmpty()) this->_onData.Call({errorValue});
+    } else if (ended && !this->_onData.IsEmpty()) {
+        this->_onData.Call({env.Null(), env.Null()});
+    }
+    this->UpdateEvents();
+}
+
+//endregion
+//endregion
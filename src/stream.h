@@ -0,0 +1,119 @@
+//
+// Created by root on 4/6/24.
+//
+
+#ifndef NODE_LIBVIRT_STREAM_H
+#define NODE_LIBVIRT_STREAM_H
+
+#include <napi.h>
+#include <libvirt/libvirt.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Non-blocking virStream driven by the native event loop.
+ *
+ * Data is received on the event loop thread straight into pooled chunks which JavaScript gets as external buffers,
+ * written buffers are sent from their own memory while a reference keeps them alive. Backpressure maps onto the
+ * stream event mask: READABLE is dropped while JavaScript is paused or too many chunks are undelivered.
+ * lib/stream.ts wraps this into a Node.js Duplex.
+ */
+class Stream : public Napi::ObjectWrap<Stream> {
+public:
+    static Napi::Object Init(Napi::Env env, Napi::Object exports);
+
+    static Napi::Object New(Napi::Env env, const std::initializer_list<napi_value> &args);
+
+    explicit Stream(const Napi::CallbackInfo &info);
+
+    ~Stream() override;
+
+private:
+    struct Chunk {
+        char *data;
+        size_t length;
+    };
+
+    struct PendingWrite {
+        const char *data;
+        size_t length;
+        size_t offset;
+        Napi::ObjectReference *buffer;
+        Napi::FunctionReference *callback;
+    };
+
+//region INSTANCE METHODS
+
+    /**
+     * Start delivering data to onData(error, chunk), chunk is null at end of stream.
+     */
+    Napi::Value ReadStart(const Napi::CallbackInfo &info);
+
+    Napi::Value Pause(const Napi::CallbackInfo &info);
+
+    Napi::Value Resume(const Napi::CallbackInfo &info);
+
+    /**
+     * Queue a Buffer for sending, callback(error?) runs once it is fully sent.
+     */
+    Napi::Value Write(const Napi::CallbackInfo &info);
+
+    /**
+     * Complete the transfer with virStreamFinish.
+     * @return Promise<void>
+     */
+    Napi::Value Finish(const Napi::CallbackInfo &info);
+
+    /**
+     * Cancel the transfer with virStreamAbort.
+     * @return Promise<void>
+     */
+    Napi::Value Abort(const Napi::CallbackInfo &info);
+//endregion
+
+    /**
+     * Register the event callback, throws a JavaScript exception and returns false if that fails or the stream
+     * was already unwatched by finish or abort.
+     */
+    bool Watch(Napi::Env env);
+
+    void Unwatch();
+
+    void UpdateEvents();
+
+    int EventMask();
+
+    void ScheduleDrain();
+
+    void Drain(Napi::Env env);
+
+    static void OnEvent(virStreamPtr stream, int events, void *opaque);
+
+    static void OnFree(void *opaque);
+
+    static const size_t MaxPendingChunks = 16;
+
+    virStreamPtr _stream = nullptr;
+
+    Napi::FunctionReference _onData;
+    Napi::ThreadSafeFunction _tsfn;
+    bool _watching = false;
+    bool _unwatched = false;
+
+    std::mutex _mutex;
+    bool _reading = false;
+    bool _paused = false;
+    bool _ended = false;
+    bool _scheduled = false;
+    bool _released = false;
+    std::string _error;
+    bool _errorDelivered = false;
+    std::deque<Chunk> _chunks;
+    std::deque<PendingWrite> _writes;
+    std::vector<PendingWrite> _written;
+};
+
+#endif //NODE_LIBVIRT_STREAM_H
@@ -0,0 +1,126 @@
+//
+// Created by root on 4/22/24.
+//
+
+#include "volume_clone.h"
+#include "helper/libvirt_error.h"
+
+#include <libvirt/virterror.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <cstdlib>
+#include <stdexcept>
+
+VolumeCloneBatch::VolumeCloneBatch(virStoragePoolPtr pool, virStorageVolPtr source, std::vector<std::string> &&names,
+                                   Options options)
+        : _pool(pool), _source(source), _options(std::move(options)), _names(std::move(names)),
+          _volumes(_names.size(), nullptr) {
+}
+
+VolumeCloneBatch::~VolumeCloneBatch() {
+    /* Volumes that were not handed out by Run */
+    for (auto volume: _volumes) {
+        if (volume) virStorageVolFree(volume);
+    }
+    if (_source) virStorageVolFree(_source);
+    if (_pool) virStoragePoolFree(_pool);
+}
+
+std::vector<std::string> VolumeCloneBatch::CloneXml(const std::string &sourceXml,
+                                                    const std::vector<std::string> &names) {
+    std::unique_ptr<xmlDoc, void (*)(xmlDocPtr)> doc(
+            xmlReadMemory(sourceXml.data(), static_cast<int>(sourceXml.size()), "volume.xml", nullptr,
+                          XML_PARSE_NONET | XML_PARSE_NOERROR | XML_PARSE_NOWARNING),
+            xmlFreeDoc);
+    auto root = doc ? xmlDocGetRootElement(doc.get()) : nullptr;
+    if (!root || xmlStrcmp(root->name, BAD_CAST "volume") != 0) {
+        throw std::runtime_error("Failed to parse volume XML");
+    }
+    xmlNodePtr nameNode = nullptr;
+    for (auto node = root->children; node; node = node->next) {
+        if (node->type == XML_ELEMENT_NODE && xmlStrcmp(node->name, BAD_CAST "name") == 0) {
+            nameNode = node;
+            break;
+        }
+    }
+    if (!nameNode) nameNode = xmlNewChild(root, nullptr, BAD_CAST "name", nullptr);
+
+    std::vector<std::string> xmls;
+    xmls.reserve(names.size());
+    for (const auto &name: names) {
+        xmlNodeSetContent(nameNode, nullptr);
+        /* Unlike xmlNodeSetContent, this escapes the name */
+        xmlNodeAddContent(nameNode, BAD_CAST name.c_str());
+        xmlChar *buffer = nullptr;
+        int size = 0;
+        xmlDocDumpMemory(doc.get(), &buffer, &size);
+        if (!buffer) throw std::runtime_error("Failed to serialize volume XML");
+        xmls.emplace_back(reinterpret_cast<const char *>(buffer), static_cast<size_t>(size));
+        xmlFree(buffer);
+    }
+    return xmls;
+}
+
+std::vector<VolumeCloneBatch::Result> VolumeCloneBatch::Run() {
+    std::string error;
+    auto sourceXml = virStorageVolGetXMLDesc(_source, 0);
+    if (!sourceXml) {
+        error = LastErrorMessage("Failed to get the source volume XML");
+    } else {
+        try {
+            _xmls = CloneXml(sourceXml, _names);
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+        free(sourceXml);
+    }
+
+    auto self = shared_from_this();
+    auto runner = std::make_shared<BatchRunner>(_names.size(), _options.concurrency, 0,
+                                                [self](size_t index, std::string &error) -> bool {
+                                                    return self->Clone(index, error);
+                                                });
+    if (!error.empty()) {
+        for (size_t i = 0; i < _names.size(); i++) runner->Fail(i, error);
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _runner = runner;
+        if (_cancelled) runner->Cancel();
+    }
+    auto outcomes = runner->Run(Executor::Lane::Bulk);
+
+    /* Without a timeout every started clone has returned */
+    std::vector<Result> results;
+    results.reserve(outcomes.size());
+    for (size_t i = 0; i < outcomes.size(); i++) {
+        Result result;
+        result.name = _names[i];
+        result.status = outcomes[i].status;
+        result.error = outcomes[i].error;
+        result.volume = _volumes[i];
+        _volumes[i] = nullptr;
+        result.startedMs = outcomes[i].startedMs;
+        result.durationMs = outcomes[i].durationMs;
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+void VolumeCloneBatch::Cancel() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cancelled = true;
+    auto runner = _runner.lock();
+    if (runner) runner->Cancel();
+}
+
+bool VolumeCloneBatch::Clone(size_t index, std::string &error) {
+    auto volume = virStorageVolCreateXMLFrom(_pool, _xmls[index].c_str(), _source, _options.flags);
+    if (!volume) {
+        error = LastErrorMessage("Failed to clone volume");
+        return false;
+    }
+    _volumes[index] = volume;
+    return true;
+}
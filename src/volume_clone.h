@@ -0,0 +1,89 @@
+//
+// Created by root on 4/22/24.
+//
+
+#ifndef NODE_LIBVIRT_VOLUME_CLONE_H
+#define NODE_LIBVIRT_VOLUME_CLONE_H
+
+#include <libvirt/libvirt.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "batch_runner.h"
+
+/**
+ * Clone one source volume (a golden image) into many new volumes of a pool with bounded parallelism, see
+ * BatchRunner.
+ *
+ * The source XML is fetched once and every clone gets a copy with its own name, the same as virsh vol-clone.
+ * Cancelling stops handing out names, clones already running finish since virStorageVolCreateXMLFrom cannot be
+ * interrupted.
+ */
+class VolumeCloneBatch : public std::enable_shared_from_this<VolumeCloneBatch> {
+public:
+    typedef BatchRunner::Status Status;
+
+    struct Options {
+        size_t concurrency = 4;
+        /** virStorageVolCreateFlags */
+        unsigned int flags = 0;
+    };
+
+    struct Result {
+        std::string name;
+        Status status;
+        std::string error;
+        /** Referenced new volume when the clone succeeded, the caller takes ownership */
+        virStorageVolPtr volume;
+        /** Relative to the start of the batch, negative if the clone was never started */
+        double startedMs;
+        double durationMs;
+    };
+
+    static const size_t MaxConcurrency = 64;
+
+    /**
+     * Takes ownership of the pool and source references.
+     */
+    VolumeCloneBatch(virStoragePoolPtr pool, virStorageVolPtr source, std::vector<std::string> &&names,
+                     Options options);
+
+    ~VolumeCloneBatch();
+
+    /**
+     * Run the batch and wait until every clone finished or was cancelled, call it from a bulk lane worker.
+     * @return results in input order
+     */
+    std::vector<Result> Run();
+
+    /**
+     * Thread safe.
+     */
+    void Cancel();
+
+    /**
+     * Source volume XML with /volume/name replaced, throws std::runtime_error on malformed XML.
+     */
+    static std::vector<std::string> CloneXml(const std::string &sourceXml, const std::vector<std::string> &names);
+
+private:
+    bool Clone(size_t index, std::string &error);
+
+    virStoragePoolPtr _pool;
+    virStorageVolPtr _source;
+    const Options _options;
+    const std::vector<std::string> _names;
+    std::vector<std::string> _xmls;
+    /** Written by the runner, one per name */
+    std::vector<virStorageVolPtr> _volumes;
+
+    std::mutex _mutex;
+    /** Weak, the runner holds this batch through its task */
+    std::weak_ptr<BatchRunner> _runner;
+    bool _cancelled = false;
+};
+
+#endif //NODE_LIBVIRT_VOLUME_CLONE_H
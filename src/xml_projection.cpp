@@ -0,0 +1,200 @@
+//
+// Created by root on 4/8/24.
+//
+
+#include "xml_projection.h"
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+#include <libxml/xpath.h>
+#include <libxml/xmlerror.h>
+
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+//region COMPILED EXPRESSION CACHE
+
+/**
+ * Compiled expressions are evaluated with per thread contexts, so every executor thread keeps its own cache and no
+ * locking is needed. The cache is dropped when it grows past MaxEntries, selectors are expected to be a small set.
+ */
+class XPathCache {
+public:
+    static const size_t MaxEntries = 256;
+
+    ~XPathCache() {
+        Clear();
+    }
+
+    xmlXPathCompExprPtr Get(const std::string &expression) {
+        auto found = _compiled.find(expression);
+        if (found != _compiled.end()) return found->second;
+
+        auto compiled = xmlXPathCompile(reinterpret_cast<const xmlChar *>(expression.c_str()));
+        if (!compiled) {
+            throw std::runtime_error("Invalid XPath selector: " + expression);
+        }
+        if (_compiled.size() >= MaxEntries) Clear();
+        _compiled.emplace(expression, compiled);
+        return compiled;
+    }
+
+    static XPathCache &ForThread() {
+        thread_local XPathCache cache;
+        return cache;
+    }
+
+private:
+    void Clear() {
+        for (auto &entry: _compiled) xmlXPathFreeCompExpr(entry.second);
+        _compiled.clear();
+    }
+
+    std::unordered_map<std::string, xmlXPathCompExprPtr> _compiled;
+};
+
+static void IgnoreXmlError(void *, const char *, ...) {
+}
+
+/**
+ * libxml2 reports parse and compile errors on stderr by default, the caller gets them as exceptions instead.
+ * The handlers are thread local in libxml2, so they are installed once per thread.
+ */
+static void SilenceXmlErrors() {
+    thread_local bool silenced = false;
+    if (silenced) return;
+    xmlSetGenericErrorFunc(nullptr, IgnoreXmlError);
+    xmlSetStructuredErrorFunc(nullptr, nullptr);
+    silenced = true;
+}
+
+//endregion
+
+bool ReadXmlSelectors(Napi::Env env, const Napi::Value &value, XmlSelectors &selectors) {
+    if (value.IsArray()) {
+        auto array = value.As<Napi::Array>();
+        for (uint32_t i = 0; i < array.Length(); i++) {
+            auto item = array.Get(i);
+            if (!item.IsString()) {
+                Napi::TypeError::New(env, "Selectors must be strings").ThrowAsJavaScriptException();
+                return false;
+            }
+            auto expression = item.ToString().Utf8Value();
+            selectors.push_back({expression, expression});
+        }
+    } else if (value.IsObject()) {
+        auto object = value.ToObject();
+        auto keys = object.GetPropertyNames();
+        for (uint32_t i = 0; i < keys.Length(); i++) {
+            auto key = keys.Get(i).ToString().Utf8Value();
+            auto item = object.Get(key);
+            if (!item.IsString()) {
+                Napi::TypeError::New(env, "Selectors must be strings").ThrowAsJavaScriptException();
+                return false;
+            }
+            selectors.push_back({key, item.ToString().Utf8Value()});
+        }
+    } else {
+        Napi::TypeError::New(env, "Expected selectors as { key: xpath } or xpath[]").ThrowAsJavaScriptException();
+        return false;
+    }
+    if (selectors.empty()) {
+        Napi::TypeError::New(env, "At least one selector is required").ThrowAsJavaScriptException();
+        return false;
+    }
+    return true;
+}
+
+void CompileXmlSelectors(const XmlSelectors &selectors) {
+    SilenceXmlErrors();
+    auto &cache = XPathCache::ForThread();
+    for (const auto &selector: selectors) cache.Get(selector.expression);
+}
+
+XmlProjection ProjectXml(const std::string &xml, const XmlSelectors &selectors) {
+    SilenceXmlErrors();
+    auto &cache = XPathCache::ForThread();
+
+    std::unique_ptr<xmlDoc, void (*)(xmlDocPtr)> doc(
+            xmlReadMemory(xml.data(), static_cast<int>(xml.size()), "domain.xml", nullptr,
+                          XML_PARSE_NONET | XML_PARSE_NOBLANKS),
+            xmlFreeDoc);
+    if (!doc) {
+        throw std::runtime_error("Failed to parse XML document");
+    }
+    std::unique_ptr<xmlXPathContext, void (*)(xmlXPathContextPtr)> context(xmlXPathNewContext(doc.get()),
+                                                                           xmlXPathFreeContext);
+    if (!context) {
+        throw std::runtime_error("Failed to create XPath context");
+    }
+
+    XmlProjection projection;
+    projection.reserve(selectors.size());
+    for (const auto &selector: selectors) {
+        auto compiled = cache.Get(selector.expression);
+        std::unique_ptr<xmlXPathObject, void (*)(xmlXPathObjectPtr)> result(
+                xmlXPathCompiledEval(compiled, context.get()), xmlXPathFreeObject);
+        if (!result) {
+            throw std::runtime_error("Failed to evaluate XPath selector: " + selector.expression);
+        }
+
+        XmlValue value;
+        switch (result->type) {
+            case XPATH_NODESET:
+                value.kind = XmlValue::Nodes;
+                if (result->nodesetval) {
+                    value.nodes.reserve(result->nodesetval->nodeNr);
+                    for (int i = 0; i < result->nodesetval->nodeNr; i++) {
+                        auto content = xmlNodeGetContent(result->nodesetval->nodeTab[i]);
+                        value.nodes.emplace_back(content ? reinterpret_cast<const char *>(content) : "");
+                        xmlFree(content);
+                    }
+                }
+                break;
+            case XPATH_BOOLEAN:
+                value.kind = XmlValue::Boolean;
+                value.boolean = result->boolval != 0;
+                break;
+            case XPATH_NUMBER:
+                value.kind = XmlValue::Number;
+                value.number = result->floatval;
+                break;
+            case XPATH_STRING:
+                value.kind = XmlValue::String;
+                value.string = result->stringval ? reinterpret_cast<const char *>(result->stringval) : "";
+                break;
+            default:
+                throw std::runtime_error("Unsupported XPath result type: " + selector.expression);
+        }
+        projection.emplace_back(selector.key, std::move(value));
+    }
+    return projection;
+}
+
+Napi::Object XmlProjectionToObject(Napi::Env env, const XmlProjection &projection) {
+    auto obj = Napi::Object::New(env);
+    for (const auto &entry: projection) {
+        const auto &value = entry.second;
+        switch (value.kind) {
+            case XmlValue::Nodes: {
+                auto nodes = Napi::Array::New(env, value.nodes.size());
+                for (size_t i = 0; i < value.nodes.size(); i++) {
+                    nodes.Set(i, Napi::String::New(env, value.nodes[i]));
+                }
+                obj.Set(entry.first, nodes);
+                break;
+            }
+            case XmlValue::String:
+                obj.Set(entry.first, Napi::String::New(env, value.string));
+                break;
+            case XmlValue::Number:
+                obj.Set(entry.first, Napi::Number::New(env, value.number));
+                break;
+            case XmlValue::Boolean:
+                obj.Set(entry.first, Napi::Boolean::New(env, value.boolean));
+                break;
+        }
+    }
+    return obj;
+}
@@ -0,0 +1,55 @@
+//
+// Created by root on 4/8/24.
+//
+
+#ifndef NODE_LIBVIRT_XML_PROJECTION_H
+#define NODE_LIBVIRT_XML_PROJECTION_H
+
+#include <napi.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct XmlSelector {
+    std::string key;
+    std::string expression;
+};
+
+typedef std::vector<XmlSelector> XmlSelectors;
+
+/**
+ * Result of one selector: node sets become the string values of their nodes, other XPath results stay scalar.
+ */
+struct XmlValue {
+    enum Kind {
+        Nodes, String, Number, Boolean
+    } kind = Nodes;
+    std::vector<std::string> nodes;
+    std::string string;
+    double number = 0;
+    bool boolean = false;
+};
+
+typedef std::vector<std::pair<std::string, XmlValue>> XmlProjection;
+
+/**
+ * Read selectors from { key: "xpath" } or ["xpath", ...] (the expression is the key).
+ * Throws a JavaScript exception and returns false on invalid input.
+ */
+bool ReadXmlSelectors(Napi::Env env, const Napi::Value &value, XmlSelectors &selectors);
+
+/**
+ * Compile all selectors through the per thread cache, throws std::runtime_error naming the first invalid one.
+ * Safe to call from a worker thread.
+ */
+void CompileXmlSelectors(const XmlSelectors &selectors);
+
+/**
+ * Parse the document with libxml2 and evaluate the selectors against it.
+ * Safe to call from a worker thread; throws std::runtime_error on malformed XML or invalid selectors.
+ */
+XmlProjection ProjectXml(const std::string &xml, const XmlSelectors &selectors);
+
+Napi::Object XmlProjectionToObject(Napi::Env env, const XmlProjection &projection);
+
+#endif //NODE_LIBVIRT_XML_PROJECTION_H
@@ -0,0 +1,64 @@
+import {Hypervisor, AddressSource} from "../lib/binding";
+
+const hypervisor = new Hypervisor({
+    uri: "test:///default"
+});
+
+function check(condition: boolean, message: string) {
+    if (!condition) throw new Error(message);
+}
+
+function normalizeMac(mac: string) {
+    return mac.toLowerCase().replace(/-/g, ":");
+}
+
+async function main() {
+    await hypervisor.connect();
+    const domain = await hypervisor.lookupDomainByName("test");
+    const projection = await domain.queryXML({macs: "/domain/devices/interface/mac/@address"});
+    const macs = (projection.macs as string[]).map(normalizeMac);
+
+    /* The test driver reports the same addresses for every source, each must be listed once */
+    const inventory = await hypervisor.addressInventory({sources: ["lease", "agent", "arp", "dhcp"], concurrency: 2});
+    check(inventory.count === inventory.uuid.length && inventory.count === inventory.ip.length,
+        "Column lengths do not match count");
+
+    const keys = new Set<string>();
+    for (let i = 0; i < inventory.count; i++) {
+        const key = `${inventory.uuid[i]}|${normalizeMac(inventory.mac[i])}|${inventory.ip[i]}`;
+        check(!keys.has(key), `Duplicate inventory row ${key}`);
+        keys.add(key);
+
+        /* Rows carrying a MAC of the domain XML belong to that domain, whichever source found them */
+        if (macs.includes(normalizeMac(inventory.mac[i]))) {
+            check(inventory.uuid[i] === domain.uuid, `Row ${key} is not attributed to ${domain.uuid}`);
+        }
+        if (inventory.source[i] === AddressSource.DHCP && /^[0:-]*$/.test(inventory.mac[i])) {
+            check(inventory.uuid[i] === "", `DHCP row ${key} attributed through an unassigned MAC`);
+        }
+    }
+
+    /* Addresses the lease source reports are listed under it, not under a later source */
+    for (const iface of await domain.interfaceAddresses("lease")) {
+        for (const addr of iface.addrs) {
+            const rows = [];
+            for (let i = 0; i < inventory.count; i++) {
+                if (inventory.uuid[i] === domain.uuid && inventory.ip[i] === addr.addr) rows.push(i);
+            }
+            check(rows.length === 1, `Expected one row for ${addr.addr}, got ${rows.length}`);
+            check(inventory.source[rows[0]] === AddressSource.LEASE, `${addr.addr} is not listed under lease`);
+            check(inventory.interface[rows[0]] === iface.name, `${addr.addr} lists the wrong interface`);
+        }
+    }
+
+    for (const error of inventory.errors) {
+        console.log(`not read: ${error.source} ${error.target}: ${error.message}`);
+    }
+    await hypervisor.disconnect();
+    console.log("address inventory ok");
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
@@ -0,0 +1,88 @@
+import {Hypervisor} from "../lib/binding";
+import type {BalloonAction} from "../lib/types/balloon";
+
+const hypervisor = new Hypervisor({
+    uri: "test:///default"
+});
+
+function check(condition: boolean, message: string) {
+    if (!condition) throw new Error(message);
+}
+
+function sleep(ms: number) {
+    return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+function expectThrow(fn: () => void, type: Function, what: string) {
+    try {
+        fn();
+    } catch (error) {
+        check(error instanceof type, `${what}: expected a ${type.name}, got ${error}`);
+        return;
+    }
+    throw new Error(`${what}: expected a ${type.name}`);
+}
+
+async function main() {
+    await hypervisor.connect();
+    const domain = await hypervisor.lookupDomainByName("test");
+
+    const actions: BalloonAction[] = [];
+    /* A watermark above any guest makes every round try to grow it, or report why it could not */
+    const stepKiB = 1024;
+    const controller = hypervisor.createBalloonController([domain], {
+        minFreeKiB: 1024 * 1024 * 1024,
+        stepKiB,
+        intervalMs: 500,
+        cooldownMs: 0,
+        statsPeriod: 1
+    }, (batch) => actions.push(...batch));
+
+    check(controller.size === 1, "Expected one domain");
+    check(!controller.running, "Controller must start stopped");
+    check(controller.policy.intervalMs === 500 && controller.policy.stepKiB === stepKiB, "Policy was not applied");
+
+    /* The first round runs right away, the next one an interval later */
+    controller.start();
+    check(controller.running, "Controller did not start");
+    await sleep(1200);
+    controller.stop();
+    check(!controller.running, "Controller did not stop");
+    const rounds = controller.stats.rounds;
+    check(rounds >= 2, `Expected at least 2 rounds, got ${rounds}`);
+
+    await sleep(700);
+    check(controller.stats.rounds === rounds, "Rounds ran after stop");
+    const stats = controller.stats;
+    check(actions.filter((action) => action.type === "grow").length === stats.grown, "Listener missed grow actions");
+    check(actions.filter((action) => action.type === "error").length === stats.errors, "Listener missed errors");
+    check(stats.shrunk === 0, "Nothing is above a zero maxFreeKiB");
+    for (const action of actions) {
+        check(action.domain === 0, `Action for unknown domain ${action.domain}`);
+        if (action.type === "grow") {
+            check(action.toKiB > action.fromKiB && action.toKiB - action.fromKiB <= stepKiB,
+                `Grow from ${action.fromKiB} to ${action.toKiB} exceeds the step`);
+        } else {
+            check(action.type === "error" && action.message.length > 0, `Unexpected action ${JSON.stringify(action)}`);
+        }
+    }
+
+    /* Stopped controllers can be started again */
+    controller.start();
+    await sleep(200);
+    controller.stop();
+    check(controller.stats.rounds > rounds, "Restarted controller ran no round");
+
+    expectThrow(() => controller.setPolicy({intervalMs: 100}), RangeError, "intervalMs below 500");
+    expectThrow(() => controller.setPolicy({minFreeKiB: 2048, maxFreeKiB: 1024}), RangeError, "maxFreeKiB below minFreeKiB");
+    controller.setPolicy({stepKiB: 2048});
+    check(controller.policy.stepKiB === 2048 && controller.policy.intervalMs === 500, "setPolicy changed other fields");
+
+    await hypervisor.disconnect();
+    console.log("balloon ok");
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
@@ -0,0 +1,82 @@
+import {Hypervisor, Domain} from "../lib/binding";
+import {DomainState} from "../lib/types/domain";
+import type {BulkResult} from "../lib/types/hypervisor";
+
+const hypervisor = new Hypervisor({
+    uri: "test:///default"
+});
+
+function domainXML(name: string) {
+    return `
+<domain type='test'>
+  <name>${name}</name>
+  <memory>8192</memory>
+  <os>
+    <type>hvm</type>
+  </os>
+</domain>
+`;
+}
+
+function check(condition: boolean, message: string) {
+    if (!condition) throw new Error(message);
+}
+
+function checkAll(results: BulkResult[], status: BulkResult["status"], what: string) {
+    results.forEach((result, i) => {
+        check(result.status === status, `${what}: domain ${i} is ${JSON.stringify(result)}, expected ${status}`);
+    });
+}
+
+async function main() {
+    await hypervisor.connect();
+
+    const domains: Domain[] = [];
+    for (let i = 0; i < 6; i++) {
+        domains.push(await Domain.DefineXML(domainXML(`bulk-test-${i}`), hypervisor));
+    }
+
+    /* More domains than runners, every one is started once and the batch waits for all of them */
+    const options = {concurrency: 2, timeoutMs: 5000};
+    const started = await hypervisor.bulk("start", domains, options);
+    check(started.length === domains.length, "Expected one result per domain");
+    checkAll(started, "ok", "start");
+    for (const result of started) {
+        check(result.startedMs !== undefined && result.startedMs >= 0, "Started domain without startedMs");
+        check(result.durationMs >= 0, "Negative durationMs");
+    }
+    check(domains.every((domain) => domain.info.state === DomainState.RUNNING), "Not every domain is running");
+
+    checkAll(await hypervisor.bulk("suspend", domains, options), "ok", "suspend");
+    check(domains.every((domain) => domain.info.state === DomainState.PAUSED), "Not every domain is paused");
+    checkAll(await hypervisor.bulk("resume", domains, options), "ok", "resume");
+    checkAll(await hypervisor.bulk("destroy", domains, options), "ok", "destroy");
+
+    /* Failures are reported per domain, the rest of the batch still runs */
+    const failed = await hypervisor.bulk("resume", domains, options);
+    checkAll(failed, "error", "resume of inactive domains");
+    check(failed.every((result) => !!result.error), "Failed result without error");
+
+    /* Aborted before it ran, no domain is started */
+    const controller = new AbortController();
+    controller.abort();
+    const cancelled = await hypervisor.bulk("start", domains, {concurrency: 2, signal: controller.signal});
+    checkAll(cancelled, "cancelled", "aborted start");
+    check(cancelled.every((result) => result.startedMs === undefined), "Cancelled domain reports startedMs");
+
+    let rejected: unknown = null;
+    try {
+        await hypervisor.bulk("start", domains, {timeoutMs: -1});
+    } catch (error) {
+        rejected = error;
+    }
+    check(rejected instanceof RangeError, `Expected a RangeError for a negative timeoutMs, got ${rejected}`);
+
+    await hypervisor.disconnect();
+    console.log("bulk ok");
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
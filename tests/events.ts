@@ -0,0 +1,45 @@
+import {Hypervisor, Domain, domainEvents, DomainLifecycleEvent} from "../lib/binding";
+
+const hypervisor = new Hypervisor({
+    uri: "test:///default"
+});
+
+const domainXML = `
+<domain type='test'>
+  <name>events-test</name>
+  <memory>8192</memory>
+  <os>
+    <type>hvm</type>
+  </os>
+</domain>
+`
+
+async function main() {
+    await hypervisor.connect();
+
+    const events = await domainEvents(hypervisor, {events: ["lifecycle"]});
+    const received: DomainLifecycleEvent[] = [];
+    events.on("lifecycle", (event) => {
+        console.log(event);
+        received.push(event.event);
+    });
+
+    const domain = await Domain.DefineXML(domainXML, hypervisor);
+    await domain.create();
+
+    /* Events are delivered asynchronously by the native event loop thread */
+    await new Promise((resolve) => setTimeout(resolve, 500));
+    await events.stop();
+
+    for (const expected of [DomainLifecycleEvent.DEFINED, DomainLifecycleEvent.STARTED]) {
+        if (!received.includes(expected)) {
+            throw new Error(`Missing lifecycle event ${DomainLifecycleEvent[expected]}`);
+        }
+    }
+    console.log("events ok");
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
@@ -0,0 +1,50 @@
+import {Hypervisor} from "../lib/binding";
+
+const hypervisor = new Hypervisor({
+    uri: "test:///default"
+});
+
+function check(condition: boolean, message: string) {
+    if (!condition) throw new Error(message);
+}
+
+async function rejection(promise: Promise<unknown>): Promise<Error> {
+    try {
+        await promise;
+    } catch (error) {
+        return error as Error;
+    }
+    throw new Error("Expected the call to be cancelled");
+}
+
+async function main() {
+    await hypervisor.connect();
+    const domain = await hypervisor.lookupDomainByName("test");
+    const targets = [{domain, disks: [], interfaces: ["vnet0"]}];
+
+    /* The sampler is started only once the promise resolved */
+    const sampler = await hypervisor.createIoSampler(targets, {intervalMs: 100});
+    check(sampler.running, "Resolved sampler is not running");
+    sampler.stop();
+    check(!sampler.running, "Sampler did not stop");
+
+    /* Aborted before the call, and while it is queued or running: the discarded sampler is never started */
+    const aborted = new AbortController();
+    aborted.abort();
+    const early = await rejection(hypervisor.createIoSampler(targets, {signal: aborted.signal}));
+    check(early.name === "AbortError", `Expected an AbortError, got ${early}`);
+
+    const controller = new AbortController();
+    const pending = hypervisor.createIoSampler(targets, {intervalMs: 100, signal: controller.signal});
+    controller.abort();
+    const late = await rejection(pending);
+    check(late.name === "AbortError", `Expected an AbortError, got ${late}`);
+
+    await hypervisor.disconnect();
+    console.log("io sampler ok");
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
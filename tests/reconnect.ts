@@ -0,0 +1,63 @@
+import {Hypervisor} from "../lib/binding";
+import type {ConnectionState} from "../lib/types/hypervisor";
+
+const hypervisor = new Hypervisor({
+    uri: "test:///default",
+    reconnect: {initialDelayMs: 10}
+});
+
+function check(condition: boolean, message: string) {
+    if (!condition) throw new Error(message);
+}
+
+function waitForState(states: ConnectionState[], state: ConnectionState, timeoutMs = 5000): Promise<void> {
+    const start = Date.now();
+    return new Promise((resolve, reject) => {
+        const poll = () => {
+            if (states.includes(state)) return resolve();
+            if (Date.now() - start > timeoutMs) return reject(new Error(`Timed out waiting for ${state}`));
+            setTimeout(poll, 10);
+        };
+        poll();
+    });
+}
+
+async function main() {
+    await hypervisor.connect();
+    const states: ConnectionState[] = [];
+    hypervisor.setConnectionListener((event) => {
+        console.log(event);
+        states.push(event.state);
+    });
+
+    const domain = await hypervisor.lookupDomainByName("test");
+
+    /* WithRetry: operations queued during the reconnect continue on the new connections */
+    hypervisor.reconnect();
+    const [lookedUp, hostData] = await Promise.all([
+        hypervisor.lookupDomainByName("test"),
+        hypervisor.refreshHostData()
+    ]);
+    check(lookedUp === domain, "Lookup during the reconnect returned a new wrapper");
+    check(hostData.hostname.length > 0, "Host data was not reloaded");
+
+    await waitForState(states, "connected");
+    for (const expected of ["disconnected", "reconnecting", "connected"] as ConnectionState[]) {
+        check(states.includes(expected), `Missing state ${expected}`);
+    }
+    check(hypervisor.poolStats.reconnects === 1, "Reconnect was not counted");
+
+    /* Registry rebinding: entries went stale, lookups go to the new connection and keep the wrapper identity */
+    const rebound = await hypervisor.lookupDomainByName("test");
+    check(rebound === domain, "Registry lost the wrapper across the reconnect");
+    check(rebound.info.state !== undefined, "Domain handle is not usable after the reconnect");
+
+    hypervisor.setConnectionListener(null);
+    await hypervisor.disconnect();
+    console.log("reconnect ok");
+}
+
+main().catch((error) => {
+    console.error(error);
+    process.exit(1);
+});
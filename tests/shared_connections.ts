@@ -0,0 +1,111 @@
+import {isMainThread, parentPort, Worker, workerData} from "worker_threads";
+import {Hypervisor, libvirt} from "../lib/binding";
+import type {SharedConnectionStats} from "../lib/types/hypervisor";
+
+const uri = "test:///default";
+
+function check(condition: boolean, message: string) {
+    if (!condition) throw new Error(message);
+}
+
+function shared(): SharedConnectionStats | undefined {
+    return libvirt.GetSharedConnections().find((stats) => stats.uri === uri && !stats.readOnly);
+}
+
+/* Background tasks (host data refresh, event deregistration) hold the pool for a moment */
+function waitForCounts(users: number, holders: number, timeoutMs = 5000): Promise<void> {
+    const start = Date.now();
+    return new Promise((resolve, reject) => {
+        const poll = () => {
+            const stats = shared();
+            if (stats && stats.users === users && stats.holders === holders) return resolve();
+            if (Date.now() - start > timeoutMs) {
+                return reject(new Error(`Expected ${users} users and ${holders} holders, got ${JSON.stringify(stats)}`));
+            }
+            setTimeout(poll, 10);
+        };
+        poll();
+    });
+}
+
+/**
+ * Connects a shared Hypervisor, disconnects on "disconnect" and exits on "exit", a connected wrapper is left to the
+ * environment teardown.
+ */
+async function worker() {
+    const hypervisor = new Hypervisor({uri, shared: true});
+    await hypervisor.connect();
+    check((await hypervisor.refreshHostData()).hostname.length > 0, "Shared connection is not usable in the worker");
+    parentPort!.on("message", async (message: string) => {
+        if (message === "exit") process.exit(0);
+        await hypervisor.disconnect();
+        parentPort!.postMessage("disconnected");
+    });
+    parentPort!.postMessage("connected");
+}
+
+function startWorker(): Worker {
+    /* ts-node only hooks the main thread, register it again in the worker */
+    return new Worker(`require("ts-node/register"); require(require("worker_threads").workerData.file);`, {
+        eval: true,
+        workerData: {file: __filename}
+    });
+}
+
+function nextMessage(target: Worker, expected: string): Promise<void> {
+    return new Promise((resolve, reject) => {
+        target.once("message", (message) => message === expected
+            ? resolve() : reject(new Error(`Expected ${expected}, got ${message}`)));
+        target.once("error", reject);
+        target.once("exit", (code) => reject(new Error(`Worker exited with ${code} before ${expected}`)));
+    });
+}
+
+function exited(target: Worker): Promise<void> {
+    return new Promise((resolve) => target.once("exit", () => resolve()));
+}
+
+async function main() {
+    const hypervisor = new Hypervisor({uri, shared: true});
+    await hypervisor.connect();
+    await waitForCounts(1, 1);
+
+    /* A worker disconnecting gives up its user, its wrapper holds the pool until the worker is gone */
+    const first = startWorker();
+    await nextMessage(first, "connected");
+    await waitForCounts(2, 2);
+    first.postMessage("disconnect");
+    await nextMessage(first, "disconnected");
+    await waitForCounts(1, 2);
+    first.postMessage("exit");
+    await exited(first);
+    await waitForCounts(1, 1);
+    check(shared()!.state === "connected", "Pool was closed while the main thread still uses it");
+
+    /* A worker exiting without disconnect is detached when its environment is torn down */
+    const second = startWorker();
+    await nextMessage(second, "connected");
+    await waitForCounts(2, 2);
+    second.postMessage("exit");
+    await exited(second);
+    await waitForCounts(1, 1);
+    check(shared()!.state === "connected", "Pool was closed by a worker that exited");
+
+    /* The last user closes the pool, the entry lives as long as a wrapper holds it */
+    await hypervisor.disconnect();
+    await waitForCounts(0, 1);
+    check(shared()!.state === "closed", "Last disconnect did not close the shared pool");
+    console.log("shared connections ok");
+}
+
+if (isMainThread) {
+    main().catch((error) => {
+        console.error(error);
+        process.exit(1);
+    });
+} else if (workerData && workerData.file === __filename) {
+    worker().catch((error) => {
+        console.error(error);
+        process.exit(1);
+    });
+}